@@ -1,9 +1,320 @@
 #include "Abstract_Data.h"
 
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+
 MKV_Rendering::Abstract_Data::Abstract_Data(std::string my_folder, int index)
 {
 	folder_name = my_folder;
 	this->index = index;
+
+	startup_mark = std::chrono::steady_clock::now();
+}
+
+void MKV_Rendering::Abstract_Data::MarkStartupStep(std::string step)
+{
+	auto now = std::chrono::steady_clock::now();
+
+	startup_steps.push_back({ step, std::chrono::duration<double, std::milli>(now - startup_mark).count() });
+
+	startup_mark = now;
+}
+
+void MKV_Rendering::Abstract_Data::StageFrame(std::shared_ptr<open3d::geometry::RGBDImage> frame, uint64_t timestamp)
+{
+	staged_frame = frame;
+	staged_timestamp = timestamp;
+}
+
+void MKV_Rendering::Abstract_Data::ClearStagedFrame()
+{
+	staged_frame = nullptr;
+	staged_timestamp = 0;
+}
+
+void MKV_Rendering::Abstract_Data::DeferColor(std::shared_ptr<open3d::geometry::RGBDImage> frame, const uint8_t* payload, size_t size)
+{
+	//Empty, but a pooled frame keeps its memory for when the color is decoded
+	frame->color_.Prepare(0, 0, 3, sizeof(uint8_t));
+
+	deferred_color_payload.assign(payload, payload + size);
+	deferred_color_frame = frame;
+	deferred_color_timestamp = _timestamp;
+}
+
+std::shared_ptr<open3d::geometry::RGBDImage> MKV_Rendering::Abstract_Data::AcquireFrameRGBD()
+{
+	return AcquireFrame(FRAME_STREAM_ALL);
+}
+
+std::shared_ptr<open3d::geometry::RGBDImage> MKV_Rendering::Abstract_Data::AcquireFrame(int streams)
+{
+	if (staged_frame != nullptr)
+	{
+		return staged_frame;
+	}
+
+	if (read_ahead_frame != nullptr && read_ahead_timestamp == _timestamp)
+	{
+		return read_ahead_frame;
+	}
+
+	bool wants_color = (streams & FRAME_STREAM_COLOR) != 0;
+
+	if (deferred_color_frame != nullptr && deferred_color_timestamp == _timestamp)
+	{
+		if (!wants_color)
+		{
+			return deferred_color_frame;
+		}
+
+		auto frame = deferred_color_frame;
+
+		//Depth is already done, only the color is left
+		bool decoded = DecodeDeferredColor(*frame);
+
+		deferred_color_frame = nullptr;
+
+		if (decoded)
+		{
+			return frame;
+		}
+	}
+
+	deferred_color_frame = nullptr;
+
+	return wants_color ? GetFrameRGBD() : GetFrameStreams(streams);
+}
+
+void MKV_Rendering::Abstract_Data::AcquireFrameTensors(open3d::t::geometry::Image& color, open3d::t::geometry::Image& depth, open3d::core::Device device)
+{
+	auto rgbd = AcquireFrameRGBD();
+
+	color = FramePool::ViewAsTensor(rgbd, rgbd->color_).To(device);
+	depth = FramePool::ViewAsTensor(rgbd, rgbd->depth_).To(device);
+}
+
+bool MKV_Rendering::Abstract_Data::TransformDepthToColor(k4a_calibration_t* calibration, k4a_transformation_t transform, uint16_t* depth, int width, int height, open3d::geometry::Image* color_space_depth, MatteMask* matte)
+{
+	if (depth_transform_mode != DepthTransformMode::K4A && reprojector == nullptr)
+	{
+		reprojector = std::make_unique<DepthReprojector>(*calibration);
+	}
+
+	bool success = false;
+
+	switch (depth_transform_mode)
+	{
+	case DepthTransformMode::TABLES:
+		success = reprojector->Reproject(depth, width, height, *color_space_depth, matte);
+		break;
+
+	case DepthTransformMode::COMPARE:
+		success = TransformDepthToColorK4A(transform, depth, width, height, color_space_depth);
+
+		if (success)
+		{
+			comparison_depth.Prepare(color_space_depth->width_, color_space_depth->height_, 1, sizeof(uint16_t));
+
+			if (reprojector->Reproject(depth, width, height, comparison_depth, matte))
+			{
+				if (matte != nullptr)
+				{
+					matte->ApplyToDepth(comparison_depth);
+					matte->ApplyToDepth(*color_space_depth);
+				}
+
+				DepthReprojector::CompareDepthImages(folder_name + " at " + std::to_string(_timestamp), *color_space_depth, comparison_depth);
+			}
+		}
+		break;
+
+	default:
+		success = TransformDepthToColorK4A(transform, depth, width, height, color_space_depth);
+		break;
+	}
+
+	if (success && matte != nullptr)
+	{
+		matte->ApplyToDepth(*color_space_depth);
+	}
+
+	return success;
+}
+
+bool MKV_Rendering::Abstract_Data::TransformDepthToFrame(k4a_calibration_t* calibration, k4a_transformation_t transform, uint16_t* depth, int width, int height, open3d::geometry::Image* frame_depth, MatteMask* matte)
+{
+	int color_width = calibration->color_camera_calibration.resolution_width;
+	int color_height = calibration->color_camera_calibration.resolution_height;
+
+	if (frame_region.IsFull())
+	{
+		frame_depth->Prepare(color_width, color_height, 1, sizeof(uint16_t));
+
+		return TransformDepthToColor(calibration, transform, depth, width, height, frame_depth, matte);
+	}
+
+	full_depth_buffer.Prepare(color_width, color_height, 1, sizeof(uint16_t));
+
+	if (!TransformDepthToColor(calibration, transform, depth, width, height, &full_depth_buffer, matte))
+	{
+		return false;
+	}
+
+	frame_region.CropDepth(full_depth_buffer, *frame_depth);
+
+	return true;
+}
+
+void MKV_Rendering::Abstract_Data::SetDepthCameraParameters(k4a_calibration_t* calibration)
+{
+	auto& params = calibration->depth_camera_calibration.intrinsics.parameters.param;
+
+	depth_width = calibration->depth_camera_calibration.resolution_width;
+	depth_height = calibration->depth_camera_calibration.resolution_height;
+
+	depth_intrinsic_mat = Eigen::Matrix3d::Identity();
+	depth_intrinsic_mat(0, 0) = params.fx;
+	depth_intrinsic_mat(1, 1) = params.fy;
+	depth_intrinsic_mat(0, 2) = params.cx;
+	depth_intrinsic_mat(1, 2) = params.cy;
+
+	depth_intrinsic_t = open3d::core::Tensor::Init<double>({
+			{params.fx, 0, params.cx},
+			{0, params.fy, params.cy},
+			{0, 0, 1}
+		});
+
+	auto& depth_to_color = calibration->extrinsics[K4A_CALIBRATION_TYPE_DEPTH][K4A_CALIBRATION_TYPE_COLOR];
+
+	//k4a gives depth to color in millimeters, the extrinsic matrices are in meters
+	Eigen::Matrix4d depth_to_color_mat = Eigen::Matrix4d::Identity();
+
+	for (int i = 0; i < 9; ++i)
+	{
+		depth_to_color_mat(i / 3, i % 3) = depth_to_color.rotation[i];
+	}
+
+	for (int i = 0; i < 3; ++i)
+	{
+		depth_to_color_mat(i, 3) = depth_to_color.translation[i] / 1000.0;
+	}
+
+	depth_extrinsic_mat = depth_to_color_mat.inverse() * extrinsic_mat;
+	depth_extrinsic_t = open3d::core::eigen_converter::EigenMatrixToTensor(depth_extrinsic_mat);
+}
+
+open3d::camera::PinholeCameraParameters MKV_Rendering::Abstract_Data::GetFrameParameters()
+{
+	auto params = GetParameters();
+
+	int width = depth_width;
+	int height = depth_height;
+
+	if (!frame_in_depth_space)
+	{
+		frame_region.DecodedSize(params.intrinsic_.width_, params.intrinsic_.height_, width, height);
+	}
+
+	Eigen::Matrix3d int_mat = GetFrameIntrinsicMat();
+
+	params.intrinsic_.SetIntrinsics(width, height, int_mat(0, 0), int_mat(1, 1), int_mat(0, 2), int_mat(1, 2));
+	params.extrinsic_ = GetFrameExtrinsicMat();
+
+	return params;
+}
+
+bool MKV_Rendering::Abstract_Data::TransformFrame(k4a_calibration_t* calibration, k4a_transformation_t transform, uint16_t* depth, int width, int height, open3d::geometry::RGBDImage* frame, MatteMask* matte)
+{
+	if (!integrate_in_depth_space)
+	{
+		frame_in_depth_space = false;
+
+		return TransformDepthToFrame(calibration, transform, depth, width, height, &frame->depth_, matte);
+	}
+
+	//Only the tables can map color onto depth, whichever way depth would be moved otherwise
+	if (reprojector == nullptr)
+	{
+		reprojector = std::make_unique<DepthReprojector>(*calibration);
+	}
+
+	if (!reprojector->HasDepthSpaceTables())
+	{
+		reprojector->BuildDepthSpaceTables(*calibration);
+		SetDepthCameraParameters(calibration);
+	}
+
+	//The decoded color moves aside, the frame's color becomes the one mapped onto the depth camera
+	decoded_color_buffer.data_.swap(frame->color_.data_);
+	decoded_color_buffer.width_ = frame->color_.width_;
+	decoded_color_buffer.height_ = frame->color_.height_;
+	decoded_color_buffer.num_of_channels_ = frame->color_.num_of_channels_;
+	decoded_color_buffer.bytes_per_channel_ = frame->color_.bytes_per_channel_;
+
+	frame_in_depth_space = reprojector->MapColorToDepth(depth, width, height, decoded_color_buffer, frame_region, frame->depth_, frame->color_, matte);
+
+	return frame_in_depth_space;
+}
+
+bool MKV_Rendering::Abstract_Data::TransformDepthToColorK4A(k4a_transformation_t transform, uint16_t* depth, int width, int height, open3d::geometry::Image* color_space_depth)
+{
+	k4a_image_t k4a_transformed_depth = nullptr;
+	k4a_image_t k4a_depth = nullptr;
+
+	if (K4A_RESULT_SUCCEEDED !=
+		k4a_image_create_from_buffer(k4a_image_format_t::K4A_IMAGE_FORMAT_DEPTH16, width, height, width * sizeof(uint16_t),
+			reinterpret_cast<uint8_t*>(depth), width * height * sizeof(uint16_t), nullptr, nullptr, &k4a_depth))
+	{
+		ErrorLogger::LOG_ERROR("Failed to create a source depth image at " + std::to_string(_timestamp) + ".", true);
+		return false;
+	}
+
+	if (K4A_RESULT_SUCCEEDED !=
+		k4a_image_create_from_buffer(k4a_image_format_t::K4A_IMAGE_FORMAT_DEPTH16, color_space_depth->width_, color_space_depth->height_, color_space_depth->BytesPerLine(),
+			color_space_depth->data_.data(), color_space_depth->data_.size(), nullptr, nullptr, &k4a_transformed_depth))
+	{
+		ErrorLogger::LOG_ERROR("Failed to create a destination depth image at " + std::to_string(_timestamp) + ".", true);
+		k4a_image_release(k4a_depth);
+		return false;
+	}
+
+	bool success = (K4A_RESULT_SUCCEEDED ==
+		k4a_transformation_depth_image_to_color_camera(
+			transform, k4a_depth, k4a_transformed_depth));
+
+	if (!success)
+	{
+		ErrorLogger::LOG_ERROR("Failed to transform depth frame to color frame at " + std::to_string(_timestamp) + ".", true);
+	}
+
+	k4a_image_release(k4a_depth);
+	k4a_image_release(k4a_transformed_depth);
+
+	return success;
+}
+
+bool MKV_Rendering::Abstract_Data::ParseDepthTransformMode(std::string name, DepthTransformMode& mode)
+{
+	if (name == "k4a")
+	{
+		mode = DepthTransformMode::K4A;
+	}
+	else if (name == "tables")
+	{
+		mode = DepthTransformMode::TABLES;
+	}
+	else if (name == "compare")
+	{
+		mode = DepthTransformMode::COMPARE;
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
 }
 
 open3d::core::Tensor MKV_Rendering::Abstract_Data::GetIntrinsic()
@@ -15,3 +326,91 @@ open3d::core::Tensor MKV_Rendering::Abstract_Data::GetExtrinsic()
 {
 	return extrinsic_t;
 }
+
+open3d::core::Tensor MKV_Rendering::Abstract_Data::GetFrameIntrinsic()
+{
+	if (frame_in_depth_space)
+	{
+		return depth_intrinsic_t;
+	}
+
+	if (frame_region.IsFull())
+	{
+		return intrinsic_t;
+	}
+
+	Eigen::Matrix3d scaled = GetFrameIntrinsicMat();
+
+	return open3d::core::Tensor::Init<double>({
+			{scaled(0, 0), 0, scaled(0, 2)},
+			{0, scaled(1, 1), scaled(1, 2)},
+			{0, 0, 1}
+		});
+}
+
+MKV_Rendering::JPEGDecodeRegion MKV_Rendering::Abstract_Data::ChooseDecodeRegion(float voxel_size, Eigen::Vector3d box_min, Eigen::Vector3d box_max)
+{
+	JPEGDecodeRegion region;
+
+	double nearest = DBL_MAX;
+
+	double left = DBL_MAX;
+	double top = DBL_MAX;
+	double right = -DBL_MAX;
+	double bottom = -DBL_MAX;
+
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		Eigen::Vector3d world(
+			(corner & 1) ? box_max.x() : box_min.x(),
+			(corner & 2) ? box_max.y() : box_min.y(),
+			(corner & 4) ? box_max.z() : box_min.z());
+
+		Eigen::Vector3d camera = extrinsic_mat.block<3, 3>(0, 0) * world + extrinsic_mat.block<3, 1>(0, 3);
+
+		//The box reaches behind the camera, its outline cannot be projected
+		if (camera.z() <= 0.0)
+		{
+			return region;
+		}
+
+		nearest = std::min(nearest, camera.z());
+
+		Eigen::Vector3d uvz = intrinsic_mat * camera;
+
+		left = std::min(left, uvz.x() / uvz.z());
+		right = std::max(right, uvz.x() / uvz.z());
+		top = std::min(top, uvz.y() / uvz.z());
+		bottom = std::max(bottom, uvz.y() / uvz.z());
+	}
+
+	//A pixel at distance z covers z / fx meters, scaled pixels cover scale times that
+	double pixel_size = nearest / intrinsic_mat(0, 0);
+
+	for (int scale = 8; scale > 1; scale /= 2)
+	{
+		if (scale * pixel_size <= voxel_size)
+		{
+			region.scale = scale;
+			break;
+		}
+	}
+
+	//A little margin so the subject's edges are not lost to rounding
+	int margin = 8 * region.scale;
+
+	int x0 = std::max(0, (int)std::floor(left) - margin);
+	int y0 = std::max(0, (int)std::floor(top) - margin);
+	int x1 = std::min(imageWidth, (int)std::ceil(right) + margin);
+	int y1 = std::min(imageHeight, (int)std::ceil(bottom) + margin);
+
+	if (x1 > x0 && y1 > y0 && (x0 > 0 || y0 > 0 || x1 < imageWidth || y1 < imageHeight))
+	{
+		region.x = x0;
+		region.y = y0;
+		region.width = x1 - x0;
+		region.height = y1 - y0;
+	}
+
+	return region;
+}
@@ -3,16 +3,52 @@
 #include "open3d/Open3D.h"
 #include "VoxelGridData.h"
 #include "ErrorLogger.h"
+#include "FramePool.h"
+#include "DepthReprojector.h"
+#include "FrameCache.h"
+#include "ImageDecoder.h"
 
 #include <k4a/k4a.h>
 #include <k4arecord/record.h>
 #include <string>
 #include <vector>
 #include <iostream>
+#include <chrono>
 #include "MeshingVoxelGrid.h"
 
 namespace MKV_Rendering {
 
+	/// <summary>
+	/// How a camera moves its depth images into the color camera's image plane
+	/// </summary>
+	enum class DepthTransformMode
+	{
+		/// <summary>
+		/// k4a_transformation_depth_image_to_color_camera
+		/// </summary>
+		K4A,
+
+		/// <summary>
+		/// Precomputed reprojection tables
+		/// </summary>
+		TABLES,
+
+		/// <summary>
+		/// Both, keeping the k4a result and printing how far the tables are from it
+		/// </summary>
+		COMPARE
+	};
+
+	/// <summary>
+	/// Which images of a frame a caller needs, combined as bits
+	/// </summary>
+	enum FrameStreamMask
+	{
+		FRAME_STREAM_DEPTH = 1,
+		FRAME_STREAM_COLOR = 2,
+		FRAME_STREAM_ALL = FRAME_STREAM_DEPTH | FRAME_STREAM_COLOR
+	};
+
 	/// <summary>
 	/// Default class that all other camera data inherits from - defines a single camera
 	/// </summary>
@@ -64,6 +100,197 @@ namespace MKV_Rendering {
 		/// </summary>
 		int index = -1;
 
+		/// <summary>
+		/// A frame decoded ahead of time, used in place of decoding the current capture
+		/// </summary>
+		std::shared_ptr<open3d::geometry::RGBDImage> staged_frame = nullptr;
+
+		/// <summary>
+		/// Time of the staged frame
+		/// </summary>
+		uint64_t staged_timestamp = 0;
+
+		/// <summary>
+		/// The current capture, decoded from files read ahead in a batch with the other cameras
+		/// </summary>
+		std::shared_ptr<open3d::geometry::RGBDImage> read_ahead_frame = nullptr;
+
+		/// <summary>
+		/// Time of the capture the read ahead frame belongs to, so it is never used once the camera has moved on
+		/// </summary>
+		uint64_t read_ahead_timestamp = 0;
+
+		/// <summary>
+		/// A frame handed out without its color, which is kept compressed in deferred_color_payload until asked for
+		/// </summary>
+		std::shared_ptr<open3d::geometry::RGBDImage> deferred_color_frame = nullptr;
+
+		/// <summary>
+		/// Time of the capture the deferred color frame belongs to
+		/// </summary>
+		uint64_t deferred_color_timestamp = 0;
+
+		/// <summary>
+		/// The deferred color frame's color, still compressed
+		/// </summary>
+		std::vector<uint8_t> deferred_color_payload;
+
+		/// <summary>
+		/// Leaves a frame's color empty and keeps its compressed color, to be decoded if the frame is asked for with color
+		/// </summary>
+		/// <param name="frame">: the frame, its color memory is kept for the decode</param>
+		/// <param name="payload">: the compressed color to keep, nullptr for cameras that can find it again themselves</param>
+		/// <param name="size">: size of the compressed color in bytes</param>
+		void DeferColor(std::shared_ptr<open3d::geometry::RGBDImage> frame, const uint8_t* payload, size_t size);
+
+		/// <summary>
+		/// Decodes deferred_color_payload into a frame's color
+		/// </summary>
+		/// <returns>Successfully(?) decoded, false if this camera never defers color</returns>
+		virtual bool DecodeDeferredColor(open3d::geometry::RGBDImage& frame)
+		{
+			return false;
+		}
+
+		/// <summary>
+		/// Time spent on each step of this camera's construction in milliseconds, in order
+		/// </summary>
+		std::vector<std::pair<std::string, double>> startup_steps;
+
+		/// <summary>
+		/// When the previous construction step ended
+		/// </summary>
+		std::chrono::steady_clock::time_point startup_mark;
+
+		/// <summary>
+		/// Records the time since the previous step, or since construction began, as a construction step
+		/// </summary>
+		/// <param name="step">: name of the step that just ended</param>
+		void MarkStartupStep(std::string step);
+
+		/// <summary>
+		/// Frames this camera decodes into, recycled once consumers release them
+		/// </summary>
+		FramePool frame_pool;
+
+		/// <summary>
+		/// Decoded frames shared across the manager's cameras, nullptr if this camera does not cache
+		/// </summary>
+		FrameCache* frame_cache = nullptr;
+
+		/// <summary>
+		/// How depth is moved into the color camera's image plane
+		/// </summary>
+		DepthTransformMode depth_transform_mode = DepthTransformMode::K4A;
+
+		/// <summary>
+		/// Precomputed depth to color mapping, built the first time it is needed
+		/// </summary>
+		std::unique_ptr<DepthReprojector> reprojector = nullptr;
+
+		/// <summary>
+		/// Holds the table result when comparing it against k4a
+		/// </summary>
+		open3d::geometry::Image comparison_depth;
+
+		/// <summary>
+		/// The part of each color image to decode and its scale, for cameras whose color is JPG
+		/// </summary>
+		JPEGDecodeRegion decode_region;
+
+		/// <summary>
+		/// The region frames are actually decoded at, after the decoder fitted decode_region to the image. The same for every
+		/// frame of a camera, full for cameras that always decode whole images
+		/// </summary>
+		JPEGDecodeRegion frame_region;
+
+		/// <summary>
+		/// Full resolution depth in the color camera's plane, before being cut down to frame_region
+		/// </summary>
+		open3d::geometry::Image full_depth_buffer;
+
+		/// <summary>
+		/// Frames are wanted in the depth camera's space and resolution, for cameras that keep their raw depth
+		/// </summary>
+		bool integrate_in_depth_space = false;
+
+		/// <summary>
+		/// Frames are actually decoded in the depth camera's space, the same for every frame of a camera like frame_region
+		/// </summary>
+		bool frame_in_depth_space = false;
+
+		/// <summary>
+		/// The depth camera's undistorted intrinsic matrix, filled when frames are first put in its space
+		/// </summary>
+		Eigen::Matrix3d depth_intrinsic_mat = Eigen::Matrix3d::Identity();
+		open3d::core::Tensor depth_intrinsic_t;
+
+		/// <summary>
+		/// World to depth camera extrinsic matrix, filled with depth_intrinsic_mat
+		/// </summary>
+		Eigen::Matrix4d depth_extrinsic_mat = Eigen::Matrix4d::Identity();
+		open3d::core::Tensor depth_extrinsic_t;
+
+		//The depth camera's resolution, filled with depth_intrinsic_mat
+		int depth_width = 0;
+		int depth_height = 0;
+
+		/// <summary>
+		/// Decoded color, before being mapped onto the depth camera's pixels
+		/// </summary>
+		open3d::geometry::Image decoded_color_buffer;
+
+		/// <summary>
+		/// Works out the depth camera's matrices from the calibration and this camera's extrinsic matrix
+		/// </summary>
+		/// <param name="calibration">: the camera's calibration</param>
+		void SetDepthCameraParameters(k4a_calibration_t* calibration);
+
+		/// <summary>
+		/// Moves a frame's depth onto its color with TransformDepthToFrame, or when frames are wanted in the depth camera's space,
+		/// keeps the depth where it is and maps the color onto it instead
+		/// </summary>
+		/// <param name="calibration">: the camera's calibration</param>
+		/// <param name="transform">: the camera's k4a transformation</param>
+		/// <param name="depth">: 16 bit depth at the depth camera's resolution</param>
+		/// <param name="width">: width of the depth image</param>
+		/// <param name="height">: height of the depth image</param>
+		/// <param name="frame">: holds the decoded color, and receives the depth, and the mapped color in the depth camera's space</param>
+		/// <param name="matte">: if given, depth outside the matte is zeroed</param>
+		/// <returns>Successfully(?) transformed</returns>
+		bool TransformFrame(k4a_calibration_t* calibration, k4a_transformation_t transform, uint16_t* depth, int width, int height, open3d::geometry::RGBDImage* frame, MatteMask* matte = nullptr);
+
+		/// <summary>
+		/// Moves depth into the color camera's plane as TransformDepthToColor does, then onto frame_region's pixels
+		/// </summary>
+		/// <param name="calibration">: the camera's calibration</param>
+		/// <param name="transform">: the camera's k4a transformation</param>
+		/// <param name="depth">: 16 bit depth at the depth camera's resolution</param>
+		/// <param name="width">: width of the depth image</param>
+		/// <param name="height">: height of the depth image</param>
+		/// <param name="frame_depth">: destination, prepared to fit</param>
+		/// <param name="matte">: if given, depth outside the matte is zeroed</param>
+		/// <returns>Successfully(?) transformed</returns>
+		bool TransformDepthToFrame(k4a_calibration_t* calibration, k4a_transformation_t transform, uint16_t* depth, int width, int height, open3d::geometry::Image* frame_depth, MatteMask* matte = nullptr);
+
+		/// <summary>
+		/// Moves a depth image into the color camera's image plane, using the selected method
+		/// </summary>
+		/// <param name="calibration">: the camera's calibration</param>
+		/// <param name="transform">: the camera's k4a transformation</param>
+		/// <param name="depth">: 16 bit depth at the depth camera's resolution</param>
+		/// <param name="width">: width of the depth image</param>
+		/// <param name="height">: height of the depth image</param>
+		/// <param name="color_space_depth">: destination, already prepared at the color camera's resolution</param>
+		/// <param name="matte">: if given, depth outside the matte is zeroed, and the tables skip work outside the subject</param>
+		/// <returns>Successfully(?) transformed</returns>
+		bool TransformDepthToColor(k4a_calibration_t* calibration, k4a_transformation_t transform, uint16_t* depth, int width, int height, open3d::geometry::Image* color_space_depth, MatteMask* matte = nullptr);
+
+		/// <summary>
+		/// The k4a path of TransformDepthToColor
+		/// </summary>
+		bool TransformDepthToColorK4A(k4a_transformation_t transform, uint16_t* depth, int width, int height, open3d::geometry::Image* color_space_depth);
+
 	public:
 		/// <summary>
 		/// Constructor. Say hi! :D
@@ -71,6 +298,9 @@ namespace MKV_Rendering {
 		/// <param name="my_folder">: Where to find the images</param>
 		Abstract_Data(std::string my_folder, int index);
 
+		//Destructor. Say goodbye! :(
+		virtual ~Abstract_Data() {}
+
 		/// <summary>
 		/// Parses the time of the current capture
 		/// </summary>
@@ -96,12 +326,70 @@ namespace MKV_Rendering {
 		/// <returns>Successfully(?) jumped</returns>
 		virtual bool SeekToTime(uint64_t time) = 0;
 
+		/// <summary>
+		/// Lists the time of every capture, in playback order, on this camera's own clock
+		/// </summary>
+		/// <param name="timeline">: where to write the times, replaced</param>
+		/// <returns>False if this camera cannot list its captures</returns>
+		virtual bool GetCaptureTimeline(std::vector<uint64_t>& timeline)
+		{
+			return false;
+		}
+
+		/// <summary>
+		/// Time on this camera's clock at which its recording started, so cameras can be lined up
+		/// </summary>
+		virtual uint64_t GetTimelineOffset()
+		{
+			return 0;
+		}
+
+		/// <summary>
+		/// Jumps to a capture by its position in GetCaptureTimeline
+		/// </summary>
+		/// <param name="capture">: the capture's position</param>
+		/// <returns>Successfully(?) jumped</returns>
+		virtual bool SeekToCaptureIndex(size_t capture)
+		{
+			return false;
+		}
+
 		/// <summary>
 		/// Gets a single RGBD image from the livescan data
 		/// </summary>
 		/// <returns>Pointer to RGBD image</returns>
 		virtual std::shared_ptr<open3d::geometry::RGBDImage> GetFrameRGBD() = 0;
 
+		/// <summary>
+		/// Gets a single RGBD image with only some of its images decoded. Cameras that cannot skip color decode it anyway
+		/// </summary>
+		/// <param name="streams">: FrameStreamMask bits of the images needed</param>
+		/// <returns>Pointer to RGBD image, its color is empty if it was not asked for and was skipped</returns>
+		virtual std::shared_ptr<open3d::geometry::RGBDImage> GetFrameStreams(int streams)
+		{
+			return GetFrameRGBD();
+		}
+
+		/// <summary>
+		/// Lists the files GetFrameRGBD would read for the current capture, so they can be read ahead in a batch
+		/// </summary>
+		/// <param name="files">: where to write the paths, replaced</param>
+		/// <returns>False if this camera does not read whole files, or the frame needs no reads</returns>
+		virtual bool GetFrameFiles(std::vector<std::string>& files)
+		{
+			return false;
+		}
+
+		/// <summary>
+		/// Decodes the current capture from the contents of the files listed by GetFrameFiles
+		/// </summary>
+		/// <param name="contents">: each file's contents, in the order they were listed</param>
+		/// <returns>Pointer to RGBD image, nullptr if this camera cannot decode from memory</returns>
+		virtual std::shared_ptr<open3d::geometry::RGBDImage> GetFrameRGBDFromMemory(std::vector<std::vector<uint8_t>*>& contents)
+		{
+			return nullptr;
+		}
+
 		/// <summary>
 		/// Gets the pinhole camera parameters
 		/// </summary>
@@ -130,13 +418,114 @@ namespace MKV_Rendering {
 
 		}
 
+		/// <summary>
+		/// Writes every frame of this camera, still compressed, into a single packed container
+		/// </summary>
+		/// <param name="container_path">: the file to write</param>
+		/// <returns>Successfully(?) written</returns>
+		virtual bool WritePackedContainer(std::string container_path)
+		{
+			ErrorLogger::LOG_ERROR("Camera " + std::to_string(index) + " cannot be packed!");
+			return false;
+		}
+
+		/// <summary>
+		/// Sets a frame that was decoded elsewhere as this camera's current frame
+		/// </summary>
+		/// <param name="frame">: the decoded frame</param>
+		/// <param name="timestamp">: time of the capture the frame came from</param>
+		void StageFrame(std::shared_ptr<open3d::geometry::RGBDImage> frame, uint64_t timestamp);
+
+		/// <summary>
+		/// Drops the staged frame, so that frames are decoded from the current capture again
+		/// </summary>
+		void ClearStagedFrame();
+
+		bool HasStagedFrame() { return staged_frame != nullptr; }
+
+		/// <summary>
+		/// Sets the current capture's frame, decoded from files read ahead
+		/// </summary>
+		void SetReadAheadFrame(std::shared_ptr<open3d::geometry::RGBDImage> frame) { read_ahead_frame = frame; read_ahead_timestamp = _timestamp; }
+
+		/// <summary>
+		/// Drops the read ahead frame, to be called whenever the current capture changes
+		/// </summary>
+		void ClearReadAheadFrame() { read_ahead_frame = nullptr; }
+
+		/// <summary>
+		/// Gets the staged frame if there is one, then the read ahead frame, otherwise decodes the current capture
+		/// </summary>
+		/// <returns>Pointer to RGBD image</returns>
+		std::shared_ptr<open3d::geometry::RGBDImage> AcquireFrameRGBD();
+
+		/// <summary>
+		/// AcquireFrameRGBD for callers that only need some of the frame's images. A frame given without its color has the
+		/// color decoded in place once the same capture is asked for with color
+		/// </summary>
+		/// <param name="streams">: FrameStreamMask bits of the images needed</param>
+		/// <returns>Pointer to RGBD image</returns>
+		std::shared_ptr<open3d::geometry::RGBDImage> AcquireFrame(int streams);
+
+		/// <summary>
+		/// Gets the current frame as tensor images sharing the frame's memory, the same frame AcquireFrameRGBD gives
+		/// </summary>
+		/// <param name="color">: where to put the color view</param>
+		/// <param name="depth">: where to put the depth view</param>
+		/// <param name="device">: where the tensors are needed, only a device other than the CPU costs a copy</param>
+		void AcquireFrameTensors(open3d::t::geometry::Image& color, open3d::t::geometry::Image& depth, open3d::core::Device device);
+
 		open3d::core::Tensor GetIntrinsic();
 		open3d::core::Tensor GetExtrinsic();
 
+		/// <summary>
+		/// Intrinsics of the decoded frames, which differ from GetIntrinsic when only part of each color image is decoded,
+		/// or when frames are in the depth camera's space
+		/// </summary>
+		open3d::core::Tensor GetFrameIntrinsic();
+		Eigen::Matrix3d GetFrameIntrinsicMat() { return frame_in_depth_space ? depth_intrinsic_mat : frame_region.ScaleIntrinsic(intrinsic_mat); }
+
+		/// <summary>
+		/// Extrinsics of the decoded frames, the depth camera's when frames are in its space
+		/// </summary>
+		open3d::core::Tensor GetFrameExtrinsic() { return frame_in_depth_space ? depth_extrinsic_t : extrinsic_t; }
+		Eigen::Matrix4d GetFrameExtrinsicMat() { return frame_in_depth_space ? depth_extrinsic_mat : extrinsic_mat; }
+
+		/// <summary>
+		/// Pinhole camera parameters of the decoded frames, sized to them, where GetParameters describes the full color image
+		/// </summary>
+		/// <returns>Pinhole camera parameters</returns>
+		open3d::camera::PinholeCameraParameters GetFrameParameters();
+
+		/// <summary>
+		/// Asks for frames in the depth camera's space, taking effect from the next decoded frame. Cameras without raw depth
+		/// keep giving frames in the color camera's space
+		/// </summary>
+		void SetIntegrateInDepthSpace(bool depth_space) { integrate_in_depth_space = depth_space; }
+
+		bool GetIntegrateInDepthSpace() { return integrate_in_depth_space; }
+
+		/// <summary>
+		/// Sets the part of each color image to decode, taking effect from the next decoded frame
+		/// </summary>
+		void SetDecodeRegion(JPEGDecodeRegion region) { decode_region = region; }
+
+		JPEGDecodeRegion GetDecodeRegion() { return decode_region; }
+
+		/// <summary>
+		/// Picks the coarsest scale at which a decoded pixel is still no wider than a voxel on the nearest part of the subject,
+		/// and a crop around where the subject's box lands in this camera's image
+		/// </summary>
+		/// <param name="voxel_size">: the voxel size of the grid being built</param>
+		/// <param name="box_min">: lowest corner of the subject's box, in world space</param>
+		/// <param name="box_max">: highest corner of the subject's box, in world space</param>
+		/// <returns>The region, full if the box is behind the camera</returns>
+		JPEGDecodeRegion ChooseDecodeRegion(float voxel_size, Eigen::Vector3d box_min, Eigen::Vector3d box_max);
+
 		Eigen::Matrix4d GetExtrinsicMat() { return extrinsic_mat; }
 		Eigen::Matrix3d GetIntrinsicMat() { return intrinsic_mat; }
 
-		uint64_t GetTimestampCached() { return _timestamp; }
+		uint64_t GetTimestampCached() { return (staged_frame != nullptr) ? staged_timestamp : _timestamp; }
 
 		int GetImageHeight() { return imageHeight; }
 
@@ -144,6 +533,26 @@ namespace MKV_Rendering {
 
 		int GetIndex() { return index; }
 
+		std::string GetFolderName() { return folder_name; }
+
+		const std::vector<std::pair<std::string, double>>& GetStartupSteps() { return startup_steps; }
+
+		size_t GetPooledFrameCount() { return frame_pool.GetFrameCount(); }
+
+		void SetFrameCache(FrameCache* cache) { frame_cache = cache; }
+
+		void SetDepthTransformMode(DepthTransformMode mode) { depth_transform_mode = mode; }
+
+		DepthTransformMode GetDepthTransformMode() { return depth_transform_mode; }
+
+		/// <summary>
+		/// Reads a depth transform mode from its name, as used in .structure files and commands
+		/// </summary>
+		/// <param name="name">: k4a, tables or compare</param>
+		/// <param name="mode">: where to write the mode</param>
+		/// <returns>The name was recognized</returns>
+		static bool ParseDepthTransformMode(std::string name, DepthTransformMode& mode);
+
 		/// <summary>
 		/// All-purpose tool to debug Open3D objects to the screen
 		/// </summary>
@@ -0,0 +1,410 @@
+#include "AsyncFileReader.h"
+#include "ErrorLogger.h"
+
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+#include <algorithm>
+
+#ifdef ASYNC_FILE_READER_IO_URING
+#include <liburing.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+MKV_Rendering::AsyncFileReader::AsyncFileReader()
+{
+}
+
+MKV_Rendering::AsyncFileReader::~AsyncFileReader()
+{
+	StopWorkers();
+}
+
+void MKV_Rendering::AsyncFileReader::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> job;
+
+		{
+			std::unique_lock<std::mutex> lock(job_mutex);
+
+			job_added.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+			if (jobs.empty())
+			{
+				return;
+			}
+
+			job = std::move(jobs.front());
+			jobs.pop_front();
+			++jobs_running;
+		}
+
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock(job_mutex);
+			--jobs_running;
+		}
+
+		job_done.notify_all();
+	}
+}
+
+void MKV_Rendering::AsyncFileReader::StartWorkers()
+{
+	if (!workers.empty())
+	{
+		return;
+	}
+
+	stopping = false;
+
+	int thread_count = std::max(1, std::min(queue_depth, (int)std::thread::hardware_concurrency() * 2));
+
+	for (int i = 0; i < thread_count; ++i)
+	{
+		workers.push_back(std::thread(&AsyncFileReader::WorkerLoop, this));
+	}
+}
+
+void MKV_Rendering::AsyncFileReader::StopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(job_mutex);
+		stopping = true;
+	}
+
+	job_added.notify_all();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+
+	workers.clear();
+}
+
+void MKV_Rendering::AsyncFileReader::Post(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(job_mutex);
+		jobs.push_back(std::move(job));
+	}
+
+	job_added.notify_one();
+}
+
+void MKV_Rendering::AsyncFileReader::WaitForJobs()
+{
+	std::unique_lock<std::mutex> lock(job_mutex);
+	job_done.wait(lock, [this] { return jobs.empty() && jobs_running == 0; });
+}
+
+bool MKV_Rendering::AsyncFileReader::ReadWholeFile(const std::string& path, std::vector<uint8_t>& data)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	std::streamsize size = file.tellg();
+	file.seekg(0, std::ios::beg);
+
+	data.resize((size_t)size);
+
+	return size == 0 || (bool)file.read((char*)data.data(), size);
+}
+
+void MKV_Rendering::AsyncFileReader::Configure(int depth, size_t megabytes)
+{
+	StopWorkers();
+
+	queue_depth = std::max(1, depth);
+	max_bytes_in_flight = std::max((size_t)1, megabytes) * 1024 * 1024;
+}
+
+void MKV_Rendering::AsyncFileReader::ReadWithThreads(std::vector<AsyncReadRequest>& requests, std::vector<size_t>& group_remaining, std::function<void(int)>& on_group_ready)
+{
+	for (auto& request : requests)
+	{
+		std::error_code error;
+		size_t size = std::filesystem::file_size(request.path, error);
+
+		if (error)
+		{
+			size = 0;
+		}
+
+		{
+			//A file larger than the budget is still read, just on its own
+			std::unique_lock<std::mutex> lock(job_mutex);
+			bytes_freed.wait(lock, [&] { return bytes_in_flight == 0 || bytes_in_flight + size <= max_bytes_in_flight; });
+			bytes_in_flight += size;
+		}
+
+		AsyncReadRequest* r = &request;
+
+		Post([this, r, size, &group_remaining, &on_group_ready]() {
+			r->success = ReadWholeFile(r->path, r->data);
+
+			bool group_ready;
+
+			{
+				std::lock_guard<std::mutex> lock(job_mutex);
+				bytes_in_flight -= size;
+				group_ready = (--group_remaining[r->group] == 0);
+			}
+
+			bytes_freed.notify_all();
+
+			if (group_ready)
+			{
+				on_group_ready(r->group);
+			}
+		});
+	}
+
+	WaitForJobs();
+}
+
+#ifdef ASYNC_FILE_READER_IO_URING
+bool MKV_Rendering::AsyncFileReader::ReadWithIoUring(std::vector<AsyncReadRequest>& requests, std::vector<size_t>& group_remaining, std::function<void(int)>& on_group_ready)
+{
+	io_uring ring;
+
+	if (io_uring_queue_init(queue_depth, &ring, 0) < 0)
+	{
+		return false;
+	}
+
+	//Reads longer than this are split, a single read's length must fit an unsigned int
+	const size_t MAX_READ_LENGTH = 1 << 30;
+
+	std::vector<int> fds(requests.size(), -1);
+	std::vector<size_t> offsets(requests.size(), 0);
+	std::vector<size_t> sizes(requests.size(), 0);
+
+	size_t next_request = 0;
+	size_t reads_in_flight = 0;
+	size_t bytes_submitted = 0;
+	size_t requests_left = requests.size();
+
+	auto finish = [&](size_t i, bool success) {
+		if (fds[i] >= 0)
+		{
+			close(fds[i]);
+			fds[i] = -1;
+		}
+
+		requests[i].success = success;
+		bytes_submitted -= sizes[i];
+		--requests_left;
+
+		//Only this thread counts down the groups, the decode happens on the workers
+		if (--group_remaining[requests[i].group] == 0)
+		{
+			int group = requests[i].group;
+			Post([group, &on_group_ready]() { on_group_ready(group); });
+		}
+	};
+
+	auto queue_read = [&](size_t i) {
+		io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+
+		size_t length = std::min(requests[i].data.size() - offsets[i], MAX_READ_LENGTH);
+
+		io_uring_prep_read(sqe, fds[i], requests[i].data.data() + offsets[i], (unsigned)length, offsets[i]);
+		io_uring_sqe_set_data(sqe, (void*)(uintptr_t)i);
+
+		++reads_in_flight;
+	};
+
+	while (requests_left > 0)
+	{
+		//Queues as many new files as the depth and byte budget allow
+		while (next_request < requests.size() && reads_in_flight < (size_t)queue_depth)
+		{
+			size_t i = next_request;
+
+			int fd = open(requests[i].path.c_str(), O_RDONLY);
+			struct stat file_stat;
+
+			if (fd < 0 || fstat(fd, &file_stat) < 0)
+			{
+				if (fd >= 0)
+				{
+					close(fd);
+				}
+
+				++next_request;
+				finish(i, false);
+				continue;
+			}
+
+			size_t size = (size_t)file_stat.st_size;
+
+			if (bytes_submitted > 0 && bytes_submitted + size > max_bytes_in_flight)
+			{
+				close(fd);
+				break;
+			}
+
+			++next_request;
+
+			fds[i] = fd;
+			requests[i].data.resize(size);
+			sizes[i] = size;
+			bytes_submitted += size;
+
+			if (size == 0)
+			{
+				finish(i, true);
+				continue;
+			}
+
+			queue_read(i);
+		}
+
+		if (reads_in_flight == 0)
+		{
+			continue;
+		}
+
+		io_uring_submit(&ring);
+
+		io_uring_cqe* cqe;
+
+		if (io_uring_wait_cqe(&ring, &cqe) < 0)
+		{
+			continue;
+		}
+
+		//Handles every completion that has landed before submitting again
+		do
+		{
+			size_t i = (size_t)(uintptr_t)io_uring_cqe_get_data(cqe);
+			int result = cqe->res;
+
+			io_uring_cqe_seen(&ring, cqe);
+			--reads_in_flight;
+
+			if (result <= 0)
+			{
+				//The file shrank or failed to read, keep what was read
+				requests[i].data.resize(offsets[i]);
+				finish(i, result == 0 && offsets[i] > 0);
+			}
+			else
+			{
+				offsets[i] += (size_t)result;
+
+				if (offsets[i] < requests[i].data.size())
+				{
+					//Short read, asks for the rest
+					queue_read(i);
+				}
+				else
+				{
+					finish(i, true);
+				}
+			}
+		} while (io_uring_peek_cqe(&ring, &cqe) == 0);
+	}
+
+	io_uring_queue_exit(&ring);
+
+	WaitForJobs();
+
+	return true;
+}
+#endif
+
+void MKV_Rendering::AsyncFileReader::ReadBatch(std::vector<AsyncReadRequest>& requests, std::function<void(int group)> on_group_ready)
+{
+	if (requests.empty())
+	{
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	StartWorkers();
+
+	int group_count = 0;
+
+	for (auto& request : requests)
+	{
+		group_count = std::max(group_count, request.group + 1);
+		request.success = false;
+	}
+
+	std::vector<size_t> group_remaining(group_count, 0);
+
+	for (auto& request : requests)
+	{
+		++group_remaining[request.group];
+	}
+
+	bool done = false;
+
+#ifdef ASYNC_FILE_READER_IO_URING
+	done = ReadWithIoUring(requests, group_remaining, on_group_ready);
+#endif
+
+	if (!done)
+	{
+		ReadWithThreads(requests, group_remaining, on_group_ready);
+	}
+
+	read_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	++batches;
+
+	for (auto& request : requests)
+	{
+		if (!request.success)
+		{
+			ErrorLogger::LOG_ERROR("Could not read " + request.path + "!");
+			continue;
+		}
+
+		++files_read;
+		bytes_read += request.data.size();
+	}
+}
+
+std::string MKV_Rendering::AsyncFileReader::GetBackendName()
+{
+#ifdef ASYNC_FILE_READER_IO_URING
+	return "io_uring";
+#else
+	return "thread pool";
+#endif
+}
+
+void MKV_Rendering::AsyncFileReader::ResetStats()
+{
+	files_read = 0;
+	bytes_read = 0;
+	batches = 0;
+	read_ms = 0;
+}
+
+void MKV_Rendering::AsyncFileReader::PrintStats()
+{
+	std::cout << "File reads (" << GetBackendName() << ", depth " << queue_depth << ", " << max_bytes_in_flight / (1024 * 1024) << " MB in flight): ";
+	std::cout << files_read << " files, " << bytes_read / (1024 * 1024) << " MB in " << batches << " batches";
+
+	if (read_ms > 0)
+	{
+		std::cout << ", " << (bytes_read / (1024.0 * 1024.0)) / (read_ms / 1000.0) << " MB/s including decode";
+	}
+
+	std::cout << std::endl;
+}
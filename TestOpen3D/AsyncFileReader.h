@@ -0,0 +1,150 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <cstdint>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<liburing.h>)
+#define ASYNC_FILE_READER_IO_URING
+#endif
+#endif
+
+namespace MKV_Rendering {
+
+	/// <summary>
+	/// One file to read in a batch
+	/// </summary>
+	struct AsyncReadRequest
+	{
+		std::string path;
+
+		/// <summary>
+		/// Requests sharing a group are handed over together once all of them have landed
+		/// </summary>
+		int group = 0;
+
+		/// <summary>
+		/// The file's contents, filled by the reader
+		/// </summary>
+		std::vector<uint8_t> data;
+
+		bool success = false;
+	};
+
+	/// <summary>
+	/// Reads batches of whole files at once, through io_uring on Linux when liburing is available and through a pool of threads
+	/// otherwise. Each group of files is handed to a callback on a worker thread as soon as its last file lands, so decoding
+	/// overlaps with the reads still in flight
+	/// </summary>
+	class AsyncFileReader
+	{
+		/// <summary>
+		/// Most reads submitted at once
+		/// </summary>
+		int queue_depth = 32;
+
+		/// <summary>
+		/// Most bytes being read at once, a single larger file is still read on its own
+		/// </summary>
+		size_t max_bytes_in_flight = 256 * 1024 * 1024;
+
+		std::vector<std::thread> workers;
+		std::deque<std::function<void()>> jobs;
+		std::mutex job_mutex;
+		std::condition_variable job_added;
+		std::condition_variable job_done;
+		size_t jobs_running = 0;
+		bool stopping = false;
+
+		/// <summary>
+		/// Bytes of reads submitted but not landed, for the thread pool
+		/// </summary>
+		size_t bytes_in_flight = 0;
+		std::condition_variable bytes_freed;
+
+		uint64_t files_read = 0;
+		uint64_t bytes_read = 0;
+		uint64_t batches = 0;
+		double read_ms = 0;
+
+		void WorkerLoop();
+
+		void StartWorkers();
+		void StopWorkers();
+
+		/// <summary>
+		/// Queues a job for the workers
+		/// </summary>
+		void Post(std::function<void()> job);
+
+		/// <summary>
+		/// Waits until every queued job has finished
+		/// </summary>
+		void WaitForJobs();
+
+		/// <summary>
+		/// Reads the batch on worker threads, each worker reading one file at a time
+		/// </summary>
+		void ReadWithThreads(std::vector<AsyncReadRequest>& requests, std::vector<size_t>& group_remaining, std::function<void(int)>& on_group_ready);
+
+#ifdef ASYNC_FILE_READER_IO_URING
+		/// <summary>
+		/// Reads the batch through one io_uring, submitting and reaping on the calling thread
+		/// </summary>
+		/// <returns>False if io_uring could not be set up, nothing was read in that case</returns>
+		bool ReadWithIoUring(std::vector<AsyncReadRequest>& requests, std::vector<size_t>& group_remaining, std::function<void(int)>& on_group_ready);
+#endif
+
+	public:
+		/// <summary>
+		/// Constructor. Say hi! :D
+		/// </summary>
+		AsyncFileReader();
+
+		//Destructor. Say goodbye! :( - waits for the workers
+		~AsyncFileReader();
+
+		AsyncFileReader(const AsyncFileReader&) = delete;
+		AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+
+		/// <summary>
+		/// Sets how much may be read at once
+		/// </summary>
+		/// <param name="depth">: most reads submitted at once, also the thread count of the thread pool</param>
+		/// <param name="megabytes">: most megabytes being read at once</param>
+		void Configure(int depth, size_t megabytes);
+
+		/// <summary>
+		/// Reads every file of a batch, returning once all are read and every group's callback has returned
+		/// </summary>
+		/// <param name="requests">: the files, groups numbered from 0</param>
+		/// <param name="on_group_ready">: called once per group on a worker thread, groups may run in parallel</param>
+		void ReadBatch(std::vector<AsyncReadRequest>& requests, std::function<void(int group)> on_group_ready);
+
+		/// <summary>
+		/// Reads a whole file with plain blocking calls
+		/// </summary>
+		/// <param name="path">: the file</param>
+		/// <param name="data">: where to put its contents, resized to fit</param>
+		/// <returns>Successfully(?) read</returns>
+		static bool ReadWholeFile(const std::string& path, std::vector<uint8_t>& data);
+
+		/// <summary>
+		/// Which way files are read
+		/// </summary>
+		static std::string GetBackendName();
+
+		void ResetStats();
+
+		/// <summary>
+		/// Prints files and bytes read, and read throughput
+		/// </summary>
+		void PrintStats();
+	};
+}
@@ -5,10 +5,16 @@
 #include "MKV_Data.h"
 #include "Image_Data.h"
 #include "Livescan_Data.h"
+#include "Packed_Data.h"
+#include "Synthetic_Data.h"
+#include "DepthCodec.h"
 #include "TextureUnpacker.h"
 #include "MeshingVoxelGrid.h"
 
 #include <fstream>
+#include <thread>
+#include <atomic>
+#include <chrono>
 
 using namespace MKV_Rendering;
 
@@ -55,6 +61,28 @@ void MKV_Rendering::CameraManager::LoadStructure(std::string structure_path, std
 	structure_file.close();
 }
 
+bool MKV_Rendering::CameraManager::PopPrefetchedFrames()
+{
+	bool success = true;
+
+	for (int i = 0; i < camera_data.size(); ++i)
+	{
+		PrefetchedFrame frame;
+
+		//A camera that has run out keeps showing its last frame, a null frame is never staged
+		if (prefetcher.Pop(i, frame) && frame.rgbd != nullptr)
+		{
+			camera_data[i]->StageFrame(frame.rgbd, frame.timestamp);
+		}
+		else
+		{
+			success = false;
+		}
+	}
+
+	return success;
+}
+
 CameraManager::CameraManager()
 {
 	
@@ -71,12 +99,15 @@ bool MKV_Rendering::CameraManager::LoadTypeStructure(std::string root_folder, st
 	std::vector<std::string> all_folders = GetDirectories(root_folder);
 	//open3d::utility::filesystem::ListFilesInDirectory(root_folder, all_folders);
 	
-	std::map<std::string, std::string> camera_structure;
-
-	int index = 0;
+	//Structure files are read up front, the cameras are then constructed in parallel
+	std::vector<std::map<std::string, std::string>> camera_structures(all_folders.size());
+	std::vector<std::function<Abstract_Data* ()>> constructors;
 
-	for (auto _folder : all_folders)
+	for (int index = 0; index < all_folders.size(); ++index)
 	{
+		auto _folder = all_folders[index];
+		auto& camera_structure = camera_structures[index];
+
 		std::string structure_path = _folder + "/" + structure_file_name;
 
 		ErrorLogger::EXECUTE("Load File Structure", this, &CameraManager::LoadStructure, structure_path, &camera_structure);
@@ -87,45 +118,77 @@ bool MKV_Rendering::CameraManager::LoadTypeStructure(std::string root_folder, st
 			std::cout << "\t" << _pair.first << ": '" << _pair.second << "'" << std::endl;
 		}
 
-		std::string c_type = camera_structure["Type"];
+		constructors.push_back([this, _folder, index, &camera_structure]() -> Abstract_Data* {
+			Abstract_Data* camera = nullptr;
 
-		if (c_type == "mkv")
-		{
-			camera_data.push_back(new MKV_Data(
-				_folder,
-				camera_structure["MKV_File"],
-				camera_structure["Calibration_File"],
-				index
-			));
+			std::string c_type = camera_structure["Type"];
 
-			camera_enabled.push_back(true);
-		}
-		else if (c_type == "image")
-		{
-			camera_data.push_back(new Image_Data(
-				_folder,
-				camera_structure["Color"],
-				camera_structure["Depth"],
-				camera_structure["Intrinsics_Json"],
-				camera_structure["Calibration_File"],
-				camera_structure["FPS"],
-				index
-			));
+			if (c_type == "mkv")
+			{
+				camera = new MKV_Data(
+					_folder,
+					camera_structure["MKV_File"],
+					camera_structure["Calibration_File"],
+					index
+				);
+			}
+			else if (c_type == "image")
+			{
+				camera = new Image_Data(
+					_folder,
+					camera_structure["Color"],
+					camera_structure["Depth"],
+					camera_structure["Intrinsics_Json"],
+					camera_structure["Calibration_File"],
+					camera_structure["FPS"],
+					index,
+					&frame_index
+				);
+			}
+			else if (c_type == "packed")
+			{
+				camera = new Packed_Data(
+					_folder,
+					camera_structure["Container_File"],
+					index
+				);
+			}
+			else if (c_type == "synthetic")
+			{
+				camera = new Synthetic_Data(
+					_folder,
+					SyntheticSceneSettings::FromStructure(camera_structure),
+					index
+				);
+			}
+			else
+			{
+				ErrorLogger::LOG_ERROR("Unrecognized file format, " + c_type + "!");
+				return nullptr;
+			}
 
-			camera_enabled.push_back(true);
-		}
-		else
-		{
-			ErrorLogger::LOG_ERROR("Unrecognized file format, " + c_type + "!");
-		}
+			std::string depth_transform = camera_structure["Depth_Transform"];
 
-		camera_structure.clear();
+			if (depth_transform != "")
+			{
+				DepthTransformMode mode;
 
-		std::cout << "Finished initializing camera!\n" << std::endl;
+				if (Abstract_Data::ParseDepthTransformMode(depth_transform, mode))
+				{
+					camera->SetDepthTransformMode(mode);
+				}
+				else
+				{
+					ErrorLogger::LOG_ERROR("Unrecognized depth transform, " + depth_transform + "!");
+				}
+			}
 
-		++index;
+			return camera;
+		});
 	}
 
+	ConstructCameras(constructors);
+
 	if (camera_data.size() == 0)
 	{
 		ErrorLogger::LOG_ERROR(
@@ -135,8 +198,19 @@ bool MKV_Rendering::CameraManager::LoadTypeStructure(std::string root_folder, st
 		return false;
 	}
 
+	for (auto cam : camera_data)
+	{
+		cam->SetFrameCache(&frame_cache);
+	}
+
+	frame_index.PrintStats();
+	frame_index.ResetStats();
+
 	loaded = true;
 
+	StartPrefetch();
+	ReadFrameSet();
+
 	return true;
 }
 
@@ -190,7 +264,7 @@ bool MKV_Rendering::CameraManager::LoadTypeLivescan(std::string image_root_folde
 	extrinsics_filestream.open(extrinsic_file);
 	std::vector<std::string> lines;
 
-	std::map<std::string, std::string> camera_structure;
+	std::vector<std::function<Abstract_Data* ()>> constructors;
 
 	for (int i = 0; i < all_folders.size(); ++i)
 	{
@@ -224,15 +298,18 @@ bool MKV_Rendering::CameraManager::LoadTypeLivescan(std::string image_root_folde
 			_matte = matte_folders[i];
 		}
 
-		camera_data.push_back(new Livescan_Data(
-			_folder, _matte,
-			extrinsics_string,
-			i, FPS
-		));
-
-		camera_enabled.push_back(true);
+		constructors.push_back([this, _folder, _matte, extrinsics_string, i, FPS]() mutable -> Abstract_Data* {
+			return new Livescan_Data(
+				_folder, _matte,
+				extrinsics_string,
+				i, FPS,
+				&frame_index
+			);
+		});
 	}
 
+	ConstructCameras(constructors);
+
 	if (camera_data.size() == 0)
 	{
 		ErrorLogger::LOG_ERROR(
@@ -242,8 +319,97 @@ bool MKV_Rendering::CameraManager::LoadTypeLivescan(std::string image_root_folde
 		return false;
 	}
 
+	for (auto cam : camera_data)
+	{
+		cam->SetFrameCache(&frame_cache);
+	}
+
+	frame_index.PrintStats();
+	frame_index.ResetStats();
+
 	loaded = true;
 
+	StartPrefetch();
+	ReadFrameSet();
+
+	return true;
+}
+
+bool MKV_Rendering::CameraManager::PackCameras(std::string output_folder, std::string structure_file_name)
+{
+	if (!loaded)
+	{
+		ErrorLogger::LOG_ERROR("Manager not loaded!");
+		return false;
+	}
+
+	bool success = true;
+
+	for (int i = 0; i < camera_data.size(); ++i)
+	{
+		std::string camera_name = std::filesystem::path(camera_data[i]->GetFolderName()).filename().string();
+
+		if (camera_name == "")
+		{
+			camera_name = "Camera_" + std::to_string(i);
+		}
+
+		std::string camera_folder = output_folder + "/" + camera_name;
+		std::string container_file = camera_name + ".vpack";
+
+		std::filesystem::create_directories(camera_folder);
+
+		std::cout << "Packing camera " << i << " into " << camera_folder << "/" << container_file << std::endl;
+
+		if (!camera_data[i]->WritePackedContainer(camera_folder + "/" + container_file))
+		{
+			success = false;
+			continue;
+		}
+
+		std::ofstream structure_file(camera_folder + "/" + structure_file_name);
+
+		structure_file << "Type packed" << std::endl;
+		structure_file << "Container_File " << container_file << std::endl;
+	}
+
+	return success;
+}
+
+bool MKV_Rendering::CameraManager::MakeSyntheticRig(std::string output_folder, std::string structure_file_name, int camera_count, int frame_count, double depth_noise)
+{
+	if (camera_count <= 0 || frame_count <= 0)
+	{
+		ErrorLogger::LOG_ERROR("A synthetic rig needs at least one camera and one frame!");
+		return false;
+	}
+
+	SyntheticSceneSettings settings;
+	settings.ring_size = camera_count;
+	settings.frame_count = frame_count;
+	settings.depth_noise = depth_noise;
+
+	for (int i = 0; i < camera_count; ++i)
+	{
+		settings.ring_index = i;
+
+		std::string camera_folder = output_folder + "/SyntheticCam" + GetNumberFixedLength(i, 8);
+
+		std::filesystem::create_directories(camera_folder);
+
+		std::ofstream structure_file(camera_folder + "/" + structure_file_name);
+
+		settings.WriteStructure(structure_file);
+
+		if (!structure_file.good())
+		{
+			ErrorLogger::LOG_ERROR("Could not write " + camera_folder + "/" + structure_file_name + "!");
+			return false;
+		}
+	}
+
+	std::cout << "Synthetic rig of " << camera_count << " cameras written to " << output_folder << std::endl;
+
 	return true;
 }
 
@@ -263,6 +429,17 @@ bool MKV_Rendering::CameraManager::Unload()
 		return false;
 	}
 
+	if (prefetcher.IsRunning())
+	{
+		StopPrefetch(false);
+		PrintPrefetchStats();
+		prefetcher.ResetStats();
+	}
+
+	frame_cache.PrintStats();
+	frame_cache.Clear();
+	frame_cache.ResetStats();
+
 	while (!camera_data.empty())
 	{
 		if (camera_data.back() != nullptr)
@@ -277,6 +454,8 @@ bool MKV_Rendering::CameraManager::Unload()
 
 	loaded = false;
 
+	ResetTimeline();
+
 	return true;
 }
 
@@ -285,33 +464,44 @@ open3d::t::geometry::TriangleMesh MKV_Rendering::CameraManager::GetMesh(VoxelGri
 	return ErrorLogger::EXECUTE("Construct Voxel Grid", this, &MKV_Rendering::CameraManager::GetVoxelGrid, data).ExtractSurfaceMesh(0.0f);
 }
 
-std::shared_ptr<open3d::geometry::TriangleMesh> MKV_Rendering::CameraManager::GetMeshUsingNewVoxelGrid(int maximum_artifact_size)
+std::shared_ptr<open3d::geometry::TriangleMesh> MKV_Rendering::CameraManager::GetMeshUsingNewVoxelGrid(int maximum_artifact_size, bool geometry_only)
 {
-	std::shared_ptr<MeshingVoxelGrid> mvg = std::make_shared<MeshingVoxelGrid>(0.005, 201, 401, 201, Eigen::Vector3d(0, 0, 0));
+	auto start = std::chrono::steady_clock::now();
+
+	std::shared_ptr<MeshingVoxelGrid> mvg = std::make_shared<MeshingVoxelGrid>(0.005, 201, 401, 201, Eigen::Vector3d(0, 0, 0), meshing_storage);
+
+	mvg->SetGeometryOnly(geometry_only);
+	mvg->SetIntegrationMode(meshing_integration, meshing_band);
 
 	for (auto cam : camera_data)
 	{
 		int index = cam->GetIndex();
 
-		if (index > 0 && camera_enabled[index])
+		if (index > 0 && IsCameraActive(index))
 		{
 			ErrorLogger::EXECUTE("Pack Frame into Voxel Grid", cam, &Abstract_Data::PackIntoNewVoxelGrid, &(*mvg));
 		}
 	}
 
-	mvg->CullArtifacts(maximum_artifact_size);
+	mvg->CullArtifacts(maximum_artifact_size, meshing_keep_largest);
+
+	auto mesh = mvg->ExtractMesh();
 
-	return mvg->ExtractMesh();
+	double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "Meshing grid (" << ((mvg->GetStorage() == MeshingVoxelStorage::DENSE) ? "dense" : "sparse");
+	std::cout << ((mvg->GetIntegrationMode() == MeshingIntegrationMode::PIXEL_DRIVEN) ? ", pixel driven" : ", voxel driven") << "): ";
+	std::cout << mvg->GetAllocatedVoxelCount() << "/" << mvg->GetVoxelCount() << " voxels allocated, ";
+	std::cout << mvg->GetMemoryBytes() / (1024.0 * 1024.0) << " MB, " << total_ms << " ms" << std::endl;
+
+	return mesh;
 }
 
-std::shared_ptr<open3d::geometry::TriangleMesh> MKV_Rendering::CameraManager::GetMeshUsingNewVoxelGridAtTimestamp(int maximum_artifact_size, uint64_t timestamp)
+std::shared_ptr<open3d::geometry::TriangleMesh> MKV_Rendering::CameraManager::GetMeshUsingNewVoxelGridAtTimestamp(int maximum_artifact_size, uint64_t timestamp, bool geometry_only)
 {
-	for (auto cam : camera_data)
-	{
-		ErrorLogger::EXECUTE("Find Frame At Time " + std::to_string(timestamp), cam, &Abstract_Data::SeekToTime, timestamp);
-	}
+	AllCamerasSeekTimestamp(timestamp);
 
-	return GetMeshUsingNewVoxelGrid(maximum_artifact_size);
+	return GetMeshUsingNewVoxelGrid(maximum_artifact_size, geometry_only);
 }
 
 open3d::geometry::VoxelGrid MKV_Rendering::CameraManager::GetOldVoxelGrid(VoxelGridData *data)
@@ -324,7 +514,7 @@ open3d::geometry::VoxelGrid MKV_Rendering::CameraManager::GetOldVoxelGrid(VoxelG
 	{
 		int index = cam->GetIndex();
 
-		if (index > 0 && camera_enabled[index])
+		if (index > 0 && IsCameraActive(index))
 		{
 			ErrorLogger::EXECUTE("Pack Frame into Voxel Grid", cam, &Abstract_Data::PackIntoOldVoxelGrid, &grid);
 		}
@@ -335,6 +525,8 @@ open3d::geometry::VoxelGrid MKV_Rendering::CameraManager::GetOldVoxelGrid(VoxelG
 
 open3d::t::geometry::TSDFVoxelGrid MKV_Rendering::CameraManager::GetVoxelGrid(VoxelGridData* data)
 {
+	ApplyIntegrationSpace(data->integrate_in_depth_space);
+
 	open3d::core::Device device(data->device_code);
 
 	open3d::t::geometry::TSDFVoxelGrid voxel_grid(
@@ -353,7 +545,7 @@ open3d::t::geometry::TSDFVoxelGrid MKV_Rendering::CameraManager::GetVoxelGrid(Vo
 	{
 		int index = cam->GetIndex();
 
-		if (index > 0 && camera_enabled[index])
+		if (index > 0 && IsCameraActive(index))
 		{
 			ErrorLogger::EXECUTE("Pack Frame into Voxel Grid", cam, &Abstract_Data::PackIntoVoxelGrid, &voxel_grid, data);
 		}
@@ -374,23 +566,26 @@ std::shared_ptr<open3d::geometry::Image> MKV_Rendering::CameraManager::CreateUVM
 	int camera_count = camera_data.size();
 	int vert_count = mesh->vertices_.size();
 	
-	std::vector<open3d::geometry::Image> color_images;
-	std::vector<open3d::geometry::Image> depth_images;
+	//Holding the frames keeps them leased, so their color can be read in place instead of copied
+	std::vector<std::shared_ptr<open3d::geometry::RGBDImage>> frames(camera_count);
+
+	//Cameras without a frame point at an empty image, as their copies used to be
+	open3d::geometry::Image no_image;
 
-	color_images.resize(camera_count);
-	depth_images.resize(camera_count);
+	std::vector<const open3d::geometry::Image*> color_images(camera_count, &no_image);
+	std::vector<std::shared_ptr<open3d::geometry::Image>> depth_images(camera_count, nullptr);
 
-	//Write all camera images at the current time to one vector
+	//Gather all camera images at the current time
 	for (auto cam : camera_data)
 	{
 		int index = cam->GetIndex();
 
-		if (index > 0 && camera_enabled[index])
+		if (index > 0 && IsCameraActive(index))
 		{
-			auto rgbd_im = ErrorLogger::EXECUTE("Get RGBD Image for Texture Stitching", cam, &Abstract_Data::GetFrameRGBD);
+			frames[index] = ErrorLogger::EXECUTE("Get RGBD Image for Texture Stitching", cam, &Abstract_Data::AcquireFrameRGBD);
 
-			color_images[index] = rgbd_im->color_;
-			depth_images[index] = *(rgbd_im->depth_.ConvertDepthToFloatImage());
+			color_images[index] = &frames[index]->color_;
+			depth_images[index] = frames[index]->depth_.ConvertDepthToFloatImage();
 		}
 	}
 
@@ -417,18 +612,20 @@ std::shared_ptr<open3d::geometry::Image> MKV_Rendering::CameraManager::CreateUVM
 	{
 		int index = camera_data[i]->GetIndex();
 
-		if (index > 0 && camera_enabled[index])
+		if (index > 0 && IsCameraActive(index))
 		{
-			auto mat = camera_data[i]->GetExtrinsicMat();
+			auto mat = camera_data[i]->GetFrameExtrinsicMat();
 
-			mesh->textures_.push_back(color_images[i]);
+			//The mesh owns its textures, so this copy stays
+			FramePool::CountImageCopy(*color_images[i]);
+			mesh->textures_.push_back(*color_images[i]);
 
 			camera_triangles[i] = std::vector<int>();
 			camera_positions_original[i] = mat.block<3, 1>(0, 3);
 			camera_rotations[i] = mat.block<3, 3>(0, 0);
 			camera_positions_rotated[i] = mat.block<3, 3>(0, 0) * mat.block<3, 1>(0, 3);
 			camera_positions_normalized[i] = camera_positions_rotated[i].normalized();
-			camera_intrinsics[i] = camera_data[i]->GetIntrinsicMat();
+			camera_intrinsics[i] = camera_data[i]->GetFrameIntrinsicMat();
 		}
 	}
 
@@ -461,7 +658,7 @@ std::shared_ptr<open3d::geometry::Image> MKV_Rendering::CameraManager::CreateUVM
 		{
 			int index = camera_data[j]->GetIndex();
 
-			if (index > 0 && camera_enabled[index])
+			if (index > 0 && IsCameraActive(index))
 			{
 				//Take the depth that is most facing the image
 				auto normal = (mesh->vertices_[mesh->triangles_[i](0)] - mesh->vertices_[mesh->triangles_[i](1)]).cross(
@@ -485,7 +682,7 @@ std::shared_ptr<open3d::geometry::Image> MKV_Rendering::CameraManager::CreateUVM
 
 					double depth = 0;
 					bool in_bounds;
-					std::tie(in_bounds, depth) = depth_images[j].FloatValueAt(uvz.x(), uvz.y());
+					std::tie(in_bounds, depth) = depth_images[j]->FloatValueAt(uvz.x(), uvz.y());
 
 					//float delta_depth = uvz.z() - depth;
 
@@ -556,7 +753,7 @@ std::shared_ptr<open3d::geometry::Image> MKV_Rendering::CameraManager::CreateUVM
 	{
 		int index = camera_data[i]->GetIndex();
 
-		if (index > 0 && camera_enabled[index])
+		if (index > 0 && IsCameraActive(index))
 		{
 			for (auto triangle_index : camera_triangles[i])
 			{
@@ -595,8 +792,8 @@ std::shared_ptr<open3d::geometry::Image> MKV_Rendering::CameraManager::CreateUVM
 					Eigen::Vector3d uvz = camera_intrinsics[i] *
 						(camera_rotations[i] * mesh->vertices_[vert_loc] + camera_positions_original[i]);
 
-					uvz.x() /= (uvz.z() * (double)color_images[i].width_);
-					uvz.y() /= (uvz.z() * (double)color_images[i].height_);
+					uvz.x() /= (uvz.z() * (double)color_images[i]->width_);
+					uvz.y() /= (uvz.z() * (double)color_images[i]->height_);
 
 					if (useTheBadTexturingMethod)
 					{
@@ -622,8 +819,8 @@ std::shared_ptr<open3d::geometry::Image> MKV_Rendering::CameraManager::CreateUVM
 		auto better_texture = std::make_shared<open3d::geometry::Image>();
 		better_texture->width_ = 1920; // color_images[0].width_;
 		better_texture->height_ = 1080; // color_images[0].height_;
-		better_texture->bytes_per_channel_ = color_images[0].bytes_per_channel_;
-		better_texture->num_of_channels_ = color_images[0].num_of_channels_;
+		better_texture->bytes_per_channel_ = color_images[0]->bytes_per_channel_;
+		better_texture->num_of_channels_ = color_images[0]->num_of_channels_;
 		better_texture->data_.resize(better_texture->width_ * better_texture->height_ * better_texture->num_of_channels_ * better_texture->bytes_per_channel_);
 
 		ErrorLogger::EXECUTE("Perform UV packing", &tu, &TextureUnpacker::PerformTextureUnpack, &color_images, mesh, &(*better_texture), false);
@@ -637,13 +834,13 @@ std::shared_ptr<open3d::geometry::Image> MKV_Rendering::CameraManager::CreateUVM
 		//Combine all the image data into one
 		for (int i = 0; i < color_images.size(); ++i)
 		{
-			to_return->data_.insert(to_return->data_.begin() + to_return->data_.size(), color_images[i].data_.begin(), color_images[i].data_.end());
+			to_return->data_.insert(to_return->data_.begin() + to_return->data_.size(), color_images[i]->data_.begin(), color_images[i]->data_.end());
 		}
 
-		to_return->height_ = color_images[0].height_ * color_images.size();
-		to_return->width_ = color_images[0].width_;
-		to_return->bytes_per_channel_ = color_images[0].bytes_per_channel_;
-		to_return->num_of_channels_ = color_images[0].num_of_channels_;
+		to_return->height_ = color_images[0]->height_ * color_images.size();
+		to_return->width_ = color_images[0]->width_;
+		to_return->bytes_per_channel_ = color_images[0]->bytes_per_channel_;
+		to_return->num_of_channels_ = color_images[0]->num_of_channels_;
 
 		return to_return;
 	}
@@ -651,16 +848,24 @@ std::shared_ptr<open3d::geometry::Image> MKV_Rendering::CameraManager::CreateUVM
 
 std::shared_ptr<open3d::geometry::Image> MKV_Rendering::CameraManager::CreateUVMapAndTextureAtTimestamp(open3d::geometry::TriangleMesh* mesh, uint64_t timestamp, bool useTheBadTexturingMethod)//, float depth_epsilon)
 {
-	for (auto cam : camera_data)
-	{
-		ErrorLogger::EXECUTE("Find Frame At Time " + std::to_string(timestamp), cam, &Abstract_Data::SeekToTime, timestamp);
-	}
+	AllCamerasSeekTimestamp(timestamp);
 
 	return CreateUVMapAndTexture(mesh, useTheBadTexturingMethod);// , depth_epsilon);
 }
 
 bool MKV_Rendering::CameraManager::CycleAllCamerasForward()
 {
+	if (timeline.IsBuilt())
+	{
+		return SeekToTimelineFrame(timeline_frame + 1);
+	}
+
+	//The cameras are already ahead, just take the frames they decoded
+	if (prefetcher.IsRunning())
+	{
+		return PopPrefetchedFrames();
+	}
+
 	bool success = true;
 
 	for (auto cam : camera_data)
@@ -668,11 +873,28 @@ bool MKV_Rendering::CameraManager::CycleAllCamerasForward()
 		success = success && ErrorLogger::EXECUTE("Cycle Camera Forward", cam, &Abstract_Data::CycleCaptureForwards);
 	}
 
+	ReadFrameSet();
+
 	return success;
 }
 
 bool MKV_Rendering::CameraManager::CycleAllCamerasBackward()
 {
+	if (timeline.IsBuilt())
+	{
+		if (timeline_frame == 0)
+		{
+			ErrorLogger::LOG_ERROR("Reached beginning of timeline!");
+			return false;
+		}
+
+		return SeekToTimelineFrame(timeline_frame - 1);
+	}
+
+	bool was_prefetching = prefetcher.IsRunning();
+
+	StopPrefetch(true);
+
 	bool success = true;
 
 	for (auto cam : camera_data)
@@ -680,16 +902,73 @@ bool MKV_Rendering::CameraManager::CycleAllCamerasBackward()
 		success = success && ErrorLogger::EXECUTE("Cycle Camera Backward", cam, &Abstract_Data::CycleCaptureBackwards);
 	}
 
+	if (was_prefetching)
+	{
+		StartPrefetch();
+	}
+
+	ReadFrameSet();
+
 	return success;
 }
 
 bool MKV_Rendering::CameraManager::AllCamerasSeekTimestamp(uint64_t timestamp)
 {
+	if (timeline.IsBuilt())
+	{
+		size_t frame = timeline.FindFrame(timestamp);
+
+		if (frame >= timeline.GetFrameCount())
+		{
+			ErrorLogger::LOG_ERROR("No timeline frame at or after " + std::to_string(timestamp) + "!");
+			return false;
+		}
+
+		return SeekToTimelineFrame(frame);
+	}
+
+	//Nothing has moved since the cameras were last sent here, keep the frames they already hold
+	if (timestamp == seek_timestamp && seek_camera_timestamps.size() == camera_data.size())
+	{
+		bool unchanged = true;
+
+		for (int i = 0; i < camera_data.size() && unchanged; ++i)
+		{
+			unchanged = (camera_data[i]->GetTimestampCached() == seek_camera_timestamps[i]);
+		}
+
+		if (unchanged)
+		{
+			return true;
+		}
+	}
+
+	bool was_prefetching = prefetcher.IsRunning();
+
+	//Decoded frames are from the wrong time now
+	StopPrefetch(false);
+
 	bool success = true;
 
 	for (auto cam : camera_data)
 	{
-		success = success && ErrorLogger::EXECUTE("Camera Seek Time", cam, &Abstract_Data::SeekToTime, timestamp);
+		//Every camera must seek, even if an earlier one failed
+		success = ErrorLogger::EXECUTE("Camera Seek Time", cam, &Abstract_Data::SeekToTime, timestamp) && success;
+	}
+
+	if (was_prefetching)
+	{
+		StartPrefetch();
+	}
+
+	ReadFrameSet();
+
+	seek_timestamp = success ? timestamp : UINT64_MAX;
+	seek_camera_timestamps.clear();
+
+	for (auto cam : camera_data)
+	{
+		seek_camera_timestamps.push_back(cam->GetTimestampCached());
 	}
 
 	return success;
@@ -702,6 +981,9 @@ open3d::t::geometry::TriangleMesh MKV_Rendering::CameraManager::GetMeshAtTimesta
 
 open3d::t::geometry::TSDFVoxelGrid MKV_Rendering::CameraManager::GetVoxelGridAtTimestamp(VoxelGridData* data, uint64_t timestamp)
 {
+	//Before seeking, so frames read ahead are decoded in the right space
+	ApplyIntegrationSpace(data->integrate_in_depth_space);
+
 	open3d::core::Device device(data->device_code);
 
 	open3d::t::geometry::TSDFVoxelGrid voxel_grid(
@@ -716,13 +998,13 @@ open3d::t::geometry::TSDFVoxelGrid MKV_Rendering::CameraManager::GetVoxelGridAtT
 		16, data->blocks, device
 	);
 
+	AllCamerasSeekTimestamp(timestamp);
+
 	for (auto cam : camera_data)
 	{
-		ErrorLogger::EXECUTE("Find Frame At Time " + std::to_string(timestamp), cam, &Abstract_Data::SeekToTime, timestamp);
-
 		int index = cam->GetIndex();
 
-		if (index > 0 && camera_enabled[index])
+		if (index > 0 && IsCameraActive(index))
 		{
 			ErrorLogger::EXECUTE("Pack Frame into Voxel Grid", cam, &Abstract_Data::PackIntoVoxelGrid, &voxel_grid, data);
 		}
@@ -731,19 +1013,19 @@ open3d::t::geometry::TSDFVoxelGrid MKV_Rendering::CameraManager::GetVoxelGridAtT
 	return voxel_grid;
 }
 
-std::vector<open3d::geometry::RGBDImage> MKV_Rendering::CameraManager::ExtractImageVectorAtTimestamp(uint64_t timestamp)
+std::vector<std::shared_ptr<open3d::geometry::RGBDImage>> MKV_Rendering::CameraManager::ExtractImageVectorAtTimestamp(uint64_t timestamp)
 {
-	std::vector<open3d::geometry::RGBDImage> to_return;
+	std::vector<std::shared_ptr<open3d::geometry::RGBDImage>> to_return;
+
+	AllCamerasSeekTimestamp(timestamp);
 
 	for (auto cam : camera_data)
 	{
-		ErrorLogger::EXECUTE("Find Frame At Time " + std::to_string(timestamp), cam, &Abstract_Data::SeekToTime, timestamp);
-
 		int index = cam->GetIndex();
 
-		if (index > 0 && camera_enabled[index])
+		if (index > 0 && IsCameraActive(index))
 		{
-			to_return.push_back(*ErrorLogger::EXECUTE("Extract RGBD Image Vector", cam, &Abstract_Data::GetFrameRGBD));
+			to_return.push_back(ErrorLogger::EXECUTE("Extract RGBD Image Vector", cam, &Abstract_Data::AcquireFrameRGBD));
 		}
 	}
 
@@ -757,7 +1039,7 @@ void MKV_Rendering::CameraManager::GetTrajectories(open3d::camera::PinholeCamera
 		open3d::camera::PinholeCameraParameters params;
 
 		traj.parameters_.push_back(
-			cam->GetParameters()
+			cam->GetFrameParameters()
 		);
 	}
 }
@@ -776,10 +1058,15 @@ void MKV_Rendering::CameraManager::CreateSSMVFolder(
 
 	camera_data_file << camera_data.size() << std::endl;
 
+	AllCamerasSeekTimestamp(timestamp);
+
 	for (int i = 0; i < camera_data.size(); ++i)
 	{
-		auto int_mat = camera_data[i]->GetIntrinsicMat();
-		auto ext_mat = camera_data[i]->GetExtrinsicMat();
+		auto rgbd_image = camera_data[i]->AcquireFrameRGBD();
+
+		//Only known once the frame is decoded, as it may be cut down or in the depth camera's space
+		auto int_mat = camera_data[i]->GetFrameIntrinsicMat();
+		auto ext_mat = camera_data[i]->GetFrameExtrinsicMat();
 
 		for (int j = 0; j < 3; ++j)
 		{
@@ -802,9 +1089,6 @@ void MKV_Rendering::CameraManager::CreateSSMVFolder(
 			camera_data_file << ext_mat(j, 3) << " ";
 		}
 
-		camera_data[i]->SeekToTime(timestamp);
-		auto rgbd_image = camera_data[i]->GetFrameRGBD();
-
 		camera_data_file << rgbd_image->color_.width_ << " ";
 		camera_data_file << rgbd_image->color_.height_ << std::endl;
 
@@ -854,6 +1138,489 @@ uint64_t MKV_Rendering::CameraManager::GetHighestTimestamp()
 	return to_return;
 }
 
+void MKV_Rendering::CameraManager::SetPrefetch(int depth, int threads)
+{
+	bool restart = loaded;
+
+	StopPrefetch(true);
+
+	prefetch_depth = std::max(depth, 0);
+	prefetch_threads = std::max(threads, 1);
+
+	if (restart)
+	{
+		StartPrefetch();
+	}
+}
+
+void MKV_Rendering::CameraManager::StartPrefetch()
+{
+	if (!loaded || prefetch_depth <= 0 || prefetcher.IsRunning())
+	{
+		return;
+	}
+
+	//The workers step every camera one capture at a time, which would pull them off the timeline
+	if (timeline.IsBuilt())
+	{
+		std::cout << "Not prefetching while a timeline is in use" << std::endl;
+		return;
+	}
+
+	prefetcher.Start(camera_data, prefetch_depth, prefetch_threads);
+
+	//The first decoded frame of each camera becomes its current frame
+	PopPrefetchedFrames();
+}
+
+void MKV_Rendering::CameraManager::StopPrefetch(bool restore_positions)
+{
+	if (!prefetcher.IsRunning())
+	{
+		return;
+	}
+
+	prefetcher.Stop();
+
+	for (auto cam : camera_data)
+	{
+		bool had_frame = cam->HasStagedFrame();
+		uint64_t shown_time = cam->GetTimestampCached();
+
+		cam->ClearStagedFrame();
+
+		//The workers left each camera a few frames past the one being shown
+		if (restore_positions && had_frame)
+		{
+			ErrorLogger::EXECUTE("Restore Camera Time", cam, &Abstract_Data::SeekToTime, shown_time);
+		}
+	}
+}
+
+void MKV_Rendering::CameraManager::PrintPrefetchStats()
+{
+	prefetcher.PrintStats();
+}
+
+void MKV_Rendering::CameraManager::SetAsyncReads(int queue_depth, size_t megabytes)
+{
+	async_reads = (queue_depth > 0);
+
+	if (async_reads)
+	{
+		file_reader.Configure(queue_depth, megabytes);
+
+		std::cout << "Reading frames in batches through " << AsyncFileReader::GetBackendName() << std::endl;
+	}
+
+	ReadFrameSet();
+}
+
+void MKV_Rendering::CameraManager::PrintAsyncReadStats()
+{
+	file_reader.PrintStats();
+}
+
+void MKV_Rendering::CameraManager::ReadFrameSet()
+{
+	for (auto cam : camera_data)
+	{
+		cam->ClearReadAheadFrame();
+	}
+
+	if (!async_reads || !loaded || prefetcher.IsRunning())
+	{
+		return;
+	}
+
+	std::vector<AsyncReadRequest> requests;
+
+	//Each camera reading files is one group, its files sit from group_starts[group] up to group_starts[group + 1]
+	std::vector<Abstract_Data*> group_cameras;
+	std::vector<size_t> group_starts;
+
+	std::vector<std::string> files;
+
+	for (int i = 0; i < camera_data.size(); ++i)
+	{
+		if (!IsCameraActive(i) || camera_data[i]->HasStagedFrame() || !camera_data[i]->GetFrameFiles(files))
+		{
+			continue;
+		}
+
+		int group = group_cameras.size();
+
+		group_cameras.push_back(camera_data[i]);
+		group_starts.push_back(requests.size());
+
+		for (auto& file : files)
+		{
+			AsyncReadRequest request;
+			request.path = file;
+			request.group = group;
+
+			requests.push_back(std::move(request));
+		}
+	}
+
+	group_starts.push_back(requests.size());
+
+	file_reader.ReadBatch(requests, [&](int group) {
+		std::vector<std::vector<uint8_t>*> contents;
+
+		for (size_t r = group_starts[group]; r < group_starts[group + 1]; ++r)
+		{
+			//The camera reads its files itself when its frame is asked for
+			if (!requests[r].success)
+			{
+				return;
+			}
+
+			contents.push_back(&requests[r].data);
+		}
+
+		auto frame = group_cameras[group]->GetFrameRGBDFromMemory(contents);
+
+		if (frame != nullptr)
+		{
+			group_cameras[group]->SetReadAheadFrame(frame);
+		}
+	});
+}
+
+void MKV_Rendering::CameraManager::SetFrameCacheBudget(size_t megabytes)
+{
+	frame_cache.SetBudget(megabytes);
+}
+
+void MKV_Rendering::CameraManager::SetFrameIndexEnabled(bool enabled)
+{
+	frame_index.SetEnabled(enabled);
+}
+
+void MKV_Rendering::CameraManager::ConstructCameras(std::vector<std::function<Abstract_Data* ()>>& constructors)
+{
+	std::vector<Abstract_Data*> slots(constructors.size(), nullptr);
+	std::vector<double> construction_ms(constructors.size(), 0.0);
+
+	std::atomic<size_t> next_slot(0);
+
+	auto start = std::chrono::steady_clock::now();
+
+	//Each worker takes the next unconstructed slot, so the slowest cameras overlap instead of queueing
+	auto worker = [&]() {
+		for (size_t slot = next_slot++; slot < constructors.size(); slot = next_slot++)
+		{
+			auto camera_start = std::chrono::steady_clock::now();
+
+			slots[slot] = constructors[slot]();
+
+			construction_ms[slot] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - camera_start).count();
+		}
+	};
+
+	size_t thread_count = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), constructors.size());
+
+	std::vector<std::thread> workers;
+
+	for (size_t t = 1; t < thread_count; ++t)
+	{
+		workers.emplace_back(worker);
+	}
+
+	worker();
+
+	for (auto& thread : workers)
+	{
+		thread.join();
+	}
+
+	double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "Constructed " << constructors.size() << " cameras on " << thread_count << " threads in " << total_ms << " ms" << std::endl;
+
+	//Slots are in folder order, so cameras land in the same order as when they were built one by one
+	for (size_t slot = 0; slot < slots.size(); ++slot)
+	{
+		if (slots[slot] == nullptr)
+		{
+			continue;
+		}
+
+		camera_data.push_back(slots[slot]);
+		camera_enabled.push_back(true);
+
+		std::cout << "\tCamera " << slots[slot]->GetIndex() << " (" << slots[slot]->GetFolderName() << "): " << construction_ms[slot] << " ms";
+
+		for (auto& step : slots[slot]->GetStartupSteps())
+		{
+			std::cout << ", " << step.first << " " << step.second << " ms";
+		}
+
+		std::cout << std::endl;
+	}
+}
+
+bool MKV_Rendering::CameraManager::IsCameraActive(int index)
+{
+	return camera_enabled[index] && (!timeline.IsBuilt() || camera_matched[index]);
+}
+
+bool MKV_Rendering::CameraManager::SeekToTimelineFrame(size_t frame)
+{
+	if (frame >= timeline.GetFrameCount())
+	{
+		ErrorLogger::LOG_ERROR("Reached end of timeline!");
+		return false;
+	}
+
+	//Already there, every camera still holds its capture
+	if (frame == timeline_frame)
+	{
+		return true;
+	}
+
+	bool success = true;
+
+	camera_matched.assign(camera_data.size(), false);
+
+	for (int i = 0; i < camera_data.size(); ++i)
+	{
+		size_t capture = timeline.GetCapture(frame, i);
+
+		//Not seeked to and never decoded
+		if (capture == CaptureTimeline::UNMATCHED)
+		{
+			continue;
+		}
+
+		camera_matched[i] = ErrorLogger::EXECUTE("Camera Seek Capture", camera_data[i], &Abstract_Data::SeekToCaptureIndex, capture);
+
+		success = camera_matched[i] && success;
+	}
+
+	timeline_frame = frame;
+
+	ReadFrameSet();
+
+	return success;
+}
+
+bool MKV_Rendering::CameraManager::BuildTimeline(uint64_t tolerance)
+{
+	//Prefetching must stay stopped from here on, its workers would move the cameras while the timeline is built and followed
+	StopPrefetch(true);
+
+	ResetTimeline();
+
+	if (!timeline.Build(camera_data, tolerance))
+	{
+		ResetTimeline();
+
+		StartPrefetch();
+
+		return false;
+	}
+
+	timeline.PrintStats();
+
+	//Stay at about the same point in playback
+	size_t frame = std::min(timeline.FindFrame(GetHighestTimestamp()), timeline.GetFrameCount() - 1);
+
+	return SeekToTimelineFrame(frame);
+}
+
+void MKV_Rendering::CameraManager::ResetTimeline()
+{
+	timeline.Clear();
+	timeline_frame = CaptureTimeline::UNMATCHED;
+	camera_matched.clear();
+}
+
+void MKV_Rendering::CameraManager::ClearTimeline()
+{
+	bool was_built = timeline.IsBuilt();
+
+	ResetTimeline();
+
+	if (was_built)
+	{
+		StartPrefetch();
+	}
+}
+
+void MKV_Rendering::CameraManager::SetDepthTransformMode(int index, DepthTransformMode mode)
+{
+	if (index < -1 || index >= (int)camera_data.size())
+	{
+		std::cout << "index " << index << " out of range!" << std::endl;
+		return;
+	}
+
+	bool was_prefetching = prefetcher.IsRunning();
+
+	//Workers may be mid-decode on the camera
+	StopPrefetch(true);
+
+	for (auto cam : camera_data)
+	{
+		if (index == -1 || cam->GetIndex() == index)
+		{
+			cam->SetDepthTransformMode(mode);
+		}
+	}
+
+	//Cached depth was made with the old method
+	frame_cache.Clear();
+
+	if (was_prefetching)
+	{
+		StartPrefetch();
+	}
+}
+
+void MKV_Rendering::CameraManager::ApplyDecodeRegions(std::vector<JPEGDecodeRegion>& regions)
+{
+	bool was_prefetching = prefetcher.IsRunning();
+
+	//Workers may be mid-decode on the cameras
+	StopPrefetch(true);
+
+	for (int i = 0; i < camera_data.size(); ++i)
+	{
+		camera_data[i]->SetDecodeRegion(regions[i]);
+
+		std::cout << "Camera " << i << " decodes color at " << regions[i].ToString() << std::endl;
+	}
+
+	//Cached frames were decoded at the old size
+	frame_cache.Clear();
+
+	if (was_prefetching)
+	{
+		StartPrefetch();
+	}
+
+	ReadFrameSet();
+}
+
+void MKV_Rendering::CameraManager::ApplyIntegrationSpace(bool depth_space)
+{
+	bool changed = false;
+
+	for (auto cam : camera_data)
+	{
+		changed |= (cam->GetIntegrateInDepthSpace() != depth_space);
+	}
+
+	if (!changed)
+	{
+		return;
+	}
+
+	bool was_prefetching = prefetcher.IsRunning();
+
+	//Workers may be mid-decode on the cameras
+	StopPrefetch(true);
+
+	for (auto cam : camera_data)
+	{
+		cam->SetIntegrateInDepthSpace(depth_space);
+	}
+
+	std::cout << "Integrating in the " << (depth_space ? "depth" : "color") << " camera's space" << std::endl;
+
+	//Cached frames were decoded in the other space
+	frame_cache.Clear();
+
+	if (was_prefetching)
+	{
+		StartPrefetch();
+	}
+
+	ReadFrameSet();
+}
+
+void MKV_Rendering::CameraManager::SetColorDecodeScale(int scale)
+{
+	if (scale != 1 && scale != 2 && scale != 4 && scale != 8)
+	{
+		std::cout << "Decode scale must be 1, 2, 4 or 8!" << std::endl;
+		return;
+	}
+
+	JPEGDecodeRegion region;
+	region.scale = scale;
+
+	std::vector<JPEGDecodeRegion> regions(camera_data.size(), region);
+
+	ApplyDecodeRegions(regions);
+}
+
+void MKV_Rendering::CameraManager::ChooseColorDecodeRegions(VoxelGridData* data, Eigen::Vector3d box_min, Eigen::Vector3d box_max)
+{
+	std::vector<JPEGDecodeRegion> regions;
+
+	for (auto cam : camera_data)
+	{
+		regions.push_back(cam->ChooseDecodeRegion(data->voxel_size, box_min.cwiseMin(box_max), box_min.cwiseMax(box_max)));
+	}
+
+	ApplyDecodeRegions(regions);
+}
+
+void MKV_Rendering::CameraManager::BenchmarkColorDecode(int iterations)
+{
+	bool was_prefetching = prefetcher.IsRunning();
+
+	//The cameras must be back on the frame being shown, and not in use by the workers
+	StopPrefetch(true);
+
+	for (auto cam : camera_data)
+	{
+		auto mkv = dynamic_cast<MKV_Data*>(cam);
+
+		if (mkv != nullptr)
+		{
+			ErrorLogger::EXECUTE("Benchmark Color Decode", mkv, &MKV_Data::BenchmarkColorDecode, iterations);
+		}
+	}
+
+	if (was_prefetching)
+	{
+		StartPrefetch();
+	}
+}
+
+void MKV_Rendering::CameraManager::BenchmarkDepthCodec(int iterations)
+{
+	bool was_prefetching = prefetcher.IsRunning();
+
+	StopPrefetch(true);
+
+	for (auto cam : camera_data)
+	{
+		auto rgbd = cam->AcquireFrameRGBD();
+
+		if (rgbd == nullptr)
+		{
+			continue;
+		}
+
+		DepthCodec::Benchmark(cam->GetFolderName() + " at " + std::to_string(cam->GetCaptureTimestamp()), rgbd->depth_, iterations);
+	}
+
+	if (was_prefetching)
+	{
+		StartPrefetch();
+	}
+}
+
+void MKV_Rendering::CameraManager::BenchmarkMeshingLayout(int iterations)
+{
+	MeshingVoxelGrid::BenchmarkLayout(201, 401, 201, iterations);
+}
+
 void MKV_Rendering::CameraManager::MakeAnErrorOnPurpose(bool cause_abort)
 {
 	CauseError(cause_abort);
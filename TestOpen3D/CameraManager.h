@@ -3,10 +3,15 @@
 #include "Abstract_Data.h"
 
 #include "VoxelGridData.h"
+#include "FramePrefetcher.h"
+#include "FrameIndex.h"
+#include "CaptureTimeline.h"
+#include "AsyncFileReader.h"
 
 #include <vector>
 #include <string>
 #include <map>
+#include <functional>
 
 namespace MKV_Rendering {
 	
@@ -29,6 +34,126 @@ namespace MKV_Rendering {
 		/// </summary>
 		bool loaded = false;
 
+		/// <summary>
+		/// Decodes upcoming frames in the background while the current ones are being integrated
+		/// </summary>
+		FramePrefetcher prefetcher;
+
+		/// <summary>
+		/// How many frames to decode ahead per camera, 0 disables prefetching
+		/// </summary>
+		int prefetch_depth = 0;
+
+		/// <summary>
+		/// How many threads decode ahead
+		/// </summary>
+		int prefetch_threads = 1;
+
+		/// <summary>
+		/// Decoded frames of the image based cameras, so a frame is decoded once per pass
+		/// </summary>
+		FrameCache frame_cache;
+
+		/// <summary>
+		/// Index files of the image based camera folders, so unchanged folders are not scanned again on load
+		/// </summary>
+		FrameIndex frame_index;
+
+		/// <summary>
+		/// Time of the last successful seek, and where every camera ended up, so seeking there again can be skipped
+		/// </summary>
+		uint64_t seek_timestamp = UINT64_MAX;
+		std::vector<uint64_t> seek_camera_timestamps;
+
+		/// <summary>
+		/// Matches captures across cameras once built, after which all movement goes frame by frame along it
+		/// </summary>
+		CaptureTimeline timeline;
+
+		/// <summary>
+		/// The timeline frame the cameras are on
+		/// </summary>
+		size_t timeline_frame = CaptureTimeline::UNMATCHED;
+
+		/// <summary>
+		/// Whether each camera has a capture in the current timeline frame
+		/// </summary>
+		std::vector<bool> camera_matched;
+
+		/// <summary>
+		/// Reads every camera's files for a frame in one batch
+		/// </summary>
+		AsyncFileReader file_reader;
+
+		/// <summary>
+		/// Whether frames are read ahead in batches whenever the cameras move
+		/// </summary>
+		bool async_reads = false;
+
+		/// <summary>
+		/// How the grids of GetMeshUsingNewVoxelGrid store their voxels
+		/// </summary>
+		MeshingVoxelStorage meshing_storage = MeshingVoxelStorage::SPARSE;
+
+		/// <summary>
+		/// Whether the grids of GetMeshUsingNewVoxelGrid integrate by voxel or by depth pixel, and the band in voxels for the latter
+		/// </summary>
+		MeshingIntegrationMode meshing_integration = MeshingIntegrationMode::VOXEL_DRIVEN;
+		int meshing_band = 2;
+
+		/// <summary>
+		/// How many of the largest solid pieces GetMeshUsingNewVoxelGrid keeps, 0 keeps every piece past the artifact size
+		/// </summary>
+		int meshing_keep_largest = 0;
+
+		/// <summary>
+		/// Reads the files of every active camera's current capture in one batch and decodes each camera's frame as soon as its
+		/// files land. Does nothing while prefetching, which already decodes ahead
+		/// </summary>
+		void ReadFrameSet();
+
+		/// <summary>
+		/// Gives each camera its decode region, dropping every frame decoded with the old ones
+		/// </summary>
+		/// <param name="regions">: one per camera, in manager order</param>
+		void ApplyDecodeRegions(std::vector<JPEGDecodeRegion>& regions);
+
+		/// <summary>
+		/// Puts every camera's frames in its depth or color camera's space, dropping every frame decoded in the other. Does
+		/// nothing if the cameras are already there
+		/// </summary>
+		/// <param name="depth_space">: true for the depth camera's space</param>
+		void ApplyIntegrationSpace(bool depth_space);
+
+		/// <summary>
+		/// Moves every matched camera to its capture in a timeline frame. Unmatched cameras are left alone, and sit the frame out
+		/// </summary>
+		/// <param name="frame">: the timeline frame</param>
+		/// <returns>Successfully(?) moved</returns>
+		bool SeekToTimelineFrame(size_t frame);
+
+		/// <summary>
+		/// Forgets the timeline and where the cameras were on it, without restarting anything
+		/// </summary>
+		void ResetTimeline();
+
+		/// <summary>
+		/// Whether a camera should be used for the current frame, being enabled and, with a timeline, matched
+		/// </summary>
+		bool IsCameraActive(int index);
+
+		/// <summary>
+		/// Constructs cameras on a pool of threads and adds them in slot order, printing how long each took and on what
+		/// </summary>
+		/// <param name="constructors">: one per camera slot, returning nullptr if that slot has no camera</param>
+		void ConstructCameras(std::vector<std::function<Abstract_Data* ()>>& constructors);
+
+		/// <summary>
+		/// Stages the next prefetched frame on every camera
+		/// </summary>
+		/// <returns>Successfully(?) staged a new frame on every camera</returns>
+		bool PopPrefetchedFrames();
+
 		/// <summary>
 		/// Causes an error, use wisely
 		/// </summary>
@@ -65,6 +190,25 @@ namespace MKV_Rendering {
 		/// <returns>Successfully(?) loaded the files</returns>
 		bool LoadTypeLivescan(std::string image_root_folder, std::string matte_root_folder, float FPS);
 
+		/// <summary>
+		/// Packs every loaded camera into a single container each, with a structure file so they can be loaded as 'packed' cameras
+		/// </summary>
+		/// <param name="output_folder">: gets one subfolder per camera</param>
+		/// <param name="structure_file_name">: name of the structure file written next to each container</param>
+		/// <returns>Successfully(?) packed every camera</returns>
+		bool PackCameras(std::string output_folder, std::string structure_file_name);
+
+		/// <summary>
+		/// Writes a folder per camera of a synthetic ring, loadable with LoadTypeStructure. Other settings can be changed in the structure files
+		/// </summary>
+		/// <param name="output_folder">: gets one subfolder per camera</param>
+		/// <param name="structure_file_name">: name of the structure file in each subfolder</param>
+		/// <param name="camera_count">: cameras in the ring</param>
+		/// <param name="frame_count">: frames each camera plays</param>
+		/// <param name="depth_noise">: standard deviation of the depth noise in millimeters</param>
+		/// <returns>Successfully(?) written</returns>
+		bool MakeSyntheticRig(std::string output_folder, std::string structure_file_name, int camera_count, int frame_count, double depth_noise);
+
 		//Default destructor, say goodbye :(
 		~CameraManager();
 
@@ -85,16 +229,18 @@ namespace MKV_Rendering {
 		/// Gets a single mesh from our new voxel grid
 		/// </summary>
 		/// <param name="maximum_artifact_size">: max culling size for artifacts</param>
+		/// <param name="geometry_only">: skips voxel colors, so no camera decodes color for the mesh</param>
 		/// <returns>A pointer to a mesh</returns>
-		std::shared_ptr<open3d::geometry::TriangleMesh> GetMeshUsingNewVoxelGrid(int maximum_artifact_size);
+		std::shared_ptr<open3d::geometry::TriangleMesh> GetMeshUsingNewVoxelGrid(int maximum_artifact_size, bool geometry_only = false);
 
 		/// <summary>
 		/// Gets a single mesh at a specific timestamp from our new voxel grid
 		/// </summary>
 		/// <param name="maximum_artifact_size">: max culling size for artifacts</param>
 		/// <param name="timestamp">: time in playback</param>
+		/// <param name="geometry_only">: skips voxel colors, so no camera decodes color for the mesh</param>
 		/// <returns>A pointer to a mesh</returns>
-		std::shared_ptr<open3d::geometry::TriangleMesh> GetMeshUsingNewVoxelGridAtTimestamp(int maximum_artifact_size, uint64_t timestamp);
+		std::shared_ptr<open3d::geometry::TriangleMesh> GetMeshUsingNewVoxelGridAtTimestamp(int maximum_artifact_size, uint64_t timestamp, bool geometry_only = false);
 
 		/// <summary>
 		/// Gets an old Open3D voxel grid
@@ -166,8 +312,8 @@ namespace MKV_Rendering {
 		/// Gets a set of RGBD images across all child cameras at a specific timestamp
 		/// </summary>
 		/// <param name="timestamp">: time in playback</param>
-		/// <returns>The image vector</returns>
-		std::vector<open3d::geometry::RGBDImage> ExtractImageVectorAtTimestamp(uint64_t timestamp);
+		/// <returns>The cameras' frames, shared rather than copied</returns>
+		std::vector<std::shared_ptr<open3d::geometry::RGBDImage>> ExtractImageVectorAtTimestamp(uint64_t timestamp);
 
 		/// <summary>
 		/// Trajectory values from all child cameras
@@ -205,6 +351,122 @@ namespace MKV_Rendering {
 		/// <returns>The largest timestamp</returns>
 		uint64_t GetHighestTimestamp();
 
+		/// <summary>
+		/// Sets how far ahead frames are decoded, restarting prefetching if cameras are loaded
+		/// </summary>
+		/// <param name="depth">: frames to keep decoded per camera, 0 disables prefetching</param>
+		/// <param name="threads">: decoding threads</param>
+		void SetPrefetch(int depth, int threads);
+
+		/// <summary>
+		/// Starts decoding ahead from every camera's current frame, if prefetching is enabled
+		/// </summary>
+		void StartPrefetch();
+
+		/// <summary>
+		/// Stops decoding ahead
+		/// </summary>
+		/// <param name="restore_positions">: seek each camera back to the frame it is showing, rather than where decoding had reached</param>
+		void StopPrefetch(bool restore_positions);
+
+		/// <summary>
+		/// Prints prefetch hit/miss counts and stall time
+		/// </summary>
+		void PrintPrefetchStats();
+
+		/// <summary>
+		/// Sets whether and how frames are read ahead in batches, reading the current frame set straight away if enabled
+		/// </summary>
+		/// <param name="queue_depth">: most file reads in flight at once, 0 disables batched reads</param>
+		/// <param name="megabytes">: most megabytes being read at once</param>
+		void SetAsyncReads(int queue_depth, size_t megabytes);
+
+		/// <summary>
+		/// Prints batched read counts and throughput
+		/// </summary>
+		void PrintAsyncReadStats();
+
+		/// <summary>
+		/// Sets how much memory decoded frames may be cached in
+		/// </summary>
+		/// <param name="megabytes">: the budget, 0 disables caching</param>
+		void SetFrameCacheBudget(size_t megabytes);
+
+		/// <summary>
+		/// Turns frame index files on or off for the next load
+		/// </summary>
+		/// <param name="enabled">: write and reuse index files, or scan every folder</param>
+		void SetFrameIndexEnabled(bool enabled);
+
+		/// <summary>
+		/// Matches the captures of all cameras into one timeline, then keeps the cameras on it. Prefetching is stopped while it is in use
+		/// </summary>
+		/// <param name="tolerance">: how far a capture may be from a frame, in microseconds, 0 for half a frame</param>
+		/// <returns>Successfully(?) built</returns>
+		bool BuildTimeline(uint64_t tolerance);
+
+		/// <summary>
+		/// Drops the timeline, so cameras move independently again
+		/// </summary>
+		void ClearTimeline();
+
+		/// <summary>
+		/// Chooses how a camera moves depth into the color camera's image plane
+		/// </summary>
+		/// <param name="index">: the camera, or -1 for all cameras</param>
+		/// <param name="mode">: the method to use</param>
+		void SetDepthTransformMode(int index, DepthTransformMode mode);
+
+		/// <summary>
+		/// Decodes every camera's color at a fraction of its resolution, for previews and coarse passes
+		/// </summary>
+		/// <param name="scale">: full resolution pixels per decoded pixel along each side, 1, 2, 4 or 8</param>
+		void SetColorDecodeScale(int scale);
+
+		/// <summary>
+		/// Sets how the grids of GetMeshUsingNewVoxelGrid store their voxels, dense being the reference to compare against
+		/// </summary>
+		void SetMeshingStorage(MeshingVoxelStorage storage) { meshing_storage = storage; }
+
+		/// <summary>
+		/// Sets whether the grids of GetMeshUsingNewVoxelGrid visit every voxel per image or only the bands around the depth
+		/// </summary>
+		/// <param name="mode">: voxel driven, or pixel driven</param>
+		/// <param name="band">: voxels kept on either side of each depth sample when pixel driven</param>
+		void SetMeshingIntegration(MeshingIntegrationMode mode, int band) { meshing_integration = mode; meshing_band = band; }
+
+		/// <summary>
+		/// Makes GetMeshUsingNewVoxelGrid keep only the largest solid pieces, for captures of a single subject
+		/// </summary>
+		/// <param name="count">: pieces to keep, 0 to keep all</param>
+		void SetMeshingKeepLargest(int count) { meshing_keep_largest = count; }
+
+		/// <summary>
+		/// Lets each camera decode only the part of its color the subject is in, at the coarsest scale the voxel size allows
+		/// </summary>
+		/// <param name="data">: the voxel grid settings the frames will be integrated with</param>
+		/// <param name="box_min">: lowest corner of the subject's box, in world space</param>
+		/// <param name="box_max">: highest corner of the subject's box, in world space</param>
+		void ChooseColorDecodeRegions(VoxelGridData* data, Eigen::Vector3d box_min, Eigen::Vector3d box_max);
+
+		/// <summary>
+		/// Benchmarks color decoding on every MKV camera at its current frame
+		/// </summary>
+		/// <param name="iterations">: decodes per camera and decode path</param>
+		void BenchmarkColorDecode(int iterations);
+
+		/// <summary>
+		/// Compares the depth codec against PNG on every camera's current depth frame
+		/// </summary>
+		/// <param name="iterations">: encodes and decodes per camera and codec</param>
+		void BenchmarkDepthCodec(int iterations);
+
+		/// <summary>
+		/// Compares the meshing grid's voxel arrays against the old single voxel struct, over a box the size of the meshing grid
+		/// </summary>
+		/// <param name="iterations">: times each pass is run per layout</param>
+		void BenchmarkMeshingLayout(int iterations);
+
 		/// <summary>
 		/// Please don't call this :)
 		/// </summary>
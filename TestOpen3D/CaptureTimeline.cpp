@@ -0,0 +1,125 @@
+#include "CaptureTimeline.h"
+#include "ErrorLogger.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+MKV_Rendering::CaptureTimeline::CaptureTimeline()
+{
+}
+
+void MKV_Rendering::CaptureTimeline::Clear()
+{
+	frame_times.clear();
+	matches.clear();
+	camera_count = 0;
+	reference_camera = -1;
+	tolerance = 0;
+}
+
+bool MKV_Rendering::CaptureTimeline::Build(std::vector<Abstract_Data*>& cameras, uint64_t max_difference)
+{
+	Clear();
+
+	std::vector<std::vector<uint64_t>> timelines(cameras.size());
+	std::vector<int64_t> offsets(cameras.size());
+
+	for (int i = 0; i < cameras.size(); ++i)
+	{
+		if (!cameras[i]->GetCaptureTimeline(timelines[i]))
+		{
+			ErrorLogger::LOG_ERROR("Camera " + std::to_string(i) + " cannot list its captures!");
+			return false;
+		}
+
+		offsets[i] = (int64_t)cameras[i]->GetTimelineOffset();
+
+		//The densest camera leaves the fewest captures of the others unused
+		if (reference_camera < 0 || timelines[i].size() > timelines[reference_camera].size())
+		{
+			reference_camera = i;
+		}
+	}
+
+	if (reference_camera < 0 || timelines[reference_camera].empty())
+	{
+		ErrorLogger::LOG_ERROR("No captures to build a timeline from!");
+		return false;
+	}
+
+	auto& reference = timelines[reference_camera];
+
+	tolerance = max_difference;
+
+	if (tolerance == 0)
+	{
+		std::vector<uint64_t> intervals;
+
+		for (size_t i = 1; i < reference.size(); ++i)
+		{
+			intervals.push_back(reference[i] - reference[i - 1]);
+		}
+
+		if (!intervals.empty())
+		{
+			std::nth_element(intervals.begin(), intervals.begin() + intervals.size() / 2, intervals.end());
+			tolerance = intervals[intervals.size() / 2] / 2;
+		}
+	}
+
+	camera_count = cameras.size();
+	frame_times = reference;
+	matches.assign(frame_times.size() * camera_count, UNMATCHED);
+
+	for (int c = 0; c < camera_count; ++c)
+	{
+		auto& timeline = timelines[c];
+
+		//Moves a camera's capture times onto the reference camera's clock
+		int64_t shift = offsets[reference_camera] - offsets[c];
+
+		//Frames and captures are both in order, so the nearest capture only ever moves forwards
+		size_t capture = 0;
+
+		for (size_t f = 0; f < frame_times.size() && !timeline.empty(); ++f)
+		{
+			int64_t frame_time = (int64_t)frame_times[f];
+
+			while (capture + 1 < timeline.size() &&
+				std::abs((int64_t)timeline[capture + 1] + shift - frame_time) <= std::abs((int64_t)timeline[capture] + shift - frame_time))
+			{
+				++capture;
+			}
+
+			if ((uint64_t)std::abs((int64_t)timeline[capture] + shift - frame_time) <= tolerance)
+			{
+				matches[f * camera_count + c] = capture;
+			}
+		}
+	}
+
+	return true;
+}
+
+size_t MKV_Rendering::CaptureTimeline::FindFrame(uint64_t time)
+{
+	return std::lower_bound(frame_times.begin(), frame_times.end(), time) - frame_times.begin();
+}
+
+void MKV_Rendering::CaptureTimeline::PrintStats()
+{
+	std::cout << "Timeline: " << frame_times.size() << " frames from camera " << reference_camera << ", tolerance " << tolerance << " us" << std::endl;
+
+	for (int c = 0; c < camera_count; ++c)
+	{
+		size_t matched = 0;
+
+		for (size_t f = 0; f < frame_times.size(); ++f)
+		{
+			matched += (GetCapture(f, c) != UNMATCHED);
+		}
+
+		std::cout << "\tCamera " << c << ": matched in " << matched << " frames, skipped in " << frame_times.size() - matched << std::endl;
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Abstract_Data.h"
+
+#include <vector>
+#include <cstdint>
+
+namespace MKV_Rendering {
+
+	/// <summary>
+	/// One timeline across all cameras. Each frame of the timeline is a capture of the reference camera, matched to the nearest
+	/// capture of every other camera within a tolerance. Cameras without a capture close enough sit that frame out
+	/// </summary>
+	class CaptureTimeline
+	{
+		/// <summary>
+		/// Frame times, on the reference camera's clock
+		/// </summary>
+		std::vector<uint64_t> frame_times;
+
+		/// <summary>
+		/// Capture of each camera for each frame, frame by frame, UNMATCHED where a camera has none
+		/// </summary>
+		std::vector<size_t> matches;
+
+		size_t camera_count = 0;
+
+		/// <summary>
+		/// The camera whose captures make up the frames
+		/// </summary>
+		int reference_camera = -1;
+
+		/// <summary>
+		/// Largest difference between a frame time and a matched capture's time, in microseconds
+		/// </summary>
+		uint64_t tolerance = 0;
+
+	public:
+		/// <summary>
+		/// Marks a camera without a capture in a frame
+		/// </summary>
+		static const size_t UNMATCHED = SIZE_MAX;
+
+		CaptureTimeline();
+
+		/// <summary>
+		/// Builds the timeline from the cameras' capture timelines and offsets
+		/// </summary>
+		/// <param name="cameras">: the cameras, in manager order</param>
+		/// <param name="max_difference">: tolerance in microseconds, 0 for half of the reference camera's typical frame interval</param>
+		/// <returns>Successfully(?) built, false if a camera cannot list its captures</returns>
+		bool Build(std::vector<Abstract_Data*>& cameras, uint64_t max_difference);
+
+		void Clear();
+
+		bool IsBuilt() { return !frame_times.empty(); }
+
+		size_t GetFrameCount() { return frame_times.size(); }
+
+		uint64_t GetFrameTime(size_t frame) { return frame_times[frame]; }
+
+		/// <summary>
+		/// Gets which capture of a camera belongs to a frame
+		/// </summary>
+		/// <returns>The capture's position in the camera's timeline, or UNMATCHED</returns>
+		size_t GetCapture(size_t frame, int camera) { return matches[frame * camera_count + camera]; }
+
+		/// <summary>
+		/// Finds the first frame at or after a time, the same rounding as Abstract_Data::SeekToTime
+		/// </summary>
+		/// <param name="time">: time on the reference camera's clock</param>
+		/// <returns>The frame, or GetFrameCount() if the time is past the end</returns>
+		size_t FindFrame(uint64_t time);
+
+		/// <summary>
+		/// Prints the frame count, tolerance, and how many frames each camera was matched in
+		/// </summary>
+		void PrintStats();
+	};
+}
@@ -0,0 +1,490 @@
+#include "DepthCodec.h"
+#include "ImageDecoder.h"
+#include "ErrorLogger.h"
+
+#include <png.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+/// <summary>
+/// Start of every encoded image, followed by the byte size of each band and then the bands
+/// </summary>
+struct DepthCodecHeader
+{
+	char magic[4] = { 'R', 'V', 'L', '1' };
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t band_count = 0;
+};
+
+/// <summary>
+/// Packs nibbles into 32 bit words, first nibble in the highest bits
+/// </summary>
+class NibbleWriter
+{
+	std::vector<uint8_t>& output;
+
+	uint32_t word = 0;
+	int nibbles = 0;
+
+public:
+	NibbleWriter(std::vector<uint8_t>& output) : output(output)
+	{
+	}
+
+	inline void Write(uint32_t nibble)
+	{
+		word = (word << 4) | nibble;
+
+		if (++nibbles == 8)
+		{
+			size_t end = output.size();
+			output.resize(end + sizeof(uint32_t));
+			std::memcpy(output.data() + end, &word, sizeof(uint32_t));
+
+			word = 0;
+			nibbles = 0;
+		}
+	}
+
+	/// <summary>
+	/// 3 bits per nibble, the top bit says whether another nibble follows
+	/// </summary>
+	inline void WriteVariable(uint32_t value)
+	{
+		do
+		{
+			uint32_t nibble = value & 7;
+			value >>= 3;
+
+			if (value)
+			{
+				nibble |= 8;
+			}
+
+			Write(nibble);
+		} while (value);
+	}
+
+	void Finish()
+	{
+		while (nibbles != 0)
+		{
+			Write(0);
+		}
+	}
+};
+
+/// <summary>
+/// Reads back what NibbleWriter wrote, failing rather than reading past the end
+/// </summary>
+class NibbleReader
+{
+	const uint8_t* input;
+	const uint8_t* end;
+
+	uint32_t word = 0;
+	int nibbles = 0;
+
+public:
+	NibbleReader(const uint8_t* input, size_t size) : input(input), end(input + size)
+	{
+	}
+
+	inline bool Read(uint32_t& nibble)
+	{
+		if (nibbles == 0)
+		{
+			if (end - input < (ptrdiff_t)sizeof(uint32_t))
+			{
+				return false;
+			}
+
+			std::memcpy(&word, input, sizeof(uint32_t));
+			input += sizeof(uint32_t);
+			nibbles = 8;
+		}
+
+		nibble = word >> 28;
+		word <<= 4;
+		--nibbles;
+
+		return true;
+	}
+
+	inline bool ReadVariable(uint32_t& value)
+	{
+		value = 0;
+
+		uint32_t nibble;
+		int shift = 0;
+
+		do
+		{
+			if (shift > 30 || !Read(nibble))
+			{
+				return false;
+			}
+
+			value |= (nibble & 7) << shift;
+			shift += 3;
+		} while (nibble & 8);
+
+		return true;
+	}
+};
+
+static void EncodeBand(const uint16_t* depth, size_t count, std::vector<uint8_t>& output)
+{
+	NibbleWriter writer(output);
+
+	int previous = 0;
+	size_t i = 0;
+
+	while (i < count)
+	{
+		size_t zeros_start = i;
+
+		while (i < count && depth[i] == 0)
+		{
+			++i;
+		}
+
+		writer.WriteVariable((uint32_t)(i - zeros_start));
+
+		size_t values_start = i;
+		size_t values_end = i;
+
+		while (values_end < count && depth[values_end] != 0)
+		{
+			++values_end;
+		}
+
+		writer.WriteVariable((uint32_t)(values_end - values_start));
+
+		for (; i < values_end; ++i)
+		{
+			int delta = (int)depth[i] - previous;
+
+			//Zigzag, so small negative deltas stay small
+			writer.WriteVariable((uint32_t)((delta << 1) ^ (delta >> 31)));
+
+			previous = depth[i];
+		}
+	}
+
+	writer.Finish();
+}
+
+static bool DecodeBand(const uint8_t* input, size_t size, uint16_t* depth, size_t count)
+{
+	NibbleReader reader(input, size);
+
+	int previous = 0;
+	size_t i = 0;
+
+	while (i < count)
+	{
+		uint32_t zeros;
+		uint32_t values;
+
+		if (!reader.ReadVariable(zeros) || zeros > count - i)
+		{
+			return false;
+		}
+
+		std::memset(depth + i, 0, zeros * sizeof(uint16_t));
+		i += zeros;
+
+		if (!reader.ReadVariable(values) || values > count - i)
+		{
+			return false;
+		}
+
+		for (uint32_t v = 0; v < values; ++v)
+		{
+			uint32_t zigzag;
+
+			if (!reader.ReadVariable(zigzag))
+			{
+				return false;
+			}
+
+			int delta = (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+
+			previous += delta;
+			depth[i++] = (uint16_t)previous;
+		}
+	}
+
+	return true;
+}
+
+bool MKV_Rendering::DepthCodec::Encode(const open3d::geometry::Image& depth, std::vector<uint8_t>& output, int band_count)
+{
+	if (depth.num_of_channels_ != 1 || depth.bytes_per_channel_ != sizeof(uint16_t))
+	{
+		ErrorLogger::LOG_ERROR("Depth codec needs a single channel, 16 bit image!");
+		return false;
+	}
+
+	band_count = std::clamp(band_count, 1, std::max(depth.height_, 1));
+
+	DepthCodecHeader header;
+	header.width = depth.width_;
+	header.height = depth.height_;
+	header.band_count = band_count;
+
+	auto pixels = reinterpret_cast<const uint16_t*>(depth.data_.data());
+
+	std::vector<std::vector<uint8_t>> bands(band_count);
+
+#pragma omp parallel for schedule(dynamic)
+	for (int b = 0; b < band_count; ++b)
+	{
+		size_t first_row = (size_t)depth.height_ * b / band_count;
+		size_t last_row = (size_t)depth.height_ * (b + 1) / band_count;
+
+		bands[b].reserve((last_row - first_row) * depth.width_);
+
+		EncodeBand(pixels + first_row * depth.width_, (last_row - first_row) * depth.width_, bands[b]);
+	}
+
+	size_t total = sizeof(DepthCodecHeader) + band_count * sizeof(uint32_t);
+
+	for (auto& band : bands)
+	{
+		total += band.size();
+	}
+
+	output.resize(total);
+
+	std::memcpy(output.data(), &header, sizeof(DepthCodecHeader));
+
+	uint8_t* band_sizes = output.data() + sizeof(DepthCodecHeader);
+	uint8_t* band_data = band_sizes + band_count * sizeof(uint32_t);
+
+	for (int b = 0; b < band_count; ++b)
+	{
+		uint32_t band_size = (uint32_t)bands[b].size();
+
+		std::memcpy(band_sizes + b * sizeof(uint32_t), &band_size, sizeof(uint32_t));
+		std::memcpy(band_data, bands[b].data(), band_size);
+
+		band_data += band_size;
+	}
+
+	return true;
+}
+
+bool MKV_Rendering::DepthCodec::IsEncoded(const uint8_t* data, size_t size)
+{
+	DepthCodecHeader expected;
+
+	return size >= sizeof(DepthCodecHeader) && std::memcmp(data, expected.magic, sizeof(expected.magic)) == 0;
+}
+
+bool MKV_Rendering::DepthCodec::Decode(const uint8_t* data, size_t size, open3d::geometry::Image& depth)
+{
+	if (!IsEncoded(data, size))
+	{
+		ErrorLogger::LOG_ERROR("Not an encoded depth image!");
+		return false;
+	}
+
+	DepthCodecHeader header;
+	std::memcpy(&header, data, sizeof(DepthCodecHeader));
+
+	size_t tables_size = sizeof(DepthCodecHeader) + (size_t)header.band_count * sizeof(uint32_t);
+
+	if (header.band_count == 0 || header.band_count > header.height || size < tables_size)
+	{
+		ErrorLogger::LOG_ERROR("Encoded depth image is corrupt!");
+		return false;
+	}
+
+	std::vector<size_t> band_offsets(header.band_count);
+	std::vector<uint32_t> band_sizes(header.band_count);
+
+	size_t offset = tables_size;
+
+	for (uint32_t b = 0; b < header.band_count; ++b)
+	{
+		std::memcpy(&band_sizes[b], data + sizeof(DepthCodecHeader) + b * sizeof(uint32_t), sizeof(uint32_t));
+
+		band_offsets[b] = offset;
+		offset += band_sizes[b];
+	}
+
+	if (offset > size)
+	{
+		ErrorLogger::LOG_ERROR("Encoded depth image is truncated!");
+		return false;
+	}
+
+	depth.Prepare(header.width, header.height, 1, sizeof(uint16_t));
+
+	auto pixels = reinterpret_cast<uint16_t*>(depth.data_.data());
+
+	int band_count = (int)header.band_count;
+	int failed_bands = 0;
+
+#pragma omp parallel for schedule(dynamic) reduction(+:failed_bands)
+	for (int b = 0; b < band_count; ++b)
+	{
+		size_t first_row = (size_t)header.height * b / band_count;
+		size_t last_row = (size_t)header.height * (b + 1) / band_count;
+
+		if (!DecodeBand(data + band_offsets[b], band_sizes[b], pixels + first_row * header.width, (last_row - first_row) * header.width))
+		{
+			++failed_bands;
+		}
+	}
+
+	if (failed_bands > 0)
+	{
+		ErrorLogger::LOG_ERROR("Encoded depth image is corrupt in " + std::to_string(failed_bands) + " bands!");
+		return false;
+	}
+
+	return true;
+}
+
+bool MKV_Rendering::DepthCodec::ReadDepth(std::string path, open3d::geometry::Image& depth)
+{
+	std::string extension = open3d::utility::filesystem::GetFileExtensionInLowerCase(path);
+
+	if (extension != "rvl")
+	{
+		return open3d::io::ReadImage(path, depth);
+	}
+
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+	if (!file.is_open())
+	{
+		ErrorLogger::LOG_ERROR("Could not open " + path + "!");
+		return false;
+	}
+
+	//Each reading thread keeps its own buffer, so replays do not allocate per frame
+	thread_local std::vector<uint8_t> encoded;
+
+	size_t size = (size_t)file.tellg();
+	file.seekg(0, std::ios::beg);
+
+	encoded.resize(size);
+	file.read(reinterpret_cast<char*>(encoded.data()), size);
+
+	if (!file.good())
+	{
+		ErrorLogger::LOG_ERROR("Could not read " + path + "!");
+		return false;
+	}
+
+	return Decode(encoded.data(), size, depth);
+}
+
+bool MKV_Rendering::DepthCodec::WriteDepth(std::string path, const open3d::geometry::Image& depth)
+{
+	thread_local std::vector<uint8_t> encoded;
+
+	if (!Encode(depth, encoded))
+	{
+		return false;
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+	file.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+
+	return file.good();
+}
+
+void MKV_Rendering::DepthCodec::Benchmark(std::string label, const open3d::geometry::Image& depth, int iterations)
+{
+	if (depth.num_of_channels_ != 1 || depth.bytes_per_channel_ != sizeof(uint16_t))
+	{
+		ErrorLogger::LOG_ERROR("Depth codec needs a single channel, 16 bit image!");
+		return;
+	}
+
+	iterations = std::max(iterations, 1);
+
+	double raw_megabytes = (double)depth.data_.size() / (1024.0 * 1024.0);
+
+	std::vector<uint8_t> rvl;
+	open3d::geometry::Image rvl_decoded;
+
+	auto rvl_start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < iterations; ++i)
+	{
+		Encode(depth, rvl);
+	}
+
+	auto rvl_encoded = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < iterations; ++i)
+	{
+		Decode(rvl.data(), rvl.size(), rvl_decoded);
+	}
+
+	auto rvl_end = std::chrono::steady_clock::now();
+
+	//Same PNG settings Open3D writes depth with
+	png_image png;
+	std::memset(&png, 0, sizeof(png));
+	png.version = PNG_IMAGE_VERSION;
+	png.width = depth.width_;
+	png.height = depth.height_;
+	png.format = PNG_FORMAT_LINEAR_Y;
+
+	png_alloc_size_t png_size = 0;
+	png_image_write_to_memory(&png, NULL, &png_size, 0, depth.data_.data(), 0, NULL);
+
+	std::vector<uint8_t> png_encoded(png_size);
+	open3d::geometry::Image png_decoded;
+	ImageDecoder decoder;
+
+	auto png_start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < iterations; ++i)
+	{
+		png_size = png_encoded.size();
+		png_image_write_to_memory(&png, png_encoded.data(), &png_size, 0, depth.data_.data(), 0, NULL);
+	}
+
+	auto png_encoded_time = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < iterations; ++i)
+	{
+		decoder.DecodePNG(png_encoded.data(), png_size, png_decoded);
+	}
+
+	auto png_end = std::chrono::steady_clock::now();
+
+	size_t mismatched = 0;
+
+	for (size_t i = 0; i < depth.data_.size() && i < rvl_decoded.data_.size(); ++i)
+	{
+		if (depth.data_[i] != rvl_decoded.data_[i])
+		{
+			++mismatched;
+		}
+	}
+
+	auto throughput = [raw_megabytes, iterations](std::chrono::steady_clock::duration time) {
+		return raw_megabytes * iterations / std::max(std::chrono::duration<double>(time).count(), 1e-9);
+	};
+
+	std::cout << label << " (" << depth.width_ << "x" << depth.height_ << ", " << iterations << " iterations)" << std::endl;
+	std::cout << "\tRVL: " << rvl.size() << " bytes (" << (double)depth.data_.size() / std::max<size_t>(rvl.size(), 1) << ":1), encode " <<
+		throughput(rvl_encoded - rvl_start) << " MB/s, decode " << throughput(rvl_end - rvl_encoded) << " MB/s" << std::endl;
+	std::cout << "\tPNG: " << png_size << " bytes (" << (double)depth.data_.size() / std::max<size_t>(png_size, 1) << ":1), encode " <<
+		throughput(png_encoded_time - png_start) << " MB/s, decode " << throughput(png_end - png_encoded_time) << " MB/s" << std::endl;
+	std::cout << "\tRVL mismatched bytes: " << mismatched << std::endl;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "open3d/Open3D.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace MKV_Rendering {
+
+	/// <summary>
+	/// Lossless codec for 16 bit depth images, following RVL (run length of zeros, then variable length zigzag deltas of the
+	/// values in between, packed in nibbles). The image is split into bands of rows that are coded independently, so encoding
+	/// and decoding run on every core. Files use the .rvl extension
+	/// </summary>
+	class DepthCodec
+	{
+	public:
+		/// <summary>
+		/// Bands an image is split into when encoding, decoding uses however many the file has
+		/// </summary>
+		static const int DEFAULT_BAND_COUNT = 16;
+
+		/// <summary>
+		/// Encodes a depth image
+		/// </summary>
+		/// <param name="depth">: single channel, 16 bit depth</param>
+		/// <param name="output">: the encoded image, replaced</param>
+		/// <param name="band_count">: how many bands to split the image into</param>
+		/// <returns>Successfully(?) encoded</returns>
+		static bool Encode(const open3d::geometry::Image& depth, std::vector<uint8_t>& output, int band_count = DEFAULT_BAND_COUNT);
+
+		/// <summary>
+		/// Decodes a depth image
+		/// </summary>
+		/// <param name="data">: the encoded image</param>
+		/// <param name="size">: size of the encoded image in bytes</param>
+		/// <param name="depth">: destination, prepared to fit</param>
+		/// <returns>Successfully(?) decoded</returns>
+		static bool Decode(const uint8_t* data, size_t size, open3d::geometry::Image& depth);
+
+		/// <summary>
+		/// Whether some data starts like an encoded depth image
+		/// </summary>
+		static bool IsEncoded(const uint8_t* data, size_t size);
+
+		/// <summary>
+		/// Reads a depth image, decoding .rvl files here and leaving everything else to open3d::io::ReadImage
+		/// </summary>
+		/// <param name="path">: the file to read</param>
+		/// <param name="depth">: destination</param>
+		/// <returns>Successfully(?) read</returns>
+		static bool ReadDepth(std::string path, open3d::geometry::Image& depth);
+
+		/// <summary>
+		/// Encodes a depth image and writes it to a file
+		/// </summary>
+		/// <param name="path">: the file to write, normally ending in .rvl</param>
+		/// <param name="depth">: single channel, 16 bit depth</param>
+		/// <returns>Successfully(?) written</returns>
+		static bool WriteDepth(std::string path, const open3d::geometry::Image& depth);
+
+		/// <summary>
+		/// Prints encode/decode speed and size of this codec against PNG, for one depth image
+		/// </summary>
+		/// <param name="label">: printed with the results</param>
+		/// <param name="depth">: single channel, 16 bit depth</param>
+		/// <param name="iterations">: encodes and decodes per codec</param>
+		static void Benchmark(std::string label, const open3d::geometry::Image& depth, int iterations);
+	};
+}
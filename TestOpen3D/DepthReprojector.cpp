@@ -0,0 +1,541 @@
+#include "DepthReprojector.h"
+#include "ErrorLogger.h"
+
+#include <cmath>
+#include <limits>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+
+/// <summary>
+/// Which side of the line a to b the point p is on, positive to the left
+/// </summary>
+static inline float EdgeFunction(float ax, float ay, float bx, float by, float px, float py)
+{
+	return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+}
+
+/// <summary>
+/// Point in triangle test that does not care about the triangle's winding
+/// </summary>
+static inline bool InTriangle(const float* us, const float* vs, int a, int b, int c, float px, float py)
+{
+	float e0 = EdgeFunction(us[a], vs[a], us[b], vs[b], px, py);
+	float e1 = EdgeFunction(us[b], vs[b], us[c], vs[c], px, py);
+	float e2 = EdgeFunction(us[c], vs[c], us[a], vs[a], px, py);
+
+	return (e0 >= 0 && e1 >= 0 && e2 >= 0) || (e0 <= 0 && e1 <= 0 && e2 <= 0);
+}
+
+MKV_Rendering::DepthReprojector::DepthReprojector(const k4a_calibration_t& calibration)
+{
+	auto& depth_camera = calibration.depth_camera_calibration;
+	auto& color_camera = calibration.color_camera_calibration;
+
+	depth_width = depth_camera.resolution_width;
+	depth_height = depth_camera.resolution_height;
+
+	color_width = color_camera.resolution_width;
+	color_height = color_camera.resolution_height;
+
+	int depth_count = depth_width * depth_height;
+
+	ray_x.resize(depth_count);
+	ray_y.resize(depth_count);
+
+	color_u.resize(depth_count);
+	color_v.resize(depth_count);
+	color_z.resize(depth_count);
+
+	z_buffer.reset(new std::atomic<uint16_t>[color_width * color_height]);
+
+	//Unprojecting at a depth of 1 gives the point where each pixel's ray crosses z = 1, with the lens undistorted
+#pragma omp parallel for schedule(static)
+	for (int v = 0; v < depth_height; ++v)
+	{
+		for (int u = 0; u < depth_width; ++u)
+		{
+			int i = v * depth_width + u;
+
+			k4a_float2_t pixel;
+			pixel.xy.x = (float)u;
+			pixel.xy.y = (float)v;
+
+			k4a_float3_t ray;
+			int valid = 0;
+
+			if (K4A_RESULT_SUCCEEDED == k4a_calibration_2d_to_3d(&calibration, &pixel, 1.f,
+				K4A_CALIBRATION_TYPE_DEPTH, K4A_CALIBRATION_TYPE_DEPTH, &ray, &valid) && valid)
+			{
+				ray_x[i] = ray.xyz.x;
+				ray_y[i] = ray.xyz.y;
+			}
+			else
+			{
+				ray_x[i] = std::numeric_limits<float>::quiet_NaN();
+				ray_y[i] = std::numeric_limits<float>::quiet_NaN();
+			}
+		}
+	}
+
+	auto& depth_to_color = calibration.extrinsics[K4A_CALIBRATION_TYPE_DEPTH][K4A_CALIBRATION_TYPE_COLOR];
+
+	std::memcpy(rotation, depth_to_color.rotation, sizeof(rotation));
+	std::memcpy(translation, depth_to_color.translation, sizeof(translation));
+
+	color_intrinsics = color_camera.intrinsics.parameters;
+	color_model = color_camera.intrinsics.type;
+	color_metric_radius = color_camera.metric_radius;
+
+	if (color_model != K4A_CALIBRATION_LENS_DISTORTION_MODEL_BROWN_CONRADY &&
+		color_model != K4A_CALIBRATION_LENS_DISTORTION_MODEL_RATIONAL_6KT)
+	{
+		ErrorLogger::LOG_ERROR("Unsupported color lens model, reprojection will not match the k4a transformation!");
+	}
+}
+
+bool MKV_Rendering::DepthReprojector::ProjectToColor(float x, float y, float z, float& u, float& v)
+{
+	auto& p = color_intrinsics.param;
+
+	//Same lens model as the k4a projection
+	float xp = x / z - p.codx;
+	float yp = y / z - p.cody;
+
+	float xp2 = xp * xp;
+	float yp2 = yp * yp;
+	float xyp = xp * yp;
+	float rs = xp2 + yp2;
+
+	if (color_metric_radius > 0 && rs > color_metric_radius * color_metric_radius)
+	{
+		return false;
+	}
+
+	float rss = rs * rs;
+	float rsc = rss * rs;
+	float a = 1.f + p.k1 * rs + p.k2 * rss + p.k3 * rsc;
+	float b = 1.f + p.k4 * rs + p.k5 * rss + p.k6 * rsc;
+	float bi = (b != 0.f) ? 1.f / b : 1.f;
+	float d = a * bi;
+
+	float xp_d = xp * d;
+	float yp_d = yp * d;
+
+	float rs_2xp2 = rs + 2.f * xp2;
+	float rs_2yp2 = rs + 2.f * yp2;
+
+	if (color_model == K4A_CALIBRATION_LENS_DISTORTION_MODEL_RATIONAL_6KT)
+	{
+		xp_d += rs_2xp2 * p.p2 + xyp * p.p1;
+		yp_d += rs_2yp2 * p.p1 + xyp * p.p2;
+	}
+	else
+	{
+		xp_d += rs_2xp2 * p.p2 + 2.f * xyp * p.p1;
+		yp_d += rs_2yp2 * p.p1 + 2.f * xyp * p.p2;
+	}
+
+	xp_d += p.codx;
+	yp_d += p.cody;
+
+	u = xp_d * p.fx + p.cx;
+	v = yp_d * p.fy + p.cy;
+
+	return true;
+}
+
+void MKV_Rendering::DepthReprojector::WriteNearest(int pixel, uint16_t depth)
+{
+	uint16_t current = z_buffer[pixel].load(std::memory_order_relaxed);
+
+	while (depth < current && !z_buffer[pixel].compare_exchange_weak(current, depth, std::memory_order_relaxed))
+	{
+	}
+}
+
+void MKV_Rendering::DepthReprojector::DrawQuad(const int corners[4])
+{
+	float us[4];
+	float vs[4];
+	uint16_t zs[4];
+
+	for (int k = 0; k < 4; ++k)
+	{
+		zs[k] = color_z[corners[k]];
+
+		if (zs[k] == 0)
+		{
+			return;
+		}
+
+		us[k] = color_u[corners[k]];
+		vs[k] = color_v[corners[k]];
+	}
+
+	if (max_quad_depth_range > 0)
+	{
+		uint16_t z_min = std::min(std::min(zs[0], zs[1]), std::min(zs[2], zs[3]));
+		uint16_t z_max = std::max(std::max(zs[0], zs[1]), std::max(zs[2], zs[3]));
+
+		if (z_max - z_min > max_quad_depth_range)
+		{
+			return;
+		}
+	}
+
+	int x_min = std::max(0, (int)std::ceil(std::min(std::min(us[0], us[1]), std::min(us[2], us[3]))));
+	int x_max = std::min(color_width - 1, (int)std::floor(std::max(std::max(us[0], us[1]), std::max(us[2], us[3]))));
+	int y_min = std::max(0, (int)std::ceil(std::min(std::min(vs[0], vs[1]), std::min(vs[2], vs[3]))));
+	int y_max = std::min(color_height - 1, (int)std::floor(std::max(std::max(vs[0], vs[1]), std::max(vs[2], vs[3]))));
+
+	//Neighbouring depth pixels land a few color pixels apart, anything larger has been torn apart by the lens edge
+	if (x_max - x_min > 32 || y_max - y_min > 32)
+	{
+		return;
+	}
+
+	for (int y = y_min; y <= y_max; ++y)
+	{
+		for (int x = x_min; x <= x_max; ++x)
+		{
+			float px = (float)x;
+			float py = (float)y;
+
+			if (!InTriangle(us, vs, 0, 1, 2, px, py) && !InTriangle(us, vs, 0, 2, 3, px, py))
+			{
+				continue;
+			}
+
+			int nearest = 0;
+			float nearest_distance = std::numeric_limits<float>::max();
+
+			for (int k = 0; k < 4; ++k)
+			{
+				float du = us[k] - px;
+				float dv = vs[k] - py;
+				float distance = du * du + dv * dv;
+
+				if (distance < nearest_distance)
+				{
+					nearest_distance = distance;
+					nearest = k;
+				}
+			}
+
+			WriteNearest(y * color_width + x, zs[nearest]);
+		}
+	}
+}
+
+bool MKV_Rendering::DepthReprojector::Reproject(const uint16_t* depth, int width, int height, open3d::geometry::Image& color_space_depth, MatteMask* matte)
+{
+	if (width != depth_width || height != depth_height)
+	{
+		ErrorLogger::LOG_ERROR("Depth image is " + std::to_string(width) + "x" + std::to_string(height) +
+			", calibration expects " + std::to_string(depth_width) + "x" + std::to_string(depth_height) + "!");
+		return false;
+	}
+
+	if (color_space_depth.width_ != color_width || color_space_depth.height_ != color_height ||
+		color_space_depth.num_of_channels_ != 1 || color_space_depth.bytes_per_channel_ != sizeof(uint16_t))
+	{
+		ErrorLogger::LOG_ERROR("Destination must be a 16 bit, single channel image of " +
+			std::to_string(color_width) + "x" + std::to_string(color_height) + "!");
+		return false;
+	}
+
+	int color_count = color_width * color_height;
+
+	//Only depth landing near the subject is kept, quads are a few pixels across so a small margin keeps its edges whole
+	const float clip_margin = 4.f;
+
+	float clip_min_u = -clip_margin;
+	float clip_min_v = -clip_margin;
+	float clip_max_u = (float)color_width + clip_margin;
+	float clip_max_v = (float)color_height + clip_margin;
+
+	if (matte != nullptr)
+	{
+		if (matte->IsEmpty())
+		{
+			std::memset(color_space_depth.data_.data(), 0, color_space_depth.data_.size());
+			return true;
+		}
+
+		int min_u, min_v, max_u, max_v;
+		matte->GetBoundingBox(min_u, min_v, max_u, max_v);
+
+		clip_min_u = (float)min_u - clip_margin;
+		clip_min_v = (float)min_v - clip_margin;
+		clip_max_u = (float)max_u + clip_margin;
+		clip_max_v = (float)max_v + clip_margin;
+	}
+
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < color_count; ++i)
+	{
+		z_buffer[i].store(std::numeric_limits<uint16_t>::max(), std::memory_order_relaxed);
+	}
+
+	//Where every depth pixel lands in the color image
+#pragma omp parallel for schedule(static)
+	for (int v = 0; v < depth_height; ++v)
+	{
+		int row = v * depth_width;
+
+		for (int u = 0; u < depth_width; ++u)
+		{
+			int i = row + u;
+
+			float d = (float)depth[i];
+			float rx = ray_x[i];
+
+			color_z[i] = 0;
+
+			if (d == 0.f || std::isnan(rx))
+			{
+				continue;
+			}
+
+			float x = rx * d;
+			float y = ray_y[i] * d;
+
+			float cx = rotation[0] * x + rotation[1] * y + rotation[2] * d + translation[0];
+			float cy = rotation[3] * x + rotation[4] * y + rotation[5] * d + translation[1];
+			float cz = rotation[6] * x + rotation[7] * y + rotation[8] * d + translation[2];
+
+			if (cz <= 0.f || !ProjectToColor(cx, cy, cz, color_u[i], color_v[i]))
+			{
+				continue;
+			}
+
+			if (color_u[i] < clip_min_u || color_u[i] > clip_max_u || color_v[i] < clip_min_v || color_v[i] > clip_max_v)
+			{
+				continue;
+			}
+
+			color_z[i] = (uint16_t)std::min(cz + 0.5f, 65534.f);
+		}
+	}
+
+	//Fill between neighbouring depth pixels, keeping the nearest surface where quads overlap
+#pragma omp parallel for schedule(static)
+	for (int v = 0; v < depth_height - 1; ++v)
+	{
+		for (int u = 0; u < depth_width - 1; ++u)
+		{
+			int i = v * depth_width + u;
+
+			int corners[4] = { i, i + 1, i + depth_width + 1, i + depth_width };
+
+			DrawQuad(corners);
+		}
+	}
+
+	uint16_t* output = reinterpret_cast<uint16_t*>(color_space_depth.data_.data());
+
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < color_count; ++i)
+	{
+		uint16_t z = z_buffer[i].load(std::memory_order_relaxed);
+
+		output[i] = (z == std::numeric_limits<uint16_t>::max()) ? 0 : z;
+	}
+
+	return true;
+}
+
+void MKV_Rendering::DepthReprojector::BuildDepthSpaceTables(const k4a_calibration_t& calibration)
+{
+	auto& params = calibration.depth_camera_calibration.intrinsics.parameters.param;
+
+	depth_fx = params.fx;
+	depth_fy = params.fy;
+	depth_cx = params.cx;
+	depth_cy = params.cy;
+
+	depth_source.assign(depth_width * depth_height, -1);
+
+	//Each undistorted pixel's ray goes through the real lens to find the depth pixel that saw along it
+#pragma omp parallel for schedule(static)
+	for (int v = 0; v < depth_height; ++v)
+	{
+		for (int u = 0; u < depth_width; ++u)
+		{
+			k4a_float3_t point;
+			point.xyz.x = ((float)u - depth_cx) / depth_fx;
+			point.xyz.y = ((float)v - depth_cy) / depth_fy;
+			point.xyz.z = 1.f;
+
+			k4a_float2_t pixel;
+			int valid = 0;
+
+			if (K4A_RESULT_SUCCEEDED != k4a_calibration_3d_to_2d(&calibration, &point,
+				K4A_CALIBRATION_TYPE_DEPTH, K4A_CALIBRATION_TYPE_DEPTH, &pixel, &valid) || !valid)
+			{
+				continue;
+			}
+
+			int source_u = (int)std::floor(pixel.xy.x + 0.5f);
+			int source_v = (int)std::floor(pixel.xy.y + 0.5f);
+
+			if (source_u < 0 || source_v < 0 || source_u >= depth_width || source_v >= depth_height)
+			{
+				continue;
+			}
+
+			depth_source[v * depth_width + u] = source_v * depth_width + source_u;
+		}
+	}
+}
+
+bool MKV_Rendering::DepthReprojector::MapColorToDepth(const uint16_t* depth, int width, int height, const open3d::geometry::Image& color, const JPEGDecodeRegion& color_region,
+	open3d::geometry::Image& depth_space_depth, open3d::geometry::Image& depth_space_color, MatteMask* matte)
+{
+	if (width != depth_width || height != depth_height)
+	{
+		ErrorLogger::LOG_ERROR("Depth image is " + std::to_string(width) + "x" + std::to_string(height) +
+			", calibration expects " + std::to_string(depth_width) + "x" + std::to_string(depth_height) + "!");
+		return false;
+	}
+
+	if (depth_source.empty())
+	{
+		ErrorLogger::LOG_ERROR("Depth space tables have not been built!");
+		return false;
+	}
+
+	int pixel_bytes = color.num_of_channels_ * color.bytes_per_channel_;
+
+	depth_space_depth.Prepare(depth_width, depth_height, 1, sizeof(uint16_t));
+	depth_space_color.Prepare(depth_width, depth_height, color.num_of_channels_, color.bytes_per_channel_);
+
+	if (matte != nullptr && matte->IsEmpty())
+	{
+		std::memset(depth_space_depth.data_.data(), 0, depth_space_depth.data_.size());
+		std::memset(depth_space_color.data_.data(), 0, depth_space_color.data_.size());
+		return true;
+	}
+
+	//Same mapping from the color camera's pixels to decoded pixels as JPEGDecodeRegion::ScaleIntrinsic
+	float scale = (float)color_region.scale;
+	float offset_u = (float)color_region.x + (scale - 1.f) / 2.f;
+	float offset_v = (float)color_region.y + (scale - 1.f) / 2.f;
+
+	const uint8_t* input_color = color.data_.data();
+	uint16_t* output_depth = reinterpret_cast<uint16_t*>(depth_space_depth.data_.data());
+	uint8_t* output_color = depth_space_color.data_.data();
+
+#pragma omp parallel for schedule(static)
+	for (int v = 0; v < depth_height; ++v)
+	{
+		for (int u = 0; u < depth_width; ++u)
+		{
+			int i = v * depth_width + u;
+			int source = depth_source[i];
+
+			uint8_t* pixel = output_color + (size_t)i * pixel_bytes;
+			float d = (source >= 0) ? (float)depth[source] : 0.f;
+
+			output_depth[i] = 0;
+			std::memset(pixel, 0, pixel_bytes);
+
+			if (d == 0.f)
+			{
+				continue;
+			}
+
+			float x = ((float)u - depth_cx) / depth_fx * d;
+			float y = ((float)v - depth_cy) / depth_fy * d;
+
+			float cx = rotation[0] * x + rotation[1] * y + rotation[2] * d + translation[0];
+			float cy = rotation[3] * x + rotation[4] * y + rotation[5] * d + translation[1];
+			float cz = rotation[6] * x + rotation[7] * y + rotation[8] * d + translation[2];
+
+			float color_x, color_y;
+
+			if (cz <= 0.f || !ProjectToColor(cx, cy, cz, color_x, color_y))
+			{
+				continue;
+			}
+
+			if (matte != nullptr)
+			{
+				int matte_u = (int)std::floor(color_x + 0.5f);
+				int matte_v = (int)std::floor(color_y + 0.5f);
+
+				if (matte_u < 0 || matte_v < 0 || matte_u >= matte->GetWidth() || matte_v >= matte->GetHeight() || !matte->IsSet(matte_u, matte_v))
+				{
+					continue;
+				}
+			}
+
+			//Depth seen by no decoded color pixel is dropped, as it would be cropped away in the color camera's space
+			int color_u = (int)std::floor((color_x - offset_u) / scale + 0.5f);
+			int color_v = (int)std::floor((color_y - offset_v) / scale + 0.5f);
+
+			if (color_u < 0 || color_v < 0 || color_u >= color.width_ || color_v >= color.height_)
+			{
+				continue;
+			}
+
+			std::memcpy(pixel, input_color + ((size_t)color_v * color.width_ + color_u) * pixel_bytes, pixel_bytes);
+			output_depth[i] = (uint16_t)d;
+		}
+	}
+
+	return true;
+}
+
+void MKV_Rendering::DepthReprojector::CompareDepthImages(std::string label, open3d::geometry::Image& reference, open3d::geometry::Image& candidate, uint16_t tolerance)
+{
+	if (reference.width_ != candidate.width_ || reference.height_ != candidate.height_)
+	{
+		ErrorLogger::LOG_ERROR("Cannot compare depth images of different sizes!");
+		return;
+	}
+
+	size_t both = 0;
+	size_t matching = 0;
+	size_t only_reference = 0;
+	size_t only_candidate = 0;
+	uint64_t total_difference = 0;
+	int max_difference = 0;
+
+	for (int v = 0; v < reference.height_; ++v)
+	{
+		for (int u = 0; u < reference.width_; ++u)
+		{
+			uint16_t r = *reference.PointerAt<uint16_t>(u, v);
+			uint16_t c = *candidate.PointerAt<uint16_t>(u, v);
+
+			if (r > 0 && c > 0)
+			{
+				int difference = std::abs((int)r - (int)c);
+
+				++both;
+				total_difference += difference;
+				max_difference = std::max(max_difference, difference);
+
+				if (difference <= tolerance)
+				{
+					++matching;
+				}
+			}
+			else if (r > 0)
+			{
+				++only_reference;
+			}
+			else if (c > 0)
+			{
+				++only_candidate;
+			}
+		}
+	}
+
+	std::cout << label << " reprojection compared to k4a:" << std::endl;
+	std::cout << "\tPixels with depth in both: " << both << ", within " << tolerance << "mm: " << matching << std::endl;
+	std::cout << "\tMean difference: " << ((both > 0) ? (double)total_difference / (double)both : 0.0) << "mm, max: " << max_difference << "mm" << std::endl;
+	std::cout << "\tPixels only k4a filled: " << only_reference << ", only tables filled: " << only_candidate << std::endl;
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "open3d/Open3D.h"
+#include "MatteMask.h"
+#include "ImageDecoder.h"
+
+#include <k4a/k4a.h>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace MKV_Rendering {
+
+	/// <summary>
+	/// Moves depth images into the color camera's image plane, like k4a_transformation_depth_image_to_color_camera.
+	/// The rig never moves during a take, so the ray through every depth pixel is worked out once from the calibration,
+	/// and each frame is only a scatter of those rays into the color image with a z-buffer
+	/// </summary>
+	class DepthReprojector
+	{
+		int depth_width = 0;
+		int depth_height = 0;
+
+		int color_width = 0;
+		int color_height = 0;
+
+		/// <summary>
+		/// X of each depth pixel's ray where it crosses z = 1, NaN if the pixel has no valid ray
+		/// </summary>
+		std::vector<float> ray_x;
+
+		/// <summary>
+		/// Y of each depth pixel's ray where it crosses z = 1
+		/// </summary>
+		std::vector<float> ray_y;
+
+		/// <summary>
+		/// Depth camera to color camera rotation, row major
+		/// </summary>
+		float rotation[9];
+
+		/// <summary>
+		/// Depth camera to color camera translation, in millimeters
+		/// </summary>
+		float translation[3];
+
+		/// <summary>
+		/// The color camera's lens
+		/// </summary>
+		k4a_calibration_intrinsic_parameters_t color_intrinsics;
+
+		k4a_calibration_model_type_t color_model;
+
+		/// <summary>
+		/// Points further from the optical axis than this (on the z = 1 plane) do not project, 0 for no limit
+		/// </summary>
+		float color_metric_radius = 0;
+
+		/// <summary>
+		/// Where each depth pixel of the current frame lands in the color image
+		/// </summary>
+		std::vector<float> color_u;
+		std::vector<float> color_v;
+
+		/// <summary>
+		/// Depth of each depth pixel of the current frame as seen from the color camera, 0 if it does not land
+		/// </summary>
+		std::vector<uint16_t> color_z;
+
+		/// <summary>
+		/// Nearest depth written to each color pixel so far, shared between threads
+		/// </summary>
+		std::unique_ptr<std::atomic<uint16_t>[]> z_buffer;
+
+		/// <summary>
+		/// Quads whose corners differ in depth by more than this are not drawn, 0 draws every quad
+		/// </summary>
+		uint16_t max_quad_depth_range = 0;
+
+		/// <summary>
+		/// Which pixel of the depth image each pixel of the undistorted depth image takes its depth from, -1 for none.
+		/// Empty until frames are first wanted in the depth camera's space
+		/// </summary>
+		std::vector<int> depth_source;
+
+		/// <summary>
+		/// The depth camera's lens without its distortion, which the undistorted depth image is seen through
+		/// </summary>
+		float depth_fx = 0;
+		float depth_fy = 0;
+		float depth_cx = 0;
+		float depth_cy = 0;
+
+		/// <summary>
+		/// Projects a point in the color camera's space onto its image, with the lens distortion applied
+		/// </summary>
+		/// <returns>The point lands inside the lens' valid radius</returns>
+		bool ProjectToColor(float x, float y, float z, float& u, float& v);
+
+		/// <summary>
+		/// Fills the color pixels covered by the quad between four neighbouring depth pixels
+		/// </summary>
+		/// <param name="corners">: depth pixel indices of the top left, top right, bottom right and bottom left corners</param>
+		void DrawQuad(const int corners[4]);
+
+		/// <summary>
+		/// Writes a depth to a color pixel if it is nearer than what is there
+		/// </summary>
+		void WriteNearest(int pixel, uint16_t depth);
+
+	public:
+		/// <summary>
+		/// Constructor. Say hi! :D - builds the ray table, which is the slow part
+		/// </summary>
+		/// <param name="calibration">: the camera's calibration</param>
+		DepthReprojector(const k4a_calibration_t& calibration);
+
+		/// <summary>
+		/// Moves a depth image into the color camera's image plane
+		/// </summary>
+		/// <param name="depth">: 16 bit depth at the depth camera's resolution</param>
+		/// <param name="width">: width of the depth image</param>
+		/// <param name="height">: height of the depth image</param>
+		/// <param name="color_space_depth">: destination, already prepared at the color camera's resolution</param>
+		/// <param name="matte">: if given, depth landing outside the subject's bounding box is dropped before any drawing</param>
+		/// <returns>Successfully(?) reprojected</returns>
+		bool Reproject(const uint16_t* depth, int width, int height, open3d::geometry::Image& color_space_depth, MatteMask* matte = nullptr);
+
+		void SetMaxQuadDepthRange(uint16_t range) { max_quad_depth_range = range; }
+
+		/// <summary>
+		/// Builds the table that undistorts depth images, needed before MapColorToDepth
+		/// </summary>
+		/// <param name="calibration">: the camera's calibration</param>
+		void BuildDepthSpaceTables(const k4a_calibration_t& calibration);
+
+		bool HasDepthSpaceTables() { return !depth_source.empty(); }
+
+		/// <summary>
+		/// Undistorts a depth image in place of moving it, and colors each of its pixels from the color image. Frames stay at
+		/// the depth camera's resolution, which is a fraction of the color camera's
+		/// </summary>
+		/// <param name="depth">: 16 bit depth at the depth camera's resolution</param>
+		/// <param name="width">: width of the depth image</param>
+		/// <param name="height">: height of the depth image</param>
+		/// <param name="color">: the decoded color image</param>
+		/// <param name="color_region">: the part of the color camera's image the color was decoded from</param>
+		/// <param name="depth_space_depth">: destination for the undistorted depth, prepared to fit</param>
+		/// <param name="depth_space_color">: destination for the color of each depth pixel, prepared to fit</param>
+		/// <param name="matte">: if given, depth landing outside it in the color image is dropped</param>
+		/// <returns>Successfully(?) mapped</returns>
+		bool MapColorToDepth(const uint16_t* depth, int width, int height, const open3d::geometry::Image& color, const JPEGDecodeRegion& color_region,
+			open3d::geometry::Image& depth_space_depth, open3d::geometry::Image& depth_space_color, MatteMask* matte = nullptr);
+
+		/// <summary>
+		/// Prints how far a reprojected depth image is from a reference one
+		/// </summary>
+		/// <param name="label">: printed with the results</param>
+		/// <param name="reference">: the expected depth</param>
+		/// <param name="candidate">: the depth to check</param>
+		/// <param name="tolerance">: largest difference, in millimeters, that counts as a match</param>
+		static void CompareDepthImages(std::string label, open3d::geometry::Image& reference, open3d::geometry::Image& candidate, uint16_t tolerance = 2);
+	};
+}
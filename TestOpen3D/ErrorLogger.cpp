@@ -2,7 +2,7 @@
 #include <iostream>
 #include <assert.h>
 
-std::vector<ErrorLogger::StackMessage*> ErrorLogger::call_stack = std::vector<ErrorLogger::StackMessage*>();
+thread_local std::vector<ErrorLogger::StackMessage*> ErrorLogger::call_stack = std::vector<ErrorLogger::StackMessage*>();
 
 ErrorLogger::StackMessage::StackMessage(std::string name)
 {
@@ -13,7 +13,8 @@ class ErrorLogger {
 		~StackMessage();
 	};
 
-	static std::vector<StackMessage*> call_stack;
+	//Each thread keeps its own stack, so worker threads can use EXECUTE safely
+	static thread_local std::vector<StackMessage*> call_stack;
 
 	friend class StackMessage;
 public:
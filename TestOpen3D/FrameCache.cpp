@@ -0,0 +1,177 @@
+#include "FrameCache.h"
+
+#include <iostream>
+
+uint64_t MKV_Rendering::FrameCache::MakeKey(int camera, uint64_t frame, FrameStream stream)
+{
+	//16 bits of camera, 8 of stream, 40 of frame
+	return ((uint64_t)(camera & 0xFFFF) << 48) | ((uint64_t)stream << 40) | (frame & 0xFFFFFFFFFFull);
+}
+
+void MKV_Rendering::FrameCache::Evict()
+{
+	while (resident_bytes > budget_bytes && !entries.empty())
+	{
+		auto& oldest = entries.back();
+
+		resident_bytes -= oldest.bytes;
+		lookup.erase(oldest.key);
+		entries.pop_back();
+
+		++evictions;
+	}
+}
+
+MKV_Rendering::FrameCache::FrameCache(size_t budget_megabytes)
+{
+	budget_bytes = budget_megabytes * 1024 * 1024;
+}
+
+void MKV_Rendering::FrameCache::SetBudget(size_t budget_megabytes)
+{
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	budget_bytes = budget_megabytes * 1024 * 1024;
+
+	Evict();
+}
+
+MKV_Rendering::FrameCache::CacheEntry* MKV_Rendering::FrameCache::Find(uint64_t key)
+{
+	if (budget_bytes == 0)
+	{
+		return nullptr;
+	}
+
+	auto found = lookup.find(key);
+
+	if (found == lookup.end())
+	{
+		++misses;
+		return nullptr;
+	}
+
+	++hits;
+
+	//Move to the front, it is now the most recently used
+	entries.splice(entries.begin(), entries, found->second);
+
+	return &(*found->second);
+}
+
+void MKV_Rendering::FrameCache::Insert(CacheEntry& entry)
+{
+	if (entry.bytes > budget_bytes)
+	{
+		return;
+	}
+
+	auto found = lookup.find(entry.key);
+
+	if (found != lookup.end())
+	{
+		resident_bytes -= found->second->bytes;
+		entries.erase(found->second);
+		lookup.erase(found);
+	}
+
+	entries.push_front(entry);
+	lookup[entry.key] = entries.begin();
+	resident_bytes += entry.bytes;
+
+	Evict();
+}
+
+std::shared_ptr<open3d::geometry::RGBDImage> MKV_Rendering::FrameCache::GetFrame(int camera, uint64_t frame, FrameStream stream)
+{
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	auto entry = Find(MakeKey(camera, frame, stream));
+
+	return (entry != nullptr) ? entry->frame : nullptr;
+}
+
+bool MKV_Rendering::FrameCache::Contains(int camera, uint64_t frame, FrameStream stream)
+{
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	return budget_bytes > 0 && lookup.find(MakeKey(camera, frame, stream)) != lookup.end();
+}
+
+void MKV_Rendering::FrameCache::PutFrame(int camera, uint64_t frame, FrameStream stream, std::shared_ptr<open3d::geometry::RGBDImage> data)
+{
+	if (data == nullptr)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	CacheEntry entry;
+	entry.key = MakeKey(camera, frame, stream);
+	entry.frame = data;
+	entry.bytes = data->color_.data_.size() + data->depth_.data_.size();
+
+	Insert(entry);
+}
+
+std::shared_ptr<MKV_Rendering::MatteMask> MKV_Rendering::FrameCache::GetMatte(int camera, uint64_t frame)
+{
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	auto entry = Find(MakeKey(camera, frame, FrameStream::MATTE));
+
+	return (entry != nullptr) ? entry->matte : nullptr;
+}
+
+void MKV_Rendering::FrameCache::PutMatte(int camera, uint64_t frame, std::shared_ptr<MatteMask> data)
+{
+	if (data == nullptr)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	CacheEntry entry;
+	entry.key = MakeKey(camera, frame, FrameStream::MATTE);
+	entry.matte = data;
+	entry.bytes = data->GetByteSize();
+
+	Insert(entry);
+}
+
+void MKV_Rendering::FrameCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	entries.clear();
+	lookup.clear();
+	resident_bytes = 0;
+}
+
+void MKV_Rendering::FrameCache::ResetStats()
+{
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	hits = 0;
+	misses = 0;
+	evictions = 0;
+}
+
+void MKV_Rendering::FrameCache::PrintStats()
+{
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	uint64_t total = hits + misses;
+
+	std::cout << "Frame cache hits: " << hits << "/" << total;
+
+	if (total > 0)
+	{
+		std::cout << " (" << 100.0 * (double)hits / (double)total << "%)";
+	}
+
+	std::cout << ", evictions: " << evictions << std::endl;
+	std::cout << "Frame cache resident: " << resident_bytes / (1024.0 * 1024.0) << " MB of " << budget_bytes / (1024 * 1024) << " MB in " << entries.size() << " frames" << std::endl;
+}
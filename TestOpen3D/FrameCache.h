@@ -0,0 +1,161 @@
+#pragma once
+
+#include "open3d/Open3D.h"
+#include "MatteMask.h"
+
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+
+namespace MKV_Rendering {
+
+	/// <summary>
+	/// The kinds of decoded data a camera can keep for one of its frames
+	/// </summary>
+	enum class FrameStream
+	{
+		/// <summary>
+		/// Color with depth already moved into the color camera's space
+		/// </summary>
+		RGBD,
+
+		/// <summary>
+		/// Packed matte
+		/// </summary>
+		MATTE
+	};
+
+	/// <summary>
+	/// Least recently used cache of decoded frames across all cameras, held within a memory budget
+	/// </summary>
+	class FrameCache
+	{
+		struct CacheEntry
+		{
+			uint64_t key = 0;
+
+			std::shared_ptr<open3d::geometry::RGBDImage> frame = nullptr;
+
+			std::shared_ptr<MatteMask> matte = nullptr;
+
+			size_t bytes = 0;
+		};
+
+		/// <summary>
+		/// Entries from most to least recently used
+		/// </summary>
+		std::list<CacheEntry> entries;
+
+		/// <summary>
+		/// Finds an entry in the list by key
+		/// </summary>
+		std::unordered_map<uint64_t, std::list<CacheEntry>::iterator> lookup;
+
+		std::mutex cache_mutex;
+
+		/// <summary>
+		/// Most memory the cached frames may take up, 0 disables caching
+		/// </summary>
+		size_t budget_bytes = 0;
+
+		size_t resident_bytes = 0;
+
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+
+		/// <summary>
+		/// Packs camera, frame and stream into one key
+		/// </summary>
+		static uint64_t MakeKey(int camera, uint64_t frame, FrameStream stream);
+
+		/// <summary>
+		/// Drops least recently used entries until the cache fits its budget
+		/// </summary>
+		void Evict();
+
+		/// <summary>
+		/// Finds an entry and marks it as recently used, counting the hit or miss
+		/// </summary>
+		/// <returns>The entry, or nullptr if it is not cached</returns>
+		CacheEntry* Find(uint64_t key);
+
+		/// <summary>
+		/// Adds an entry as the most recently used, replacing any with the same key
+		/// </summary>
+		void Insert(CacheEntry& entry);
+
+	public:
+		/// <summary>
+		/// Constructor. Say hi! :D
+		/// </summary>
+		/// <param name="budget_megabytes">: memory budget</param>
+		FrameCache(size_t budget_megabytes = 512);
+
+		/// <summary>
+		/// Changes the memory budget, evicting frames if it shrinks
+		/// </summary>
+		/// <param name="budget_megabytes">: memory budget, 0 disables caching</param>
+		void SetBudget(size_t budget_megabytes);
+
+		/// <summary>
+		/// Looks up a decoded frame, marking it as recently used
+		/// </summary>
+		/// <param name="camera">: index of the camera</param>
+		/// <param name="frame">: the camera's frame number</param>
+		/// <param name="stream">: which data of the frame</param>
+		/// <returns>The frame, or nullptr if it is not cached</returns>
+		std::shared_ptr<open3d::geometry::RGBDImage> GetFrame(int camera, uint64_t frame, FrameStream stream);
+
+		/// <summary>
+		/// Checks whether a frame or matte is cached, without counting a hit or miss or marking it as recently used. For
+		/// deciding whether to read files, before the frame itself is asked for
+		/// </summary>
+		/// <param name="camera">: index of the camera</param>
+		/// <param name="frame">: the camera's frame number</param>
+		/// <param name="stream">: which data of the frame</param>
+		/// <returns>True if it is cached</returns>
+		bool Contains(int camera, uint64_t frame, FrameStream stream);
+
+		/// <summary>
+		/// Keeps a decoded frame. Cached frames must not be written to afterwards
+		/// </summary>
+		/// <param name="camera">: index of the camera</param>
+		/// <param name="frame">: the camera's frame number</param>
+		/// <param name="stream">: which data of the frame</param>
+		/// <param name="data">: the decoded frame</param>
+		void PutFrame(int camera, uint64_t frame, FrameStream stream, std::shared_ptr<open3d::geometry::RGBDImage> data);
+
+		/// <summary>
+		/// Looks up a packed matte, marking it as recently used
+		/// </summary>
+		/// <param name="camera">: index of the camera</param>
+		/// <param name="frame">: the camera's frame number</param>
+		/// <returns>The matte, or nullptr if it is not cached</returns>
+		std::shared_ptr<MatteMask> GetMatte(int camera, uint64_t frame);
+
+		/// <summary>
+		/// Keeps a packed matte. Cached mattes must not be written to afterwards
+		/// </summary>
+		/// <param name="camera">: index of the camera</param>
+		/// <param name="frame">: the camera's frame number</param>
+		/// <param name="data">: the packed matte</param>
+		void PutMatte(int camera, uint64_t frame, std::shared_ptr<MatteMask> data);
+
+		/// <summary>
+		/// Drops every cached frame
+		/// </summary>
+		void Clear();
+
+		/// <summary>
+		/// Resets the hit/miss/eviction counters
+		/// </summary>
+		void ResetStats();
+
+		/// <summary>
+		/// Prints hit rate and memory use to the console
+		/// </summary>
+		void PrintStats();
+	};
+}
@@ -0,0 +1,322 @@
+#include "FrameIndex.h"
+#include "ErrorLogger.h"
+
+#include "open3d/Open3D.h"
+
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+const std::string MKV_Rendering::FrameIndex::INDEX_FILE_NAME = ".frame_index";
+
+/// <summary>
+/// Start of every index file
+/// </summary>
+struct FrameIndexHeader
+{
+	char magic[4] = { 'F', 'I', 'D', 'X' };
+	uint32_t version = 1;
+	uint32_t layout = 0;
+	uint32_t padding = 0;
+
+	/// <summary>
+	/// The folder's modification time and size when the index was written
+	/// </summary>
+	uint64_t folder_time = 0;
+	uint64_t folder_size = 0;
+
+	uint64_t entry_count = 0;
+	uint64_t names_size = 0;
+};
+
+/// <summary>
+/// Gets what is compared to tell whether a folder changed since it was indexed.
+/// Adding, removing or renaming a file changes both, rewriting an existing file changes neither
+/// </summary>
+static bool GetFolderFingerprint(const std::string& folder, uint64_t& folder_time, uint64_t& folder_size)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+
+	if (!GetFileAttributesExA(folder.c_str(), GetFileExInfoStandard, &attributes))
+	{
+		return false;
+	}
+
+	folder_time = ((uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+	folder_size = ((uint64_t)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+#else
+	struct stat folder_stat;
+
+	if (stat(folder.c_str(), &folder_stat) != 0)
+	{
+		return false;
+	}
+
+#ifdef __linux__
+	folder_time = (uint64_t)folder_stat.st_mtim.tv_sec * 1000000000ull + (uint64_t)folder_stat.st_mtim.tv_nsec;
+#else
+	folder_time = (uint64_t)folder_stat.st_mtime;
+#endif
+	folder_size = (uint64_t)folder_stat.st_size;
+#endif
+
+	return true;
+}
+
+void MKV_Rendering::FolderIndex::Attach(const uint8_t* index_data)
+{
+	auto header = reinterpret_cast<const FrameIndexHeader*>(index_data);
+
+	entry_count = (size_t)header->entry_count;
+	entries = reinterpret_cast<const FrameIndexEntry*>(index_data + sizeof(FrameIndexHeader));
+	names = reinterpret_cast<const char*>(entries + entry_count);
+}
+
+std::string MKV_Rendering::FolderIndex::GetName(size_t i)
+{
+	return std::string(names + entries[i].name_offset, entries[i].name_length);
+}
+
+std::string MKV_Rendering::FolderIndex::GetPath(size_t i)
+{
+	return folder + "/" + GetName(i);
+}
+
+void MKV_Rendering::FolderIndex::Clear()
+{
+	mapping.Close();
+	built.clear();
+	built.shrink_to_fit();
+
+	entries = nullptr;
+	entry_count = 0;
+	names = nullptr;
+}
+
+MKV_Rendering::FrameIndex::FrameIndex()
+{
+}
+
+void MKV_Rendering::FrameIndex::Scan(std::string folder, uint32_t layout, const std::function<bool(const std::string&, FrameIndexEntry&)>& classify, FolderIndex& index)
+{
+	std::vector<std::string> all_files;
+
+	open3d::utility::filesystem::ListFilesInDirectory(folder, all_files);
+
+	std::vector<FrameIndexEntry> found;
+	std::vector<std::string> found_names;
+
+	for (auto& s : all_files)
+	{
+		std::string file_name = open3d::utility::filesystem::GetFileNameWithoutDirectory(s);
+
+		if (file_name == INDEX_FILE_NAME)
+		{
+			continue;
+		}
+
+		FrameIndexEntry entry;
+
+		try
+		{
+			if (!classify(file_name, entry))
+			{
+				continue;
+			}
+		}
+		catch (const std::exception& e)
+		{
+			ErrorLogger::LOG_ERROR("Could not parse " + s + ": " + std::string(e.what()));
+			continue;
+		}
+
+		entry.name_length = (uint32_t)file_name.size();
+
+		found.push_back(entry);
+		found_names.push_back(file_name);
+	}
+
+	std::vector<size_t> order(found.size());
+
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		order[i] = i;
+	}
+
+	std::sort(order.begin(), order.end(), [&found, &found_names](size_t a, size_t b) {
+		if (found[a].kind != found[b].kind)
+		{
+			return found[a].kind < found[b].kind;
+		}
+
+		if (found[a].frame != found[b].frame)
+		{
+			return found[a].frame < found[b].frame;
+		}
+
+		return found_names[a] < found_names[b];
+	});
+
+	FrameIndexHeader header;
+	header.layout = layout;
+	header.entry_count = found.size();
+
+	for (auto& name : found_names)
+	{
+		header.names_size += name.size();
+	}
+
+	auto& index_data = index.built;
+
+	index_data.resize(sizeof(FrameIndexHeader) + found.size() * sizeof(FrameIndexEntry) + header.names_size);
+
+	auto entries = reinterpret_cast<FrameIndexEntry*>(index_data.data() + sizeof(FrameIndexHeader));
+	auto names = reinterpret_cast<char*>(entries + found.size());
+
+	uint32_t name_offset = 0;
+
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		entries[i] = found[order[i]];
+		entries[i].name_offset = name_offset;
+
+		auto& name = found_names[order[i]];
+
+		std::memcpy(names + name_offset, name.data(), name.size());
+		name_offset += (uint32_t)name.size();
+	}
+
+	std::memcpy(index_data.data(), &header, sizeof(FrameIndexHeader));
+}
+
+bool MKV_Rendering::FrameIndex::Write(std::string folder, std::vector<uint8_t>& index_data)
+{
+	std::string index_path = folder + "/" + INDEX_FILE_NAME;
+
+	{
+		std::ofstream index_file(index_path, std::ios::binary | std::ios::trunc);
+
+		if (!index_file.is_open())
+		{
+			return false;
+		}
+
+		index_file.write(reinterpret_cast<const char*>(index_data.data()), index_data.size());
+
+		if (!index_file.good())
+		{
+			return false;
+		}
+	}
+
+	//Creating the index changed the folder, so the fingerprint is taken afterwards and patched in place, which changes nothing further
+	auto header = reinterpret_cast<FrameIndexHeader*>(index_data.data());
+
+	if (!GetFolderFingerprint(folder, header->folder_time, header->folder_size))
+	{
+		return false;
+	}
+
+	std::fstream index_file(index_path, std::ios::binary | std::ios::in | std::ios::out);
+
+	if (!index_file.is_open())
+	{
+		return false;
+	}
+
+	index_file.seekp(0);
+	index_file.write(reinterpret_cast<const char*>(header), sizeof(FrameIndexHeader));
+
+	return index_file.good();
+}
+
+void MKV_Rendering::FrameIndex::Open(std::string folder, uint32_t layout, Classifier classify, FolderIndex& index)
+{
+	auto open_start = std::chrono::steady_clock::now();
+
+	index.Clear();
+	index.folder = folder;
+
+	bool reused = false;
+
+	uint64_t folder_time = 0;
+	uint64_t folder_size = 0;
+
+	if (enabled && GetFolderFingerprint(folder, folder_time, folder_size) &&
+		index.mapping.Open(folder + "/" + INDEX_FILE_NAME) && index.mapping.GetSize() >= sizeof(FrameIndexHeader))
+	{
+		FrameIndexHeader expected;
+		auto header = reinterpret_cast<const FrameIndexHeader*>(index.mapping.GetData());
+
+		reused =
+			std::memcmp(header->magic, expected.magic, sizeof(expected.magic)) == 0 &&
+			header->version == expected.version &&
+			header->layout == layout &&
+			header->folder_time == folder_time &&
+			header->folder_size == folder_size &&
+			index.mapping.GetSize() == sizeof(FrameIndexHeader) + header->entry_count * sizeof(FrameIndexEntry) + header->names_size;
+	}
+
+	if (reused)
+	{
+		index.Attach(index.mapping.GetData());
+	}
+	else
+	{
+		index.mapping.Close();
+
+		Scan(folder, layout, classify, index);
+
+		if (enabled && !Write(folder, index.built))
+		{
+			ErrorLogger::LOG_ERROR("Could not write frame index for " + folder + ", it will be rescanned next time");
+		}
+
+		index.Attach(index.built.data());
+	}
+
+	std::lock_guard<std::mutex> lock(stats_mutex);
+
+	if (reused)
+	{
+		++folders_reused;
+	}
+	else
+	{
+		++folders_rescanned;
+	}
+
+	open_time += std::chrono::steady_clock::now() - open_start;
+}
+
+void MKV_Rendering::FrameIndex::SetEnabled(bool enabled)
+{
+	this->enabled = enabled;
+}
+
+void MKV_Rendering::FrameIndex::PrintStats()
+{
+	std::lock_guard<std::mutex> lock(stats_mutex);
+
+	std::cout << "Frame index: " << folders_reused << " folders reused, " << folders_rescanned << " rescanned, " <<
+		std::chrono::duration<double, std::milli>(open_time).count() << " ms" << std::endl;
+}
+
+void MKV_Rendering::FrameIndex::ResetStats()
+{
+	std::lock_guard<std::mutex> lock(stats_mutex);
+
+	folders_reused = 0;
+	folders_rescanned = 0;
+	open_time = std::chrono::steady_clock::duration::zero();
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+
+namespace MKV_Rendering {
+
+	/// <summary>
+	/// What an indexed file holds
+	/// </summary>
+	enum class IndexedFileKind : uint8_t
+	{
+		COLOR,
+		DEPTH,
+		MATTE,
+		INTRINSICS
+	};
+
+	/// <summary>
+	/// One file of a folder, exactly as stored in the index file
+	/// </summary>
+	struct FrameIndexEntry
+	{
+		/// <summary>
+		/// Frame number parsed from the file name
+		/// </summary>
+		int64_t frame = 0;
+
+		/// <summary>
+		/// Timestamp parsed from the file name, only valid if has_timestamp is set
+		/// </summary>
+		uint64_t timestamp = 0;
+
+		/// <summary>
+		/// Where the file name starts in the index's name table, and how long it is
+		/// </summary>
+		uint32_t name_offset = 0;
+		uint32_t name_length = 0;
+
+		IndexedFileKind kind = IndexedFileKind::COLOR;
+		uint8_t has_timestamp = 0;
+		uint8_t padding[6] = {};
+	};
+
+	/// <summary>
+	/// The index of a single folder, either mapped from its index file or freshly built from a scan.
+	/// Entries are sorted by kind, then frame, then name
+	/// </summary>
+	class FolderIndex
+	{
+		friend class FrameIndex;
+
+		std::string folder;
+
+		/// <summary>
+		/// The index file, when it was still valid
+		/// </summary>
+		MappedFile mapping;
+
+		/// <summary>
+		/// The index as built by a scan, when there was no valid index file
+		/// </summary>
+		std::vector<uint8_t> built;
+
+		const FrameIndexEntry* entries = nullptr;
+		size_t entry_count = 0;
+		const char* names = nullptr;
+
+		/// <summary>
+		/// Points the accessors at an index laid out in memory, which has already been validated
+		/// </summary>
+		void Attach(const uint8_t* index_data);
+
+	public:
+		size_t GetCount() { return entry_count; }
+
+		const FrameIndexEntry& GetEntry(size_t i) { return entries[i]; }
+
+		/// <summary>
+		/// File name of an entry, without the folder
+		/// </summary>
+		std::string GetName(size_t i);
+
+		/// <summary>
+		/// Full path of an entry, the same as listing the folder would give
+		/// </summary>
+		std::string GetPath(size_t i);
+
+		/// <summary>
+		/// Releases the mapping or scan results
+		/// </summary>
+		void Clear();
+	};
+
+	/// <summary>
+	/// Keeps a small binary index file in every camera folder, holding the frame number and timestamp of every file.
+	/// A folder is only listed and its file names parsed again when its modification time or size changes
+	/// </summary>
+	class FrameIndex
+	{
+		/// <summary>
+		/// Write index files, or only scan
+		/// </summary>
+		bool enabled = true;
+
+		std::mutex stats_mutex;
+
+		int folders_reused = 0;
+		int folders_rescanned = 0;
+
+		std::chrono::steady_clock::duration open_time = std::chrono::steady_clock::duration::zero();
+
+		/// <summary>
+		/// Lists and classifies every file of a folder
+		/// </summary>
+		void Scan(std::string folder, uint32_t layout, const std::function<bool(const std::string&, FrameIndexEntry&)>& classify, FolderIndex& index);
+
+		/// <summary>
+		/// Writes a freshly built index next to the files it lists
+		/// </summary>
+		/// <returns>Successfully(?) written</returns>
+		bool Write(std::string folder, std::vector<uint8_t>& index_data);
+
+	public:
+		/// <summary>
+		/// Name of the index file kept in each folder
+		/// </summary>
+		static const std::string INDEX_FILE_NAME;
+
+		/// <summary>
+		/// Decides whether a file belongs in the index, and fills in its kind, frame and timestamp from its name
+		/// </summary>
+		using Classifier = std::function<bool(const std::string& file_name, FrameIndexEntry& entry)>;
+
+		/// <summary>
+		/// Constructor. Say hi! :D
+		/// </summary>
+		FrameIndex();
+
+		/// <summary>
+		/// Gets the index of a folder, mapping its index file if it is still up to date, otherwise rescanning the folder
+		/// </summary>
+		/// <param name="folder">: the folder to index</param>
+		/// <param name="layout">: identifies the classifier, so differently classified indices of a folder are never mixed up</param>
+		/// <param name="classify">: classifies each file while scanning</param>
+		/// <param name="index">: where to put the index</param>
+		void Open(std::string folder, uint32_t layout, Classifier classify, FolderIndex& index);
+
+		/// <summary>
+		/// Turns writing and reusing index files on or off, folders are always scanned when off
+		/// </summary>
+		void SetEnabled(bool enabled);
+
+		bool IsEnabled() { return enabled; }
+
+		/// <summary>
+		/// Prints how many folders were reused or rescanned, and how long opening them took
+		/// </summary>
+		void PrintStats();
+
+		void ResetStats();
+	};
+}
@@ -0,0 +1,96 @@
+#include "FramePool.h"
+
+#include <iostream>
+
+std::atomic<uint64_t> MKV_Rendering::FramePool::image_copies(0);
+std::atomic<uint64_t> MKV_Rendering::FramePool::image_copy_bytes(0);
+
+MKV_Rendering::FramePool::FramePool(size_t initial_frames)
+{
+	for (size_t i = 0; i < initial_frames; ++i)
+	{
+		frames.push_back(std::make_shared<open3d::geometry::RGBDImage>());
+	}
+}
+
+std::shared_ptr<open3d::geometry::RGBDImage> MKV_Rendering::FramePool::Lease()
+{
+	std::lock_guard<std::mutex> lock(pool_mutex);
+
+	//Only the pool holds a frame nobody has leased, and only the pool hands frames out, so this count cannot rise under us
+	for (auto& frame : frames)
+	{
+		if (frame.use_count() == 1)
+		{
+			return frame;
+		}
+	}
+
+	frames.push_back(std::make_shared<open3d::geometry::RGBDImage>());
+
+	return frames.back();
+}
+
+size_t MKV_Rendering::FramePool::GetFrameCount()
+{
+	std::lock_guard<std::mutex> lock(pool_mutex);
+
+	return frames.size();
+}
+
+open3d::t::geometry::Image MKV_Rendering::FramePool::ViewAsTensor(std::shared_ptr<open3d::geometry::RGBDImage> frame, open3d::geometry::Image& image)
+{
+	open3d::core::Dtype dtype = open3d::core::Dtype::UInt8;
+
+	//The same element types FromLegacyImage picks
+	if (image.bytes_per_channel_ == 2)
+	{
+		dtype = open3d::core::Dtype::UInt16;
+	}
+	else if (image.bytes_per_channel_ == 4)
+	{
+		dtype = open3d::core::Dtype::Float32;
+	}
+
+	//The blob's deleter keeps the frame leased, the pixels themselves belong to the image
+	auto blob = std::make_shared<open3d::core::Blob>(open3d::core::Device("CPU:0"), image.data_.data(), [frame](void*) {});
+
+	int64_t width = image.width_;
+	int64_t height = image.height_;
+	int64_t channels = image.num_of_channels_;
+
+	open3d::core::Tensor pixels({ height, width, channels }, { width * channels, channels, 1 }, image.data_.data(), dtype, blob);
+
+	return open3d::t::geometry::Image(pixels);
+}
+
+void MKV_Rendering::FramePool::CountImageCopy(const open3d::geometry::Image& image)
+{
+	++image_copies;
+	image_copy_bytes += image.data_.size();
+}
+
+void MKV_Rendering::FramePool::PrintCopyStats()
+{
+	std::cout << "Decoded images copied: " << image_copies << " (" << image_copy_bytes / (1024 * 1024) << " MB)" << std::endl;
+
+	image_copies = 0;
+	image_copy_bytes = 0;
+}
+
+size_t MKV_Rendering::FramePool::GetLeasedCount()
+{
+	std::lock_guard<std::mutex> lock(pool_mutex);
+
+	size_t leased = 0;
+
+	for (auto& frame : frames)
+	{
+		if (frame.use_count() > 1)
+		{
+			++leased;
+		}
+	}
+
+	return leased;
+}
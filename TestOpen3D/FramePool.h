@@ -0,0 +1,82 @@
+#pragma once
+
+#include "open3d/Open3D.h"
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+namespace MKV_Rendering {
+
+	/// <summary>
+	/// A set of reusable RGBD frames belonging to one camera. A frame is leased while anything outside the pool holds it,
+	/// and goes back to the pool once every holder has let go of it, keeping its allocated image memory
+	/// </summary>
+	class FramePool
+	{
+		/// <summary>
+		/// Every frame this pool has made, leased or not
+		/// </summary>
+		std::vector<std::shared_ptr<open3d::geometry::RGBDImage>> frames;
+
+		/// <summary>
+		/// Guards the frame list, frames may be leased and released from different threads
+		/// </summary>
+		std::mutex pool_mutex;
+
+		/// <summary>
+		/// Whole frame images copied anywhere after decoding, across every pool
+		/// </summary>
+		static std::atomic<uint64_t> image_copies;
+		static std::atomic<uint64_t> image_copy_bytes;
+
+	public:
+		/// <summary>
+		/// Constructor. Say hi! :D
+		/// </summary>
+		/// <param name="initial_frames">: how many frames to create up front</param>
+		FramePool(size_t initial_frames = 0);
+
+		/// <summary>
+		/// Hands out a frame nobody else is holding, creating a new one only if all frames are leased.
+		/// The frame keeps whatever it last held - resize it with Image::Prepare, which reuses its memory if the size matches
+		/// </summary>
+		/// <returns>The leased frame, released by letting every copy of the pointer go</returns>
+		std::shared_ptr<open3d::geometry::RGBDImage> Lease();
+
+		/// <summary>
+		/// How many frames this pool has created, a number that stops growing once playback reaches steady state
+		/// </summary>
+		/// <returns>The frame count</returns>
+		size_t GetFrameCount();
+
+		/// <summary>
+		/// How many frames are currently held outside the pool
+		/// </summary>
+		/// <returns>The leased frame count</returns>
+		size_t GetLeasedCount();
+
+		/// <summary>
+		/// Wraps one image of a frame in a tensor image sharing its memory, nothing is copied. The tensor holds the frame,
+		/// so it stays leased until every tensor made from it is gone and is never rewritten under one
+		/// </summary>
+		/// <param name="frame">: the frame the image belongs to</param>
+		/// <param name="image">: the frame's color or depth image</param>
+		/// <returns>A CPU tensor image over the image's pixels</returns>
+		static open3d::t::geometry::Image ViewAsTensor(std::shared_ptr<open3d::geometry::RGBDImage> frame, open3d::geometry::Image& image);
+
+		/// <summary>
+		/// Records a copy of a decoded image, to be called wherever one is still made on purpose
+		/// </summary>
+		/// <param name="image">: the image being copied</param>
+		static void CountImageCopy(const open3d::geometry::Image& image);
+
+		static uint64_t GetImageCopyCount() { return image_copies; }
+
+		/// <summary>
+		/// Prints how many decoded images were copied and how much memory that moved, then starts counting again
+		/// </summary>
+		static void PrintCopyStats();
+	};
+}
@@ -0,0 +1,191 @@
+#include "FramePrefetcher.h"
+#include "ErrorLogger.h"
+
+#include <iostream>
+#include <algorithm>
+
+MKV_Rendering::FramePrefetcher::FramePrefetcher()
+{
+}
+
+MKV_Rendering::FramePrefetcher::~FramePrefetcher()
+{
+	Stop();
+}
+
+void MKV_Rendering::FramePrefetcher::WorkerLoop(int worker_index, int worker_count)
+{
+	std::unique_lock<std::mutex> lock(ring_mutex);
+
+	while (running)
+	{
+		bool decoded_any = false;
+
+		for (size_t i = worker_index; i < rings.size() && running; i += worker_count)
+		{
+			auto& ring = rings[i];
+
+			if (ring.exhausted || ring.count >= ring.frames.size())
+			{
+				continue;
+			}
+
+			//Only this worker touches this camera, so decoding can happen outside the lock
+			lock.unlock();
+
+			PrefetchedFrame frame;
+			frame.rgbd = ErrorLogger::EXECUTE("Prefetch Frame", ring.camera, &Abstract_Data::GetFrameRGBD);
+			frame.timestamp = ring.camera->GetCaptureTimestamp();
+
+			//A frame that failed to decode ends the ring, rather than leaving the consumer to decode it on a camera this
+			//worker still owns
+			bool has_next = (frame.rgbd != nullptr) && ErrorLogger::EXECUTE("Prefetch Cycle Camera Forward", ring.camera, &Abstract_Data::CycleCaptureForwards);
+
+			lock.lock();
+
+			if (frame.rgbd != nullptr)
+			{
+				ring.frames[(ring.head + ring.count) % ring.frames.size()] = frame;
+				++ring.count;
+			}
+			else
+			{
+				ErrorLogger::LOG_ERROR("Could not prefetch the frame at " + std::to_string(frame.timestamp) + ", prefetching stopped on this camera");
+			}
+
+			ring.exhausted = !has_next;
+
+			decoded_any = true;
+
+			frame_ready.notify_all();
+		}
+
+		if (!decoded_any && running)
+		{
+			slot_freed.wait(lock);
+		}
+	}
+}
+
+void MKV_Rendering::FramePrefetcher::Start(std::vector<Abstract_Data*>& cameras, int depth, int thread_count)
+{
+	Stop();
+
+	if (cameras.empty())
+	{
+		ErrorLogger::LOG_ERROR("No cameras to prefetch!");
+		return;
+	}
+
+	depth = std::max(depth, 1);
+	thread_count = std::clamp(thread_count, 1, (int)cameras.size());
+
+	rings.resize(cameras.size());
+
+	for (int i = 0; i < cameras.size(); ++i)
+	{
+		rings[i].camera = cameras[i];
+		rings[i].frames.resize(depth);
+		rings[i].head = 0;
+		rings[i].count = 0;
+		rings[i].exhausted = false;
+	}
+
+	running = true;
+
+	for (int i = 0; i < thread_count; ++i)
+	{
+		workers.emplace_back(&FramePrefetcher::WorkerLoop, this, i, thread_count);
+	}
+
+	std::cout << "Prefetching " << depth << " frames on " << cameras.size() << " cameras with " << thread_count << " threads" << std::endl;
+}
+
+void MKV_Rendering::FramePrefetcher::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(ring_mutex);
+		running = false;
+	}
+
+	slot_freed.notify_all();
+	frame_ready.notify_all();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+
+	workers.clear();
+	rings.clear();
+}
+
+bool MKV_Rendering::FramePrefetcher::Pop(int camera_slot, PrefetchedFrame& frame)
+{
+	std::unique_lock<std::mutex> lock(ring_mutex);
+
+	if (camera_slot < 0 || camera_slot >= rings.size())
+	{
+		ErrorLogger::LOG_ERROR("Prefetch slot " + std::to_string(camera_slot) + " out of range!");
+		return false;
+	}
+
+	auto& ring = rings[camera_slot];
+
+	if (ring.count > 0)
+	{
+		++hits;
+	}
+	else if (!ring.exhausted && running)
+	{
+		++misses;
+
+		auto stall_start = std::chrono::steady_clock::now();
+
+		frame_ready.wait(lock, [&ring, this] { return ring.count > 0 || ring.exhausted || !running; });
+
+		stall_time += std::chrono::steady_clock::now() - stall_start;
+	}
+
+	if (ring.count == 0)
+	{
+		return false;
+	}
+
+	frame = ring.frames[ring.head];
+	ring.frames[ring.head] = PrefetchedFrame();
+
+	ring.head = (ring.head + 1) % ring.frames.size();
+	--ring.count;
+
+	slot_freed.notify_all();
+
+	return true;
+}
+
+void MKV_Rendering::FramePrefetcher::ResetStats()
+{
+	std::lock_guard<std::mutex> lock(ring_mutex);
+
+	hits = 0;
+	misses = 0;
+	stall_time = std::chrono::steady_clock::duration::zero();
+}
+
+void MKV_Rendering::FramePrefetcher::PrintStats()
+{
+	std::lock_guard<std::mutex> lock(ring_mutex);
+
+	uint64_t total = hits + misses;
+	double stall_ms = std::chrono::duration<double, std::milli>(stall_time).count();
+
+	std::cout << "Prefetch hits: " << hits << "/" << total << ", misses: " << misses << "/" << total << std::endl;
+	std::cout << "Prefetch stall time: " << stall_ms << " ms";
+
+	if (misses > 0)
+	{
+		std::cout << " (" << stall_ms / (double)misses << " ms per miss)";
+	}
+
+	std::cout << std::endl;
+}
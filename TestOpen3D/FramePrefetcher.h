@@ -0,0 +1,141 @@
+#pragma once
+
+#include "Abstract_Data.h"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+namespace MKV_Rendering {
+
+	/// <summary>
+	/// A single decoded frame waiting to be consumed
+	/// </summary>
+	struct PrefetchedFrame
+	{
+		/// <summary>
+		/// The decoded image, already in the color camera's space
+		/// </summary>
+		std::shared_ptr<open3d::geometry::RGBDImage> rgbd = nullptr;
+
+		/// <summary>
+		/// Time of the capture this frame was decoded from
+		/// </summary>
+		uint64_t timestamp = 0;
+	};
+
+	/// <summary>
+	/// Decodes upcoming frames of every camera on worker threads, keeping a bounded ring of them per camera
+	/// </summary>
+	class FramePrefetcher
+	{
+		/// <summary>
+		/// Ring of decoded frames belonging to one camera
+		/// </summary>
+		struct CameraRing
+		{
+			Abstract_Data* camera = nullptr;
+
+			std::vector<PrefetchedFrame> frames;
+
+			size_t head = 0;
+			size_t count = 0;
+
+			/// <summary>
+			/// The camera has no frames left to decode
+			/// </summary>
+			bool exhausted = false;
+		};
+
+		std::vector<CameraRing> rings;
+
+		std::vector<std::thread> workers;
+
+		/// <summary>
+		/// Guards the rings, workers hold it only while touching ring bookkeeping
+		/// </summary>
+		std::mutex ring_mutex;
+
+		/// <summary>
+		/// Signalled when a frame is consumed, so workers can fill the slot
+		/// </summary>
+		std::condition_variable slot_freed;
+
+		/// <summary>
+		/// Signalled when a frame is decoded, so a stalled consumer can continue
+		/// </summary>
+		std::condition_variable frame_ready;
+
+		/// <summary>
+		/// Written under ring_mutex so waiting threads see the change, atomic so IsRunning can read it from any thread
+		/// </summary>
+		std::atomic<bool> running = false;
+
+		/// <summary>
+		/// Frames already waiting when requested
+		/// </summary>
+		uint64_t hits = 0;
+
+		/// <summary>
+		/// Frames the consumer had to wait on
+		/// </summary>
+		uint64_t misses = 0;
+
+		/// <summary>
+		/// Total time the consumer spent waiting on workers
+		/// </summary>
+		std::chrono::steady_clock::duration stall_time = std::chrono::steady_clock::duration::zero();
+
+		/// <summary>
+		/// Decoding loop, serves every camera whose index modulo the thread count matches
+		/// </summary>
+		/// <param name="worker_index">: which worker this is</param>
+		/// <param name="worker_count">: how many workers there are</param>
+		void WorkerLoop(int worker_index, int worker_count);
+
+	public:
+		/// <summary>
+		/// Constructor. Say hi! :D
+		/// </summary>
+		FramePrefetcher();
+
+		//Destructor. Say goodbye! :( - stops all workers
+		~FramePrefetcher();
+
+		/// <summary>
+		/// Starts decoding ahead on every camera, from each camera's current position
+		/// </summary>
+		/// <param name="cameras">: the cameras to prefetch - the prefetcher owns their playback position until stopped</param>
+		/// <param name="depth">: how many decoded frames to keep ready per camera</param>
+		/// <param name="thread_count">: how many worker threads to decode with</param>
+		void Start(std::vector<Abstract_Data*>& cameras, int depth, int thread_count);
+
+		/// <summary>
+		/// Stops all workers and discards any frames not yet consumed
+		/// </summary>
+		void Stop();
+
+		/// <summary>
+		/// Takes the next decoded frame of a camera, waiting for it if it is not ready yet
+		/// </summary>
+		/// <param name="camera_slot">: position of the camera in the vector given to Start</param>
+		/// <param name="frame">: where to write the frame</param>
+		/// <returns>False if the camera has run out of frames</returns>
+		bool Pop(int camera_slot, PrefetchedFrame& frame);
+
+		bool IsRunning() { return running; }
+
+		/// <summary>
+		/// Resets the hit/miss/stall counters
+		/// </summary>
+		void ResetStats();
+
+		/// <summary>
+		/// Prints hit/miss counts and stall time to the console
+		/// </summary>
+		void PrintStats();
+	};
+}
@@ -0,0 +1,295 @@
+#include "ImageDecoder.h"
+#include "ErrorLogger.h"
+#include "DepthCodec.h"
+
+#include <png.h>
+#include <cstring>
+#include <algorithm>
+
+MKV_Rendering::ImageDecoder::ImageDecoder()
+{
+}
+
+MKV_Rendering::ImageDecoder::~ImageDecoder()
+{
+	if (jpeg_decompressor != nullptr)
+	{
+		tjDestroy(jpeg_decompressor);
+	}
+
+	if (jpeg_transformer != nullptr)
+	{
+		tjDestroy(jpeg_transformer);
+	}
+}
+
+Eigen::Matrix3d MKV_Rendering::JPEGDecodeRegion::ScaleIntrinsic(const Eigen::Matrix3d& intrinsic) const
+{
+	Eigen::Matrix3d scaled = intrinsic;
+
+	//A decoded pixel's centre sits in the middle of the full resolution pixels it covers
+	scaled(0, 0) /= scale;
+	scaled(1, 1) /= scale;
+	scaled(0, 2) = (intrinsic(0, 2) - x - (scale - 1) / 2.0) / scale;
+	scaled(1, 2) = (intrinsic(1, 2) - y - (scale - 1) / 2.0) / scale;
+
+	return scaled;
+}
+
+void MKV_Rendering::JPEGDecodeRegion::DecodedSize(int full_width, int full_height, int& out_width, int& out_height) const
+{
+	int crop_width = (width > 0) ? width : full_width - x;
+	int crop_height = (height > 0) ? height : full_height - y;
+
+	out_width = (crop_width + scale - 1) / scale;
+	out_height = (crop_height + scale - 1) / scale;
+}
+
+void MKV_Rendering::JPEGDecodeRegion::CropDepth(const open3d::geometry::Image& full_depth, open3d::geometry::Image& depth) const
+{
+	int out_width, out_height;
+	DecodedSize(full_depth.width_, full_depth.height_, out_width, out_height);
+
+	depth.Prepare(out_width, out_height, 1, sizeof(uint16_t));
+
+	const uint16_t* source = reinterpret_cast<const uint16_t*>(full_depth.data_.data());
+	uint16_t* destination = reinterpret_cast<uint16_t*>(depth.data_.data());
+
+#pragma omp parallel for schedule(static)
+	for (int v = 0; v < out_height; ++v)
+	{
+		int source_v = std::min(y + v * scale + scale / 2, full_depth.height_ - 1);
+
+		const uint16_t* source_row = source + (size_t)source_v * full_depth.width_;
+		uint16_t* destination_row = destination + (size_t)v * out_width;
+
+		for (int u = 0; u < out_width; ++u)
+		{
+			destination_row[u] = source_row[std::min(x + u * scale + scale / 2, full_depth.width_ - 1)];
+		}
+	}
+}
+
+std::string MKV_Rendering::JPEGDecodeRegion::ToString() const
+{
+	std::string text = "1/" + std::to_string(scale);
+
+	if (width > 0 && height > 0)
+	{
+		text += " of " + std::to_string(width) + "x" + std::to_string(height) + " at " + std::to_string(x) + "," + std::to_string(y);
+	}
+
+	return text;
+}
+
+bool MKV_Rendering::ImageDecoder::DecodeJPEG(const uint8_t* data, size_t size, open3d::geometry::Image& image)
+{
+	if (jpeg_decompressor == nullptr)
+	{
+		jpeg_decompressor = tjInitDecompress();
+	}
+
+	int width = 0;
+	int height = 0;
+	int subsampling = 0;
+	int colorspace = 0;
+
+	if (0 != tjDecompressHeader3(jpeg_decompressor, data, static_cast<unsigned long>(size), &width, &height, &subsampling, &colorspace))
+	{
+		ErrorLogger::LOG_ERROR("Failed to read JPG header: " + std::string(tjGetErrorStr2(jpeg_decompressor)));
+		return false;
+	}
+
+	image.Prepare(width, height, 3, sizeof(uint8_t));
+
+	if (0 != tjDecompress2(jpeg_decompressor, data, static_cast<unsigned long>(size),
+		image.data_.data(), width, 0 /* pitch */, height,
+		TJPF_RGB, TJFLAG_FASTDCT | TJFLAG_FASTUPSAMPLE))
+	{
+		ErrorLogger::LOG_ERROR("Failed to decompress JPG: " + std::string(tjGetErrorStr2(jpeg_decompressor)));
+		return false;
+	}
+
+	return true;
+}
+
+bool MKV_Rendering::ImageDecoder::DecodeJPEG(const uint8_t* data, size_t size, open3d::geometry::Image& image, const JPEGDecodeRegion& region, JPEGDecodeRegion* applied)
+{
+	if (region.IsFull())
+	{
+		if (applied != nullptr)
+		{
+			*applied = region;
+		}
+
+		return DecodeJPEG(data, size, image);
+	}
+
+	if (jpeg_decompressor == nullptr)
+	{
+		jpeg_decompressor = tjInitDecompress();
+	}
+
+	int width = 0;
+	int height = 0;
+	int subsampling = 0;
+	int colorspace = 0;
+
+	if (0 != tjDecompressHeader3(jpeg_decompressor, data, static_cast<unsigned long>(size), &width, &height, &subsampling, &colorspace))
+	{
+		ErrorLogger::LOG_ERROR("Failed to read JPG header: " + std::string(tjGetErrorStr2(jpeg_decompressor)));
+		return false;
+	}
+
+	JPEGDecodeRegion used;
+
+	//Only scales TurboJPEG offers are used, anything else decodes at full size
+	int factor_count = 0;
+	tjscalingfactor* factors = tjGetScalingFactors(&factor_count);
+	tjscalingfactor factor = { 1, 1 };
+
+	for (int i = 0; i < factor_count; ++i)
+	{
+		if (factors[i].num == 1 && factors[i].denom == region.scale)
+		{
+			factor = factors[i];
+			used.scale = region.scale;
+		}
+	}
+
+	const uint8_t* source = data;
+	unsigned long source_size = static_cast<unsigned long>(size);
+	unsigned char* cropped = nullptr;
+
+	int crop_width = width;
+	int crop_height = height;
+
+	if (region.width > 0 && region.height > 0)
+	{
+		//Lossless crops have to start on a block boundary, so the crop grows up and left to the nearest one
+		int block_width = (subsampling >= 0 && subsampling < 6) ? tjMCUWidth[subsampling] : 16;
+		int block_height = (subsampling >= 0 && subsampling < 6) ? tjMCUHeight[subsampling] : 16;
+
+		int left = std::max(0, std::min(region.x, width - 1));
+		int top = std::max(0, std::min(region.y, height - 1));
+		int right = std::min(width, region.x + region.width);
+		int bottom = std::min(height, region.y + region.height);
+
+		left -= left % block_width;
+		top -= top % block_height;
+
+		if (right > left && bottom > top && (left > 0 || top > 0 || right < width || bottom < height))
+		{
+			if (jpeg_transformer == nullptr)
+			{
+				jpeg_transformer = tjInitTransform();
+			}
+
+			tjtransform crop;
+			std::memset(&crop, 0, sizeof(crop));
+			crop.r.x = left;
+			crop.r.y = top;
+			crop.r.w = right - left;
+			crop.r.h = bottom - top;
+			crop.op = TJXOP_NONE;
+			crop.options = TJXOPT_CROP;
+
+			unsigned long cropped_size = 0;
+
+			if (0 != tjTransform(jpeg_transformer, data, static_cast<unsigned long>(size), 1, &cropped, &cropped_size, &crop, 0))
+			{
+				ErrorLogger::LOG_ERROR("Failed to crop JPG: " + std::string(tjGetErrorStr2(jpeg_transformer)));
+				return false;
+			}
+
+			source = cropped;
+			source_size = cropped_size;
+
+			used.x = left;
+			used.y = top;
+			used.width = crop_width = right - left;
+			used.height = crop_height = bottom - top;
+		}
+	}
+
+	int out_width = TJSCALED(crop_width, factor);
+	int out_height = TJSCALED(crop_height, factor);
+
+	image.Prepare(out_width, out_height, 3, sizeof(uint8_t));
+
+	bool success = (0 == tjDecompress2(jpeg_decompressor, source, source_size,
+		image.data_.data(), out_width, 0 /* pitch */, out_height,
+		TJPF_RGB, TJFLAG_FASTDCT | TJFLAG_FASTUPSAMPLE));
+
+	if (!success)
+	{
+		ErrorLogger::LOG_ERROR("Failed to decompress JPG: " + std::string(tjGetErrorStr2(jpeg_decompressor)));
+	}
+
+	if (cropped != nullptr)
+	{
+		tjFree(cropped);
+	}
+
+	if (applied != nullptr)
+	{
+		*applied = used;
+	}
+
+	return success;
+}
+
+bool MKV_Rendering::ImageDecoder::DecodePNG(const uint8_t* data, size_t size, open3d::geometry::Image& image)
+{
+	png_image png;
+	std::memset(&png, 0, sizeof(png));
+	png.version = PNG_IMAGE_VERSION;
+
+	if (png_image_begin_read_from_memory(&png, data, size) == 0)
+	{
+		ErrorLogger::LOG_ERROR("Failed to read PNG header: " + std::string(png.message));
+		return false;
+	}
+
+	//Same as Open3D's reader, colormapped images are expanded to full color
+	if (png.format & PNG_FORMAT_FLAG_COLORMAP)
+	{
+		png.format &= ~PNG_FORMAT_FLAG_COLORMAP;
+	}
+
+	image.Prepare(png.width, png.height,
+		PNG_IMAGE_SAMPLE_CHANNELS(png.format),
+		PNG_IMAGE_SAMPLE_COMPONENT_SIZE(png.format));
+
+	if (png_image_finish_read(&png, NULL, image.data_.data(), 0, NULL) == 0)
+	{
+		ErrorLogger::LOG_ERROR("Failed to decompress PNG: " + std::string(png.message));
+		png_image_free(&png);
+		return false;
+	}
+
+	return true;
+}
+
+bool MKV_Rendering::ImageDecoder::Decode(const uint8_t* data, size_t size, open3d::geometry::Image& image)
+{
+	static const uint8_t png_signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+	if (size >= 2 && data[0] == 0xFF && data[1] == 0xD8)
+	{
+		return DecodeJPEG(data, size, image);
+	}
+
+	if (size >= sizeof(png_signature) && std::memcmp(data, png_signature, sizeof(png_signature)) == 0)
+	{
+		return DecodePNG(data, size, image);
+	}
+
+	if (DepthCodec::IsEncoded(data, size))
+	{
+		return DepthCodec::Decode(data, size, image);
+	}
+
+	ErrorLogger::LOG_ERROR("Unrecognized image format!");
+	return false;
+}
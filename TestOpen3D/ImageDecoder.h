@@ -0,0 +1,115 @@
+#pragma once
+
+#include "open3d/Open3D.h"
+
+#include <turbojpeg.h>
+#include <cstdint>
+#include <cstddef>
+
+namespace MKV_Rendering {
+
+	/// <summary>
+	/// Which part of a JPG to decode and how small. TurboJPEG scales while still in the DCT domain and crops before decoding,
+	/// so both save most of the decoding work rather than just the pixels kept
+	/// </summary>
+	struct JPEGDecodeRegion
+	{
+		/// <summary>
+		/// Full resolution pixels per decoded pixel along each side: 1, 2, 4 or 8
+		/// </summary>
+		int scale = 1;
+
+		/// <summary>
+		/// The crop in full resolution pixels, a width or height of 0 keeps the whole image
+		/// </summary>
+		int x = 0;
+		int y = 0;
+		int width = 0;
+		int height = 0;
+
+		bool IsFull() const { return scale == 1 && width == 0 && height == 0; }
+
+		/// <summary>
+		/// Moves full resolution intrinsics onto the decoded pixels
+		/// </summary>
+		/// <param name="intrinsic">: the full resolution intrinsic matrix</param>
+		/// <returns>The intrinsic matrix of the decoded image</returns>
+		Eigen::Matrix3d ScaleIntrinsic(const Eigen::Matrix3d& intrinsic) const;
+
+		/// <summary>
+		/// Size of the decoded image, given the size of the full resolution one
+		/// </summary>
+		void DecodedSize(int full_width, int full_height, int& out_width, int& out_height) const;
+
+		/// <summary>
+		/// Samples full resolution depth onto the decoded color's pixels, nearest neighbour so no depths are blended
+		/// </summary>
+		/// <param name="full_depth">: depth in the color camera's plane at full resolution</param>
+		/// <param name="depth">: destination, prepared to the decoded size</param>
+		void CropDepth(const open3d::geometry::Image& full_depth, open3d::geometry::Image& depth) const;
+
+		std::string ToString() const;
+	};
+
+	/// <summary>
+	/// Decodes JPG and PNG images that are already in memory, into images whose memory is reused between calls.
+	/// Holds a TurboJPEG handle, so one decoder should not be used by two threads at once
+	/// </summary>
+	class ImageDecoder
+	{
+		tjhandle jpeg_decompressor = nullptr;
+
+		/// <summary>
+		/// Crops JPGs losslessly before they are decoded, made the first time a crop is asked for
+		/// </summary>
+		tjhandle jpeg_transformer = nullptr;
+
+	public:
+		/// <summary>
+		/// Constructor. Say hi! :D
+		/// </summary>
+		ImageDecoder();
+
+		//Destructor. Say goodbye! :( - releases the TurboJPEG handle
+		~ImageDecoder();
+
+		ImageDecoder(const ImageDecoder&) = delete;
+		ImageDecoder& operator=(const ImageDecoder&) = delete;
+
+		/// <summary>
+		/// Decodes a JPG into 8 bit RGB
+		/// </summary>
+		/// <param name="data">: the compressed image</param>
+		/// <param name="size">: size of the compressed image in bytes</param>
+		/// <param name="image">: destination, prepared to fit</param>
+		/// <returns>Successfully(?) decoded</returns>
+		bool DecodeJPEG(const uint8_t* data, size_t size, open3d::geometry::Image& image);
+
+		/// <summary>
+		/// Decodes part of a JPG into 8 bit RGB, at a fraction of its resolution
+		/// </summary>
+		/// <param name="data">: the compressed image</param>
+		/// <param name="size">: size of the compressed image in bytes</param>
+		/// <param name="image">: destination, prepared to fit</param>
+		/// <param name="region">: the crop and scale wanted</param>
+		/// <param name="applied">: if given, the crop and scale actually used. Crops are widened to whole JPG blocks and kept
+		/// inside the image, and scales TurboJPEG cannot do fall back to 1</param>
+		/// <returns>Successfully(?) decoded</returns>
+		bool DecodeJPEG(const uint8_t* data, size_t size, open3d::geometry::Image& image, const JPEGDecodeRegion& region, JPEGDecodeRegion* applied = nullptr);
+
+		/// <summary>
+		/// Decodes a PNG keeping its channels and bit depth, the same as open3d::io::ReadImage does
+		/// </summary>
+		/// <param name="data">: the compressed image</param>
+		/// <param name="size">: size of the compressed image in bytes</param>
+		/// <param name="image">: destination, prepared to fit</param>
+		/// <returns>Successfully(?) decoded</returns>
+		bool DecodePNG(const uint8_t* data, size_t size, open3d::geometry::Image& image);
+
+		/// <summary>
+		/// Decodes a JPG or PNG, telling which from its first bytes
+		/// </summary>
+		/// <returns>Successfully(?) decoded</returns>
+		bool Decode(const uint8_t* data, size_t size, open3d::geometry::Image& image);
+	};
+}
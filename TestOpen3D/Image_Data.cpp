@@ -1,9 +1,41 @@
 #include "Image_Data.h"
+#include "DepthCodec.h"
 
 #include <fstream>
+#include <algorithm>
 
 #include "AdditionalUtilities.h"
 
+/// <summary>
+/// Identifies how image folders are classified in their index files
+/// </summary>
+static const uint32_t IMAGE_FOLDER_LAYOUT = 0x494D4731;
+
+/// <summary>
+/// Every file is a frame, ordered by name - a timestamp is taken from after the last underscore if there is one
+/// </summary>
+static bool ClassifyImage(const std::string& file_name, MKV_Rendering::FrameIndexEntry& entry)
+{
+    entry.kind = MKV_Rendering::IndexedFileKind::COLOR;
+
+    try
+    {
+        std::vector<std::string> split_file;
+        std::vector<std::string> split_extension;
+        SplitString(file_name, split_file, '_');
+        SplitString(split_file.back(), split_extension, '.');
+
+        entry.timestamp = std::stoull(split_extension[0]);
+        entry.has_timestamp = 1;
+    }
+    catch (const std::exception&)
+    {
+        entry.has_timestamp = 0;
+    }
+
+    return true;
+}
+
 void MKV_Rendering::Image_Data::UpdateTimestamp()
 {
     if (FPS > 0)
@@ -14,8 +46,35 @@ void MKV_Rendering::Image_Data::UpdateTimestamp()
 
 void MKV_Rendering::Image_Data::LoadImages()
 {
-    open3d::utility::filesystem::ListFilesInDirectory(color_folder, color_files);
-    open3d::utility::filesystem::ListFilesInDirectory(depth_folder, depth_files);
+    //Without a shared index the folders are still read through one, it is just never written
+    FrameIndex scan_only;
+    FrameIndex* indexer = frame_index;
+
+    if (indexer == nullptr)
+    {
+        scan_only.SetEnabled(false);
+        indexer = &scan_only;
+    }
+
+    FolderIndex color_index;
+    FolderIndex depth_index;
+
+    indexer->Open(color_folder, IMAGE_FOLDER_LAYOUT, ClassifyImage, color_index);
+    indexer->Open(depth_folder, IMAGE_FOLDER_LAYOUT, ClassifyImage, depth_index);
+
+    //Entries come sorted by name
+    color_files.reserve(color_index.GetCount());
+    depth_files.reserve(depth_index.GetCount());
+
+    for (size_t i = 0; i < color_index.GetCount(); ++i)
+    {
+        color_files.push_back(color_index.GetPath(i));
+    }
+
+    for (size_t i = 0; i < depth_index.GetCount(); ++i)
+    {
+        depth_files.push_back(depth_index.GetPath(i));
+    }
 
     if (color_files.size() == 0)
     {
@@ -27,9 +86,6 @@ void MKV_Rendering::Image_Data::LoadImages()
         ErrorLogger::LOG_ERROR("No depth files present!", true);
     }
 
-    std::sort(color_files.begin(), color_files.end());
-    std::sort(depth_files.begin(), depth_files.end());
-
     //Shorter than an if statement, and supposedly faster
     int color_greater = (color_files.size() > depth_files.size());
     int max_files = color_greater * color_files.size() + (1 - color_greater) * depth_files.size();
@@ -41,23 +97,19 @@ void MKV_Rendering::Image_Data::LoadImages()
     {
         std::cout << "No FPS attribute present, parsing images for timestamps..." << std::endl;
 
-        try
+        //Timestamps were parsed when the folder was indexed
+        for (int i = 0; i < max_files; ++i)
         {
-            for (int i = 0; i < max_files; ++i)
+            if ((size_t)i >= color_index.GetCount() || !color_index.GetEntry(i).has_timestamp)
             {
-                std::vector<std::string> split_file;
-                std::vector<std::string> split_extension;
-                SplitString(color_files[i], split_file, '_');
-                SplitString(split_file.back(), split_extension, '.');
-
-                auto timestamp = std::stoull(split_extension[0]);
-                color_timestamps[timestamp] = color_files[i];
-                depth_timestamps[timestamp] = color_files[i];
+                ErrorLogger::LOG_ERROR("Error when parsing timestamps: no timestamp in " + color_files[i], true);
+                break;
             }
-        }
-        catch (const std::exception& e)
-        {
-            ErrorLogger::LOG_ERROR("Error when parsing timestamps: " + std::string(e.what()), true);
+
+            auto timestamp = color_index.GetEntry(i).timestamp;
+            color_timestamps[timestamp] = color_files[i];
+            frame_timestamps.push_back(timestamp);
+            depth_timestamps[timestamp] = color_files[i];
         }
     }
 }
@@ -144,55 +196,15 @@ void MKV_Rendering::Image_Data::GetExtrinsicTensor()
     extrinsic_t = open3d::core::eigen_converter::EigenMatrixToTensor(extrinsic_mat);
 }
 
-open3d::geometry::Image MKV_Rendering::Image_Data::TransformDepth(open3d::geometry::Image *old_depth, open3d::geometry::Image* color)
+void MKV_Rendering::Image_Data::TransformDepth(open3d::geometry::Image *old_depth, open3d::geometry::Image* color, open3d::geometry::Image* new_depth)
 {
-    open3d::geometry::Image new_depth;
-
-    auto width = color->width_;
-    auto height = color->height_;
-    auto stride = color->BytesPerLine();
-
-    new_depth.height_ = height;
-    new_depth.width_ = width;
-    new_depth.bytes_per_channel_ = old_depth->bytes_per_channel_;
-    new_depth.num_of_channels_ = old_depth->num_of_channels_;
-    new_depth.data_.resize(height * width * new_depth.bytes_per_channel_);
+    //Reuses the destination's memory when the size matches
+    new_depth->Prepare(color->width_, color->height_, old_depth->num_of_channels_, old_depth->bytes_per_channel_);
 
-    k4a_image_t k4a_transformed_depth = nullptr;
-    k4a_image_t k4a_depth = nullptr;
-
-    if (K4A_RESULT_SUCCEEDED != 
-        k4a_image_create_from_buffer(k4a_image_format_t::K4A_IMAGE_FORMAT_DEPTH16, old_depth->width_, old_depth->height_, old_depth->BytesPerLine(), 
-            old_depth->data_.data(), old_depth->data_.size(), nullptr, nullptr, &k4a_depth))
-    {
-        ErrorLogger::LOG_ERROR("Failed to create a source depth image at " + std::to_string(_timestamp) + ".", true);
-    }
-
-    if (K4A_RESULT_SUCCEEDED !=
-        k4a_image_create_from_buffer(k4a_image_format_t::K4A_IMAGE_FORMAT_DEPTH16, new_depth.width_, new_depth.height_, new_depth.BytesPerLine(),
-            new_depth.data_.data(), new_depth.data_.size(), nullptr, nullptr, &k4a_transformed_depth))
-    {
-        ErrorLogger::LOG_ERROR("Failed to create a destination depth image at " + std::to_string(_timestamp) + ".", true);
-    }
-
-    k4a_image_create_from_buffer(
-        K4A_IMAGE_FORMAT_DEPTH16, width, height,
-        width * sizeof(uint16_t), new_depth.data_.data(),
-        width * height * sizeof(uint16_t), NULL, NULL,
-        &k4a_transformed_depth);
-    if (K4A_RESULT_SUCCEEDED !=
-        k4a_transformation_depth_image_to_color_camera(
-            transform, k4a_depth, k4a_transformed_depth)) {
-        ErrorLogger::LOG_ERROR("Failed to transform depth frame to color frame at " + std::to_string(_timestamp) + ".", true);
-    }
-
-    k4a_image_release(k4a_depth);
-    k4a_image_release(k4a_transformed_depth);
-
-    return new_depth;
+    TransformDepthToColor(&calibration, transform, reinterpret_cast<uint16_t*>(old_depth->data_.data()), old_depth->width_, old_depth->height_, new_depth);
 }
 
-MKV_Rendering::Image_Data::Image_Data(std::string root_folder, std::string color_folder, std::string depth_folder, std::string intrinsics, std::string extrinsics, std::string FPS, int index) : Abstract_Data(root_folder, index)
+MKV_Rendering::Image_Data::Image_Data(std::string root_folder, std::string color_folder, std::string depth_folder, std::string intrinsics, std::string extrinsics, std::string FPS, int index, FrameIndex* frame_index) : Abstract_Data(root_folder, index), frame_index(frame_index)
 {
     this->color_folder = root_folder + "/" + color_folder;
     this->depth_folder = root_folder + "/" + depth_folder;
@@ -212,16 +224,18 @@ MKV_Rendering::Image_Data::Image_Data(std::string root_folder, std::string color
     current_frame = 0;
 
     ErrorLogger::EXECUTE("Load Images", this, &Image_Data::LoadImages);
+    MarkStartupStep("Load Images");
 
     ErrorLogger::EXECUTE("Create Intrinsic Tensor", this, &Image_Data::GetIntrinsicTensor);
     ErrorLogger::EXECUTE("Create Extrinsic Tensor", this, &Image_Data::GetExtrinsicTensor);
+    MarkStartupStep("Tensors");
 
-    auto im = open3d::t::io::CreateImageFromFile(color_files[current_frame]);
-
-    int imageWidth = im->GetCols();
-    int imageHeight = im->GetRows();
+    //The first frame is decoded when it is first used, the calibration already knows its size
+    imageWidth = calibration.color_camera_calibration.resolution_width;
+    imageHeight = calibration.color_camera_calibration.resolution_height;
 
     transform = k4a_transformation_create(&calibration);
+    MarkStartupStep("Transformation");
 }
 
 MKV_Rendering::Image_Data::~Image_Data()
@@ -267,6 +281,54 @@ bool MKV_Rendering::Image_Data::CycleCaptureBackwards()
     return true;
 }
 
+bool MKV_Rendering::Image_Data::GetCaptureTimeline(std::vector<uint64_t>& timeline)
+{
+    if (FPS > 0)
+    {
+        timeline.resize(color_files.size());
+
+        //Same conversion as UpdateTimestamp
+        for (size_t i = 0; i < timeline.size(); ++i)
+        {
+            timeline[i] = i * 1000000.0 / FPS;
+        }
+
+        return true;
+    }
+
+    timeline = frame_timestamps;
+
+    if (!std::is_sorted(timeline.begin(), timeline.end()))
+    {
+        ErrorLogger::LOG_ERROR("Image timestamps in " + color_folder + " are not in the same order as the names!");
+        return false;
+    }
+
+    return !timeline.empty();
+}
+
+bool MKV_Rendering::Image_Data::SeekToCaptureIndex(size_t capture)
+{
+    if (capture >= color_files.size() || (FPS <= 0 && capture >= frame_timestamps.size()))
+    {
+        ErrorLogger::LOG_ERROR("Capture " + std::to_string(capture) + " is past the end of the image folder!");
+        return false;
+    }
+
+    current_frame = capture;
+
+    if (FPS > 0)
+    {
+        UpdateTimestamp();
+    }
+    else
+    {
+        _timestamp = frame_timestamps[capture];
+    }
+
+    return true;
+}
+
 bool MKV_Rendering::Image_Data::SeekToTime(uint64_t time)
 {
     auto time_seconds = time / 1000000.0;
@@ -322,14 +384,81 @@ bool MKV_Rendering::Image_Data::SeekToTime(uint64_t time)
 
 std::shared_ptr<open3d::geometry::RGBDImage> MKV_Rendering::Image_Data::GetFrameRGBD()
 {
-    auto col = (*open3d::t::io::CreateImageFromFile(color_files[current_frame])).ToLegacyImage();
-    auto dep = (*open3d::t::io::CreateImageFromFile(depth_files[current_frame])).ToLegacyImage();
+    if (frame_cache != nullptr)
+    {
+        auto cached = frame_cache->GetFrame(index, current_frame, FrameStream::RGBD);
+
+        if (cached != nullptr)
+        {
+            return cached;
+        }
+    }
+
+    //Reading into a pooled frame reuses its memory instead of allocating new images
+    auto rgbd = frame_pool.Lease();
+
+    if (!open3d::io::ReadImage(color_files[current_frame], rgbd->color_) ||
+        !DepthCodec::ReadDepth(depth_files[current_frame], rgbd->depth_))
+    {
+        ErrorLogger::LOG_ERROR("Could not read " + color_files[current_frame] + " or " + depth_files[current_frame] + "!");
+        return nullptr;
+    }
 
     std::cout << color_files[current_frame] << std::endl;
 
-    return std::make_shared<open3d::geometry::RGBDImage>(
-        col, dep
-    );
+    if (frame_cache != nullptr)
+    {
+        frame_cache->PutFrame(index, current_frame, FrameStream::RGBD, rgbd);
+    }
+
+    return rgbd;
+}
+
+bool MKV_Rendering::Image_Data::GetFrameFiles(std::vector<std::string>& files)
+{
+    files.clear();
+
+    if (current_frame >= color_files.size() || current_frame >= depth_files.size())
+    {
+        return false;
+    }
+
+    if (frame_cache != nullptr && frame_cache->Contains(index, current_frame, FrameStream::RGBD))
+    {
+        return false;
+    }
+
+    files.push_back(color_files[current_frame]);
+    files.push_back(depth_files[current_frame]);
+
+    return true;
+}
+
+std::shared_ptr<open3d::geometry::RGBDImage> MKV_Rendering::Image_Data::GetFrameRGBDFromMemory(std::vector<std::vector<uint8_t>*>& contents)
+{
+    if (contents.size() < 2)
+    {
+        ErrorLogger::LOG_ERROR("Camera " + std::to_string(index) + " needs its color and depth files to decode a frame!");
+        return nullptr;
+    }
+
+    auto rgbd = frame_pool.Lease();
+
+    //Color and depth may be JPG, PNG or RVL, the decoder tells them apart. A truncated or corrupt file leaves the frame
+    //half prepared, so it is not cached and the camera reads the files itself
+    if (!decoder.Decode(contents[0]->data(), contents[0]->size(), rgbd->color_) ||
+        !decoder.Decode(contents[1]->data(), contents[1]->size(), rgbd->depth_))
+    {
+        ErrorLogger::LOG_ERROR("Could not decode " + color_files[current_frame] + " or " + depth_files[current_frame] + "!");
+        return nullptr;
+    }
+
+    if (frame_cache != nullptr)
+    {
+        frame_cache->PutFrame(index, current_frame, FrameStream::RGBD, rgbd);
+    }
+
+    return rgbd;
 }
 
 open3d::camera::PinholeCameraParameters MKV_Rendering::Image_Data::GetParameters()
@@ -352,27 +481,62 @@ open3d::camera::PinholeCameraParameters MKV_Rendering::Image_Data::GetParameters
 
 void MKV_Rendering::Image_Data::PackIntoVoxelGrid(open3d::t::geometry::TSDFVoxelGrid* grid, VoxelGridData* data)
 {
-    auto color = (*open3d::t::io::CreateImageFromFile(color_files[current_frame]));
-    auto depth = (*open3d::t::io::CreateImageFromFile(depth_files[current_frame]));// .ToLegacyImage();
-
-    //auto new_depth = open3d::t::geometry::Image::FromLegacyImage(ErrorLogger::EXECUTE("Transforming Depth", this, &Image_Data::TransformDepth, &depth, &color.ToLegacyImage()));
-
-    //std::cout << intrinsic_t.ToString() << std::endl;
-    //std::cout << extrinsic_t.ToString() << std::endl;
+    open3d::t::geometry::Image color;
+    open3d::t::geometry::Image depth;
 
-    color.To(grid->GetDevice());
-    depth.To(grid->GetDevice());
+    AcquireFrameTensors(color, depth, grid->GetDevice());
 
     grid->Integrate(depth, color,
-        intrinsic_t, extrinsic_t,
+        GetFrameIntrinsic(), extrinsic_t,
         data->depth_scale, data->depth_max);
 }
 
 void MKV_Rendering::Image_Data::PackIntoOldVoxelGrid(open3d::geometry::VoxelGrid* grid)
 {
-    auto rgbd = GetFrameRGBD();
+    auto rgbd = AcquireFrame(FRAME_STREAM_DEPTH);
 
-    auto params = GetParameters();
+    auto params = GetFrameParameters();
 
     grid->CarveSilhouette(rgbd->depth_, params, true);
+}
+
+bool MKV_Rendering::Image_Data::WritePackedContainer(std::string container_path)
+{
+    PackedContainerWriter writer;
+
+    //Image folders keep depth already moved into the color camera's space
+    if (!writer.Begin(container_path, calibration, extrinsic_mat, true))
+    {
+        return false;
+    }
+
+    std::map<std::string, uint64_t> file_timestamps;
+
+    if (FPS <= 0)
+    {
+        for (auto& timestamp : color_timestamps)
+        {
+            file_timestamps[timestamp.second] = timestamp.first;
+        }
+    }
+
+    size_t frame_count = std::min(color_files.size(), depth_files.size());
+
+    if (color_files.size() != depth_files.size())
+    {
+        ErrorLogger::LOG_ERROR("Color and depth counts differ (" + std::to_string(color_files.size()) + " and " +
+            std::to_string(depth_files.size()) + "), only the first " + std::to_string(frame_count) + " frames are packed");
+    }
+
+    for (size_t frame = 0; frame < frame_count; ++frame)
+    {
+        uint64_t timestamp = (FPS > 0) ? (uint64_t)(frame * 1000000.0 / FPS) : file_timestamps[color_files[frame]];
+
+        if (!writer.AddFrame(timestamp, color_files[frame], depth_files[frame], ""))
+        {
+            return false;
+        }
+    }
+
+    return writer.Finish();
 }
\ No newline at end of file
@@ -3,6 +3,9 @@
 #include "open3d/Open3D.h"
 #include "VoxelGridData.h"
 #include "Abstract_Data.h"
+#include "FrameIndex.h"
+#include "PackedContainer.h"
+#include "ImageDecoder.h"
 
 #include <k4a/k4a.h>
 #include <k4arecord/record.h>
@@ -32,6 +35,11 @@ namespace MKV_Rendering {
 		/// </summary>
 		std::map<uint64_t, std::string> color_timestamps;
 
+		/// <summary>
+		/// Timestamp parsed from each color image name, in order, when there is no FPS
+		/// </summary>
+		std::vector<uint64_t> frame_timestamps;
+
 		/// <summary>
 		/// Vector of depth images in order
 		/// </summary>
@@ -67,11 +75,21 @@ namespace MKV_Rendering {
 		/// </summary>
 		double FPS;
 
+		/// <summary>
+		/// Where folder indices are kept, nullptr to always scan the folders
+		/// </summary>
+		FrameIndex* frame_index = nullptr;
+
 		/// <summary>
 		/// The current map element being used
 		/// </summary>
 		size_t current_frame = 0;
 
+		/// <summary>
+		/// Decodes files that were read ahead
+		/// </summary>
+		ImageDecoder decoder;
+
 		/// <summary>
 		/// Updates the timestamp
 		/// </summary>
@@ -92,7 +110,7 @@ namespace MKV_Rendering {
 		/// </summary>
 		void GetExtrinsicTensor();
 
-		open3d::geometry::Image TransformDepth(open3d::geometry::Image* old_depth, open3d::geometry::Image* color);
+		void TransformDepth(open3d::geometry::Image* old_depth, open3d::geometry::Image* color, open3d::geometry::Image* new_depth);
 	public:
 		/// <summary>
 		/// Constructor - say hi! :D
@@ -103,7 +121,8 @@ namespace MKV_Rendering {
 		/// <param name="intrinsics">: the intrinsics file name (in .json)</param>
 		/// <param name="extrinsics">: the extrinsics file name (in .log)</param>
 		/// <param name="FPS">: playback speed</param>
-		Image_Data(std::string root_folder, std::string color_folder, std::string depth_folder, std::string intrinsics, std::string extrinsics, std::string FPS, int index);
+		/// <param name="frame_index">: reuses folder indices from previous runs, nullptr to always scan the folders</param>
+		Image_Data(std::string root_folder, std::string color_folder, std::string depth_folder, std::string intrinsics, std::string extrinsics, std::string FPS, int index, FrameIndex* frame_index = nullptr);
 		
 		//Destructor - say goodbye! :(
 		~Image_Data();
@@ -114,13 +133,19 @@ namespace MKV_Rendering {
 		bool CycleCaptureForwards();
 		bool CycleCaptureBackwards();
 		bool SeekToTime(uint64_t time);
+		bool GetCaptureTimeline(std::vector<uint64_t>& timeline);
+		bool SeekToCaptureIndex(size_t capture);
 
 		std::shared_ptr<open3d::geometry::RGBDImage> GetFrameRGBD();
+		bool GetFrameFiles(std::vector<std::string>& files);
+		std::shared_ptr<open3d::geometry::RGBDImage> GetFrameRGBDFromMemory(std::vector<std::vector<uint8_t>*>& contents);
 
 		open3d::camera::PinholeCameraParameters GetParameters();
 
 		void PackIntoVoxelGrid(open3d::t::geometry::TSDFVoxelGrid* grid, VoxelGridData* data);
 
 		void PackIntoOldVoxelGrid(open3d::geometry::VoxelGrid* grid);
+
+		bool WritePackedContainer(std::string container_path);
 	};
 }
\ No newline at end of file
@@ -1,9 +1,76 @@
 #include "Livescan_Data.h"
+#include "DepthCodec.h"
 
 #include <fstream>
 
 #include "AdditionalUtilities.h"
 
+/// <summary>
+/// Identifies how Livescan folders are classified in their index files
+/// </summary>
+static const uint32_t LIVESCAN_IMAGE_LAYOUT = 0x4C534932;
+static const uint32_t LIVESCAN_MATTE_LAYOUT = 0x4C534D31;
+
+/// <summary>
+/// Color_<frame>.jpg, Depth_<frame>.png (or .rvl) and the intrinsics json
+/// </summary>
+static bool ClassifyLivescanImage(const std::string& file_name, MKV_Rendering::FrameIndexEntry& entry)
+{
+	std::vector<std::string> split_extension;
+	SplitString(file_name, split_extension, '.');
+
+	if (split_extension.empty())
+	{
+		return false;
+	}
+
+	if ((split_extension.front().find("Color_") != std::string::npos) && (split_extension.back() == "jpg"))
+	{
+		entry.kind = MKV_Rendering::IndexedFileKind::COLOR;
+	}
+	else if ((split_extension.front().find("Depth_") != std::string::npos) && (split_extension.back() == "png" || split_extension.back() == "rvl"))
+	{
+		entry.kind = MKV_Rendering::IndexedFileKind::DEPTH;
+	}
+	else if (split_extension.back() == "json")
+	{
+		entry.kind = MKV_Rendering::IndexedFileKind::INTRINSICS;
+		return true;
+	}
+	else
+	{
+		return false;
+	}
+
+	std::vector<std::string> split_num;
+	SplitString(split_extension.front(), split_num, '_');
+	entry.frame = std::stoi(split_num.back());
+
+	return true;
+}
+
+/// <summary>
+/// Anything with 'matte' in its name, numbered after the last underscore
+/// </summary>
+static bool ClassifyLivescanMatte(const std::string& file_name, MKV_Rendering::FrameIndexEntry& entry)
+{
+	if (file_name.find("matte") == std::string::npos)
+	{
+		return false;
+	}
+
+	std::vector<std::string> split_extension;
+	SplitString(file_name, split_extension, '.');
+
+	std::vector<std::string> split_num;
+	SplitString(split_extension.front(), split_num, '_');
+
+	entry.kind = MKV_Rendering::IndexedFileKind::MATTE;
+	entry.frame = std::stoi(split_num.back());
+
+	return true;
+}
+
 void MKV_Rendering::Livescan_Data::UpdateTimestamp()
 {
 	_timestamp = (double)current_frame / FPS * 1000000.0;
@@ -11,36 +78,51 @@ void MKV_Rendering::Livescan_Data::UpdateTimestamp()
 
 void MKV_Rendering::Livescan_Data::LoadImages()
 {
-	std::vector<std::string> all_files;
+	//Without a shared index the folders are still read through one, it is just never written
+	FrameIndex scan_only;
+	FrameIndex* indexer = frame_index;
 
-	open3d::utility::filesystem::ListFilesInDirectory(folder_name, all_files);
+	if (indexer == nullptr)
+	{
+		scan_only.SetEnabled(false);
+		indexer = &scan_only;
+	}
+
+	FolderIndex image_index;
+	indexer->Open(folder_name, LIVESCAN_IMAGE_LAYOUT, ClassifyLivescanImage, image_index);
 
-	for (auto s : all_files)
+	//Entries come sorted by frame, so every insert lands at the end of its map
+	for (size_t i = 0; i < image_index.GetCount(); ++i)
 	{
-		std::vector<std::string> split_extension;
-		SplitString(s, split_extension, '.', "\\/");
+		auto& entry = image_index.GetEntry(i);
 
-		if ((split_extension.front().find("Color_") != std::string::npos) && (split_extension.back() == "jpg"))
-		{
-			std::vector<std::string> split_num;
-			SplitString(split_extension.front(), split_num, '_');
-			int loc = std::stoi(split_num.back());
-			color_files[loc] = s;
-		}
-		else if ((split_extension.front().find("Depth_") != std::string::npos) && (split_extension.back() == "png"))
-		{
-			std::vector<std::string> split_num;
-			SplitString(split_extension.front(), split_num, '_');
-			int loc = std::stoi(split_num.back());
-			depth_files[loc] = s;
-		}
-		else if (split_extension.back() == "json")
+		switch (entry.kind)
 		{
-			std::cout << s << std::endl;
-			intrinsics_file = s;
+		case IndexedFileKind::COLOR:
+			color_files.emplace_hint(color_files.end(), (int)entry.frame, image_index.GetPath(i));
+			break;
+
+		case IndexedFileKind::DEPTH:
+			depth_files.emplace_hint(depth_files.end(), (int)entry.frame, image_index.GetPath(i));
+			break;
+
+		case IndexedFileKind::INTRINSICS:
+			intrinsics_file = image_index.GetPath(i);
+			std::cout << intrinsics_file << std::endl;
+			break;
+
+		default:
+			break;
 		}
 	}
 
+	frame_numbers.reserve(color_files.size());
+
+	for (auto& color_file : color_files)
+	{
+		frame_numbers.push_back(color_file.first);
+	}
+
 	if (intrinsics_file == "")
 	{
 		E_LOG("No intrinsics json found!", true);
@@ -48,22 +130,12 @@ void MKV_Rendering::Livescan_Data::LoadImages()
 
 	if (matte_folder_name != "")
 	{
-		std::vector<std::string> all_mattes;
+		FolderIndex matte_index;
+		indexer->Open(matte_folder_name, LIVESCAN_MATTE_LAYOUT, ClassifyLivescanMatte, matte_index);
 
-		open3d::utility::filesystem::ListFilesInDirectory(matte_folder_name, all_mattes);
-
-		for (auto s : all_mattes)
+		for (size_t i = 0; i < matte_index.GetCount(); ++i)
 		{
-			std::vector<std::string> split_extension;
-			SplitString(s, split_extension, '.', "\\/");
-
-			if (s.find("matte") != std::string::npos)
-			{
-				std::vector<std::string> split_num;
-				SplitString(split_extension.front(), split_num, '_');
-				int loc = std::stoi(split_num.back());
-				matte_files[loc] = s;
-			}
+			matte_files.emplace_hint(matte_files.end(), (int)matte_index.GetEntry(i).frame, matte_index.GetPath(i));
 		}
 	}
 
@@ -120,76 +192,80 @@ void MKV_Rendering::Livescan_Data::GetExtrinsicTensor()
 	extrinsic_t = open3d::core::eigen_converter::EigenMatrixToTensor(extrinsic_mat);
 }
 
-open3d::geometry::Image MKV_Rendering::Livescan_Data::TransformDepth(open3d::geometry::Image* old_depth, open3d::geometry::Image* color)
+bool MKV_Rendering::Livescan_Data::TransformDepth(open3d::geometry::Image* old_depth, open3d::geometry::RGBDImage* frame, std::vector<uint8_t>* matte_contents)
 {
-	open3d::geometry::Image new_depth;
+	//The matte is loaded first so the transform can skip everything outside the subject
+	std::shared_ptr<MatteMask> matte = LoadMatte(matte_contents);
 
-	auto width = color->width_;
-	auto height = color->height_;
-	auto stride = color->BytesPerLine();
+	//Lands at the decoded color's size, which is smaller than the color camera's when only a region is decoded
+	return TransformFrame(&calibration, transform, reinterpret_cast<uint16_t*>(old_depth->data_.data()), old_depth->width_, old_depth->height_, frame, matte.get());
+}
 
-	new_depth.height_ = height;
-	new_depth.width_ = width;
-	new_depth.bytes_per_channel_ = old_depth->bytes_per_channel_;
-	new_depth.num_of_channels_ = old_depth->num_of_channels_;
-	new_depth.data_.resize(height * width * new_depth.bytes_per_channel_);
+bool MKV_Rendering::Livescan_Data::DecodeColor(const uint8_t* data, size_t size, open3d::geometry::Image& color)
+{
+	//Only JPGs can be decoded in part, anything else is decoded whole
+	if (size >= 2 && data[0] == 0xFF && data[1] == 0xD8)
+	{
+		return decoder.DecodeJPEG(data, size, color, decode_region, &frame_region);
+	}
 
-	std::cout <<
-		new_depth.height_ << ", " <<
-		new_depth.width_ << ", " <<
-		new_depth.bytes_per_channel_ << ", " <<
-		new_depth.num_of_channels_ << std::endl;
+	frame_region = JPEGDecodeRegion();
 
-	k4a_image_t k4a_transformed_depth = nullptr;
-	k4a_image_t k4a_depth = nullptr;
+	return decoder.Decode(data, size, color);
+}
 
-	if (K4A_RESULT_SUCCEEDED !=
-		k4a_image_create_from_buffer(k4a_image_format_t::K4A_IMAGE_FORMAT_DEPTH16, old_depth->width_, old_depth->height_, old_depth->BytesPerLine(),
-			old_depth->data_.data(), old_depth->data_.size(), nullptr, nullptr, &k4a_depth))
+std::shared_ptr<MKV_Rendering::MatteMask> MKV_Rendering::Livescan_Data::LoadMatte(std::vector<uint8_t>* contents)
+{
+	if (matte_folder_name == "" || matte_files.empty())
 	{
-		ErrorLogger::LOG_ERROR("Failed to create a source depth image at " + std::to_string(_timestamp) + ".", true);
+		return nullptr;
 	}
 
-	if (K4A_RESULT_SUCCEEDED !=
-		k4a_image_create_from_buffer(k4a_image_format_t::K4A_IMAGE_FORMAT_DEPTH16, new_depth.width_, new_depth.height_, new_depth.BytesPerLine(),
-			new_depth.data_.data(), new_depth.data_.size(), nullptr, nullptr, &k4a_transformed_depth))
-	{
-		ErrorLogger::LOG_ERROR("Failed to create a destination depth image at " + std::to_string(_timestamp) + ".", true);
-	}
+	auto matte_file = matte_files.lower_bound(current_frame);
 
-	if (K4A_RESULT_SUCCEEDED !=
-		k4a_transformation_depth_image_to_color_camera(
-			transform, k4a_depth, k4a_transformed_depth)) {
-		ErrorLogger::LOG_ERROR("Failed to transform depth frame to color frame at " + std::to_string(_timestamp) + ".", true);
+	if (matte_file == matte_files.end())
+	{
+		return nullptr;
 	}
 
-	k4a_image_release(k4a_depth);
-	k4a_image_release(k4a_transformed_depth);
+	std::shared_ptr<MatteMask> matte = nullptr;
 
-	if (matte_folder_name != "")
+	if (frame_cache != nullptr)
 	{
-		std::cout << "applying matte:\t\t" << matte_files.lower_bound(current_frame)->second << std::endl;
+		matte = frame_cache->GetMatte(index, matte_file->first);
 
-		open3d::geometry::Image matte = (*open3d::t::io::CreateImageFromFile(matte_files.lower_bound(current_frame)->second)).ToLegacyImage();
-
-		std::cout << matte.bytes_per_channel_ << ", " << matte.num_of_channels_ << std::endl;
+		if (matte != nullptr)
+		{
+			return matte;
+		}
+	}
 
-#ifdef _WIN32
-#pragma omp parallel for schedule(static)
-#else
-#pragma omp parallel for collapse(3) schedule(static)
-#endif
-		for (int v = 0; v < new_depth.height_; ++v) {
-			for (int u = 0; u < new_depth.width_; ++u) {
-				(*new_depth.PointerAt<uint16_t>(u, v)) = ((*matte.PointerAt<uint8_t>(u, v, 0)) > 0) ? (*new_depth.PointerAt<uint16_t>(u, v)) : uint16_t(0);
-			}
+	if (contents != nullptr)
+	{
+		if (!decoder.Decode(contents->data(), contents->size(), matte_buffer))
+		{
+			ErrorLogger::LOG_ERROR("Could not decode matte " + matte_file->second + "!");
+			return nullptr;
 		}
 	}
+	else if (!open3d::io::ReadImage(matte_file->second, matte_buffer))
+	{
+		ErrorLogger::LOG_ERROR("Could not read matte " + matte_file->second + "!");
+		return nullptr;
+	}
 
-	return new_depth;
+	matte = std::make_shared<MatteMask>();
+	matte->FromImage(matte_buffer);
+
+	if (frame_cache != nullptr)
+	{
+		frame_cache->PutMatte(index, matte_file->first, matte);
+	}
+
+	return matte;
 }
 
-MKV_Rendering::Livescan_Data::Livescan_Data(std::string data_folder, std::string matte_folder, std::vector<std::string>& extrinsics, int index, double FPS) : Abstract_Data(data_folder, index), FPS(FPS)
+MKV_Rendering::Livescan_Data::Livescan_Data(std::string data_folder, std::string matte_folder, std::vector<std::string>& extrinsics, int index, double FPS, FrameIndex* frame_index) : Abstract_Data(data_folder, index), FPS(FPS), frame_index(frame_index)
 {
 	matte_folder_name = matte_folder;
 
@@ -206,16 +282,18 @@ MKV_Rendering::Livescan_Data::Livescan_Data(std::string data_folder, std::string
 	}
 
 	ErrorLogger::EXECUTE("Load Images", this, &Livescan_Data::LoadImages);
+	MarkStartupStep("Load Images");
 
 	ErrorLogger::EXECUTE("Create Intrinsic Tensor", this, &Livescan_Data::GetIntrinsicTensor);
 	ErrorLogger::EXECUTE("Create Extrinsic Tensor", this, &Livescan_Data::GetExtrinsicTensor);
+	MarkStartupStep("Tensors");
 
-	auto im = open3d::t::io::CreateImageFromFile(color_files.lower_bound(current_frame)->second);
-
-	int imageWidth = im->GetCols();
-	int imageHeight = im->GetRows();
+	//The first frame is decoded when it is first used, the calibration already knows its size
+	imageWidth = calibration.color_camera_calibration.resolution_width;
+	imageHeight = calibration.color_camera_calibration.resolution_height;
 
 	transform = k4a_transformation_create(&calibration);
+	MarkStartupStep("Transformation");
 }
 
 MKV_Rendering::Livescan_Data::~Livescan_Data()
@@ -283,18 +361,151 @@ bool MKV_Rendering::Livescan_Data::SeekToTime(uint64_t time)
 	return true;
 }
 
+bool MKV_Rendering::Livescan_Data::GetCaptureTimeline(std::vector<uint64_t>& timeline)
+{
+	timeline.clear();
+	timeline.reserve(frame_numbers.size());
+
+	//Same conversion as UpdateTimestamp, so seeking to a listed time lands on its frame
+	for (int frame : frame_numbers)
+	{
+		timeline.push_back((double)frame / FPS * 1000000.0);
+	}
+
+	return true;
+}
+
+bool MKV_Rendering::Livescan_Data::SeekToCaptureIndex(size_t capture)
+{
+	if (capture >= frame_numbers.size())
+	{
+		ErrorLogger::LOG_ERROR("Capture " + std::to_string(capture) + " is past the end of the image folder!");
+		return false;
+	}
+
+	current_frame = frame_numbers[capture];
+	UpdateTimestamp();
+
+	return true;
+}
+
 std::shared_ptr<open3d::geometry::RGBDImage> MKV_Rendering::Livescan_Data::GetFrameRGBD()
 {
-	auto col = (*open3d::t::io::CreateImageFromFile(color_files.lower_bound(current_frame)->second)).ToLegacyImage();
-	auto dep = (*open3d::t::io::CreateImageFromFile(depth_files.lower_bound(current_frame)->second)).ToLegacyImage();
+	return DecodeFrame(nullptr);
+}
+
+bool MKV_Rendering::Livescan_Data::GetFrameFiles(std::vector<std::string>& files)
+{
+	files.clear();
+
+	auto color_file = color_files.lower_bound(current_frame);
+
+	if (color_file == color_files.end())
+	{
+		return false;
+	}
+
+	if (frame_cache != nullptr && frame_cache->Contains(index, color_file->first, FrameStream::RGBD))
+	{
+		return false;
+	}
+
+	files.push_back(color_file->second);
+	files.push_back(depth_files.lower_bound(current_frame)->second);
+
+	if (matte_folder_name != "" && !matte_files.empty())
+	{
+		auto matte_file = matte_files.lower_bound(current_frame);
+
+		if (matte_file != matte_files.end() && (frame_cache == nullptr || !frame_cache->Contains(index, matte_file->first, FrameStream::MATTE)))
+		{
+			files.push_back(matte_file->second);
+		}
+	}
+
+	return true;
+}
+
+std::shared_ptr<open3d::geometry::RGBDImage> MKV_Rendering::Livescan_Data::GetFrameRGBDFromMemory(std::vector<std::vector<uint8_t>*>& contents)
+{
+	if (contents.size() < 2)
+	{
+		ErrorLogger::LOG_ERROR("Camera " + std::to_string(index) + " needs its color and depth files to decode a frame!");
+		return nullptr;
+	}
+
+	return DecodeFrame(&contents);
+}
+
+std::shared_ptr<open3d::geometry::RGBDImage> MKV_Rendering::Livescan_Data::DecodeFrame(std::vector<std::vector<uint8_t>*>* contents)
+{
+	int frame_key = color_files.lower_bound(current_frame)->first;
+
+	if (frame_cache != nullptr)
+	{
+		auto cached = frame_cache->GetFrame(index, frame_key, FrameStream::RGBD);
+
+		if (cached != nullptr)
+		{
+			return cached;
+		}
+	}
+
+	//Reading into a pooled frame reuses its memory instead of allocating new images
+	auto rgbd = frame_pool.Lease();
+
+	std::vector<uint8_t>* matte_contents = nullptr;
+
+	bool decoded;
+
+	if (contents != nullptr)
+	{
+		//Color and depth may be JPG, PNG or RVL, the decoder tells them apart
+		decoded = DecodeColor((*contents)[0]->data(), (*contents)[0]->size(), rgbd->color_) &&
+			decoder.Decode((*contents)[1]->data(), (*contents)[1]->size(), raw_depth_buffer);
 
-	auto new_dep = ErrorLogger::EXECUTE("Transforming Depth", this, &Livescan_Data::TransformDepth, &dep, &col);
+		if (contents->size() > 2)
+		{
+			matte_contents = (*contents)[2];
+		}
+	}
+	else
+	{
+		if (decode_region.IsFull())
+		{
+			decoded = open3d::io::ReadImage(color_files.lower_bound(current_frame)->second, rgbd->color_);
+			frame_region = JPEGDecodeRegion();
+		}
+		else
+		{
+			decoded = AsyncFileReader::ReadWholeFile(color_files.lower_bound(current_frame)->second, color_file_buffer) &&
+				DecodeColor(color_file_buffer.data(), color_file_buffer.size(), rgbd->color_);
+		}
+
+		decoded = decoded && DepthCodec::ReadDepth(depth_files.lower_bound(current_frame)->second, raw_depth_buffer);
+	}
+
+	//A truncated or corrupt file leaves the frame half prepared, so it is neither returned nor cached
+	if (!decoded)
+	{
+		ErrorLogger::LOG_ERROR("Could not decode " + color_files.lower_bound(current_frame)->second + " or its depth!");
+		return nullptr;
+	}
+
+	if (!ErrorLogger::EXECUTE("Transforming Depth", this, &Livescan_Data::TransformDepth, &raw_depth_buffer, &(*rgbd), matte_contents))
+	{
+		ErrorLogger::LOG_ERROR("Could not transform depth of " + color_files.lower_bound(current_frame)->second + "!");
+		return nullptr;
+	}
 
-	std::cout << color_files[current_frame] << std::endl;
+	std::cout << color_files.lower_bound(current_frame)->second << std::endl;
 
-	return std::make_shared<open3d::geometry::RGBDImage>(
-		col, new_dep
-		);
+	if (frame_cache != nullptr)
+	{
+		frame_cache->PutFrame(index, frame_key, FrameStream::RGBD, rgbd);
+	}
+
+	return rgbd;
 }
 
 open3d::camera::PinholeCameraParameters MKV_Rendering::Livescan_Data::GetParameters()
@@ -317,42 +528,66 @@ open3d::camera::PinholeCameraParameters MKV_Rendering::Livescan_Data::GetParamet
 
 void MKV_Rendering::Livescan_Data::PackIntoVoxelGrid(open3d::t::geometry::TSDFVoxelGrid* grid, VoxelGridData* data)
 {
-	auto color = (*open3d::t::io::CreateImageFromFile(color_files.lower_bound(current_frame)->second));
-	auto depth = (*open3d::t::io::CreateImageFromFile(depth_files.lower_bound(current_frame)->second)).ToLegacyImage();
-
-	std::cout << "current frame: " << current_frame << "," << color_files.lower_bound(current_frame)->second << ", " << depth_files.lower_bound(current_frame)->second << std::endl;
+	open3d::t::geometry::Image color;
+	open3d::t::geometry::Image depth;
 
-	auto transformed_depth = ErrorLogger::EXECUTE("Transforming Depth", this, &Livescan_Data::TransformDepth, &depth, &color.ToLegacyImage());
-
-	auto new_depth = open3d::t::geometry::Image::FromLegacyImage(
-		transformed_depth
-	);
+	AcquireFrameTensors(color, depth, grid->GetDevice());
 
-	color.To(grid->GetDevice());
-	new_depth.To(grid->GetDevice());
-
-	grid->Integrate(new_depth, color,
-		intrinsic_t, extrinsic_t,
+	grid->Integrate(depth, color,
+		GetFrameIntrinsic(), GetFrameExtrinsic(),
 		data->depth_scale, data->depth_max);
 }
 
 void MKV_Rendering::Livescan_Data::PackIntoOldVoxelGrid(open3d::geometry::VoxelGrid* grid)
 {
-	auto rgbd = GetFrameRGBD();
+	auto rgbd = AcquireFrame(FRAME_STREAM_DEPTH);
 
-	auto params = GetParameters();
+	auto params = GetFrameParameters();
 
 	grid->CarveSilhouette(rgbd->depth_, params, true);
 }
 
 void MKV_Rendering::Livescan_Data::PackIntoNewVoxelGrid(MeshingVoxelGrid* grid)
 {
-	auto color = (*open3d::t::io::CreateImageFromFile(color_files.lower_bound(current_frame)->second)).ToLegacyImage();
-	auto depth = (*open3d::t::io::CreateImageFromFile(depth_files.lower_bound(current_frame)->second)).ToLegacyImage();
+	auto rgbd = AcquireFrame(grid->IsGeometryOnly() ? FRAME_STREAM_DEPTH : FRAME_STREAM_ALL);
+
+	grid->AddImage(rgbd->color_, rgbd->depth_, GetFrameExtrinsicMat(), GetFrameIntrinsicMat());
+}
 
-	std::cout << "current frame: " << current_frame << "," << color_files.lower_bound(current_frame)->second << ", " << depth_files.lower_bound(current_frame)->second << std::endl;
+bool MKV_Rendering::Livescan_Data::WritePackedContainer(std::string container_path)
+{
+	PackedContainerWriter writer;
 
-	auto transformed_depth = ErrorLogger::EXECUTE("Transforming Depth", this, &Livescan_Data::TransformDepth, &depth, &color);
+	if (!writer.Begin(container_path, calibration, extrinsic_mat))
+	{
+		return false;
+	}
+
+	//Packs exactly what playback shows at each position, frames shown more than once are stored once
+	for (size_t frame = 0; frame < color_files.size(); ++frame)
+	{
+		auto color_file = color_files.lower_bound(frame);
+		auto depth_file = depth_files.lower_bound(frame);
+
+		if (color_file == color_files.end() || depth_file == depth_files.end())
+		{
+			break;
+		}
+
+		std::string matte_path = "";
+
+		if (!matte_files.empty() && matte_files.lower_bound(frame) != matte_files.end())
+		{
+			matte_path = matte_files.lower_bound(frame)->second;
+		}
+
+		uint64_t timestamp = (double)frame / FPS * 1000000.0;
+
+		if (!writer.AddFrame(timestamp, color_file->second, depth_file->second, matte_path))
+		{
+			return false;
+		}
+	}
 
-	grid->AddImage(color, transformed_depth, extrinsic_mat, intrinsic_mat);
+	return writer.Finish();
 }
@@ -3,6 +3,10 @@
 #include "open3d/Open3D.h"
 #include "VoxelGridData.h"
 #include "Abstract_Data.h"
+#include "FrameIndex.h"
+#include "PackedContainer.h"
+#include "ImageDecoder.h"
+#include "AsyncFileReader.h"
 
 #include <k4a/k4a.h>
 #include <k4arecord/record.h>
@@ -67,11 +71,61 @@ namespace MKV_Rendering {
 		/// </summary>
 		double FPS;
 
+		/// <summary>
+		/// Where folder indices are kept, nullptr to always scan the folders
+		/// </summary>
+		FrameIndex* frame_index = nullptr;
+
 		/// <summary>
 		/// Current frame
 		/// </summary>
 		size_t current_frame = 0;
 
+		/// <summary>
+		/// Frame numbers of the color images in order, so captures can be found by position
+		/// </summary>
+		std::vector<int> frame_numbers;
+
+		/// <summary>
+		/// Depth as read from disk, before being moved into the color camera's space
+		/// </summary>
+		open3d::geometry::Image raw_depth_buffer;
+
+		/// <summary>
+		/// The current frame's matte as read from disk, before being packed
+		/// </summary>
+		open3d::geometry::Image matte_buffer;
+
+		/// <summary>
+		/// Decodes files that were read ahead
+		/// </summary>
+		ImageDecoder decoder;
+
+		/// <summary>
+		/// The current color file as read from disk, when only part of it is decoded
+		/// </summary>
+		std::vector<uint8_t> color_file_buffer;
+
+		/// <summary>
+		/// Decodes a color image, only the decode region of it if it is a JPG
+		/// </summary>
+		/// <returns>Successfully(?) decoded</returns>
+		bool DecodeColor(const uint8_t* data, size_t size, open3d::geometry::Image& color);
+
+		/// <summary>
+		/// Gets the current frame's packed matte, from the frame cache if it was decoded before
+		/// </summary>
+		/// <param name="contents">: the matte file's contents if it was read ahead, nullptr to read it here</param>
+		/// <returns>The matte, or nullptr if this camera has none</returns>
+		std::shared_ptr<MatteMask> LoadMatte(std::vector<uint8_t>* contents = nullptr);
+
+		/// <summary>
+		/// Decodes the current frame, reading its files here unless their contents are given
+		/// </summary>
+		/// <param name="contents">: color, depth and optionally matte contents as listed by GetFrameFiles, nullptr to read the files</param>
+		/// <returns>Pointer to RGBD image</returns>
+		std::shared_ptr<open3d::geometry::RGBDImage> DecodeFrame(std::vector<std::vector<uint8_t>*>* contents);
+
 		/// <summary>
 		/// Caches the current playback time
 		/// </summary>
@@ -81,7 +135,7 @@ namespace MKV_Rendering {
 		void GetIntrinsicTensor();
 		void GetExtrinsicTensor();
 
-		open3d::geometry::Image TransformDepth(open3d::geometry::Image* old_depth, open3d::geometry::Image* color);
+		bool TransformDepth(open3d::geometry::Image* old_depth, open3d::geometry::RGBDImage* frame, std::vector<uint8_t>* matte_contents);
 	public:
 		/// <summary>
 		/// Constructor. Say hi! :D
@@ -91,7 +145,8 @@ namespace MKV_Rendering {
 		/// <param name="extrinsics">: camera extrinsics</param>
 		/// <param name="camera_ID">: camera's ID</param>
 		/// <param name="FPS">: playback speed</param>
-		Livescan_Data(std::string data_folder, std::string matte_folder, std::vector<std::string> &extrinsics, int index, double FPS);
+		/// <param name="frame_index">: reuses folder indices from previous runs, nullptr to always scan the folders</param>
+		Livescan_Data(std::string data_folder, std::string matte_folder, std::vector<std::string> &extrinsics, int index, double FPS, FrameIndex* frame_index = nullptr);
 
 		//Destructor. Say goodbye! :(
 		~Livescan_Data();
@@ -102,8 +157,12 @@ namespace MKV_Rendering {
 		bool CycleCaptureForwards();
 		bool CycleCaptureBackwards();
 		bool SeekToTime(uint64_t time);
+		bool GetCaptureTimeline(std::vector<uint64_t>& timeline);
+		bool SeekToCaptureIndex(size_t capture);
 
 		std::shared_ptr<open3d::geometry::RGBDImage> GetFrameRGBD();
+		bool GetFrameFiles(std::vector<std::string>& files);
+		std::shared_ptr<open3d::geometry::RGBDImage> GetFrameRGBDFromMemory(std::vector<std::vector<uint8_t>*>& contents);
 
 		open3d::camera::PinholeCameraParameters GetParameters();
 
@@ -112,5 +171,7 @@ namespace MKV_Rendering {
 		void PackIntoOldVoxelGrid(open3d::geometry::VoxelGrid* grid);
 
 		void PackIntoNewVoxelGrid(MeshingVoxelGrid* grid);
+
+		bool WritePackedContainer(std::string container_path);
 	};
 }
\ No newline at end of file
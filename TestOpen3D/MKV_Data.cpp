@@ -6,12 +6,48 @@
 #include "AdditionalUtilities.h"
 
 #include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
 #include <turbojpeg.h>
 
 using namespace MKV_Rendering;
 
 MKV_Data* MKV_Data::main_camera_data = nullptr;
 
+std::mutex MKV_Data::main_camera_lock;
+
+const std::string MKV_Data::TIMESTAMP_INDEX_EXTENSION = ".tsindex";
+
+/// <summary>
+/// Start of a timestamp index, followed by one timestamp per capture. The MKV's size and write time tell whether the index is stale
+/// </summary>
+struct TimestampIndexHeader
+{
+    char magic[4] = { 'M', 'T', 'S', 'I' };
+    uint32_t version = 1;
+    uint64_t mkv_size = 0;
+    int64_t mkv_time = 0;
+    uint64_t capture_count = 0;
+};
+
+static bool GetMKVFingerprint(const std::string& mkv_file, uint64_t& mkv_size, int64_t& mkv_time)
+{
+    std::error_code error;
+
+    mkv_size = std::filesystem::file_size(mkv_file, error);
+
+    if (error)
+    {
+        return false;
+    }
+
+    mkv_time = std::filesystem::last_write_time(mkv_file, error).time_since_epoch().count();
+
+    return !error;
+}
+
 void MKV_Rendering::MKV_Data::Initialize(std::string my_folder, std::string mkv_name, std::string calibration_name)
 {
     if (mkv_name != "")
@@ -71,6 +107,9 @@ void MKV_Data::Calibrate()
     switch (record_config.wired_sync_mode)
     {
     case K4A_WIRED_SYNC_MODE_MASTER:
+        //Cameras are constructed in parallel
+        main_camera_lock.lock();
+
         if (main_camera_data == nullptr)
         {
             main_camera_data = this;
@@ -80,6 +119,8 @@ void MKV_Data::Calibrate()
         {
             ErrorLogger::LOG_ERROR("Conflict between " + main_camera_data->mkv_file + " and " + mkv_file + " over main camera", true);
         }
+
+        main_camera_lock.unlock();
         break;
     case K4A_WIRED_SYNC_MODE_SUBORDINATE:
         std::cout << mkv_file << " set as subordinate camera" << std::endl;
@@ -93,6 +134,118 @@ void MKV_Data::Calibrate()
     std::cout << "Start Offset: " << start_offset << std::endl;
 }
 
+bool MKV_Data::BuildTimestampIndex()
+{
+    capture_timestamps.clear();
+
+    k4a_capture_t indexed_capture = NULL;
+
+    while (k4a_playback_get_next_capture(handle, &indexed_capture) == k4a_stream_result_t::K4A_STREAM_RESULT_SUCCEEDED)
+    {
+        //Same as GetCaptureTimestamp, the earliest image in the capture
+        uint64_t timestamp = UINT64_MAX;
+
+        k4a_image_t images[3] = {
+            k4a_capture_get_color_image(indexed_capture),
+            k4a_capture_get_depth_image(indexed_capture),
+            k4a_capture_get_ir_image(indexed_capture)
+        };
+
+        for (auto image : images)
+        {
+            if (image != NULL)
+            {
+                timestamp = std::min(timestamp, k4a_image_get_device_timestamp_usec(image));
+                k4a_image_release(image);
+            }
+        }
+
+        k4a_capture_release(indexed_capture);
+        indexed_capture = NULL;
+
+        if (!capture_timestamps.empty() && timestamp <= capture_timestamps.back())
+        {
+            ErrorLogger::LOG_ERROR("Captures out of order in " + mkv_file + ", seeking without an index");
+            capture_timestamps.clear();
+            break;
+        }
+
+        capture_timestamps.push_back(timestamp);
+    }
+
+    k4a_playback_seek_timestamp(handle, 0, k4a_playback_seek_origin_t::K4A_PLAYBACK_SEEK_BEGIN);
+
+    return !capture_timestamps.empty();
+}
+
+void MKV_Data::LoadTimestampIndex()
+{
+    std::string index_path = mkv_file + TIMESTAMP_INDEX_EXTENSION;
+
+    TimestampIndexHeader expected;
+
+    if (!GetMKVFingerprint(mkv_file, expected.mkv_size, expected.mkv_time))
+    {
+        ErrorLogger::LOG_ERROR("Could not stat " + mkv_file + "!");
+    }
+
+    std::ifstream index_in(index_path, std::ios::binary | std::ios::ate);
+
+    if (index_in.is_open())
+    {
+        uint64_t index_size = (uint64_t)index_in.tellg();
+        index_in.seekg(0, std::ios::beg);
+
+        TimestampIndexHeader header;
+        index_in.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+        //The count is checked against what the file holds before anything is allocated for it, divided so a huge count
+        //cannot overflow
+        if (index_in.good() &&
+            header.capture_count <= (index_size - sizeof(header)) / sizeof(uint64_t) &&
+            std::memcmp(header.magic, expected.magic, sizeof(expected.magic)) == 0 &&
+            header.version == expected.version &&
+            header.mkv_size == expected.mkv_size &&
+            header.mkv_time == expected.mkv_time)
+        {
+            capture_timestamps.resize(header.capture_count);
+            index_in.read(reinterpret_cast<char*>(capture_timestamps.data()), header.capture_count * sizeof(uint64_t));
+
+            if (index_in.good() && std::is_sorted(capture_timestamps.begin(), capture_timestamps.end()))
+            {
+                std::cout << capture_timestamps.size() << " captures indexed in " << index_path << std::endl;
+                return;
+            }
+        }
+
+        capture_timestamps.clear();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    if (!BuildTimestampIndex())
+    {
+        return;
+    }
+
+    std::cout << "Indexed " << capture_timestamps.size() << " captures of " << mkv_file << " in " <<
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+
+    expected.capture_count = capture_timestamps.size();
+
+    //The index is only a shortcut, an MKV in a read only folder is indexed again next time
+    std::ofstream index_out(index_path, std::ios::binary | std::ios::trunc);
+    index_out.write(reinterpret_cast<const char*>(&expected), sizeof(expected));
+    index_out.write(reinterpret_cast<const char*>(capture_timestamps.data()), capture_timestamps.size() * sizeof(uint64_t));
+}
+
+void MKV_Data::UpdateCurrentCapture()
+{
+    auto found = std::lower_bound(capture_timestamps.begin(), capture_timestamps.end(), _timestamp);
+
+    current_capture = (found != capture_timestamps.end() && *found == _timestamp) ? found - capture_timestamps.begin() : SIZE_MAX;
+}
+
 void MKV_Data::GetPlaybackDataRaw()
 {
     if (!playback_data.empty())
@@ -243,22 +396,57 @@ void MKV_Data::ConvertBGRAToRGB(open3d::geometry::Image& bgra, open3d::geometry:
     }
 }
 
-std::shared_ptr<open3d::geometry::RGBDImage> MKV_Data::DecompressCapture()
+bool MKV_Data::DecodeColor(k4a_image_t k4a_color, open3d::geometry::Image& rgb, const JPEGDecodeRegion& region, JPEGDecodeRegion* applied)
 {
-    static std::shared_ptr<open3d::geometry::Image> color_buffer = nullptr;
-    static std::shared_ptr<open3d::geometry::RGBDImage> rgbd_buffer = nullptr;
-
-    if (color_buffer == nullptr) {
-        color_buffer = std::make_shared<open3d::geometry::Image>();
+    if (!decoder.DecodeJPEG(k4a_image_get_buffer(k4a_color), k4a_image_get_size(k4a_color), rgb, region, applied)) {
+        ErrorLogger::LOG_ERROR("Failed to decompress color image at " + std::to_string(_timestamp));
+        return false;
     }
-    if (rgbd_buffer == nullptr) {
-        rgbd_buffer = std::make_shared<open3d::geometry::RGBDImage>();
+
+    return true;
+}
+
+bool MKV_Data::DecodeColorViaBGRA(k4a_image_t k4a_color, open3d::geometry::Image& bgra, open3d::geometry::Image& rgb)
+{
+    int width = k4a_image_get_width_pixels(k4a_color);
+    int height = k4a_image_get_height_pixels(k4a_color);
+
+    rgb.Prepare(width, height, 3, sizeof(uint8_t));
+    bgra.Prepare(width, height, 4, sizeof(uint8_t));
+
+    tjhandle tjHandle;
+    tjHandle = tjInitDecompress();
+    if (0 !=
+        tjDecompress2(tjHandle, k4a_image_get_buffer(k4a_color),
+            static_cast<unsigned long>(
+                k4a_image_get_size(k4a_color)),
+            bgra.data_.data(), width, 0 /* pitch */, height,
+            TJPF_BGRA, TJFLAG_FASTDCT | TJFLAG_FASTUPSAMPLE)) {
+        ErrorLogger::LOG_ERROR("Failed to decompress color image at " + std::to_string(_timestamp) + ".");
+        tjDestroy(tjHandle);
+        return false;
     }
+    tjDestroy(tjHandle);
+
+    ErrorLogger::EXECUTE(
+        "Converting Image Type from BGRA to RGB",
+        this,
+        &MKV_Data::ConvertBGRAToRGB, bgra, rgb);
+
+    return true;
+}
+
+std::shared_ptr<open3d::geometry::RGBDImage> MKV_Data::DecompressCapture(int streams)
+{
+    //Frames may be held by the prefetcher while the next is decoded, so each decode leases its own
+    auto rgbd_buffer = frame_pool.Lease();
 
     k4a_image_t k4a_color = k4a_capture_get_color_image(*capture);
     k4a_image_t k4a_depth = k4a_capture_get_depth_image(*capture);
     if (k4a_color == nullptr || k4a_depth == nullptr) {
         ErrorLogger::LOG_ERROR("Capture at " + std::to_string(_timestamp) + " empty, skipping");
+        if (k4a_color != nullptr) k4a_image_release(k4a_color);
+        if (k4a_depth != nullptr) k4a_image_release(k4a_depth);
         return nullptr;
     }
 
@@ -266,6 +454,8 @@ std::shared_ptr<open3d::geometry::RGBDImage> MKV_Data::DecompressCapture()
     if (K4A_IMAGE_FORMAT_COLOR_MJPG !=
         k4a_image_get_format(k4a_color)) {
         ErrorLogger::LOG_ERROR("Unexpected image format at " + std::to_string(_timestamp) + ". The stream may have been corrupted.");
+        k4a_image_release(k4a_color);
+        k4a_image_release(k4a_depth);
         return nullptr;
     }
 
@@ -275,41 +465,27 @@ std::shared_ptr<open3d::geometry::RGBDImage> MKV_Data::DecompressCapture()
     imageWidth = width;
     imageHeight = height;
 
-    /* resize */
-    rgbd_buffer->color_.Prepare(width, height, 3, sizeof(uint8_t));
-    color_buffer->Prepare(width, height, 4, sizeof(uint8_t));
+    /* color is only kept compressed when the whole image would be decoded and depth does not need it */
+    bool defer_color = (streams & FRAME_STREAM_COLOR) == 0 && decode_region.IsFull() && !integrate_in_depth_space;
 
-    tjhandle tjHandle;
-    tjHandle = tjInitDecompress();
-    if (0 !=
-        tjDecompress2(tjHandle, k4a_image_get_buffer(k4a_color),
-            static_cast<unsigned long>(
-                k4a_image_get_size(k4a_color)),
-            color_buffer->data_.data(), width, 0 /* pitch */, height,
-            TJPF_BGRA, TJFLAG_FASTDCT | TJFLAG_FASTUPSAMPLE)) {
-        ErrorLogger::LOG_ERROR("Failed to decompress color image at " + std::to_string(_timestamp) + ".");
+    /* decode straight into the RGB image, no intermediate BGRA buffer */
+    if (defer_color) {
+        frame_region = JPEGDecodeRegion();
+    }
+    else if (!DecodeColor(k4a_color, rgbd_buffer->color_, decode_region, &frame_region)) {
+        k4a_image_release(k4a_color);
+        k4a_image_release(k4a_depth);
         return nullptr;
     }
-    tjDestroy(tjHandle);
-    ErrorLogger::EXECUTE(
-        "Converting Image Type from BGRA to RGB", 
-        this, 
-        &MKV_Data::ConvertBGRAToRGB, *color_buffer, rgbd_buffer->color_);
 
     /* transform depth to color plane */
-    k4a_image_t k4a_transformed_depth = nullptr;
     if (transform) {
-        rgbd_buffer->depth_.Prepare(width, height, 1, sizeof(uint16_t));
-        k4a_image_create_from_buffer(
-            K4A_IMAGE_FORMAT_DEPTH16, width, height,
-            width * sizeof(uint16_t), rgbd_buffer->depth_.data_.data(),
-            width * height * sizeof(uint16_t), NULL, NULL,
-            &k4a_transformed_depth);
-
-        if (K4A_RESULT_SUCCEEDED !=
-            k4a_transformation_depth_image_to_color_camera(
-                transform, k4a_depth, k4a_transformed_depth)) {
-            ErrorLogger::LOG_ERROR("Failed to transform depth frame to color frame at " + std::to_string(_timestamp) + ".", true);
+        if (!TransformFrame(&calibration, transform,
+            reinterpret_cast<uint16_t*>(k4a_image_get_buffer(k4a_depth)),
+            k4a_image_get_width_pixels(k4a_depth), k4a_image_get_height_pixels(k4a_depth),
+            &(*rgbd_buffer))) {
+            k4a_image_release(k4a_color);
+            k4a_image_release(k4a_depth);
             return nullptr;
         }
     }
@@ -323,14 +499,13 @@ std::shared_ptr<open3d::geometry::RGBDImage> MKV_Data::DecompressCapture()
             k4a_image_get_size(k4a_depth));
     }
 
-    DrawObject(rgbd_buffer->depth_);
+    if (defer_color) {
+        DeferColor(rgbd_buffer, k4a_image_get_buffer(k4a_color), k4a_image_get_size(k4a_color));
+    }
 
     /* process depth */
     k4a_image_release(k4a_color);
     k4a_image_release(k4a_depth);
-    if (transform) {
-        k4a_image_release(k4a_transformed_depth);
-    }
 
     return rgbd_buffer;
 }
@@ -338,28 +513,43 @@ std::shared_ptr<open3d::geometry::RGBDImage> MKV_Data::DecompressCapture()
 MKV_Data::MKV_Data(std::string my_folder, std::string mkv_name, std::string calibration_name, int index) : Abstract_Data(my_folder, index)
 {
     ErrorLogger::EXECUTE("Initialization", this, &MKV_Data::Initialize, my_folder, mkv_name, calibration_name);
+    MarkStartupStep("Initialization");
 
     ErrorLogger::EXECUTE("Calibrate Camera", this, &MKV_Data::Calibrate);
+    MarkStartupStep("Open Playback");
 
     ErrorLogger::EXECUTE("Retrieve Playback Data", this, &MKV_Data::GetPlaybackDataRaw);
+    MarkStartupStep("Calibration");
 
     ErrorLogger::EXECUTE("Create Intrinsic Tensor", this, &MKV_Data::GetIntrinsicTensor);
     ErrorLogger::EXECUTE("Create Extrinsic Tensor", this, &MKV_Data::GetExtrinsicTensor);
+    MarkStartupStep("Tensors");
 
     transform = k4a_transformation_create(&calibration);
+    MarkStartupStep("Transformation");
+
+    ErrorLogger::EXECUTE("Load Timestamp Index", this, &MKV_Data::LoadTimestampIndex);
+    MarkStartupStep("Timestamp Index");
 
     ErrorLogger::EXECUTE("Set Capture To First Frame", this, &MKV_Data::CycleCaptureForwards);
+    MarkStartupStep("First Capture");
 
-    ErrorLogger::EXECUTE("Decompressing Capture", this, &MKV_Data::DecompressCapture);
+    //The first frame is decoded when it is first used, the calibration already knows its size
+    imageWidth = calibration.color_camera_calibration.resolution_width;
+    imageHeight = calibration.color_camera_calibration.resolution_height;
 }
 
 MKV_Data::~MKV_Data()
 {
+    main_camera_lock.lock();
+
     if (main_camera_data == this)
     {
         main_camera_data = nullptr;
     }
 
+    main_camera_lock.unlock();
+
     if (capture != nullptr)
     {
         k4a_capture_release(*capture);
@@ -395,27 +585,31 @@ uint64_t MKV_Data::GetCaptureTimestamp()
     return min_timestamp;
 }
 
-bool MKV_Data::CycleCaptureForwards()
+bool MKV_Data::ReadCapture(bool forwards)
 {
     if (capture == nullptr)
     {
         capture = new k4a_capture_t();
     }
-    else
+    else if (*capture != NULL)
     {
         k4a_capture_release(*capture);
     }
 
     *capture = NULL;
 
-    switch (k4a_playback_get_next_capture(handle, capture))
+    auto result = forwards ? k4a_playback_get_next_capture(handle, capture) : k4a_playback_get_previous_capture(handle, capture);
+
+    switch (result)
     {
     case k4a_stream_result_t::K4A_STREAM_RESULT_EOF:
         ErrorLogger::LOG_ERROR("Stream has reached EOF on: " + mkv_file);
+        current_capture = SIZE_MAX;
         return false;
         break;
     case k4a_stream_result_t::K4A_STREAM_RESULT_FAILED:
-        ErrorLogger::LOG_ERROR("Stream failed on: " + mkv_file, true);
+        ErrorLogger::LOG_ERROR("Stream failed on: " + mkv_file, forwards);
+        current_capture = SIZE_MAX;
         return false;
         break;
     default:
@@ -423,81 +617,99 @@ bool MKV_Data::CycleCaptureForwards()
         break;
     }
 
+    UpdateCurrentCapture();
+
     return true;
 }
 
-bool MKV_Data::CycleCaptureBackwards()
+bool MKV_Data::CycleCaptureForwards()
 {
-    if (capture == nullptr)
-    {
-        capture = new k4a_capture_t();
-    }
-    else
-    {
-        k4a_capture_release(*capture);
-    }
-
-    *capture = NULL;
-
-    switch (k4a_playback_get_previous_capture(handle, capture))
-    {
-    case k4a_stream_result_t::K4A_STREAM_RESULT_EOF:
-        ErrorLogger::LOG_ERROR("Stream has reached EOF on: " + mkv_file);
-        return false;
-        break;
-    case k4a_stream_result_t::K4A_STREAM_RESULT_FAILED:
-        ErrorLogger::LOG_ERROR("Stream failed on: " + mkv_file);
-        return false;
-        break;
-    default:
-        _timestamp = ErrorLogger::EXECUTE("Retrieving Capture Timestamp", this, &MKV_Data::GetCaptureTimestamp);
-        break;
-    }
+    return ReadCapture(true);
+}
 
-    return true;
+bool MKV_Data::CycleCaptureBackwards()
+{
+    return ReadCapture(false);
 }
 
 bool MKV_Data::SeekToTime(uint64_t time)
 {
-    if (capture == nullptr)
-    {
-        capture = new k4a_capture_t();
-    }
-    else
+    size_t target = SIZE_MAX;
+
+    if (!capture_timestamps.empty())
     {
-        k4a_capture_release(*capture);
-    }
+        target = std::lower_bound(capture_timestamps.begin(), capture_timestamps.end(), time) - capture_timestamps.begin();
 
-    *capture = NULL;
+        if (target >= capture_timestamps.size())
+        {
+            ErrorLogger::LOG_ERROR("No capture at or after " + std::to_string(time) + " on: " + mkv_file);
+            return false;
+        }
+
+        //Already there, nothing to read
+        if (target == current_capture && capture != nullptr && *capture != NULL)
+        {
+            return true;
+        }
+
+        //Playing forwards, the next capture is the one after the current one anyway
+        if (current_capture != SIZE_MAX && target == current_capture + 1)
+        {
+            return ReadCapture(true);
+        }
+
+        //Seeking to the capture's own timestamp lands exactly on it
+        time = capture_timestamps[target];
+    }
 
     if (k4a_result_t::K4A_RESULT_SUCCEEDED !=
         k4a_playback_seek_timestamp(handle, time, k4a_playback_seek_origin_t::K4A_PLAYBACK_SEEK_DEVICE_TIME))
     {
         ErrorLogger::LOG_ERROR("Problem seeking timestamp on: " + mkv_file);
+        current_capture = SIZE_MAX;
         return false;
     }
 
-    switch (k4a_playback_get_next_capture(handle, capture))
+    if (!ReadCapture(true))
     {
-    case k4a_stream_result_t::K4A_STREAM_RESULT_EOF:
-        ErrorLogger::LOG_ERROR("Stream has reached EOF on: " + mkv_file);
-        return false;
-        break;
-    case k4a_stream_result_t::K4A_STREAM_RESULT_FAILED:
-        ErrorLogger::LOG_ERROR("Stream failed on: " + mkv_file);
         return false;
-        break;
-    default:
-        _timestamp = ErrorLogger::EXECUTE("Retrieving Capture Timestamp", this, &MKV_Data::GetCaptureTimestamp);
-        break;
     }
 
     std::cout << "Seeking to " << _timestamp << std::endl;
 
+    if (target != SIZE_MAX && current_capture != target)
+    {
+        ErrorLogger::LOG_ERROR("Seek on " + mkv_file + " landed on " + std::to_string(_timestamp) + " instead of " + std::to_string(time) + "!");
+    }
+
     return true;
 }
 
+bool MKV_Data::GetCaptureTimeline(std::vector<uint64_t>& timeline)
+{
+    timeline = capture_timestamps;
+
+    return !timeline.empty();
+}
+
+bool MKV_Data::SeekToCaptureIndex(size_t capture)
+{
+    if (capture >= capture_timestamps.size())
+    {
+        ErrorLogger::LOG_ERROR("Capture " + std::to_string(capture) + " is past the end of: " + mkv_file);
+        return false;
+    }
+
+    //Goes through the index, so the current and next captures are not seeked to
+    return SeekToTime(capture_timestamps[capture]);
+}
+
 std::shared_ptr<open3d::geometry::RGBDImage> MKV_Data::GetFrameRGBD()
+{
+    return GetFrameStreams(FRAME_STREAM_ALL);
+}
+
+std::shared_ptr<open3d::geometry::RGBDImage> MKV_Data::GetFrameStreams(int streams)
 {
     bool valid_frame = false;
 
@@ -505,7 +717,7 @@ std::shared_ptr<open3d::geometry::RGBDImage> MKV_Data::GetFrameRGBD()
 
     while (!valid_frame)
     {
-        rgbd = ErrorLogger::EXECUTE("Decompressing Capture", this, &MKV_Data::DecompressCapture);
+        rgbd = ErrorLogger::EXECUTE("Decompressing Capture", this, &MKV_Data::DecompressCapture, streams);
 
         valid_frame = (rgbd != nullptr);
 
@@ -518,6 +730,16 @@ std::shared_ptr<open3d::geometry::RGBDImage> MKV_Data::GetFrameRGBD()
     return rgbd;
 }
 
+bool MKV_Data::DecodeDeferredColor(open3d::geometry::RGBDImage& frame)
+{
+    if (!decoder.DecodeJPEG(deferred_color_payload.data(), deferred_color_payload.size(), frame.color_)) {
+        ErrorLogger::LOG_ERROR("Failed to decompress deferred color image at " + std::to_string(_timestamp));
+        return false;
+    }
+
+    return true;
+}
+
 open3d::camera::PinholeCameraParameters MKV_Rendering::MKV_Data::GetParameters()
 {
     open3d::camera::PinholeCameraParameters to_return;
@@ -543,21 +765,73 @@ void MKV_Rendering::MKV_Data::WriteIntrinsics(std::string filename_and_path)
     file.close();
 }
 
+void MKV_Rendering::MKV_Data::BenchmarkColorDecode(int iterations)
+{
+    k4a_image_t k4a_color = k4a_capture_get_color_image(*capture);
+
+    if (k4a_color == nullptr || k4a_image_get_format(k4a_color) != K4A_IMAGE_FORMAT_COLOR_MJPG)
+    {
+        ErrorLogger::LOG_ERROR("No MJPEG color image at " + std::to_string(_timestamp) + " to benchmark!");
+
+        if (k4a_color != nullptr)
+            k4a_image_release(k4a_color);
+
+        return;
+    }
+
+    open3d::geometry::Image direct_rgb;
+    open3d::geometry::Image bgra;
+    open3d::geometry::Image swizzled_rgb;
+
+    iterations = std::max(iterations, 1);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < iterations; ++i)
+    {
+        DecodeColor(k4a_color, direct_rgb);
+    }
+
+    auto direct_end = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < iterations; ++i)
+    {
+        DecodeColorViaBGRA(k4a_color, bgra, swizzled_rgb);
+    }
+
+    auto bgra_end = std::chrono::steady_clock::now();
+
+    k4a_image_release(k4a_color);
+
+    double direct_ms = std::chrono::duration<double, std::milli>(direct_end - start).count() / (double)iterations;
+    double bgra_ms = std::chrono::duration<double, std::milli>(bgra_end - direct_end).count() / (double)iterations;
+
+    size_t mismatched = 0;
+
+    for (size_t i = 0; i < direct_rgb.data_.size() && i < swizzled_rgb.data_.size(); ++i)
+    {
+        if (direct_rgb.data_[i] != swizzled_rgb.data_[i])
+            ++mismatched;
+    }
+
+    std::cout << folder_name << " (" << direct_rgb.width_ << "x" << direct_rgb.height_ << ", " << iterations << " decodes)" << std::endl;
+    std::cout << "\tDirect RGB: " << direct_ms << " ms per frame" << std::endl;
+    std::cout << "\tBGRA + swizzle: " << bgra_ms << " ms per frame" << std::endl;
+    std::cout << "\tMismatched bytes: " << mismatched << std::endl;
+}
+
 void MKV_Rendering::MKV_Data::PackIntoVoxelGrid(open3d::t::geometry::TSDFVoxelGrid* grid, VoxelGridData* data)
 {
     if (calibration_file == "")
         ErrorLogger::LOG_ERROR("No calibration present on " + folder_name + "!", true);
 
-    auto rgbd = GetFrameRGBD();
+    open3d::t::geometry::Image color;
+    open3d::t::geometry::Image depth;
 
-    auto color = open3d::t::geometry::Image::FromLegacyImage(rgbd->color_);
-    auto depth = open3d::t::geometry::Image::FromLegacyImage(rgbd->depth_);
-
-    color.To(grid->GetDevice());
-    depth.To(grid->GetDevice());
+    AcquireFrameTensors(color, depth, grid->GetDevice());
 
     grid->Integrate(depth, color,
-        intrinsic_t, extrinsic_t,
+        GetFrameIntrinsic(), GetFrameExtrinsic(),
         data->depth_scale, data->depth_max);
 }
 
@@ -566,9 +840,17 @@ void MKV_Rendering::MKV_Data::PackIntoOldVoxelGrid(open3d::geometry::VoxelGrid*
     if (calibration_file == "")
         ErrorLogger::LOG_ERROR("No calibration present on " + folder_name + "!", true);
 
-    auto rgbd = GetFrameRGBD();
+    //Carving only looks at depth
+    auto rgbd = AcquireFrame(FRAME_STREAM_DEPTH);
 
-    auto params = GetParameters();
+    auto params = GetFrameParameters();
 
     grid->CarveSilhouette(rgbd->depth_, params, true);
 }
+
+void MKV_Rendering::MKV_Data::PackIntoNewVoxelGrid(MeshingVoxelGrid* grid)
+{
+    auto rgbd = AcquireFrame(grid->IsGeometryOnly() ? FRAME_STREAM_DEPTH : FRAME_STREAM_ALL);
+
+    grid->AddImage(rgbd->color_, rgbd->depth_, GetFrameExtrinsicMat(), GetFrameIntrinsicMat());
+}
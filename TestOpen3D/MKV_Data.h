@@ -5,7 +5,9 @@
 
 #include <k4a/k4a.h>
 #include <k4arecord/record.h>
+#include <turbojpeg.h>
 #include <string>
+#include <mutex>
 
 namespace MKV_Rendering {
 
@@ -19,6 +21,11 @@ namespace MKV_Rendering {
 		/// </summary>
 		static MKV_Data* main_camera_data;
 
+		/// <summary>
+		/// Guards main_camera_data
+		/// </summary>
+		static std::mutex main_camera_lock;
+
 		/// <summary>
 		/// the mkv filename
 		/// </summary>
@@ -54,6 +61,11 @@ namespace MKV_Rendering {
 		/// </summary>
 		k4a_capture_t* capture = nullptr;
 
+		/// <summary>
+		/// JPEG decoder, kept for the camera's lifetime. Frames of one camera are only ever decoded on one thread at a time
+		/// </summary>
+		ImageDecoder decoder;
+
 		/// <summary>
 		/// Raw playback data
 		/// </summary>
@@ -64,6 +76,39 @@ namespace MKV_Rendering {
 		/// </summary>
 		uint64_t start_offset = 0;
 
+		/// <summary>
+		/// Timestamp of every capture in the MKV, in playback order. Empty if the MKV could not be indexed
+		/// </summary>
+		std::vector<uint64_t> capture_timestamps;
+
+		/// <summary>
+		/// Position of the current capture in capture_timestamps
+		/// </summary>
+		size_t current_capture = SIZE_MAX;
+
+		/// <summary>
+		/// Loads the capture timestamps from the index next to the MKV, or reads every capture and writes that index
+		/// </summary>
+		void LoadTimestampIndex();
+
+		/// <summary>
+		/// Reads the timestamp of every capture, leaving the playback at the beginning
+		/// </summary>
+		/// <returns>Successfully(?) indexed, false if the timestamps are out of order</returns>
+		bool BuildTimestampIndex();
+
+		/// <summary>
+		/// Finds the current capture in the index from its timestamp
+		/// </summary>
+		void UpdateCurrentCapture();
+
+		/// <summary>
+		/// Releases the current capture and reads the next or previous one
+		/// </summary>
+		/// <param name="forwards">: which way to read</param>
+		/// <returns>Successfully(?) read</returns>
+		bool ReadCapture(bool forwards);
+
 		/// <summary>
 		/// Initializes this object
 		/// </summary>
@@ -99,11 +144,33 @@ namespace MKV_Rendering {
 		/// <param name="rgb">: reference to the RGB destination image</param>
 		void ConvertBGRAToRGB(open3d::geometry::Image& bgra, open3d::geometry::Image& rgb);
 
+		/// <summary>
+		/// Decodes an MJPEG color image straight into an RGB image
+		/// </summary>
+		/// <param name="k4a_color">: the compressed color image</param>
+		/// <param name="rgb">: destination, resized to fit</param>
+		/// <param name="region">: the part of the image to decode and its scale, the whole image by default</param>
+		/// <param name="applied">: if given, the region the decoder actually used</param>
+		/// <returns>Successfully(?) decoded</returns>
+		bool DecodeColor(k4a_image_t k4a_color, open3d::geometry::Image& rgb, const JPEGDecodeRegion& region = JPEGDecodeRegion(), JPEGDecodeRegion* applied = nullptr);
+
+		/// <summary>
+		/// Old decode path, decoding to BGRA and swizzling into RGB. Only kept to benchmark against
+		/// </summary>
+		/// <param name="k4a_color">: the compressed color image</param>
+		/// <param name="bgra">: intermediate image, resized to fit</param>
+		/// <param name="rgb">: destination, resized to fit</param>
+		/// <returns>Successfully(?) decoded</returns>
+		bool DecodeColorViaBGRA(k4a_image_t k4a_color, open3d::geometry::Image& bgra, open3d::geometry::Image& rgb);
+
 		/// <summary>
 		/// Reaads the capture for us
 		/// </summary>
+		/// <param name="streams">: FrameStreamMask bits of the images needed, color left compressed if it is not</param>
 		/// <returns>A pointer to a single RGBD image</returns>
-		std::shared_ptr<open3d::geometry::RGBDImage> DecompressCapture();
+		std::shared_ptr<open3d::geometry::RGBDImage> DecompressCapture(int streams);
+
+		bool DecodeDeferredColor(open3d::geometry::RGBDImage& frame);
 
 	public:
 		/// <summary>
@@ -119,22 +186,39 @@ namespace MKV_Rendering {
 
 		uint64_t GetStartOffset() { return start_offset; }
 
+		/// <summary>
+		/// Extension of the timestamp index written next to each MKV
+		/// </summary>
+		static const std::string TIMESTAMP_INDEX_EXTENSION;
+
 		//See Abstract_Data for below
 
 		uint64_t GetCaptureTimestamp();
 		bool CycleCaptureForwards();
 		bool CycleCaptureBackwards();
 		bool SeekToTime(uint64_t time);
+		bool GetCaptureTimeline(std::vector<uint64_t>& timeline);
+		bool SeekToCaptureIndex(size_t capture);
+		uint64_t GetTimelineOffset() { return start_offset; }
 
 		std::shared_ptr<open3d::geometry::RGBDImage> GetFrameRGBD();
+		std::shared_ptr<open3d::geometry::RGBDImage> GetFrameStreams(int streams);
 
 		open3d::camera::PinholeCameraParameters GetParameters();
 
 		void WriteIntrinsics(std::string filename);
 
+		/// <summary>
+		/// Times decoding the current capture's color image, directly to RGB and through BGRA, and checks both give the same pixels
+		/// </summary>
+		/// <param name="iterations">: how many times to decode with each path</param>
+		void BenchmarkColorDecode(int iterations);
+
 		void PackIntoVoxelGrid(open3d::t::geometry::TSDFVoxelGrid* grid, VoxelGridData* data);
 
 		void PackIntoOldVoxelGrid(open3d::geometry::VoxelGrid* grid);
+
+		void PackIntoNewVoxelGrid(MeshingVoxelGrid* grid);
 	};
 }
 
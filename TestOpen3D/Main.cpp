@@ -5,6 +5,7 @@
 #include "VoxelGridData.h"
 #include "AdditionalUtilities.h"
 #include "NodeWrapper.h"
+#include "DepthCodec.h"
 
 #include "open3d/io/sensor/azure_kinect/K4aPlugin.h"
 #include "open3d/Open3D.h"
@@ -288,7 +289,8 @@ namespace MKV_Rendering {
     }
 
     //Currently skipping frames for some reason
-    void CreateImageArrayFromMKV(MKV_Data* data, std::string color_destination_folder, std::string depth_destination_folder, int max_output_images)
+    //Depth is written as 16 bit PNG, or with the lossless depth codec when rvl_depth is set
+    void CreateImageArrayFromMKV(MKV_Data* data, std::string color_destination_folder, std::string depth_destination_folder, int max_output_images, bool rvl_depth = false)
     {
         bool next_capture = true;
 
@@ -306,7 +308,14 @@ namespace MKV_Rendering {
             std::string timestamp = std::to_string(data->GetTimestampCached());
 
             open3d::io::WriteImageToPNG(color_destination_folder + "/color_" + num + "_" + timestamp + ".png", rgbd_image->color_);
-            open3d::io::WriteImageToPNG(depth_destination_folder + "/depth_" + num + "_" + timestamp + ".png", rgbd_image->depth_);
+            if (rvl_depth)
+            {
+                DepthCodec::WriteDepth(depth_destination_folder + "/depth_" + num + "_" + timestamp + ".rvl", rgbd_image->depth_);
+            }
+            else
+            {
+                open3d::io::WriteImageToPNG(depth_destination_folder + "/depth_" + num + "_" + timestamp + ".png", rgbd_image->depth_);
+            }
 
             next_capture = data->CycleCaptureForwards();
 
@@ -325,7 +334,7 @@ namespace MKV_Rendering {
     }
 
     void SaveMKVDataForImages(int max_output, std::string mkv_folder_path, std::string image_folder_path, 
-        std::string intrinsics_filename, std::string calibration_filename, std::string color_folder_name, std::string depth_folder_name, double FPS)
+        std::string intrinsics_filename, std::string calibration_filename, std::string color_folder_name, std::string depth_folder_name, double FPS, bool rvl_depth = false)
     {
         auto directories = GetDirectories(mkv_folder_path);
 
@@ -337,7 +346,7 @@ namespace MKV_Rendering {
 
             std::string new_dir = image_folder_path + "/FramesCam" + GetNumberFixedLength(iter, 8);
 
-            CreateImageArrayFromMKV(&data, new_dir + "/" + color_folder_name, new_dir + "/" + depth_folder_name, max_output);
+            CreateImageArrayFromMKV(&data, new_dir + "/" + color_folder_name, new_dir + "/" + depth_folder_name, max_output, rvl_depth);
             SaveJSON(&data, new_dir + "/" + intrinsics_filename);
             CopyCalibration(calibration_filename, dir, new_dir);
 
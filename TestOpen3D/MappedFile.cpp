@@ -0,0 +1,132 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MKV_Rendering::MappedFile::MappedFile()
+{
+}
+
+MKV_Rendering::MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MKV_Rendering::MappedFile::Open(std::string path)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER file_size;
+
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+	if (mapping == NULL)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+	if (view == NULL)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	file_handle = file;
+	mapping_handle = mapping;
+	data = static_cast<const uint8_t*>(view);
+	size = (size_t)file_size.QuadPart;
+#else
+	int descriptor = open(path.c_str(), O_RDONLY);
+
+	if (descriptor < 0)
+	{
+		return false;
+	}
+
+	struct stat file_stat;
+
+	if (fstat(descriptor, &file_stat) != 0 || file_stat.st_size == 0)
+	{
+		close(descriptor);
+		return false;
+	}
+
+	void* view = mmap(nullptr, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+
+	if (view == MAP_FAILED)
+	{
+		close(descriptor);
+		return false;
+	}
+
+	file_descriptor = descriptor;
+	data = static_cast<const uint8_t*>(view);
+	size = (size_t)file_stat.st_size;
+#endif
+
+	return true;
+}
+
+void MKV_Rendering::MappedFile::Close()
+{
+#ifdef _WIN32
+	if (data != nullptr)
+	{
+		UnmapViewOfFile(data);
+	}
+
+	if (mapping_handle != nullptr)
+	{
+		CloseHandle((HANDLE)mapping_handle);
+	}
+
+	if (file_handle != nullptr)
+	{
+		CloseHandle((HANDLE)file_handle);
+	}
+
+	file_handle = nullptr;
+	mapping_handle = nullptr;
+#else
+	if (data != nullptr)
+	{
+		munmap((void*)data, size);
+	}
+
+	if (file_descriptor >= 0)
+	{
+		close(file_descriptor);
+	}
+
+	file_descriptor = -1;
+#endif
+
+	data = nullptr;
+	size = 0;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace MKV_Rendering {
+
+	/// <summary>
+	/// A whole file mapped read only into memory, unmapped when destroyed
+	/// </summary>
+	class MappedFile
+	{
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+
+#ifdef _WIN32
+		void* file_handle = nullptr;
+		void* mapping_handle = nullptr;
+#else
+		int file_descriptor = -1;
+#endif
+
+	public:
+		/// <summary>
+		/// Constructor. Say hi! :D
+		/// </summary>
+		MappedFile();
+
+		//Destructor. Say goodbye! :( - unmaps the file
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		/// <summary>
+		/// Maps a file, unmapping whatever was mapped before
+		/// </summary>
+		/// <param name="path">: the file to map</param>
+		/// <returns>False if the file does not exist, is empty, or could not be mapped</returns>
+		bool Open(std::string path);
+
+		/// <summary>
+		/// Unmaps the file, safe to call when nothing is mapped
+		/// </summary>
+		void Close();
+
+		bool IsOpen() { return data != nullptr; }
+
+		const uint8_t* GetData() { return data; }
+		size_t GetSize() { return size; }
+	};
+}
@@ -0,0 +1,132 @@
+#include "MatteMask.h"
+#include "ErrorLogger.h"
+
+#include <algorithm>
+#include <cstring>
+
+MKV_Rendering::MatteMask::MatteMask()
+{
+}
+
+void MKV_Rendering::MatteMask::FromImage(open3d::geometry::Image& matte)
+{
+	width = matte.width_;
+	height = matte.height_;
+	words_per_row = (width + 63) / 64;
+
+	bits.assign((size_t)words_per_row * height, 0);
+	row_first.assign(height, width);
+	row_last.assign(height, -1);
+
+	int stride = matte.num_of_channels_ * matte.bytes_per_channel_;
+
+#pragma omp parallel for schedule(static)
+	for (int v = 0; v < height; ++v)
+	{
+		const uint8_t* row = matte.data_.data() + (size_t)v * matte.BytesPerLine();
+		uint64_t* row_bits = bits.data() + (size_t)v * words_per_row;
+
+		for (int w = 0; w < words_per_row; ++w)
+		{
+			uint64_t word = 0;
+
+			int end = std::min(64, width - w * 64);
+
+			for (int b = 0; b < end; ++b)
+			{
+				word |= (uint64_t)(row[(w * 64 + b) * stride] > 0) << b;
+			}
+
+			row_bits[w] = word;
+		}
+
+		for (int w = 0; w < words_per_row; ++w)
+		{
+			if (row_bits[w] != 0)
+			{
+				int b = 0;
+				while (!((row_bits[w] >> b) & 1ull)) ++b;
+				row_first[v] = w * 64 + b;
+				break;
+			}
+		}
+
+		for (int w = words_per_row - 1; w >= 0; --w)
+		{
+			if (row_bits[w] != 0)
+			{
+				int b = 63;
+				while (!((row_bits[w] >> b) & 1ull)) --b;
+				row_last[v] = w * 64 + b;
+				break;
+			}
+		}
+	}
+
+	min_x = width;
+	min_y = height;
+	max_x = -1;
+	max_y = -1;
+
+	for (int v = 0; v < height; ++v)
+	{
+		if (row_last[v] < 0)
+		{
+			continue;
+		}
+
+		min_x = std::min(min_x, row_first[v]);
+		max_x = std::max(max_x, row_last[v]);
+		min_y = std::min(min_y, v);
+		max_y = v;
+	}
+}
+
+void MKV_Rendering::MatteMask::ApplyToDepth(open3d::geometry::Image& depth)
+{
+	if (depth.width_ != width || depth.height_ != height || depth.bytes_per_channel_ != sizeof(uint16_t) || depth.num_of_channels_ != 1)
+	{
+		ErrorLogger::LOG_ERROR("Matte is " + std::to_string(width) + "x" + std::to_string(height) + ", depth must be a 16 bit image of the same size!");
+		return;
+	}
+
+#pragma omp parallel for schedule(static)
+	for (int v = 0; v < height; ++v)
+	{
+		uint16_t* row = reinterpret_cast<uint16_t*>(depth.data_.data()) + (size_t)v * width;
+
+		//Nothing on this row at all
+		if (row_last[v] < 0)
+		{
+			std::memset(row, 0, width * sizeof(uint16_t));
+			continue;
+		}
+
+		const uint64_t* row_bits = bits.data() + (size_t)v * words_per_row;
+
+		for (int w = 0; w < words_per_row; ++w)
+		{
+			uint64_t word = row_bits[w];
+			int start = w * 64;
+			int end = std::min(64, width - start);
+
+			if (word == 0)
+			{
+				std::memset(row + start, 0, end * sizeof(uint16_t));
+			}
+			else if (word != ~0ull)
+			{
+				for (int b = 0; b < end; ++b)
+				{
+					//All ones where the bit is set, all zeros where it is not
+					row[start + b] &= (uint16_t)(0 - (uint16_t)((word >> b) & 1ull));
+				}
+			}
+		}
+	}
+}
+
+size_t MKV_Rendering::MatteMask::GetByteSize()
+{
+	return bits.size() * sizeof(uint64_t) + (row_first.size() + row_last.size()) * sizeof(int);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "open3d/Open3D.h"
+
+#include <vector>
+#include <cstdint>
+
+namespace MKV_Rendering {
+
+	/// <summary>
+	/// A matte packed to one bit per pixel, with the extent of the subject in each row and overall,
+	/// so that empty parts of a frame can be skipped without looking at them pixel by pixel
+	/// </summary>
+	class MatteMask
+	{
+		int width = 0;
+		int height = 0;
+
+		/// <summary>
+		/// 64 bit words per row, rows start on a word
+		/// </summary>
+		int words_per_row = 0;
+
+		/// <summary>
+		/// One bit per pixel, set where the subject is, lowest bit leftmost
+		/// </summary>
+		std::vector<uint64_t> bits;
+
+		/// <summary>
+		/// First set column of each row, width if the row is empty
+		/// </summary>
+		std::vector<int> row_first;
+
+		/// <summary>
+		/// Last set column of each row, -1 if the row is empty
+		/// </summary>
+		std::vector<int> row_last;
+
+		/// <summary>
+		/// Bounding box of every set pixel, min greater than max if there are none
+		/// </summary>
+		int min_x = 0;
+		int min_y = 0;
+		int max_x = -1;
+		int max_y = -1;
+
+	public:
+		/// <summary>
+		/// Constructor. Say hi! :D
+		/// </summary>
+		MatteMask();
+
+		/// <summary>
+		/// Packs a decoded matte, a pixel is part of the subject if its first channel is not 0
+		/// </summary>
+		/// <param name="matte">: 8 bit matte image</param>
+		void FromImage(open3d::geometry::Image& matte);
+
+		/// <summary>
+		/// Zeroes depth wherever the matte is empty, a whole word or row at a time where possible
+		/// </summary>
+		/// <param name="depth">: 16 bit depth of the same size as the matte</param>
+		void ApplyToDepth(open3d::geometry::Image& depth);
+
+		bool IsSet(int u, int v) { return (bits[v * words_per_row + (u >> 6)] >> (u & 63)) & 1ull; }
+
+		bool IsEmpty() { return max_x < min_x; }
+
+		/// <summary>
+		/// Bounding box of the subject, inclusive
+		/// </summary>
+		void GetBoundingBox(int& min_u, int& min_v, int& max_u, int& max_v) { min_u = min_x; min_v = min_y; max_u = max_x; max_v = max_y; }
+
+		int GetWidth() { return width; }
+		int GetHeight() { return height; }
+
+		/// <summary>
+		/// Memory this mask takes up
+		/// </summary>
+		/// <returns>Size in bytes</returns>
+		size_t GetByteSize();
+	};
+}
@@ -1,551 +1,1735 @@
 #include "MeshingVoxelGrid.h"
-#include <queue>
+#include <chrono>
 
-MeshingVoxelGrid::MeshingVoxelGrid(double voxel_size, int voxels_x, int voxels_y, int voxels_z, Eigen::Vector3d center)
+MeshingVoxelGrid::MeshingVoxelGrid(double voxel_size, int voxels_x, int voxels_y, int voxels_z, Eigen::Vector3d center, MeshingVoxelStorage storage)
 {
 	this->voxel_size = voxel_size;
+	this->storage = storage;
 
 	size_x = voxels_x;
 	size_y = voxels_y;
 	size_z = voxels_z;
 
-	grid = new SingleVoxel[size_x * size_y * size_z];
+	origin = center - voxel_size * 0.5 * Eigen::Vector3d((double)(size_x - 1), (double)(size_y - 1), (double)(size_z - 1));
 
-	double loc_x = center.x() - voxel_size * 0.5 * (double)(size_x - 1);
-	double loc_y = center.y() - voxel_size * 0.5 * (double)(size_y - 1);
-	double loc_z = center.z() - voxel_size * 0.5 * (double)(size_z - 1);
-
-	std::cout << "Lower left bound: " << loc_x << ", " << loc_y << ", " << loc_z << std::endl;
+	std::cout << "Lower left bound: " << origin.x() << ", " << origin.y() << ", " << origin.z() << std::endl;
 
 	std::cout << "Center: " << center.x() << ", " << center.y() << ", " << center.z() << std::endl;
 
-	int grid_loc = 0;
+	bricks_x = (size_x + BRICK_SIZE - 1) / BRICK_SIZE;
+	bricks_y = (size_y + BRICK_SIZE - 1) / BRICK_SIZE;
+	bricks_z = (size_z + BRICK_SIZE - 1) / BRICK_SIZE;
 
-	double inc_loc_x = loc_x;
-	double inc_loc_y = loc_y;
-	double inc_loc_z = loc_z;
+	ResizeCarveCells(BRICK_SIZE);
 
-	for (int x = 0; x < size_x; ++x, inc_loc_x += voxel_size)
+	if (storage == MeshingVoxelStorage::DENSE)
 	{
-		inc_loc_y = loc_y;
-
-		for (int y = 0; y < size_y; ++y, inc_loc_y += voxel_size)
-		{
-			inc_loc_z = loc_z;
-
-			for (int z = 0; z < size_z; ++z, ++grid_loc, inc_loc_z += voxel_size)
-			{
-				grid[grid_loc].position = Eigen::Vector3d(inc_loc_x, inc_loc_y, inc_loc_z);
-				grid[grid_loc].color = Eigen::Vector3d((double)x / (double)size_x,(double)y / (double)size_y, (double)z / (double)size_z);
+		voxels.Resize((size_t)size_x * size_y * size_z);
 
-				grid[grid_loc].upper_bound_x = (x == size_x - 1);
-				grid[grid_loc].lower_bound_x = (x == 0);
-				grid[grid_loc].upper_bound_y = (y == size_y - 1);
-				grid[grid_loc].lower_bound_y = (y == 0);
-				grid[grid_loc].upper_bound_z = (z == size_z - 1);
-				grid[grid_loc].lower_bound_z = (z == 0);
-			}
-		}
+		ForEachVoxel([this](size_t voxel, int x, int y, int z) { InitializeVoxel(voxel, x, y, z); });
 	}
 
-	inc_loc_x -= voxel_size;
-	inc_loc_y -= voxel_size;
-	inc_loc_z -= voxel_size;
+	Eigen::Vector3d upper = GetPosition(size_x - 1, size_y - 1, size_z - 1);
 
-	std::cout << "Upper right bound: " << inc_loc_x << ", " << inc_loc_y << ", " << inc_loc_z << std::endl;
+	std::cout << "Upper right bound: " << upper.x() << ", " << upper.y() << ", " << upper.z() << std::endl;
 }
 
 MeshingVoxelGrid::~MeshingVoxelGrid()
 {
-	delete[] grid;
 }
 
-void MeshingVoxelGrid::AddImage(open3d::geometry::Image& color, open3d::geometry::Image& depth, Eigen::Matrix4d extrinsics, Eigen::Matrix3d intrinsics)
+void MeshingVoxelGrid::InitializeVoxel(size_t voxel, int x, int y, int z)
 {
-	auto depth_float = depth.ConvertDepthToFloatImage();
+	voxels.SetType(voxel, MeshingVoxelType::NONE);
+	voxels.SetValue(voxel, 0.0);
+	voxels.SetWeight(voxel, 0.0);
+	voxels.SetColor(voxel, Eigen::Vector3d((double)x / (double)size_x, (double)y / (double)size_y, (double)z / (double)size_z));
+}
 
-	int culled = 0;
-	int solid = 0;
-	int air = 0;
+size_t MeshingVoxelGrid::FindVoxel(int x, int y, int z)
+{
+	if (storage == MeshingVoxelStorage::DENSE)
+	{
+		return (size_t)DenseIndex(x, y, z);
+	}
+
+	auto slot = brick_slots.find(BrickIndex(x / BRICK_SIZE, y / BRICK_SIZE, z / BRICK_SIZE));
 
-	int grid_loc = 0;
+	if (slot == brick_slots.end())
+	{
+		return NO_VOXEL;
+	}
+
+	int local = ((x % BRICK_SIZE) * BRICK_SIZE + (y % BRICK_SIZE)) * BRICK_SIZE + (z % BRICK_SIZE);
+
+	return (size_t)slot->second * BRICK_VOXELS + local;
+}
+
+SingleVoxel MeshingVoxelGrid::GetVoxel(int x, int y, int z)
+{
+	SingleVoxel voxel;
 
-	Eigen::Matrix3d rotation = extrinsics.block<3, 3>(0, 0);
-	Eigen::Vector3d position = extrinsics.block<3, 1>(0, 3);
+	voxel.position = GetPosition(x, y, z);
 
-	Eigen::Matrix3d rotation_inv = rotation.inverse();
+	voxel.upper_bound_x = (x == size_x - 1);
+	voxel.lower_bound_x = (x == 0);
+	voxel.upper_bound_y = (y == size_y - 1);
+	voxel.lower_bound_y = (y == 0);
+	voxel.upper_bound_z = (z == size_z - 1);
+	voxel.lower_bound_z = (z == 0);
 
-	Eigen::Matrix3d intrinsic_inv = intrinsics.inverse();
+	size_t found = FindVoxel(x, y, z);
 
-	for (int x = 0; x < size_x; ++x)
+	//Pixel driven grids only work out voxels some band reached, the rest are as their carve cell was carved
+	if (IsWorkedOut(found))
 	{
-		for (int y = 0; y < size_y; ++y)
-		{
-			for (int z = 0; z < size_z; ++z, ++grid_loc)
-			{
-				auto voxel = &grid[grid_loc];
+		voxels.Unpack(found, voxel);
+		return voxel;
+	}
 
-				Eigen::Vector3d uvz = intrinsics *
-					(rotation * voxel->position + position);
+	voxel.color = Eigen::Vector3d((double)x / (double)size_x, (double)y / (double)size_y, (double)z / (double)size_z);
 
-				double pix_u = uvz.x() / (uvz.z());
-				double pix_v = uvz.y() / (uvz.z());
+	//Voxels nothing worked out are away from the surface, so the center of the cell around them is on the same side of it
+	voxel.voxel_type = carve_cells.GetType(CarveIndex(x, y, z));
+	voxel.value = (voxel.voxel_type == MeshingVoxelType::NONE) ? 0.0 : 1.0;
 
-				double pixel_depth = 0;
-				bool in_bounds;
-				std::tie(in_bounds, pixel_depth) = depth_float->FloatValueAt(pix_u, pix_v);
+	return voxel;
+}
 
-				if (!in_bounds)
-				{
-					++culled;
-					continue;
-				}
+MeshingCameraImage MeshingVoxelGrid::PrepareImage(open3d::geometry::Image& color, open3d::geometry::Image& depth, Eigen::Matrix4d extrinsics, Eigen::Matrix3d intrinsics, bool keep_color)
+{
+	MeshingCameraImage image;
 
-				int int_x = std::clamp((int)(pix_u * color.width_), 0, color.width_ - 1);
-				int int_y = std::clamp((int)(pix_v * color.height_), 0, color.height_ - 1);
-				
-				//auto color_r = *color.PointerAt<uint8_t>(int_x, int_y, 0);
-				//auto color_g = *color.PointerAt<uint8_t>(int_x, int_y, 1);
-				//auto color_b = *color.PointerAt<uint8_t>(int_x, int_y, 2);
+	image.depth = depth.ConvertDepthToFloatImage();
 
-				auto color_r = *color.PointerAt<uint8_t>(pix_u, pix_v, 0);
-				auto color_g = *color.PointerAt<uint8_t>(pix_u, pix_v, 1);
-				auto color_b = *color.PointerAt<uint8_t>(pix_u, pix_v, 2);
+	if (keep_color && !geometry_only && !color.IsEmpty())
+	{
+		image.color = std::make_shared<open3d::geometry::Image>(color);
+	}
 
-				Eigen::Vector3d pixel_position = rotation_inv * (intrinsic_inv * Eigen::Vector3d(uvz.x(), uvz.y(), pixel_depth) - position);
+	image.rotation = extrinsics.block<3, 3>(0, 0);
+	image.position = extrinsics.block<3, 1>(0, 3);
 
-				Eigen::Vector3d dist = (pixel_position - voxel->position);
-				double mag = std::min(sqrt(dist.dot(dist)) / voxel_size, 1.0);
+	image.rotation_inv = image.rotation.inverse();
 
-				//AIR
-				if (pixel_depth > uvz.z() || pixel_depth == 0)
-				{
+	image.intrinsics = intrinsics;
+	image.intrinsic_inv = intrinsics.inverse();
 
-					if (voxel->voxel_type == MeshingVoxelType::SOLID)
-					{
-						voxel->voxel_type = MeshingVoxelType::AIR;
-						voxel->value = std::min(mag, 1.0);
-					}
-					else if (voxel->voxel_type == MeshingVoxelType::AIR)
-					{
-						voxel->value = std::max(voxel->value, mag);
-					}
-					else
-					{
-						voxel->voxel_type = MeshingVoxelType::AIR;
-						voxel->value = std::max(voxel->value, mag);
-					}
+	Eigen::Matrix3d projection = intrinsics * image.rotation;
 
-					++air;
-				}
-				//SOLID
-				else
-				{
-					if (voxel->voxel_type == MeshingVoxelType::SOLID)
-					{
-						if (voxel->value > mag)
-						{
-							voxel->value = mag;
-							voxel->color = Eigen::Vector3d((double)color_r / 255.0, (double)color_g / 255.0, (double)color_b / 255.0);
-						}
+	image.projected_origin = projection * origin + intrinsics * image.position;
+	image.projected_step_x = projection.col(0) * voxel_size;
+	image.projected_step_y = projection.col(1) * voxel_size;
+	image.projected_step_z = projection.col(2) * voxel_size;
 
-						++solid;
-					}
-					else if (voxel->voxel_type == MeshingVoxelType::AIR)
-					{
+	//A voxel and the point the camera sees along its ray differ only in depth, by (0, 0, depth difference) in camera space
+	image.depth_to_voxels = (image.rotation_inv * image.intrinsic_inv * Eigen::Vector3d(0, 0, 1)).norm() / voxel_size;
 
-					}
-					else
-					{
-						voxel->voxel_type = MeshingVoxelType::SOLID;
-						voxel->color = Eigen::Vector3d((double)color_r / 255.0, (double)color_g / 255.0, (double)color_b / 255.0);
+	return image;
+}
 
-						//std::cout << voxel->color.x() << ", " << voxel->color.y() << ", " << voxel->color.z() << ", " << int_x << ", " << int_y << std::endl;
+void MeshingVoxelGrid::IntegrateVoxel(MeshingVoxelArrays& arrays, size_t voxel, const Eigen::Vector3d& voxel_position, const MeshingCameraImage& image, const open3d::geometry::Image* color, int& culled, int& solid, int& air)
+{
+	Eigen::Vector3d uvz = image.intrinsics *
+		(image.rotation * voxel_position + image.position);
 
-						voxel->value = std::min(mag, 1.0);
-						
-						++solid;
-					}
-				}
-			}
-		}
+	double pix_u = uvz.x() / (uvz.z());
+	double pix_v = uvz.y() / (uvz.z());
+
+	double pixel_depth = 0;
+	bool in_bounds;
+	std::tie(in_bounds, pixel_depth) = image.depth->FloatValueAt(pix_u, pix_v);
+
+	if (!in_bounds)
+	{
+		++culled;
+		return;
+	}
+
+	uint8_t color_r = 0;
+	uint8_t color_g = 0;
+	uint8_t color_b = 0;
+
+	if (color != nullptr)
+	{
+		color_r = *color->PointerAt<uint8_t>(pix_u, pix_v, 0);
+		color_g = *color->PointerAt<uint8_t>(pix_u, pix_v, 1);
+		color_b = *color->PointerAt<uint8_t>(pix_u, pix_v, 2);
 	}
 
-	std::cout << "culled voxels: " << culled << "/" << (size_x * size_y * size_z) << std::endl;
-	std::cout << "solid voxels: " << solid << "/" << (size_x * size_y * size_z) << std::endl;
-	std::cout << "air voxels: " << air << "/" << (size_x * size_y * size_z) << std::endl;
+	Eigen::Vector3d pixel_position = image.rotation_inv * (image.intrinsic_inv * Eigen::Vector3d(uvz.x(), uvz.y(), pixel_depth) - image.position);
+
+	Eigen::Vector3d dist = (pixel_position - voxel_position);
+	double mag = std::min(sqrt(dist.dot(dist)) / voxel_size, 1.0);
+
+	uint8_t rgb[3] = { color_r, color_g, color_b };
+
+	ApplyVerdict(arrays, voxel, pixel_depth > uvz.z() || pixel_depth == 0, mag, (color != nullptr) ? rgb : nullptr, solid, air);
 }
 
-void MeshingVoxelGrid::KillEmptySpace()
+void MeshingVoxelGrid::ApplyVerdict(MeshingVoxelArrays& arrays, size_t voxel, bool is_air, double mag, const uint8_t* rgb, int& solid, int& air)
 {
-	int empty_voxels = 0;
-	int filled_solid = 0;
-	int filled_air = 0;
-
-	int grid_loc = 0;
+	MeshingVoxelType voxel_type = arrays.GetType(voxel);
+	double value = arrays.GetValue(voxel);
 
-	int vote_solid = 0;
+	//AIR
+	if (is_air)
+	{
 
-	int step_x = size_z * size_y;
-	int step_y = size_z;
-	int step_z = 1;
+		if (voxel_type == MeshingVoxelType::SOLID)
+		{
+			arrays.SetType(voxel, MeshingVoxelType::AIR);
+			arrays.SetValue(voxel, std::min(mag, 1.0));
+		}
+		else if (voxel_type == MeshingVoxelType::AIR)
+		{
+			arrays.SetValue(voxel, std::max(value, mag));
+		}
+		else
+		{
+			arrays.SetType(voxel, MeshingVoxelType::AIR);
+			arrays.SetValue(voxel, std::max(value, mag));
+		}
 
-	for (int x = 0; x < size_x; ++x)
+		++air;
+	}
+	//SOLID
+	else
 	{
-		for (int y = 0; y < size_y; ++y)
+		if (voxel_type == MeshingVoxelType::SOLID)
 		{
-			for (int z = 0; z < size_z; ++z, ++grid_loc)
+			if (value > mag)
 			{
-				if (grid[grid_loc].voxel_type != MeshingVoxelType::NONE)
+				arrays.SetValue(voxel, mag);
+
+				if (rgb != nullptr)
 				{
-					continue;
+					arrays.SetColor(voxel, rgb[0], rgb[1], rgb[2]);
 				}
+			}
 
-				++empty_voxels;
-
-				vote_solid += (grid[grid_loc + step_x * (!grid[grid_loc].upper_bound_x)].value == MeshingVoxelType::SOLID);
-				vote_solid += (grid[grid_loc - step_x * (!grid[grid_loc].lower_bound_x)].value == MeshingVoxelType::SOLID);
-				vote_solid += (grid[grid_loc + step_y * (!grid[grid_loc].upper_bound_y)].value == MeshingVoxelType::SOLID);
-				vote_solid += (grid[grid_loc - step_y * (!grid[grid_loc].lower_bound_y)].value == MeshingVoxelType::SOLID);
-				vote_solid += (grid[grid_loc + step_z * (!grid[grid_loc].upper_bound_z)].value == MeshingVoxelType::SOLID);
-				vote_solid += (grid[grid_loc - step_z * (!grid[grid_loc].lower_bound_z)].value == MeshingVoxelType::SOLID);
+			++solid;
+		}
+		else if (voxel_type == MeshingVoxelType::AIR)
+		{
 
-				if (vote_solid >= 3)
-				{
-					grid[grid_loc].voxel_type = MeshingVoxelType::SOLID;
-					grid[grid_loc].value = (double)vote_solid / 6.0;
+		}
+		else
+		{
+			arrays.SetType(voxel, MeshingVoxelType::SOLID);
 
-					++filled_solid;
-				}
-				else
-				{
-					grid[grid_loc].voxel_type = MeshingVoxelType::AIR;
-					
-					++filled_air;
-				}
+			if (rgb != nullptr)
+			{
+				arrays.SetColor(voxel, rgb[0], rgb[1], rgb[2]);
 			}
+
+			arrays.SetValue(voxel, std::min(mag, 1.0));
+			
+			++solid;
 		}
 	}
-
-	std::cout << empty_voxels << " empty voxels found: filled " << filled_solid << " solid, filled " << filled_air << " air" << std::endl;
 }
 
-std::shared_ptr<open3d::geometry::TriangleMesh> MeshingVoxelGrid::ExtractMesh()
+void MeshingVoxelGrid::IntegrateRun(size_t first_voxel, int x, int y, int z, int count, const MeshingCameraImage& image, const open3d::geometry::Image* color, int& culled, int& solid, int& air)
 {
-	//KillEmptySpace();
+	auto& depth = *image.depth;
 
-	auto to_return = std::make_shared<open3d::geometry::TriangleMesh>();
+	const float* depth_data = (const float*)depth.data_.data();
 
-	int grid_loc = 0;
-	int solid_voxels = 0;
+	float max_u = (float)(depth.width_ - 1);
+	float max_v = (float)(depth.height_ - 1);
+
+	Eigen::Vector3d row = image.projected_origin + (double)x * image.projected_step_x + (double)y * image.projected_step_y;
+	Eigen::Vector3f step = image.projected_step_z.cast<float>();
+
+	float lane_u[KERNEL_LANES];
+	float lane_v[KERNEL_LANES];
+	float lane_z[KERNEL_LANES];
 
-	for (int x = 0; x < size_x; ++x)
+	for (int chunk = 0; chunk < count; chunk += KERNEL_LANES)
 	{
-		for (int y = 0; y < size_y; ++y)
+		int lanes = std::min(KERNEL_LANES, count - chunk);
+
+		//Voxels along z step through the projection by a constant amount, so only the start of each chunk is projected in full
+		Eigen::Vector3f start = (row + (double)(z + chunk) * image.projected_step_z).cast<float>();
+
+#pragma omp simd
+		for (int k = 0; k < lanes; ++k)
+		{
+			float projected_z = start.z() + k * step.z();
+
+			lane_u[k] = (start.x() + k * step.x()) / projected_z;
+			lane_v[k] = (start.y() + k * step.y()) / projected_z;
+			lane_z[k] = projected_z;
+		}
+
+		for (int k = 0; k < lanes; ++k)
 		{
-			for (int z = 0; z < size_z; ++z, ++grid_loc)
+			size_t voxel = first_voxel + chunk + k;
+
+			float u = lane_u[k];
+			float v = lane_v[k];
+
+			//Same bounds as FloatValueAt, anything too close to call goes the exact way
+			bool outside = u < -KERNEL_PIXEL_MARGIN || u > max_u + KERNEL_PIXEL_MARGIN || v < -KERNEL_PIXEL_MARGIN || v > max_v + KERNEL_PIXEL_MARGIN;
+
+			if (outside)
+			{
+				++culled;
+				continue;
+			}
+
+			bool inside = u >= KERNEL_PIXEL_MARGIN && u <= max_u - KERNEL_PIXEL_MARGIN && v >= KERNEL_PIXEL_MARGIN && v <= max_v - KERNEL_PIXEL_MARGIN;
+
+			if (!inside)
+			{
+				IntegrateVoxel(voxels, voxel, GetPosition(x, y, z + chunk + k), image, color, culled, solid, air);
+				continue;
+			}
+
+			int pixel_u = (int)u;
+			int pixel_v = (int)v;
+
+			//Color is read at the truncated pixel, which floats could put a pixel off
+			bool color_ambiguous = color != nullptr &&
+				(u - pixel_u < KERNEL_PIXEL_MARGIN || u - pixel_u > 1 - KERNEL_PIXEL_MARGIN ||
+				v - pixel_v < KERNEL_PIXEL_MARGIN || v - pixel_v > 1 - KERNEL_PIXEL_MARGIN);
+
+			if (color_ambiguous)
+			{
+				IntegrateVoxel(voxels, voxel, GetPosition(x, y, z + chunk + k), image, color, culled, solid, air);
+				continue;
+			}
+
+			//Bilinear sample as FloatValueAt takes it
+			int ui = std::min(pixel_u, depth.width_ - 2);
+			int vi = std::min(pixel_v, depth.height_ - 2);
+
+			float pu = u - ui;
+			float pv = v - vi;
+
+			const float* taps = depth_data + (size_t)vi * depth.width_ + ui;
+
+			float tap_00 = taps[0];
+			float tap_01 = taps[depth.width_];
+			float tap_10 = taps[1];
+			float tap_11 = taps[depth.width_ + 1];
+
+			bool all_empty = tap_00 == 0 && tap_01 == 0 && tap_10 == 0 && tap_11 == 0;
+			bool any_empty = tap_00 == 0 || tap_01 == 0 || tap_10 == 0 || tap_11 == 0;
+
+			float pixel_depth = (tap_00 * (1 - pv) + tap_01 * pv) * (1 - pu) + (tap_10 * (1 - pv) + tap_11 * pv) * pu;
+
+			//Next to a hole the exact sample may or may not be 0, and next to the surface the comparison is too close to call
+			if ((any_empty && !all_empty) || (!all_empty && std::abs(pixel_depth - lane_z[k]) < KERNEL_DEPTH_MARGIN))
 			{
-				solid_voxels += (grid[grid_loc].voxel_type == MeshingVoxelType::SOLID);
+				IntegrateVoxel(voxels, voxel, GetPosition(x, y, z + chunk + k), image, color, culled, solid, air);
+				continue;
 			}
+
+			bool is_air = all_empty || pixel_depth > lane_z[k];
+			double mag = std::min((double)std::abs((all_empty ? 0.0f : pixel_depth) - lane_z[k]) * image.depth_to_voxels, 1.0);
+
+			const uint8_t* rgb = (color != nullptr) ? color->PointerAt<uint8_t>(pixel_u, pixel_v, 0) : nullptr;
+
+			ApplyVerdict(voxels, voxel, is_air, mag, rgb, solid, air);
 		}
 	}
+}
 
-	std::cout << "Solid voxels total: " << solid_voxels << "/" << (size_x * size_y * size_z) << std::endl;
+void MeshingVoxelGrid::IntegrateSlots(const std::vector<int>& slots, const MeshingCameraImage& image, const open3d::geometry::Image* color, int& culled, int& solid, int& air)
+{
+	int slots_culled = 0;
+	int slots_solid = 0;
+	int slots_air = 0;
 
-	int index_count = 0;
+#pragma omp parallel for schedule(static) reduction(+:slots_culled, slots_solid, slots_air)
+	for (int i = 0; i < (int)slots.size(); ++i)
+	{
+		int slot = slots[i];
+		int brick = slot_bricks[slot];
 
-	int corners[8];
-	MeshingVoxelEdge edges[12];
+		int start_x = (brick / (bricks_z * bricks_y)) * BRICK_SIZE;
+		int start_y = ((brick / bricks_z) % bricks_y) * BRICK_SIZE;
+		int start_z = (brick % bricks_z) * BRICK_SIZE;
 
-	int step_x = size_z * size_y;
-	int step_y = size_z;
-	int step_z = 1;
+		int run = std::min(BRICK_SIZE, size_z - start_z);
 
-	SingleVoxel corner_voxels[8];
+		for (int local_x = 0; local_x < BRICK_SIZE && start_x + local_x < size_x; ++local_x)
+		{
+			for (int local_y = 0; local_y < BRICK_SIZE && start_y + local_y < size_y; ++local_y)
+			{
+				size_t first_voxel = (size_t)slot * BRICK_VOXELS + (local_x * BRICK_SIZE + local_y) * BRICK_SIZE;
 
-	int no_triangles = 0;
+				IntegrateRun(first_voxel, start_x + local_x, start_y + local_y, start_z, run, image, color, slots_culled, slots_solid, slots_air);
+			}
+		}
+	}
 
-	for (int x = 0; x < size_x - 1; ++x)
-	{
-		for (int y = 0; y < size_y - 1; ++y)
-		{
-			for (int z = 0; z < size_z - 1; ++z)
-			{
-				//The corners of the grid
-				corners[0] = z * step_z + y * step_y + x * step_x;
-				corners[4] = corners[0] + step_z;
-				corners[2] = corners[0] + step_y;
-				corners[6] = corners[2] + step_z;
-				corners[1] = corners[0] + step_x;
-				corners[5] = corners[1] + step_z;
-				corners[3] = corners[1] + step_y;
-				corners[7] = corners[3] + step_z;
-
-				corner_voxels[0] = grid[corners[0]];
-				corner_voxels[4] = grid[corners[4]];
-				corner_voxels[2] = grid[corners[2]];
-				corner_voxels[6] = grid[corners[6]];
-				corner_voxels[1] = grid[corners[1]];
-				corner_voxels[5] = grid[corners[5]];
-				corner_voxels[3] = grid[corners[3]];
-				corner_voxels[7] = grid[corners[7]];
-
-				//Testing which edges will be produced
-				int index = 0;
-
-				index |= 1 *	(corner_voxels[0].voxel_type == MeshingVoxelType::SOLID);
-				index |= 2 *	(corner_voxels[1].voxel_type == MeshingVoxelType::SOLID);
-				index |= 8 *	(corner_voxels[2].voxel_type == MeshingVoxelType::SOLID);
-				index |= 4 *	(corner_voxels[3].voxel_type == MeshingVoxelType::SOLID);
-				index |= 16 *	(corner_voxels[4].voxel_type == MeshingVoxelType::SOLID);
-				index |= 32 *	(corner_voxels[5].voxel_type == MeshingVoxelType::SOLID);
-				index |= 128 *	(corner_voxels[6].voxel_type == MeshingVoxelType::SOLID);
-				index |= 64 *	(corner_voxels[7].voxel_type == MeshingVoxelType::SOLID);
-
-				index = 255 - index;
-
-				if (edge_table[index] == 0)
-				{
-					++no_triangles;
-					continue;
-				}
+	culled += slots_culled;
+	solid += slots_solid;
+	air += slots_air;
+}
 
-				//Interpolating edges
-				if ((edge_table[index] & 1) > 0)
-					edges[0] = LerpCorner(corner_voxels, 0, 1);
-				if ((edge_table[index] & 2) > 0)
-					edges[1] = LerpCorner(corner_voxels, 1, 3);
-				if ((edge_table[index] & 4) > 0)
-					edges[2] = LerpCorner(corner_voxels, 3, 2);
-				if ((edge_table[index] & 8) > 0)
-					edges[3] = LerpCorner(corner_voxels, 2, 0);
-				if ((edge_table[index] & 16) > 0)
-					edges[4] = LerpCorner(corner_voxels, 4, 5);
-				if ((edge_table[index] & 32) > 0)
-					edges[5] = LerpCorner(corner_voxels, 5, 7);
-				if ((edge_table[index] & 64) > 0)
-					edges[6] = LerpCorner(corner_voxels, 7, 6);
-				if ((edge_table[index] & 128) > 0)
-					edges[7] = LerpCorner(corner_voxels, 6, 4);
-				if ((edge_table[index] & 256) > 0)
-					edges[8] = LerpCorner(corner_voxels, 0, 4);
-				if ((edge_table[index] & 512) > 0)
-					edges[9] = LerpCorner(corner_voxels, 1, 5);
-				if ((edge_table[index] & 1024) > 0)
-					edges[10] = LerpCorner(corner_voxels, 3, 7);
-				if ((edge_table[index] & 2048) > 0)
-					edges[11] = LerpCorner(corner_voxels, 2, 6);
-
-				auto tri_table_seg = tri_table[index];
-
-				//Adding triangles to the mesh
-				for (int i = 0; tri_table_seg[i] != -1; i += 3, index_count += 3)
-				{
-					auto p0 = edges[tri_table_seg[i]].position;
-					auto p1 = edges[tri_table_seg[i + 1]].position;
-					auto p2 = edges[tri_table_seg[i + 2]].position;
+std::vector<int> MeshingVoxelGrid::AllocateBricksAroundDepth(const MeshingCameraImage& image)
+{
+	std::vector<int> new_slots;
+
+	auto& depth = *image.depth;
+
+	for (int v = 0; v < depth.height_; ++v)
+	{
+		for (int u = 0; u < depth.width_; ++u)
+		{
+			double pixel_depth = *depth.PointerAt<float>(u, v);
+
+			if (pixel_depth <= 0)
+			{
+				continue;
+			}
+
+			Eigen::Vector3d world = image.rotation_inv * (image.intrinsic_inv * Eigen::Vector3d(u * pixel_depth, v * pixel_depth, pixel_depth) - image.position);
+			Eigen::Vector3d voxel_coords = (world - origin) / voxel_size;
 
-					Eigen::Vector3d normal = (p1 - p0).cross(p1 - p2);
+			int lower[3];
+			int upper[3];
+			int sizes[3] = { size_x, size_y, size_z };
+			bool outside = false;
 
-					to_return->vertices_.push_back(p0);
-					to_return->vertex_colors_.push_back(edges[tri_table_seg[i]].color);
+			for (int i = 0; i < 3; ++i)
+			{
+				lower[i] = std::max(0, (int)std::floor(voxel_coords[i]) - BRICK_BAND);
+				upper[i] = std::min(sizes[i] - 1, (int)std::ceil(voxel_coords[i]) + BRICK_BAND);
 
-					to_return->vertices_.push_back(p1);
-					to_return->vertex_colors_.push_back(edges[tri_table_seg[i + 1]].color);
+				outside |= (lower[i] > upper[i]);
+			}
 
-					to_return->vertices_.push_back(p2);
-					to_return->vertex_colors_.push_back(edges[tri_table_seg[i + 2]].color);
+			if (outside)
+			{
+				continue;
+			}
 
-					to_return->triangles_.push_back(
-						Eigen::Vector3i(index_count, index_count + 1, index_count + 2)
-					);
+			for (int brick_x = lower[0] / BRICK_SIZE; brick_x <= upper[0] / BRICK_SIZE; ++brick_x)
+			{
+				for (int brick_y = lower[1] / BRICK_SIZE; brick_y <= upper[1] / BRICK_SIZE; ++brick_y)
+				{
+					for (int brick_z = lower[2] / BRICK_SIZE; brick_z <= upper[2] / BRICK_SIZE; ++brick_z)
+					{
+						int brick = BrickIndex(brick_x, brick_y, brick_z);
 
-					Eigen::Vector3d color = normal.normalized() * 0.5 + Eigen::Vector3d(0.5, 0.5, 0.5);
+						if (brick_slots.find(brick) != brick_slots.end())
+						{
+							continue;
+						}
 
-					//to_return->vertex_colors_.push_back(color);
-					//to_return->vertex_colors_.push_back(color);
-					//to_return->vertex_colors_.push_back(color);
+						new_slots.push_back(AllocateBrick(brick));
+					}
 				}
 			}
 		}
 	}
 
-	std::cout << "Mesh vertices: " << to_return->vertices_.size() << std::endl;
-	std::cout << "Voxels without triangles: " << no_triangles << "/" << ((size_x - 1) * (size_y - 1) * (size_z - 1)) << std::endl;
-
-	return to_return;
+	return new_slots;
 }
 
-MeshingVoxelEdge MeshingVoxelGrid::LerpCorner(SingleVoxel* voxel_array, int elem1, int elem2)
+int MeshingVoxelGrid::AllocateBrick(int brick)
 {
-	double t = voxel_array[elem1].value / (voxel_array[elem1].value + voxel_array[elem2].value);
+	int slot = slot_bricks.size();
 
-	double total = 0;
+	brick_slots[brick] = slot;
+	slot_bricks.push_back(brick);
 
-	bool first_solid = (voxel_array[elem1].voxel_type == MeshingVoxelType::SOLID) * (1.0 - t);
-	bool second_solid = (voxel_array[elem2].voxel_type == MeshingVoxelType::SOLID) * t;
+	voxels.Resize(slot_bricks.size() * BRICK_VOXELS);
 
-	Eigen::Vector3d final_color = 
-		(first_solid * voxel_array[elem1].color + second_solid * voxel_array[elem2].color) / (first_solid + second_solid);
+	int start_x = (brick / (bricks_z * bricks_y)) * BRICK_SIZE;
+	int start_y = ((brick / bricks_z) % bricks_y) * BRICK_SIZE;
+	int start_z = (brick % bricks_z) * BRICK_SIZE;
 
-	//return MeshingVoxelEdge(
-	//	voxel_array[elem1].position * (1.0 - t) + voxel_array[elem2].position * t,
-	//	voxel_array[elem1].color * (1.0 - t) + voxel_array[elem2].color * t
-	//	);
+	for (int local = 0; local < BRICK_VOXELS; ++local)
+	{
+		InitializeVoxel((size_t)slot * BRICK_VOXELS + local,
+			start_x + local / (BRICK_SIZE * BRICK_SIZE), start_y + (local / BRICK_SIZE) % BRICK_SIZE, start_z + local % BRICK_SIZE);
+	}
 
-	return MeshingVoxelEdge(
-		voxel_array[elem1].position * (1.0 - t) + voxel_array[elem2].position * t,
-		final_color
-		);
+	return slot;
 }
 
-void MeshingVoxelGrid::CullArtifacts(int artifact_size)
+Eigen::Vector3i MeshingVoxelGrid::GetVoxelCoordinates(size_t voxel)
 {
-	if (artifact_size <= 0)
+	if (storage == MeshingVoxelStorage::DENSE)
 	{
-		return;
+		return Eigen::Vector3i((int)(voxel / ((size_t)size_y * size_z)), (int)((voxel / size_z) % size_y), (int)(voxel % size_z));
 	}
 
-	int grid_loc = 0;
-	int current = 0;
-	int limit = 0;
-	
-	int step_x = size_z * size_y;
-	int step_y = size_z;
-	int step_z = 1;
+	int brick = slot_bricks[voxel / BRICK_VOXELS];
+	int local = voxel % BRICK_VOXELS;
 
-	int x_lower = 0;
-	int x_upper = 0;
-
-	int y_lower = 0;
-	int y_upper = 0;
+	return Eigen::Vector3i(
+		(brick / (bricks_z * bricks_y)) * BRICK_SIZE + local / (BRICK_SIZE * BRICK_SIZE),
+		((brick / bricks_z) % bricks_y) * BRICK_SIZE + (local / BRICK_SIZE) % BRICK_SIZE,
+		(brick % bricks_z) * BRICK_SIZE + local % BRICK_SIZE);
+}
 
-	int z_lower = 0;
-	int z_upper = 0;
+size_t MeshingVoxelGrid::MarchBands(const MeshingCameraImage& image)
+{
+	size_t first_new = band_voxels.size();
 
-	bool cull_artifacts_harsh = true;
+	auto& depth = *image.depth;
 
-	int culled = 0;
+	//A point seen at depth d along pixel (u, v) is at camera_center + d * unprojection * (u, v, 1)
+	Eigen::Matrix3d unprojection = image.rotation_inv * image.intrinsic_inv;
+	Eigen::Vector3d camera_center = -(image.rotation_inv * image.position);
 
-	std::queue<int> to_check;
-	std::queue<int> marked;
+	//Width of a pixel per meter of depth
+	double pixel_width = 1.0 / std::min(image.intrinsics(0, 0), image.intrinsics(1, 1));
 
-	for (int x = 0; x < size_x; ++x)
+	for (int v = 0; v < depth.height_; ++v)
 	{
-		for (int y = 0; y < size_y; ++y)
+		for (int u = 0; u < depth.width_; ++u)
 		{
-			for (int z = 0; z < size_z; ++z, ++grid_loc)
-			{
-				limit = artifact_size;
+			double pixel_depth = *depth.PointerAt<float>(u, v);
 
-				to_check.push(grid_loc);
+			if (pixel_depth <= 0)
+			{
+				continue;
+			}
 
-				while (!to_check.empty() && limit >= 0)
-				{
-					current = to_check.front();
-					to_check.pop();
+			Eigen::Vector3d ray = unprojection * Eigen::Vector3d(u, v, 1);
+			double ray_length = ray.norm();
 
-					if (grid[current].mark_for_cull || grid[current].voxel_type != MeshingVoxelType::SOLID) {
-						continue;
-					}
+			//The band and the steps through it are in meters along the ray, half a voxel apart so no voxel is stepped over
+			double depth_band = band_voxels_wide * voxel_size / ray_length;
+			double depth_step = 0.5 * voxel_size / ray_length;
 
-					grid[current].mark_for_cull = true;
-					marked.push(current);
+			//Voxels much smaller than the pixel are covered across its width too
+			int splat = std::min(MAX_BAND_SPLAT, std::max(0, (int)std::ceil(0.5 * pixel_depth * pixel_width / voxel_size - 0.5)));
 
-					--limit;
+			for (double d = pixel_depth - depth_band; d <= pixel_depth + depth_band; d += depth_step)
+			{
+				Eigen::Vector3d coords = (camera_center + d * ray - origin) / voxel_size;
 
-					int z_1 = (current / step_z) % size_z;
-					int y_1 = (current / step_y) % size_y;
-					int x_1 = (current / step_x) % size_x;
+				int center_x = (int)std::lround(coords.x());
+				int center_y = (int)std::lround(coords.y());
+				int center_z = (int)std::lround(coords.z());
 
-					if (cull_artifacts_harsh)
+				for (int x = std::max(center_x - splat, 0); x <= std::min(center_x + splat, size_x - 1); ++x)
+				{
+					for (int y = std::max(center_y - splat, 0); y <= std::min(center_y + splat, size_y - 1); ++y)
 					{
-						if (x_1 > 0)
-						{
-							to_check.push((x_1 - 1) * step_x + y_1 * step_y + z_1 * step_z);
-						}
-						if (x_1 < size_x - 1)
-						{
-							to_check.push((x_1 + 1) * step_x + y_1 * step_y + z_1 * step_z);
-						}
-
-						if (y_1 > 0)
-						{
-							to_check.push(x_1 * step_x + (y_1 - 1) * step_y + z_1 * step_z);
-						}
-						if (y_1 < size_y - 1)
+						for (int z = std::max(center_z - splat, 0); z <= std::min(center_z + splat, size_z - 1); ++z)
 						{
-							to_check.push(x_1 * step_x + (y_1 + 1) * step_y + z_1 * step_z);
-						}
-
-						if (z_1 > 0)
-						{
-							to_check.push(x_1 * step_x + y_1 * step_y + (z_1 - 1) * step_z);
-						}
-						if (z_1 < size_z - 1)
-						{
-							to_check.push(x_1 * step_x + y_1 * step_y + (z_1 + 1) * step_z);
-						}
-					}
-					else
-					{
-						x_lower = std::max(0, x_1 - 1) * step_x;
-						x_upper = std::min(size_x, x_1 + 2) * step_x;
+							size_t voxel = FindVoxel(x, y, z);
 
-						y_lower = std::max(0, y_1 - 1) * step_y;
-						y_upper = std::min(size_y, y_1 + 2) * step_y;
+							if (voxel == NO_VOXEL)
+							{
+								AllocateBrick(BrickIndex(x / BRICK_SIZE, y / BRICK_SIZE, z / BRICK_SIZE));
 
-						z_lower = std::max(0, z_1 - 1) * step_z;
-						z_upper = std::min(size_z, z_1 + 2) * step_z;
+								voxel = FindVoxel(x, y, z);
+							}
 
-						for (int x_2 = x_lower; x_2 < x_upper; x_2 += step_x)
-						{
-							for (int y_2 = y_lower; y_2 < y_upper; y_2 += step_y)
+							if (!voxels.IsInBand(voxel))
 							{
-								for (int z_2 = z_lower; z_2 < z_upper; z_2 += step_z)
-								{
-									to_check.push(x_2 + y_2 + z_2);
-								}
+								voxels.SetInBand(voxel, true);
+								band_voxels.push_back(voxel);
 							}
 						}
 					}
 				}
+			}
+		}
+	}
 
-				while (!to_check.empty()) { to_check.pop(); }
+	return band_voxels.size() - first_new;
+}
 
-				if (limit < 0)
-				{
-					while (!marked.empty()) {
-						marked.pop();
-					}
-				}
-				else
-				{
-					culled += marked.size();
+void MeshingVoxelGrid::IntegrateBandVoxels(size_t first, const MeshingCameraImage& image, const open3d::geometry::Image* color, int& culled, int& solid, int& air)
+{
+	int band_culled = 0;
+	int band_solid = 0;
+	int band_air = 0;
 
-					while (!marked.empty()) {
-						current = marked.front();
+	int64_t count = (int64_t)band_voxels.size();
 
-						grid[current].voxel_type = MeshingVoxelType::AIR;
-						grid[current].value = 1.0f;
+#pragma omp parallel for schedule(static) reduction(+:band_culled, band_solid, band_air)
+	for (int64_t i = (int64_t)first; i < count; ++i)
+	{
+		Eigen::Vector3i coords = GetVoxelCoordinates(band_voxels[i]);
 
-						marked.pop();
-					}
-				}
-			}
-		}
+		IntegrateVoxel(voxels, band_voxels[i], GetPosition(coords.x(), coords.y(), coords.z()), image, color, band_culled, band_solid, band_air);
+	}
+
+	culled += band_culled;
+	solid += band_solid;
+	air += band_air;
+}
+
+void MeshingVoxelGrid::ResizeCarveCells(int size)
+{
+	carve_size = size;
+
+	carve_x = (size_x + carve_size - 1) / carve_size;
+	carve_y = (size_y + carve_size - 1) / carve_size;
+	carve_z = (size_z + carve_size - 1) / carve_size;
+
+	carve_cells = MeshingVoxelArrays();
+	carve_cells.Resize((size_t)carve_x * carve_y * carve_z);
+}
+
+void MeshingVoxelGrid::CarveCells(const MeshingCameraImage& image)
+{
+	int cell_culled = 0;
+	int cell_solid = 0;
+	int cell_air = 0;
+
+#pragma omp parallel for schedule(static) reduction(+:cell_culled, cell_solid, cell_air)
+	for (int cell = 0; cell < (int)carve_cells.Size(); ++cell)
+	{
+		int start_x = (cell / (carve_z * carve_y)) * carve_size;
+		int start_y = ((cell / carve_z) % carve_y) * carve_size;
+		int start_z = (cell % carve_z) * carve_size;
+
+		Eigen::Vector3d center = GetPosition(start_x, start_y, start_z) + Eigen::Vector3d::Constant(voxel_size * 0.5 * (carve_size - 1));
+
+		carve_cells.SetValue(cell, 1.0);
+
+		IntegrateVoxel(carve_cells, cell, center, image, nullptr, cell_culled, cell_solid, cell_air);
 	}
+}
+
+void MeshingVoxelGrid::SetIntegrationMode(MeshingIntegrationMode mode, int band)
+{
+	integration_mode = mode;
+	band_voxels_wide = std::max(band, 1);
 
-	for (int x = 0; x < size_x; ++x)
+	//A voxel outside every band is more than the band from the surface, so with the center of its cell less than the band
+	//away the two are on the same side of it
+	if (integration_mode == MeshingIntegrationMode::PIXEL_DRIVEN)
 	{
-		for (int y = 0; y < size_y; ++y)
-		{
-			for (int z = 0; z < size_z; ++z, ++grid_loc)
-			{
-				grid[current].mark_for_cull = false;
-			}
-		}
+		ResizeCarveCells(std::min((int)(2.0 * band_voxels_wide / std::sqrt(3.0)) + 1, (int)BRICK_SIZE));
 	}
+	else
+	{
+		ResizeCarveCells(BRICK_SIZE);
+	}
+}
+
+void MeshingVoxelGrid::AddImage(open3d::geometry::Image& color, open3d::geometry::Image& depth, Eigen::Matrix4d extrinsics, Eigen::Matrix3d intrinsics)
+{
+	int culled = 0;
+	int solid = 0;
+	int air = 0;
+
+	bool sparse = (storage == MeshingVoxelStorage::SPARSE);
+	bool pixel_driven = (integration_mode == MeshingIntegrationMode::PIXEL_DRIVEN);
+
+	MeshingCameraImage image = PrepareImage(color, depth, extrinsics, intrinsics, sparse || pixel_driven);
+
+	const open3d::geometry::Image* image_color = (!geometry_only && !color.IsEmpty()) ? &color : nullptr;
+
+	size_t integrated = GetAllocatedVoxelCount();
+
+	if (pixel_driven)
+	{
+		size_t first_new = band_voxels.size();
+
+		MarchBands(image);
+
+		//Voxels new to the bands catch up on every earlier image, in order, so every band voxel ends up as a voxel driven
+		//grid's would
+		int replay_culled = 0;
+		int replay_solid = 0;
+		int replay_air = 0;
+
+		for (auto& earlier : images)
+		{
+			IntegrateBandVoxels(first_new, earlier, earlier.color.get(), replay_culled, replay_solid, replay_air);
+		}
+
+		IntegrateBandVoxels(0, image, image_color, culled, solid, air);
+
+		integrated = band_voxels.size();
+	}
+	else if (sparse)
+	{
+		std::vector<int> new_slots = AllocateBricksAroundDepth(image);
+
+		//Bricks new to this image catch up on every earlier image, in order, so they end up as a dense grid's voxels would
+		int replay_culled = 0;
+		int replay_solid = 0;
+		int replay_air = 0;
+
+		for (auto& earlier : images)
+		{
+			IntegrateSlots(new_slots, earlier, earlier.color.get(), replay_culled, replay_solid, replay_air);
+		}
+
+		std::vector<int> all_slots(slot_bricks.size());
+
+		for (int slot = 0; slot < all_slots.size(); ++slot)
+		{
+			all_slots[slot] = slot;
+		}
+
+		IntegrateSlots(all_slots, image, image_color, culled, solid, air);
+
+		integrated = GetAllocatedVoxelCount();
+	}
+	else
+	{
+		//Each thread takes a slab of x, and runs along z within it
+#pragma omp parallel for schedule(static) reduction(+:culled, solid, air)
+		for (int x = 0; x < size_x; ++x)
+		{
+			for (int y = 0; y < size_y; ++y)
+			{
+				IntegrateRun((size_t)DenseIndex(x, y, 0), x, y, 0, size_z, image, image_color, culled, solid, air);
+			}
+		}
+	}
+
+	if (sparse || pixel_driven)
+	{
+		//Voxels without memory, or that no band reached, are as the center of their carve cell
+		CarveCells(image);
+
+		images.push_back(image);
+	}
+
+	std::cout << "culled voxels: " << culled << "/" << integrated << std::endl;
+	std::cout << "solid voxels: " << solid << "/" << integrated << std::endl;
+	std::cout << "air voxels: " << air << "/" << integrated << std::endl;
+}
+
+size_t MeshingVoxelGrid::GetMemoryBytes()
+{
+	size_t bytes = voxels.GetMemoryBytes() + carve_cells.GetMemoryBytes() + band_voxels.capacity() * sizeof(size_t);
+
+	if (storage == MeshingVoxelStorage::SPARSE)
+	{
+		bytes += slot_bricks.capacity() * sizeof(int);
+
+		//Map nodes hold the pair and a link, buckets hold a pointer each
+		bytes += brick_slots.size() * (sizeof(std::pair<const int, int>) + sizeof(void*));
+		bytes += brick_slots.bucket_count() * sizeof(void*);
+	}
+
+	for (auto& image : images)
+	{
+		bytes += image.depth->data_.size();
+
+		if (image.color != nullptr)
+		{
+			bytes += image.color->data_.size();
+		}
+	}
+
+	return bytes;
+}
+
+void MeshingVoxelGrid::KillEmptySpace()
+{
+	int empty_voxels = 0;
+	int filled_solid = 0;
+	int filled_air = 0;
+
+	int vote_solid = 0;
+
+	ForEachVoxel([&](size_t voxel, int x, int y, int z) {
+		if (voxels.GetType(voxel) != MeshingVoxelType::NONE)
+		{
+			return;
+		}
+
+		++empty_voxels;
+
+		vote_solid += (GetVoxel(std::min(x + 1, size_x - 1), y, z).value == MeshingVoxelType::SOLID);
+		vote_solid += (GetVoxel(std::max(x - 1, 0), y, z).value == MeshingVoxelType::SOLID);
+		vote_solid += (GetVoxel(x, std::min(y + 1, size_y - 1), z).value == MeshingVoxelType::SOLID);
+		vote_solid += (GetVoxel(x, std::max(y - 1, 0), z).value == MeshingVoxelType::SOLID);
+		vote_solid += (GetVoxel(x, y, std::min(z + 1, size_z - 1)).value == MeshingVoxelType::SOLID);
+		vote_solid += (GetVoxel(x, y, std::max(z - 1, 0)).value == MeshingVoxelType::SOLID);
+
+		if (vote_solid >= 3)
+		{
+			voxels.SetType(voxel, MeshingVoxelType::SOLID);
+			voxels.SetValue(voxel, (double)vote_solid / 6.0);
+
+			++filled_solid;
+		}
+		else
+		{
+			voxels.SetType(voxel, MeshingVoxelType::AIR);
+			
+			++filled_air;
+		}
+	});
+
+	std::cout << empty_voxels << " empty voxels found: filled " << filled_solid << " solid, filled " << filled_air << " air" << std::endl;
+}
+
+void MeshingVoxelGrid::LoadPlaneSolidity(int x, const std::vector<uint8_t>& bricks, std::vector<uint8_t>& solid)
+{
+	solid.resize((size_t)size_y * size_z);
+
+	if (storage == MeshingVoxelStorage::DENSE)
+	{
+		for (int y = 0; y < size_y; ++y)
+		{
+			for (int z = 0; z < size_z; ++z)
+			{
+				solid[y * size_z + z] = (GetStoredType((size_t)DenseIndex(x, y, z), x, y, z) == MeshingVoxelType::SOLID);
+			}
+		}
+
+		return;
+	}
+
+	//One lookup per brick the plane passes through, rather than per voxel. Voxels of bricks left out are left as they were
+	for (int brick_y = 0; brick_y < bricks_y; ++brick_y)
+	{
+		for (int brick_z = 0; brick_z < bricks_z; ++brick_z)
+		{
+			if (!bricks[BrickIndex(x / BRICK_SIZE, brick_y, brick_z)])
+			{
+				continue;
+			}
+
+			auto slot = brick_slots.find(BrickIndex(x / BRICK_SIZE, brick_y, brick_z));
+
+			size_t brick_first = (slot == brick_slots.end()) ? NO_VOXEL : (size_t)slot->second * BRICK_VOXELS + (x % BRICK_SIZE) * BRICK_SIZE * BRICK_SIZE;
+
+			for (int y = brick_y * BRICK_SIZE; y < std::min((brick_y + 1) * BRICK_SIZE, size_y); ++y)
+			{
+				for (int z = brick_z * BRICK_SIZE; z < std::min((brick_z + 1) * BRICK_SIZE, size_z); ++z)
+				{
+					size_t voxel = (brick_first == NO_VOXEL) ? NO_VOXEL : brick_first + (y % BRICK_SIZE) * BRICK_SIZE + (z % BRICK_SIZE);
+
+					solid[y * size_z + z] = (GetStoredType(voxel, x, y, z) == MeshingVoxelType::SOLID);
+				}
+			}
+		}
+	}
+}
+
+std::shared_ptr<open3d::geometry::TriangleMesh> MeshingVoxelGrid::ExtractMesh()
+{
+	//KillEmptySpace();
+
+	auto to_return = std::make_shared<open3d::geometry::TriangleMesh>();
+
+	int solid_voxels = 0;
+
+	ForEachVoxel([&](size_t voxel, int x, int y, int z) {
+		solid_voxels += (voxels.GetType(voxel) == MeshingVoxelType::SOLID);
+	});
+
+	std::cout << "Solid voxels total: " << solid_voxels << "/" << GetAllocatedVoxelCount() << std::endl;
+
+	bool sparse = (storage == MeshingVoxelStorage::SPARSE);
+
+	//Cells reaching into an allocated brick start in it or in one of the 7 bricks below it, the rest never hold a surface.
+	//Corners of those cells lie in the bricks visited or in one of the 7 bricks above them, which are all that is read
+	std::vector<uint8_t> visit;
+	std::vector<uint8_t> reach;
+
+	if (sparse)
+	{
+		visit.assign((size_t)bricks_x * bricks_y * bricks_z, 0);
+		reach.assign((size_t)bricks_x * bricks_y * bricks_z, 0);
+
+		for (int brick : slot_bricks)
+		{
+			int brick_x = brick / (bricks_z * bricks_y);
+			int brick_y = (brick / bricks_z) % bricks_y;
+			int brick_z = brick % bricks_z;
+
+			for (int lower = 0; lower < 8; ++lower)
+			{
+				int visit_x = brick_x - (lower & 1);
+				int visit_y = brick_y - ((lower >> 1) & 1);
+				int visit_z = brick_z - ((lower >> 2) & 1);
+
+				if (visit_x < 0 || visit_y < 0 || visit_z < 0)
+				{
+					continue;
+				}
+
+				visit[BrickIndex(visit_x, visit_y, visit_z)] = 1;
+
+				for (int upper = 0; upper < 8; ++upper)
+				{
+					int reach_x = visit_x + (upper & 1);
+					int reach_y = visit_y + ((upper >> 1) & 1);
+					int reach_z = visit_z + ((upper >> 2) & 1);
+
+					if (reach_x < bricks_x && reach_y < bricks_y && reach_z < bricks_z)
+					{
+						reach[BrickIndex(reach_x, reach_y, reach_z)] = 1;
+					}
+				}
+			}
+		}
+	}
+
+	//Calls a function on each stretch of z along a row that lies in a marked brick, the whole row for dense grids
+	auto for_each_span = [&](int x, int y, const std::vector<uint8_t>& bricks, auto&& function) {
+		if (!sparse)
+		{
+			function(0, size_z);
+			return;
+		}
+
+		for (int brick_z = 0; brick_z < bricks_z; ++brick_z)
+		{
+			if (bricks[BrickIndex(x / BRICK_SIZE, y / BRICK_SIZE, brick_z)])
+			{
+				function(brick_z * BRICK_SIZE, std::min((brick_z + 1) * BRICK_SIZE, size_z));
+			}
+		}
+	};
+
+	auto cell_visited = [&](int x, int y, int z) {
+		if (x < 0 || y < 0 || z < 0 || x >= size_x - 1 || y >= size_y - 1 || z >= size_z - 1)
+		{
+			return false;
+		}
+
+		return !sparse || visit[BrickIndex(x / BRICK_SIZE, y / BRICK_SIZE, z / BRICK_SIZE)] != 0;
+	};
+
+	//Every edge of the grid with a solid and a not solid end that some visited cell holds gets one vertex. A plane of x owns
+	//the edges starting in it, and numbers them along each row by z and then by axis, so both passes agree on the numbering
+	auto for_each_row_vertex = [&](int x, int y, const uint8_t* here, const uint8_t* next, auto&& function) {
+		for_each_span(x, y, reach, [&](int z_begin, int z_end) {
+			for (int z = z_begin; z < z_end; ++z)
+			{
+				int point = y * size_z + z;
+
+				if (x < size_x - 1 && here[point] != next[point] &&
+					(!sparse || cell_visited(x, y - 1, z - 1) || cell_visited(x, y, z - 1) || cell_visited(x, y - 1, z) || cell_visited(x, y, z)))
+				{
+					function(z, 0);
+				}
+
+				if (y < size_y - 1 && here[point] != here[point + size_z] &&
+					(!sparse || cell_visited(x - 1, y, z - 1) || cell_visited(x, y, z - 1) || cell_visited(x - 1, y, z) || cell_visited(x, y, z)))
+				{
+					function(z, 1);
+				}
+
+				if (z < size_z - 1 && here[point] != here[point + 1] &&
+					(!sparse || cell_visited(x - 1, y - 1, z) || cell_visited(x, y - 1, z) || cell_visited(x - 1, y, z) || cell_visited(x, y, z)))
+				{
+					function(z, 2);
+				}
+			}
+		});
+	};
+
+	//Calls a function on every visited cell of a row, with the index of its first corner in a plane
+	auto for_each_row_cell = [&](int x, int y, auto&& function) {
+		if (x >= size_x - 1 || y >= size_y - 1)
+		{
+			return;
+		}
+
+		for_each_span(x, y, visit, [&](int z_begin, int z_end) {
+			for (int z = z_begin; z < std::min(z_end, size_z - 1); ++z)
+			{
+				function(z, y * size_z + z);
+			}
+		});
+	};
+
+	//Corner bits follow the order the tables were written for
+	auto cell_index = [&](int point, const uint8_t* here, const uint8_t* next) {
+		int index = 0;
+
+		index |= 1 *	here[point];
+		index |= 2 *	next[point];
+		index |= 8 *	here[point + size_z];
+		index |= 4 *	next[point + size_z];
+		index |= 16 *	here[point + 1];
+		index |= 32 *	next[point + 1];
+		index |= 128 *	here[point + size_z + 1];
+		index |= 64 *	next[point + size_z + 1];
+
+		return 255 - index;
+	};
+
+	int triangle_counts[256];
+
+	for (int index = 0; index < 256; ++index)
+	{
+		triangle_counts[index] = 0;
+
+		while (tri_table[index][triangle_counts[index] * 3] != -1)
+		{
+			++triangle_counts[index];
+		}
+	}
+
+	//First pass counts the vertices and triangles of every row, so each row knows where to write before anything is written
+	std::vector<size_t> row_vertices((size_t)size_x * size_y + 1, 0);
+	std::vector<size_t> row_triangles((size_t)size_x * size_y + 1, 0);
+
+	int no_triangles = 0;
+	int cells = 0;
+
+#pragma omp parallel reduction(+:no_triangles, cells)
+	{
+		std::vector<uint8_t> here;
+		std::vector<uint8_t> next;
+
+#pragma omp for schedule(static)
+		for (int x = 0; x < size_x; ++x)
+		{
+			LoadPlaneSolidity(x, reach, here);
+
+			if (x < size_x - 1)
+			{
+				LoadPlaneSolidity(x + 1, reach, next);
+			}
+
+			for (int y = 0; y < size_y; ++y)
+			{
+				size_t vertex_count = 0;
+				size_t triangle_count = 0;
+
+				for_each_row_vertex(x, y, here.data(), next.data(), [&](int z, int axis) { ++vertex_count; });
+
+				for_each_row_cell(x, y, [&](int z, int point) {
+					int index = cell_index(point, here.data(), next.data());
+
+					triangle_count += triangle_counts[index];
+					no_triangles += (edge_table[index] == 0);
+					++cells;
+				});
+
+				row_vertices[(size_t)x * size_y + y + 1] = vertex_count;
+				row_triangles[(size_t)x * size_y + y + 1] = triangle_count;
+			}
+		}
+	}
+
+	for (size_t row = 1; row < row_vertices.size(); ++row)
+	{
+		row_vertices[row] += row_vertices[row - 1];
+		row_triangles[row] += row_triangles[row - 1];
+	}
+
+	to_return->vertices_.resize(row_vertices.back());
+	to_return->vertex_colors_.resize(row_vertices.back());
+	to_return->triangles_.resize(row_triangles.back());
+
+	//Second pass writes each plane's vertices and the triangles of the cells starting in it. A plane's edge cache holds the
+	//vertex of every edge starting at each point, by axis, for the plane and the one after it
+	const Eigen::Vector3i axis_steps[3] = { Eigen::Vector3i(1, 0, 0), Eigen::Vector3i(0, 1, 0), Eigen::Vector3i(0, 0, 1) };
+
+#pragma omp parallel
+	{
+		std::vector<uint8_t> here;
+		std::vector<uint8_t> next;
+		std::vector<uint8_t> after;
+
+		std::vector<int> edges_here((size_t)size_y * size_z * 3, -1);
+		std::vector<int> edges_next((size_t)size_y * size_z * 3, -1);
+
+#pragma omp for schedule(static)
+		for (int x = 0; x < size_x; ++x)
+		{
+			LoadPlaneSolidity(x, reach, here);
+
+			if (x < size_x - 1)
+			{
+				LoadPlaneSolidity(x + 1, reach, next);
+			}
+
+			if (x < size_x - 2)
+			{
+				LoadPlaneSolidity(x + 2, reach, after);
+			}
+
+			for (int y = 0; y < size_y; ++y)
+			{
+				size_t vertex = row_vertices[(size_t)x * size_y + y];
+
+				for_each_row_vertex(x, y, here.data(), next.data(), [&](int z, int axis) {
+					edges_here[(y * size_z + z) * 3 + axis] = (int)vertex;
+
+					SingleVoxel ends[2] = { GetVoxel(x, y, z), GetVoxel(x + axis_steps[axis].x(), y + axis_steps[axis].y(), z + axis_steps[axis].z()) };
+
+					MeshingVoxelEdge edge = LerpCorner(ends, 0, 1);
+
+					to_return->vertices_[vertex] = edge.position;
+					to_return->vertex_colors_[vertex] = edge.color;
+
+					++vertex;
+				});
+			}
+
+			if (x == size_x - 1)
+			{
+				continue;
+			}
+
+			for (int y = 0; y < size_y; ++y)
+			{
+				size_t vertex = row_vertices[(size_t)(x + 1) * size_y + y];
+
+				for_each_row_vertex(x + 1, y, next.data(), after.data(), [&](int z, int axis) {
+					edges_next[(y * size_z + z) * 3 + axis] = (int)vertex++;
+				});
+			}
+
+			for (int y = 0; y < size_y - 1; ++y)
+			{
+				size_t triangle = row_triangles[(size_t)x * size_y + y];
+
+				for_each_row_cell(x, y, [&](int z, int point) {
+					int index = cell_index(point, here.data(), next.data());
+
+					for (int i = 0; tri_table[index][i] != -1; i += 3, ++triangle)
+					{
+						int corners[3];
+
+						for (int j = 0; j < 3; ++j)
+						{
+							const int* origin = edge_origins[tri_table[index][i + j]];
+
+							const std::vector<int>& edges = (origin[0] == 0) ? edges_here : edges_next;
+
+							corners[j] = edges[((y + origin[1]) * size_z + z + origin[2]) * 3 + origin[3]];
+						}
+
+						to_return->triangles_[triangle] = Eigen::Vector3i(corners[0], corners[1], corners[2]);
+					}
+				});
+			}
+		}
+	}
+
+	std::cout << "Mesh vertices: " << to_return->vertices_.size() << ", triangles: " << to_return->triangles_.size() << std::endl;
+	std::cout << "Voxels without triangles: " << no_triangles << "/" << cells << std::endl;
+
+	return to_return;
+}
+
+MeshingVoxelEdge MeshingVoxelGrid::LerpCorner(SingleVoxel* voxel_array, int elem1, int elem2)
+{
+	double t = voxel_array[elem1].value / (voxel_array[elem1].value + voxel_array[elem2].value);
+
+	double total = 0;
+
+	bool first_solid = (voxel_array[elem1].voxel_type == MeshingVoxelType::SOLID) * (1.0 - t);
+	bool second_solid = (voxel_array[elem2].voxel_type == MeshingVoxelType::SOLID) * t;
+
+	Eigen::Vector3d final_color = 
+		(first_solid * voxel_array[elem1].color + second_solid * voxel_array[elem2].color) / (first_solid + second_solid);
+
+	//return MeshingVoxelEdge(
+	//	voxel_array[elem1].position * (1.0 - t) + voxel_array[elem2].position * t,
+	//	voxel_array[elem1].color * (1.0 - t) + voxel_array[elem2].color * t
+	//	);
+
+	return MeshingVoxelEdge(
+		voxel_array[elem1].position * (1.0 - t) + voxel_array[elem2].position * t,
+		final_color
+		);
+}
+
+void MeshingVoxelGrid::CullArtifacts(int artifact_size, int keep_largest)
+{
+	if (artifact_size <= 0 && keep_largest <= 0)
+	{
+		return;
+	}
+
+	int cells = (int)carve_cells.Size();
+	int cell_voxels = carve_size * carve_size * carve_size;
+
+	//A cell is mixed when some voxel in it was worked out on its own, every voxel of the other cells takes the cell's type
+	std::vector<uint8_t> mixed(cells, 0);
+
+	if (integration_mode == MeshingIntegrationMode::PIXEL_DRIVEN)
+	{
+		for (size_t voxel : band_voxels)
+		{
+			Eigen::Vector3i coords = GetVoxelCoordinates(voxel);
+
+			mixed[CarveIndex(coords.x(), coords.y(), coords.z())] = 1;
+		}
+	}
+	else if (storage == MeshingVoxelStorage::SPARSE)
+	{
+		//Carve cells are bricks for voxel driven grids
+		for (int brick : slot_bricks)
+		{
+			mixed[brick] = 1;
+		}
+	}
+	else
+	{
+		std::fill(mixed.begin(), mixed.end(), 1);
+	}
+
+	auto cell_start = [&](int cell) {
+		return Eigen::Vector3i((cell / (carve_z * carve_y)) * carve_size, ((cell / carve_z) % carve_y) * carve_size, (cell % carve_z) * carve_size);
+	};
+
+	//Steps to the voxel below along each axis, within a cell
+	int step_x = carve_size * carve_size;
+	int step_y = carve_size;
+
+	auto cell_offset = [&](int local) {
+		return Eigen::Vector3i(local / step_x, (local / step_y) % carve_size, local % carve_size);
+	};
+
+	//Calls a function on every voxel of a cell that lies inside the grid, in order, with its coordinates and place in the cell
+	auto for_each_cell_voxel = [&](int cell, auto&& function) {
+		Eigen::Vector3i start = cell_start(cell);
+
+		int end_x = std::min(start.x() + carve_size, size_x);
+		int end_y = std::min(start.y() + carve_size, size_y);
+		int end_z = std::min(start.z() + carve_size, size_z);
+
+		for (int x = start.x(); x < end_x; ++x)
+		{
+			for (int y = start.y(); y < end_y; ++y)
+			{
+				int local = (x - start.x()) * step_x + (y - start.y()) * step_y;
+
+				for (int z = start.z(); z < end_z; ++z, ++local)
+				{
+					function(x, y, z, local);
+				}
+			}
+		}
+	};
+
+	auto cell_voxels_inside = [&](int cell) {
+		Eigen::Vector3i start = cell_start(cell);
+
+		return std::min(carve_size, size_x - start.x()) * std::min(carve_size, size_y - start.y()) * std::min(carve_size, size_z - start.z());
+	};
+
+	//Nodes are solid cells that are not mixed, standing for all their voxels, and the solid voxels of mixed cells. They are
+	//numbered cell by cell, so every cell knows its numbers before any are handed out
+	std::vector<int> cell_first(cells + 1, 0);
+
+	//Where each mixed cell's voxels' numbers are kept, voxel by voxel
+	std::vector<int> mixed_slots(cells, -1);
+	int mixed_count = 0;
+
+	for (int cell = 0; cell < cells; ++cell)
+	{
+		if (mixed[cell])
+		{
+			mixed_slots[cell] = mixed_count++;
+		}
+	}
+
+#pragma omp parallel for schedule(static)
+	for (int cell = 0; cell < cells; ++cell)
+	{
+		if (!mixed[cell])
+		{
+			cell_first[cell + 1] = (carve_cells.GetType(cell) == MeshingVoxelType::SOLID);
+			continue;
+		}
+
+		int solid = 0;
+
+		for_each_cell_voxel(cell, [&](int x, int y, int z, int local) {
+			solid += (GetStoredType(FindVoxel(x, y, z), x, y, z) == MeshingVoxelType::SOLID);
+		});
+
+		cell_first[cell + 1] = solid;
+	}
+
+	for (int cell = 0; cell < cells; ++cell)
+	{
+		cell_first[cell + 1] += cell_first[cell];
+	}
+
+	int node_count = cell_first[cells];
+
+	std::vector<int> voxel_ids((size_t)mixed_count * cell_voxels, -1);
+	std::vector<int> node_locals(node_count, -1);
+	std::vector<int> node_sizes(node_count, 1);
+	std::vector<int> parents(node_count);
+
+	//Roots are always the lowest number of their set, so the sets come out the same whatever order they were joined in
+	auto find = [&](int id) {
+		while (parents[id] != id)
+		{
+			parents[id] = parents[parents[id]];
+			id = parents[id];
+		}
+
+		return id;
+	};
+
+	auto join = [&](int first, int second) {
+		first = find(first);
+		second = find(second);
+
+		if (first < second)
+		{
+			parents[second] = first;
+		}
+		else if (second < first)
+		{
+			parents[first] = second;
+		}
+	};
+
+	//The node a voxel belongs to, -1 if it is not solid
+	auto node_at = [&](int cell, int local) {
+		if (mixed[cell])
+		{
+			return voxel_ids[(size_t)mixed_slots[cell] * cell_voxels + local];
+		}
+
+		return (cell_first[cell + 1] > cell_first[cell]) ? cell_first[cell] : -1;
+	};
+
+	//Each mixed cell joins its solid voxels to their solid neighbours below them in the cell, touching only its own numbers
+#pragma omp parallel for schedule(static)
+	for (int cell = 0; cell < cells; ++cell)
+	{
+		int id = cell_first[cell];
+
+		if (!mixed[cell])
+		{
+			if (id < cell_first[cell + 1])
+			{
+				parents[id] = id;
+				node_sizes[id] = cell_voxels_inside(cell);
+			}
+
+			continue;
+		}
+
+		int* ids = &voxel_ids[(size_t)mixed_slots[cell] * cell_voxels];
+
+		for_each_cell_voxel(cell, [&](int x, int y, int z, int local) {
+			if (GetStoredType(FindVoxel(x, y, z), x, y, z) != MeshingVoxelType::SOLID)
+			{
+				return;
+			}
+
+			ids[local] = id;
+			node_locals[id] = local;
+			parents[id] = id;
+
+			if (x % carve_size > 0 && ids[local - step_x] >= 0)
+			{
+				join(id, ids[local - step_x]);
+			}
+
+			if (y % carve_size > 0 && ids[local - step_y] >= 0)
+			{
+				join(id, ids[local - step_y]);
+			}
+
+			if (z % carve_size > 0 && ids[local - 1] >= 0)
+			{
+				join(id, ids[local - 1]);
+			}
+
+			++id;
+		});
+	}
+
+	//Then the sets are joined across the lower faces of every cell, on one thread as they reach into other cells' numbers
+	int cell_steps[3] = { carve_y * carve_z, carve_z, 1 };
+	int local_steps[3] = { step_x, step_y, 1 };
+
+	for (int cell = 0; cell < cells; ++cell)
+	{
+		Eigen::Vector3i start = cell_start(cell);
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			if (start[axis] == 0)
+			{
+				continue;
+			}
+
+			int below = cell - cell_steps[axis];
+
+			if (!mixed[cell] && !mixed[below])
+			{
+				if (node_at(cell, 0) >= 0 && node_at(below, 0) >= 0)
+				{
+					join(node_at(cell, 0), node_at(below, 0));
+				}
+
+				continue;
+			}
+
+			for (int a = 0; a < carve_size; ++a)
+			{
+				for (int b = 0; b < carve_size; ++b)
+				{
+					Eigen::Vector3i offset = Eigen::Vector3i::Zero();
+					offset[(axis + 1) % 3] = a;
+					offset[(axis + 2) % 3] = b;
+
+					Eigen::Vector3i coords = start + offset;
+
+					if (coords.x() >= size_x || coords.y() >= size_y || coords.z() >= size_z)
+					{
+						continue;
+					}
+
+					int local = offset.x() * step_x + offset.y() * step_y + offset.z();
+
+					int first = node_at(cell, local);
+					int second = node_at(below, local + (carve_size - 1) * local_steps[axis]);
+
+					if (first >= 0 && second >= 0)
+					{
+						join(first, second);
+					}
+				}
+			}
+		}
+	}
+
+	std::vector<int> roots(node_count);
+	std::vector<size_t> component_sizes(node_count, 0);
+
+	for (int id = 0; id < node_count; ++id)
+	{
+		roots[id] = find(id);
+		component_sizes[roots[id]] += node_sizes[id];
+	}
+
+	std::vector<int> components;
+
+	for (int id = 0; id < node_count; ++id)
+	{
+		if (roots[id] == id)
+		{
+			components.push_back(id);
+		}
+	}
+
+	std::vector<uint8_t> cull_component(node_count, 0);
+
+	for (int root : components)
+	{
+		cull_component[root] = (artifact_size > 0 && component_sizes[root] <= (size_t)artifact_size);
+	}
+
+	//Past the threshold, only the largest components are kept, ties going to the one found first
+	if (keep_largest > 0 && keep_largest < (int)components.size())
+	{
+		std::sort(components.begin(), components.end(), [&](int first, int second) {
+			return component_sizes[first] != component_sizes[second] ? component_sizes[first] > component_sizes[second] : first < second;
+		});
+
+		for (int i = keep_largest; i < (int)components.size(); ++i)
+		{
+			cull_component[components[i]] = 1;
+		}
+	}
+
+	size_t culled = 0;
+	size_t solid_total = 0;
+
+	//Mixed cells some of whose voxels taking the cell's type are culled, but not all of them
+	std::vector<uint8_t> split(cells, 0);
+
+#pragma omp parallel for schedule(static) reduction(+:culled, solid_total)
+	for (int cell = 0; cell < cells; ++cell)
+	{
+		int loose = 0;
+		int loose_culled = 0;
+
+		Eigen::Vector3i start = cell_start(cell);
+
+		for (int id = cell_first[cell]; id < cell_first[cell + 1]; ++id)
+		{
+			bool cull = cull_component[roots[id]];
+
+			solid_total += node_sizes[id];
+			culled += cull ? node_sizes[id] : 0;
+
+			if (!mixed[cell])
+			{
+				if (cull)
+				{
+					carve_cells.SetType(cell, MeshingVoxelType::AIR);
+				}
+
+				continue;
+			}
+
+			Eigen::Vector3i coords = start + cell_offset(node_locals[id]);
+
+			size_t voxel = FindVoxel(coords.x(), coords.y(), coords.z());
+
+			if (IsWorkedOut(voxel))
+			{
+				if (cull)
+				{
+					voxels.SetType(voxel, MeshingVoxelType::AIR);
+					voxels.SetValue(voxel, 1.0);
+				}
+
+				continue;
+			}
+
+			++loose;
+			loose_culled += cull;
+		}
+
+		//Voxels taking the cell's type go to air with it, unless some of them are kept
+		if (loose_culled == loose && loose > 0)
+		{
+			carve_cells.SetType(cell, MeshingVoxelType::AIR);
+		}
+		else if (loose_culled > 0)
+		{
+			split[cell] = 1;
+		}
+	}
+
+	//Which only happens to pixel driven grids, where a band cuts a cell in two. The culled voxels are marked as reached by a
+	//band so they keep a type of their own, without joining band_voxels so no later image works them out again
+	for (int cell = 0; cell < cells; ++cell)
+	{
+		if (!split[cell])
+		{
+			continue;
+		}
+
+		Eigen::Vector3i start = cell_start(cell);
+
+		for (int id = cell_first[cell]; id < cell_first[cell + 1]; ++id)
+		{
+			if (!cull_component[roots[id]])
+			{
+				continue;
+			}
+
+			Eigen::Vector3i coords = start + cell_offset(node_locals[id]);
+
+			size_t voxel = FindVoxel(coords.x(), coords.y(), coords.z());
+
+			if (voxel == NO_VOXEL)
+			{
+				AllocateBrick(BrickIndex(coords.x() / BRICK_SIZE, coords.y() / BRICK_SIZE, coords.z() / BRICK_SIZE));
+
+				voxel = FindVoxel(coords.x(), coords.y(), coords.z());
+			}
+			else if (IsWorkedOut(voxel))
+			{
+				continue;
+			}
+
+			voxels.SetInBand(voxel, true);
+			voxels.SetType(voxel, MeshingVoxelType::AIR);
+			voxels.SetValue(voxel, 1.0);
+		}
+	}
+
+	std::cout << "Solid components: " << components.size() << std::endl;
+	std::cout << "Culled: " << culled << "/" << solid_total << std::endl;
+}
+
+void MeshingVoxelGrid::BenchmarkLayout(int voxels_x, int voxels_y, int voxels_z, int iterations)
+{
+	iterations = std::max(iterations, 1);
+
+	size_t count = (size_t)voxels_x * voxels_y * voxels_z;
+
+	std::vector<SingleVoxel> structs(count);
+	MeshingVoxelArrays arrays;
+	arrays.Resize(count);
+
+	//The same made up ball in both layouts, solid inside and air outside
+	size_t grid_loc = 0;
+
+	for (int x = 0; x < voxels_x; ++x)
+	{
+		for (int y = 0; y < voxels_y; ++y)
+		{
+			for (int z = 0; z < voxels_z; ++z, ++grid_loc)
+			{
+				Eigen::Vector3d offset((double)x / voxels_x - 0.5, (double)y / voxels_y - 0.5, (double)z / voxels_z - 0.5);
+				double distance = offset.norm() - 0.3;
+
+				MeshingVoxelType type = (distance < 0) ? MeshingVoxelType::SOLID : MeshingVoxelType::AIR;
+				double value = std::min(std::abs(distance) * voxels_x, 1.0);
+				Eigen::Vector3d color((double)x / voxels_x, (double)y / voxels_y, (double)z / voxels_z);
+
+				structs[grid_loc].voxel_type = type;
+				structs[grid_loc].value = value;
+				structs[grid_loc].color = color;
+				structs[grid_loc].position = Eigen::Vector3d(x, y, z);
+
+				arrays.SetType(grid_loc, type);
+				arrays.SetValue(grid_loc, value);
+				arrays.SetColor(grid_loc, color);
+			}
+		}
+	}
+
+	auto time_pass = [iterations](auto pass) {
+		auto start = std::chrono::steady_clock::now();
+
+		size_t result = 0;
+
+		for (int i = 0; i < iterations; ++i)
+		{
+			result = pass();
+		}
+
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+		return std::make_pair(ms, result);
+	};
+
+	int step_x = voxels_y * voxels_z;
+	int step_y = voxels_z;
+
+	//Reads only the type, as counting solid voxels does
+	auto struct_count = time_pass([&]() {
+		size_t solid = 0;
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			solid += (structs[i].voxel_type == MeshingVoxelType::SOLID);
+		}
+
+		return solid;
+	});
+
+	auto array_count = time_pass([&]() {
+		size_t solid = 0;
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			solid += (arrays.GetType(i) == MeshingVoxelType::SOLID);
+		}
+
+		return solid;
+	});
+
+	//Reads the types of every cell's 8 corners, as ExtractMesh does before it interpolates
+	auto struct_cells = time_pass([&]() {
+		size_t surface_cells = 0;
+
+		for (int x = 0; x < voxels_x - 1; ++x)
+		{
+			for (int y = 0; y < voxels_y - 1; ++y)
+			{
+				size_t corner = (size_t)x * step_x + (size_t)y * step_y;
+
+				for (int z = 0; z < voxels_z - 1; ++z, ++corner)
+				{
+					int solid = 0;
+
+					for (int i = 0; i < 8; ++i)
+					{
+						solid += (structs[corner + (i & 1) * step_x + ((i >> 1) & 1) * step_y + ((i >> 2) & 1)].voxel_type == MeshingVoxelType::SOLID);
+					}
+
+					surface_cells += (solid != 0 && solid != 8);
+				}
+			}
+		}
+
+		return surface_cells;
+	});
+
+	auto array_cells = time_pass([&]() {
+		size_t surface_cells = 0;
+
+		for (int x = 0; x < voxels_x - 1; ++x)
+		{
+			for (int y = 0; y < voxels_y - 1; ++y)
+			{
+				size_t corner = (size_t)x * step_x + (size_t)y * step_y;
+
+				for (int z = 0; z < voxels_z - 1; ++z, ++corner)
+				{
+					int solid = 0;
+
+					for (int i = 0; i < 8; ++i)
+					{
+						solid += (arrays.GetType(corner + (i & 1) * step_x + ((i >> 1) & 1) * step_y + ((i >> 2) & 1)) == MeshingVoxelType::SOLID);
+					}
+
+					surface_cells += (solid != 0 && solid != 8);
+				}
+			}
+		}
+
+		return surface_cells;
+	});
+
+	//Reads and writes type, value and color, as AddImage does for a camera that sees every voxel. Distances are rounded to
+	//floats so both layouts keep the same ones
+	auto struct_update = time_pass([&]() {
+		size_t recolored = 0;
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			double mag = (float)((i % 97) / 96.0);
+
+			if (structs[i].voxel_type == MeshingVoxelType::SOLID && structs[i].value > mag)
+			{
+				structs[i].value = mag;
+				structs[i].color = Eigen::Vector3d(mag, mag, mag);
+
+				++recolored;
+			}
+		}
+
+		return recolored;
+	});
+
+	auto array_update = time_pass([&]() {
+		size_t recolored = 0;
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			double mag = (float)((i % 97) / 96.0);
+
+			if (arrays.GetType(i) == MeshingVoxelType::SOLID && arrays.GetValue(i) > mag)
+			{
+				arrays.SetValue(i, mag);
+				arrays.SetColor(i, Eigen::Vector3d(mag, mag, mag));
+
+				++recolored;
+			}
+		}
+
+		return recolored;
+	});
+
+	std::cout << "Voxel layout over " << voxels_x << "x" << voxels_y << "x" << voxels_z << " voxels, " << iterations << " iterations:" << std::endl;
+	std::cout << "\tSingleVoxel: " << sizeof(SingleVoxel) << " bytes per voxel, " << (count * sizeof(SingleVoxel)) / (1024.0 * 1024.0) << " MB" << std::endl;
+	std::cout << "\tArrays: " << MeshingVoxelArrays::BytesPerVoxel() << " bytes per voxel, " << arrays.GetMemoryBytes() / (1024.0 * 1024.0) << " MB" << std::endl;
+
+	auto print_pass = [count](std::string name, std::pair<double, size_t> with_structs, std::pair<double, size_t> with_arrays) {
+		std::cout << "\t" << name << ": SingleVoxel " << with_structs.first << " ms (" << count / (with_structs.first * 1000.0) << " Mvoxels/s), arrays ";
+		std::cout << with_arrays.first << " ms (" << count / (with_arrays.first * 1000.0) << " Mvoxels/s)";
+
+		if (with_structs.second != with_arrays.second)
+		{
+			std::cout << " - results differ, " << with_structs.second << " against " << with_arrays.second;
+		}
+
+		std::cout << std::endl;
+	};
 
-	std::cout << "Culled: " << culled << "/" << (size_x * size_y * size_z) << std::endl;
+	print_pass("Count solid", struct_count, array_count);
+	print_pass("Classify cells", struct_cells, array_cells);
+	print_pass("Update voxels", struct_update, array_update);
 }
@@ -1,5 +1,11 @@
 #pragma once
 #include "open3d/Open3D.h"
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
 
 
 //The type of voxel created
@@ -16,7 +22,7 @@ enum MeshingVoxelType
 };
 
 /// <summary>
-/// One single voxel in our grid
+/// One single voxel in our grid, unpacked - grids store their voxels in a MeshingVoxelArrays
 /// </summary>
 struct SingleVoxel
 {
@@ -66,6 +72,156 @@ struct MeshingVoxelEdge
     Eigen::Vector3d color;
 };
 
+/// <summary>
+/// How a grid stores its voxels
+/// </summary>
+enum class MeshingVoxelStorage
+{
+    //One array covering the whole box, every voxel exists - kept as the reference to compare against
+    DENSE,
+
+    //Bricks of voxels in a hash map, only allocated where some camera's depth lands
+    SPARSE
+};
+
+/// <summary>
+/// How images are brought into a grid
+/// </summary>
+enum class MeshingIntegrationMode
+{
+    //Every voxel with memory is projected into every camera - kept as the reference to compare against
+    VOXEL_DRIVEN,
+
+    //Every depth pixel's ray updates only the voxels in a band around the depth it saw, free space is carved in coarse cells
+    PIXEL_DRIVEN
+};
+
+/// <summary>
+/// One camera's image as the grid uses it, kept by sparse grids so bricks allocated later can catch up on it
+/// </summary>
+struct MeshingCameraImage
+{
+    //Depth in meters
+    std::shared_ptr<open3d::geometry::Image> depth;
+
+    //A copy of the color, only kept by sparse grids that use color
+    std::shared_ptr<open3d::geometry::Image> color;
+
+    Eigen::Matrix3d rotation;
+    Eigen::Vector3d position;
+    Eigen::Matrix3d rotation_inv;
+    Eigen::Matrix3d intrinsics;
+    Eigen::Matrix3d intrinsic_inv;
+
+    //Voxel (0, 0, 0) projected as (u * z, v * z, z), and how that changes one voxel along x, y and z
+    Eigen::Vector3d projected_origin;
+    Eigen::Vector3d projected_step_x;
+    Eigen::Vector3d projected_step_y;
+    Eigen::Vector3d projected_step_z;
+
+    //Voxels of distance along a pixel's ray per meter of depth difference
+    double depth_to_voxels = 0;
+};
+
+/// <summary>
+/// The voxels of a grid as one array per field, so a pass only pulls through cache what it reads. Positions and boundaries
+/// are not stored, they follow from where a voxel sits in the grid
+/// </summary>
+class MeshingVoxelArrays
+{
+    //Bits of a voxel's flags holding its MeshingVoxelType
+    static const uint8_t TYPE_BITS = 0x3;
+
+    //Bit of a voxel's flags set once some pixel's band reached it
+    static const uint8_t BAND_BIT = 0x4;
+
+    //The solidity of each voxel
+    std::vector<float> values;
+
+    //How certain we are of each voxel's value, as a 16 bit fraction of 1
+    std::vector<uint16_t> weights;
+
+    //8 bit RGB, 3 per voxel
+    std::vector<uint8_t> colors;
+
+    //Type and band mark of each voxel
+    std::vector<uint8_t> flags;
+
+public:
+    /// <summary>
+    /// Sets how many voxels there are, new voxels are undecided, black and hold nothing
+    /// </summary>
+    void Resize(size_t count)
+    {
+        values.resize(count, 0.0f);
+        weights.resize(count, 0);
+        colors.resize(count * 3, 0);
+        flags.resize(count, MeshingVoxelType::NONE);
+    }
+
+    size_t Size() const { return values.size(); }
+
+    /// <summary>
+    /// Bytes stored for a single voxel
+    /// </summary>
+    static size_t BytesPerVoxel() { return sizeof(float) + sizeof(uint16_t) + 3 * sizeof(uint8_t) + sizeof(uint8_t); }
+
+    /// <summary>
+    /// Returns the bytes held by the arrays
+    /// </summary>
+    size_t GetMemoryBytes() const
+    {
+        return values.capacity() * sizeof(float) + weights.capacity() * sizeof(uint16_t) + colors.capacity() + flags.capacity();
+    }
+
+    MeshingVoxelType GetType(size_t voxel) const { return (MeshingVoxelType)(flags[voxel] & TYPE_BITS); }
+
+    void SetType(size_t voxel, MeshingVoxelType type) { flags[voxel] = (flags[voxel] & ~TYPE_BITS) | (uint8_t)type; }
+
+    bool IsInBand(size_t voxel) const { return (flags[voxel] & BAND_BIT) != 0; }
+
+    void SetInBand(size_t voxel, bool in_band) { flags[voxel] = in_band ? (flags[voxel] | BAND_BIT) : (flags[voxel] & ~BAND_BIT); }
+
+    double GetValue(size_t voxel) const { return values[voxel]; }
+
+    void SetValue(size_t voxel, double value) { values[voxel] = (float)value; }
+
+    double GetWeight(size_t voxel) const { return weights[voxel] / 65535.0; }
+
+    void SetWeight(size_t voxel, double weight) { weights[voxel] = (uint16_t)std::lround(std::min(std::max(weight, 0.0), 1.0) * 65535.0); }
+
+    Eigen::Vector3d GetColor(size_t voxel) const
+    {
+        return Eigen::Vector3d(colors[voxel * 3] / 255.0, colors[voxel * 3 + 1] / 255.0, colors[voxel * 3 + 2] / 255.0);
+    }
+
+    void SetColor(size_t voxel, uint8_t r, uint8_t g, uint8_t b)
+    {
+        colors[voxel * 3] = r;
+        colors[voxel * 3 + 1] = g;
+        colors[voxel * 3 + 2] = b;
+    }
+
+    void SetColor(size_t voxel, const Eigen::Vector3d& color)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            colors[voxel * 3 + i] = (uint8_t)std::lround(std::min(std::max(color[i], 0.0), 1.0) * 255.0);
+        }
+    }
+
+    /// <summary>
+    /// Copies a voxel's stored fields into a SingleVoxel, leaving its position and boundaries alone
+    /// </summary>
+    void Unpack(size_t voxel, SingleVoxel& unpacked) const
+    {
+        unpacked.value = GetValue(voxel);
+        unpacked.weight = GetWeight(voxel);
+        unpacked.color = GetColor(voxel);
+        unpacked.voxel_type = GetType(voxel);
+    }
+};
+
 /// <summary>
 /// Our own voxel grid, due to lack of faith in Open3D's grid
 /// </summary>
@@ -79,10 +235,178 @@ class MeshingVoxelGrid
 	int size_y;
 	int size_z;
 
-    //Array of voxels
-	SingleVoxel* grid;
+    //Position of the voxel at the lowest corner
+    Eigen::Vector3d origin;
+
+    MeshingVoxelStorage storage;
+
+    //The voxels - the whole box for dense storage, BRICK_VOXELS per slot for sparse storage
+    MeshingVoxelArrays voxels;
+
+    //Only occupancy is worked out, voxels keep their default color and images need no color
+    bool geometry_only = false;
+
+    //Voxels along each side of a brick
+    static const int BRICK_SIZE = 8;
+    static const int BRICK_VOXELS = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+
+    //Bricks are allocated around observed depth up to this many voxels away
+    static const int BRICK_BAND = 2;
+
+    //Bricks along each axis, the last ones may reach past the grid
+    int bricks_x = 0;
+    int bricks_y = 0;
+    int bricks_z = 0;
+
+    //Slot of each allocated brick, by brick index
+    std::unordered_map<int, int> brick_slots;
+
+    //Brick index of each slot
+    std::vector<int> slot_bricks;
+
+    //Voxels along each side of a carve cell - a brick for voxel driven grids, a little more than the band for pixel driven ones
+    int carve_size = BRICK_SIZE;
+
+    //Carve cells along each axis
+    int carve_x = 0;
+    int carve_y = 0;
+    int carve_z = 0;
+
+    //One voxel per carve cell carved at its center, whose type voxels that were never worked out on their own take
+    MeshingVoxelArrays carve_cells;
+
+    //Every image added to a sparse or pixel driven grid, in order
+    std::vector<MeshingCameraImage> images;
+
+    MeshingIntegrationMode integration_mode = MeshingIntegrationMode::VOXEL_DRIVEN;
+
+    //How far along a pixel's ray from the depth it saw voxels are updated, in voxels
+    int band_voxels_wide = 2;
+
+    //Most voxels either side of a ray a pixel updates, for voxels much smaller than a pixel
+    static const int MAX_BAND_SPLAT = 4;
+
+    //Every voxel some pixel's band reached, in the order they were reached
+    std::vector<size_t> band_voxels;
+
+    int DenseIndex(int x, int y, int z) { return (x * size_y + y) * size_z + z; }
+
+    int BrickIndex(int brick_x, int brick_y, int brick_z) { return (brick_x * bricks_y + brick_y) * bricks_z + brick_z; }
+
+    //Index of the carve cell a voxel is in
+    int CarveIndex(int x, int y, int z) { return ((x / carve_size) * carve_y + y / carve_size) * carve_z + z / carve_size; }
+
+    /// <summary>
+    /// Sets a voxel to its starting state
+    /// </summary>
+    void InitializeVoxel(size_t voxel, int x, int y, int z);
+
+    /// <summary>
+    /// Gets the pieces of an image the grid needs
+    /// </summary>
+    /// <param name="keep_color">: copies the color, for grids that replay images</param>
+    MeshingCameraImage PrepareImage(open3d::geometry::Image& color, open3d::geometry::Image& depth, Eigen::Matrix4d extrinsics, Eigen::Matrix3d intrinsics, bool keep_color);
+
+    /// <summary>
+    /// Updates a single voxel from a single camera
+    /// </summary>
+    /// <param name="arrays">: the arrays holding the voxel</param>
+    /// <param name="voxel">: the voxel's index in the arrays</param>
+    /// <param name="position">: the voxel's position</param>
+    /// <param name="image">: the camera's image</param>
+    /// <param name="color">: the color to use, nullptr for none</param>
+    /// <param name="culled">, solid, air: counts of what this camera made of the voxel</param>
+    void IntegrateVoxel(MeshingVoxelArrays& arrays, size_t voxel, const Eigen::Vector3d& position, const MeshingCameraImage& image, const open3d::geometry::Image* color, int& culled, int& solid, int& air);
+
+    /// <summary>
+    /// Applies what a camera saw at a voxel
+    /// </summary>
+    /// <param name="is_air">: the camera sees past the voxel, or sees nothing</param>
+    /// <param name="mag">: distance to the surface the camera sees, in voxels capped at 1</param>
+    /// <param name="rgb">: the color the camera sees, nullptr for none</param>
+    void ApplyVerdict(MeshingVoxelArrays& arrays, size_t voxel, bool is_air, double mag, const uint8_t* rgb, int& solid, int& air);
+
+    //Voxels projected together in the integration kernel
+    static const int KERNEL_LANES = 64;
+
+    //How close in pixels to an image edge, or to a pixel edge when reading color, the kernel leaves to IntegrateVoxel
+    static constexpr float KERNEL_PIXEL_MARGIN = 0.001f;
+
+    //How close in meters to the observed depth the kernel leaves to IntegrateVoxel
+    static constexpr float KERNEL_DEPTH_MARGIN = 0.002f;
+
+    /// <summary>
+    /// Integrates a run of voxels along z from a single camera, in floats. Voxels whose verdict floats could get wrong go
+    /// through IntegrateVoxel instead, so the result matches it voxel for voxel
+    /// </summary>
+    /// <param name="first_voxel">: index of the first voxel of the run, the rest follow it</param>
+    /// <param name="x">, y, z: coordinates of the first voxel</param>
+    /// <param name="count">: voxels in the run</param>
+    void IntegrateRun(size_t first_voxel, int x, int y, int z, int count, const MeshingCameraImage& image, const open3d::geometry::Image* color, int& culled, int& solid, int& air);
+
+    /// <summary>
+    /// Integrates every voxel of some bricks from a single camera, a brick per thread
+    /// </summary>
+    void IntegrateSlots(const std::vector<int>& slots, const MeshingCameraImage& image, const open3d::geometry::Image* color, int& culled, int& solid, int& air);
+
+    /// <summary>
+    /// Allocates every brick within BRICK_BAND voxels of a point seen by the camera
+    /// </summary>
+    /// <returns>Slots of the newly allocated bricks</returns>
+    std::vector<int> AllocateBricksAroundDepth(const MeshingCameraImage& image);
+
+    /// <summary>
+    /// Gives a brick memory, its voxels set to their starting state
+    /// </summary>
+    /// <returns>The brick's slot</returns>
+    int AllocateBrick(int brick);
+
+    /// <summary>
+    /// Returns the coordinates of a voxel from its index in the grid's arrays
+    /// </summary>
+    Eigen::Vector3i GetVoxelCoordinates(size_t voxel);
+
+    /// <summary>
+    /// Marches every depth pixel's ray through its band, adding voxels it reaches for the first time to band_voxels
+    /// </summary>
+    /// <returns>How many voxels were new</returns>
+    size_t MarchBands(const MeshingCameraImage& image);
+
+    /// <summary>
+    /// Integrates band voxels from a single camera, spread over threads
+    /// </summary>
+    /// <param name="first">: index in band_voxels to start at</param>
+    void IntegrateBandVoxels(size_t first, const MeshingCameraImage& image, const open3d::geometry::Image* color, int& culled, int& solid, int& air);
+
+    /// <summary>
+    /// Sets the carve cells' size, throwing away what they were carved to
+    /// </summary>
+    void ResizeCarveCells(int size);
+
+    /// <summary>
+    /// Carves every carve cell as if it were one big voxel at its center
+    /// </summary>
+    void CarveCells(const MeshingCameraImage& image);
+
+    //Whether a voxel from its index was worked out on its own, rather than taking its carve cell's type
+    bool IsWorkedOut(size_t voxel) { return (voxel != NO_VOXEL) && (integration_mode == MeshingIntegrationMode::VOXEL_DRIVEN || voxels.IsInBand(voxel)); }
+
+    //Type of a voxel from its index, voxels nothing worked out take their carve cell's type
+    MeshingVoxelType GetStoredType(size_t voxel, int x, int y, int z)
+    {
+        return IsWorkedOut(voxel) ? voxels.GetType(voxel) : carve_cells.GetType(CarveIndex(x, y, z));
+    }
+
+    /// <summary>
+    /// Fills whether each voxel of a plane of x is solid, indexed y * size_z + z
+    /// </summary>
+    /// <param name="bricks">: for sparse grids, which bricks to read by brick index</param>
+    void LoadPlaneSolidity(int x, const std::vector<uint8_t>& bricks, std::vector<uint8_t>& solid);
 
 public:
+    //Index FindVoxel returns for voxels without memory
+    static const size_t NO_VOXEL = (size_t)-1;
+
 	/// <summary>
 	/// Grid constructor - say hi! :D
 	/// </summary>
@@ -91,7 +415,8 @@ public:
 	/// <param name="voxels_y">: how many voxels on y axis</param>
 	/// <param name="voxels_z">: how many voxels on z axis</param>
 	/// <param name="center">: allows you to offset the default position of the grid, in case cameras are not centered</param>
-	MeshingVoxelGrid(double voxel_size, int voxels_x, int voxels_y, int voxels_z, Eigen::Vector3d center);
+	/// <param name="storage">: how the voxels are stored</param>
+	MeshingVoxelGrid(double voxel_size, int voxels_x, int voxels_y, int voxels_z, Eigen::Vector3d center, MeshingVoxelStorage storage = MeshingVoxelStorage::DENSE);
 
     //Default destructor - Say goodbye! :(
 	~MeshingVoxelGrid();
@@ -105,13 +430,30 @@ public:
 	/// <param name="intrinsics">: intrinsics of the camera</param>
 	void AddImage(open3d::geometry::Image& color, open3d::geometry::Image& depth, Eigen::Matrix4d extrinsics, Eigen::Matrix3d intrinsics);
 
+    /// <summary>
+    /// Skips voxel colors, so cameras need not decode their color images
+    /// </summary>
+    void SetGeometryOnly(bool geometry_only) { this->geometry_only = geometry_only; }
+
+    bool IsGeometryOnly() { return geometry_only; }
+
+    /// <summary>
+    /// Sets how images are brought into the grid, call before adding any
+    /// </summary>
+    /// <param name="mode">: the mode</param>
+    /// <param name="band">: for pixel driven grids, how many voxels either side of the depth a pixel saw are updated</param>
+    void SetIntegrationMode(MeshingIntegrationMode mode, int band = 2);
+
+    MeshingIntegrationMode GetIntegrationMode() { return integration_mode; }
+
     /// <summary>
     /// Culls all voxels that don't belong to a camera - converts them from undecided to air
     /// </summary>
     void KillEmptySpace();
 
     /// <summary>
-    /// Returns the mesh from the voxel grid
+    /// Returns the mesh from the voxel grid, with one vertex per grid edge the surface crosses shared by every triangle on it.
+    /// Planes of x are spread over threads, and the mesh comes out the same whatever the thread count
     /// </summary>
     std::shared_ptr<open3d::geometry::TriangleMesh> ExtractMesh();
 
@@ -120,6 +462,18 @@ public:
 	/// </summary>
 	int GetVoxelCount() { return size_x * size_y * size_z; }
 
+    /// <summary>
+    /// Returns how many voxels have memory behind them
+    /// </summary>
+    size_t GetAllocatedVoxelCount() { return voxels.Size(); }
+
+    /// <summary>
+    /// Returns the bytes held by the voxels and everything kept to fill them
+    /// </summary>
+    size_t GetMemoryBytes();
+
+    MeshingVoxelStorage GetStorage() { return storage; }
+
 	/// <summary>
 	/// Returns the X dimension of the voxels
 	/// </summary>
@@ -135,10 +489,73 @@ public:
     /// </summary>
 	int GetSizeZ() { return size_z;	}
 
+    /// <summary>
+    /// Returns where a voxel sits in local space
+    /// </summary>
+    Eigen::Vector3d GetPosition(int x, int y, int z) { return origin + voxel_size * Eigen::Vector3d((double)x, (double)y, (double)z); }
+
+    /// <summary>
+    /// Finds a voxel's index in the grid's arrays
+    /// </summary>
+    /// <returns>The index, NO_VOXEL if it lies in a brick that was never allocated</returns>
+    size_t FindVoxel(int x, int y, int z);
+
+    /// <summary>
+    /// Gets a voxel unpacked with its position and boundaries, voxels nothing worked out take their carve cell's type
+    /// </summary>
+    SingleVoxel GetVoxel(int x, int y, int z);
+
+    /// <summary>
+    /// Calls a function on every voxel that has memory behind it, with the voxel's index and coordinates
+    /// </summary>
+    template<class F>
+    void ForEachVoxel(F function)
+    {
+        if (storage == MeshingVoxelStorage::DENSE)
+        {
+            size_t grid_loc = 0;
+
+            for (int x = 0; x < size_x; ++x)
+                for (int y = 0; y < size_y; ++y)
+                    for (int z = 0; z < size_z; ++z, ++grid_loc)
+                        function(grid_loc, x, y, z);
+
+            return;
+        }
+
+        for (int slot = 0; slot < slot_bricks.size(); ++slot)
+        {
+            int brick = slot_bricks[slot];
+
+            int start_x = (brick / (bricks_z * bricks_y)) * BRICK_SIZE;
+            int start_y = ((brick / bricks_z) % bricks_y) * BRICK_SIZE;
+            int start_z = (brick % bricks_z) * BRICK_SIZE;
+
+            for (int local = 0; local < BRICK_VOXELS; ++local)
+            {
+                int x = start_x + local / (BRICK_SIZE * BRICK_SIZE);
+                int y = start_y + (local / BRICK_SIZE) % BRICK_SIZE;
+                int z = start_z + local % BRICK_SIZE;
+
+                if (x < size_x && y < size_y && z < size_z)
+                {
+                    function((size_t)slot * BRICK_VOXELS + local, x, y, z);
+                }
+            }
+        }
+    }
+
 	/// <summary>
 	/// Operator overloard for getting a voxel from the grid
 	/// </summary>
-	SingleVoxel operator[](std::size_t idx) { return grid[idx]; }
+	SingleVoxel operator[](std::size_t idx) { return GetVoxel((int)(idx / ((size_t)size_y * size_z)), (int)((idx / size_z) % size_y), (int)(idx % size_z)); }
+
+    /// <summary>
+    /// Compares passes over this grid's arrays against the same passes over an array of SingleVoxel, printing memory and speed
+    /// </summary>
+    /// <param name="voxels_x">, voxels_y, voxels_z: size of the box to compare over</param>
+    /// <param name="iterations">: times each pass is run</param>
+    static void BenchmarkLayout(int voxels_x, int voxels_y, int voxels_z, int iterations);
 
     /// <summary>
     /// Interpolates between 2 elements of the voxel array, according to the voxel's values
@@ -150,10 +567,13 @@ public:
     MeshingVoxelEdge LerpCorner(SingleVoxel* voxel_array, int elem1, int elem2);
 
     /// <summary>
-    /// Performs a pseudo-smoothing operation, and attempts to destroy unwanted noise
+    /// Destroys unwanted noise - labels the pieces of solid voxels touching along their faces, and turns the small ones to air.
+    /// Carve cells are labelled in parallel and then joined across their borders. A cell with no voxel worked out on its own is
+    /// labelled as one piece, so the time taken follows the worked out voxels
     /// </summary>
-    /// <param name="artifact_size">How big of an artifact to look for - too big values may distort grid</param>
-    void CullArtifacts(int artifact_size);
+    /// <param name="artifact_size">: pieces of this many solid voxels or fewer are culled, 0 culls none by size</param>
+    /// <param name="keep_largest">: if above 0, only this many of the largest pieces are kept</param>
+    void CullArtifacts(int artifact_size, int keep_largest = 0);
 
     /// <summary>
     /// Voxel grid black magic
@@ -453,4 +873,13 @@ public:
         {0, 3, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
         {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}
     };
+
+    /// <summary>
+    /// For each edge of the tables, the corner of the cell it starts from as x, y, z offsets, then the axis it runs along
+    /// </summary>
+    const int edge_origins[12][4] = {
+        {0, 0, 0, 0}, {1, 0, 0, 1}, {0, 1, 0, 0}, {0, 0, 0, 1},
+        {0, 0, 1, 0}, {1, 0, 1, 1}, {0, 1, 1, 0}, {0, 0, 1, 1},
+        {0, 0, 0, 2}, {1, 0, 0, 2}, {1, 1, 0, 2}, {0, 1, 0, 2}
+    };
 };
\ No newline at end of file
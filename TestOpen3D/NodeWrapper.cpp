@@ -98,6 +98,24 @@ void NodeWrapper::PrintHelp() {
 	DebugLine(">   --EnableCamera [int, cameraNum]");
 	DebugLine(">   Enables a disabled camera");
 	DebugLine("");
+	DebugLine(">   --FrameCache [int, megabytes]");
+	DebugLine(">   Sets how much memory decoded image frames may be cached in, 0 disables (default 512)");
+	DebugLine("");
+	DebugLine(">   --FrameIndex [int, 0/1]");
+	DebugLine(">   Turns off/on the index files kept in image camera folders to skip rescanning them on load (default 1) - call before 'LoadCameras'");
+	DebugLine("");
+	DebugLine(">   --PackCameras [string, outputFolder] [string, structureFileName]");
+	DebugLine(">   Packs every loaded Livescan/image camera into one container file each, loadable afterwards as a .structure dataset");
+	DebugLine("");
+	DebugLine(">   --MakeSyntheticRig [string, outputFolder] [string, structureFileName] [int, cameras] [int, frames] [float, depth noise in mm]");
+	DebugLine(">   Writes a ring of synthetic cameras rendering an animated figure, loadable with 'LoadCamerasStructure' - no recordings needed");
+	DebugLine("");
+	DebugLine(">   --SyncTimeline [int, tolerance in microseconds]");
+	DebugLine(">   Matches the captures of all cameras into one timeline, skipping cameras with no capture close enough; 0 uses half a frame, -1 drops the timeline");
+	DebugLine("");
+	DebugLine(">   --SetDepthTransform [int, cameraNum] [string, k4a/tables/compare]");
+	DebugLine(">   Chooses how a camera moves depth into the color image - k4a's transformation (default), precomputed tables, or both with a comparison printed. Use -1 for all cameras");
+	DebugLine("");
 	DebugLine(">   --EditVoxelGridData");
 	DebugLine(">   Edits voxel grid data depending on the following commands: ");
 	DebugLine(">   >   --blocks [int] -> controls the blocks in the grid (default 1000");
@@ -106,6 +124,7 @@ void NodeWrapper::PrintHelp() {
 	DebugLine(">   >   --deviceCode [string] -> which device to use (default CPU:0)");
 	DebugLine(">   >   --sdfTrunc [float] -> grid will not show changes that are less significant than this number (default 0.04f)");
 	DebugLine(">   >   --voxel_size [float] -> the size of a single voxel (default 0.005859375f)");
+	DebugLine(">   >   --depthSpace [int, 0/1] -> integrates at the depth camera's resolution, mapping color onto depth instead of depth onto color (default 0)");
 	DebugLine("");
 	DebugLine(">   --MakeObj [ulong, time] [string, filename] [string, filepath]");
 	DebugLine(">   Extracts an OBJ mesh from the current data at the provided time, and saves it as filename in filepath");
@@ -113,6 +132,51 @@ void NodeWrapper::PrintHelp() {
 	DebugLine(">   --TextureObj [string, .obj file] [ulong, time] [string, filename] [string, filepath]");
 	DebugLine(">   Textures a pre-existing OBJ file according to present data, then save it as filename in filepath");
 	DebugLine("");
+	DebugLine(">   --MakeObjSequence [ulong, start time] [int, frame count] [string, filename] [string, filepath]");
+	DebugLine(">   Extracts consecutive OBJ meshes starting at the provided time, saving each as filename followed by its frame number");
+	DebugLine("");
+	DebugLine(">   --MakeObjMeshingGrid [ulong, time] [int, artifact size] [string, filename] [string, filepath]");
+	DebugLine(">   Extracts an OBJ mesh through our own voxel grid at the provided time, printing its memory and time taken");
+	DebugLine("");
+	DebugLine(">   --MeshingGridStorage [string, dense/sparse]");
+	DebugLine(">   Chooses how 'MakeObjMeshingGrid' stores voxels - bricks only near observed depth (default), or the whole box as a reference");
+	DebugLine("");
+	DebugLine(">   --MeshingGridIntegration [string, voxels/pixels] [int, band]");
+	DebugLine(">   Chooses whether 'MakeObjMeshingGrid' visits every voxel per image (default), or only band voxels either side of each depth pixel");
+	DebugLine("");
+	DebugLine(">   --MeshingGridKeepLargest [int, count]");
+	DebugLine(">   Makes 'MakeObjMeshingGrid' keep only the count largest solid pieces, 0 keeps all (default)");
+	DebugLine("");
+	DebugLine(">   --BenchmarkMeshingLayout [int, iterations]");
+	DebugLine(">   Compares memory and speed of the meshing grid's voxel arrays against the old single voxel struct");
+	DebugLine("");
+	DebugLine(">   --Prefetch [int, depth] [int, threads]");
+	DebugLine(">   Decodes up to depth frames ahead per camera on background threads, 0 disables (default 0)");
+	DebugLine("");
+	DebugLine(">   --PrefetchStats");
+	DebugLine(">   Prints how often a prefetched frame was ready, and how long was spent waiting on decoding");
+	DebugLine("");
+	DebugLine(">   --AsyncReads [int, queue depth] [int, megabytes in flight]");
+	DebugLine(">   Reads every image camera's files for a frame in one batch, decoding each camera as its files land, 0 disables (default 0)");
+	DebugLine("");
+	DebugLine(">   --AsyncReadStats");
+	DebugLine(">   Prints how many files and bytes were read in batches, and how fast");
+	DebugLine("");
+	DebugLine(">   --ColorDecodeScale [int, 1 2 4 or 8]");
+	DebugLine(">   Decodes JPG color at a fraction of its resolution for previews, intrinsics and depth follow (default 1)");
+	DebugLine("");
+	DebugLine(">   --ColorDecodeAuto [float, min x] [float, min y] [float, min z] [float, max x] [float, max y] [float, max z]");
+	DebugLine(">   Decodes only the part of each camera's JPG color the subject's box covers, as coarse as the voxel size allows");
+	DebugLine("");
+	DebugLine(">   --FrameCopyStats");
+	DebugLine(">   Prints how many decoded images were copied since last asked, frames are otherwise shared");
+	DebugLine("");
+	DebugLine(">   --BenchmarkColorDecode [int, iterations]");
+	DebugLine(">   Times decoding the current MJPEG frame of every MKV camera, directly to RGB against the old BGRA path");
+	DebugLine("");
+	DebugLine(">   --BenchmarkDepthCodec [int, iterations]");
+	DebugLine(">   Compares size and speed of the RVL depth codec against PNG on every camera's current depth frame");
+	DebugLine("");
 }
 
 void NodeWrapper::PerformOperations(int maxSpecs, char** specs)
@@ -190,6 +254,90 @@ void NodeWrapper::PerformOperations(int maxSpecs, char** specs)
 			{
 				currentSpec += EnableCamera(currentSpec, false);
 			}
+			else if (spec == "--MakeObjSequence")
+			{
+				currentSpec += MakeOBJSequence(currentSpec);
+			}
+			else if (spec == "--Prefetch")
+			{
+				currentSpec += SetPrefetch(currentSpec);
+			}
+			else if (spec == "--PrefetchStats")
+			{
+				currentSpec += PrefetchStats(currentSpec);
+			}
+			else if (spec == "--AsyncReads")
+			{
+				currentSpec += SetAsyncReads(currentSpec);
+			}
+			else if (spec == "--AsyncReadStats")
+			{
+				currentSpec += AsyncReadStats(currentSpec);
+			}
+			else if (spec == "--ColorDecodeScale")
+			{
+				currentSpec += SetColorDecodeScale(currentSpec);
+			}
+			else if (spec == "--ColorDecodeAuto")
+			{
+				currentSpec += ChooseColorDecodeRegions(currentSpec);
+			}
+			else if (spec == "--FrameCopyStats")
+			{
+				currentSpec += FrameCopyStats(currentSpec);
+			}
+			else if (spec == "--BenchmarkColorDecode")
+			{
+				currentSpec += BenchmarkColorDecode(currentSpec);
+			}
+			else if (spec == "--BenchmarkDepthCodec")
+			{
+				currentSpec += BenchmarkDepthCodec(currentSpec);
+			}
+			else if (spec == "--SetDepthTransform")
+			{
+				currentSpec += SetDepthTransform(currentSpec);
+			}
+			else if (spec == "--FrameCache")
+			{
+				currentSpec += SetFrameCache(currentSpec);
+			}
+			else if (spec == "--FrameIndex")
+			{
+				currentSpec += SetFrameIndex(currentSpec);
+			}
+			else if (spec == "--MakeSyntheticRig")
+			{
+				currentSpec += MakeSyntheticRig(currentSpec);
+			}
+			else if (spec == "--SyncTimeline")
+			{
+				currentSpec += SyncTimeline(currentSpec);
+			}
+			else if (spec == "--PackCameras")
+			{
+				currentSpec += PackCameras(currentSpec);
+			}
+			else if (spec == "--MakeObjMeshingGrid")
+			{
+				currentSpec += MakeOBJMeshingGrid(currentSpec);
+			}
+			else if (spec == "--MeshingGridStorage")
+			{
+				currentSpec += SetMeshingGridStorage(currentSpec);
+			}
+			else if (spec == "--MeshingGridIntegration")
+			{
+				currentSpec += SetMeshingGridIntegration(currentSpec);
+			}
+			else if (spec == "--MeshingGridKeepLargest")
+			{
+				currentSpec += SetMeshingGridKeepLargest(currentSpec);
+			}
+			else if (spec == "--BenchmarkMeshingLayout")
+			{
+				currentSpec += BenchmarkMeshingLayout(currentSpec);
+			}
 			else if (spec == "--help")
 			{
 				PrintHelp();
@@ -270,6 +418,142 @@ int NodeWrapper::MakeOBJ(int startingLoc)
 	return argAmount;
 }
 
+int NodeWrapper::MakeOBJMeshingGrid(int startingLoc)
+{
+	int argAmount = 4;
+
+	if (specsLength < startingLoc + argAmount)
+	{
+		std::cout << "Invalid argument amount" << std::endl;
+
+		return argAmount;
+	}
+
+	auto obj = cm->GetMeshUsingNewVoxelGridAtTimestamp(std::stoi(pseudoSpecs[startingLoc + 1]), std::stoull(pseudoSpecs[startingLoc]));
+
+	WriteOBJ(pseudoSpecs[startingLoc + 2] + ".obj", pseudoSpecs[startingLoc + 3], obj.get());
+
+	return argAmount;
+}
+
+int NodeWrapper::SetMeshingGridStorage(int startingLoc)
+{
+	int argAmount = 1;
+
+	if (specsLength < startingLoc + argAmount)
+	{
+		std::cout << "Invalid argument amount" << std::endl;
+
+		return argAmount;
+	}
+
+	if (pseudoSpecs[startingLoc] == "dense")
+	{
+		cm->SetMeshingStorage(MeshingVoxelStorage::DENSE);
+	}
+	else if (pseudoSpecs[startingLoc] == "sparse")
+	{
+		cm->SetMeshingStorage(MeshingVoxelStorage::SPARSE);
+	}
+	else
+	{
+		std::cout << "Unknown meshing grid storage: " << pseudoSpecs[startingLoc] << std::endl;
+	}
+
+	return argAmount;
+}
+
+int NodeWrapper::SetMeshingGridIntegration(int startingLoc)
+{
+	int argAmount = 2;
+
+	if (specsLength < startingLoc + argAmount)
+	{
+		std::cout << "Invalid argument amount" << std::endl;
+
+		return argAmount;
+	}
+
+	int band = std::stoi(pseudoSpecs[startingLoc + 1]);
+
+	if (pseudoSpecs[startingLoc] == "voxels")
+	{
+		cm->SetMeshingIntegration(MeshingIntegrationMode::VOXEL_DRIVEN, band);
+	}
+	else if (pseudoSpecs[startingLoc] == "pixels")
+	{
+		cm->SetMeshingIntegration(MeshingIntegrationMode::PIXEL_DRIVEN, band);
+	}
+	else
+	{
+		std::cout << "Unknown meshing grid integration: " << pseudoSpecs[startingLoc] << std::endl;
+	}
+
+	return argAmount;
+}
+
+int NodeWrapper::SetMeshingGridKeepLargest(int startingLoc)
+{
+	int argAmount = 1;
+
+	if (specsLength < startingLoc + argAmount)
+	{
+		std::cout << "Invalid argument amount" << std::endl;
+
+		return argAmount;
+	}
+
+	cm->SetMeshingKeepLargest(std::stoi(pseudoSpecs[startingLoc]));
+
+	return argAmount;
+}
+
+int NodeWrapper::BenchmarkMeshingLayout(int startingLoc)
+{
+	int argAmount = 1;
+
+	if (specsLength < startingLoc + argAmount)
+	{
+		std::cout << "Invalid argument amount" << std::endl;
+
+		return argAmount;
+	}
+
+	cm->BenchmarkMeshingLayout(std::stoi(pseudoSpecs[startingLoc]));
+
+	return argAmount;
+}
+
+int NodeWrapper::MakeOBJSequence(int startingLoc)
+{
+	int argAmount = 4;
+
+	if (specsLength < startingLoc + argAmount)
+	{
+		std::cout << "Invalid argument amount" << std::endl;
+
+		return argAmount;
+	}
+
+	int frame_count = std::stoi(pseudoSpecs[startingLoc + 1]);
+
+	cm->AllCamerasSeekTimestamp(std::stoull(pseudoSpecs[startingLoc]));
+
+	for (int i = 0; i < frame_count; ++i)
+	{
+		auto obj = cm->GetMesh(vgd).ToLegacyTriangleMesh();
+
+		WriteOBJ(pseudoSpecs[startingLoc + 2] + GetNumberFixedLength(i, 8) + ".obj", pseudoSpecs[startingLoc + 3], &obj);
+
+		if (i < frame_count - 1 && !cm->CycleAllCamerasForward())
+		{
+			break;
+		}
+	}
+
+	return argAmount;
+}
+
 int NodeWrapper::TextureOBJ(int startingLoc)
 {
 	int argAmount = 4;
@@ -390,6 +674,12 @@ int NodeWrapper::SetVoxelGridData(int startingLoc)
 
 			vgd->voxel_size = std::stof(pseudoSpecs[currentSpec]);
 		}
+		else if (spec == "--depthSpace")
+		{
+			++currentSpec;
+
+			vgd->integrate_in_depth_space = (std::stoi(pseudoSpecs[currentSpec]) != 0);
+		}
 		else
 		{
 			return currentSpec - startingLoc;
@@ -421,3 +711,243 @@ int NodeWrapper::CleanupMeshPoisson(int startingLoc)
 {
 	return 0;
 }
+
+int NodeWrapper::SetPrefetch(int startingLoc)
+{
+	int argAmount = 2;
+
+	if (specsLength < startingLoc + argAmount)
+	{
+		std::cout << "Invalid argument amount" << std::endl;
+
+		return argAmount;
+	}
+
+	cm->SetPrefetch(std::stoi(pseudoSpecs[startingLoc]), std::stoi(pseudoSpecs[startingLoc + 1]));
+
+	return argAmount;
+}
+
+int NodeWrapper::PrefetchStats(int startingLoc)
+{
+	cm->PrintPrefetchStats();
+
+	return 0;
+}
+
+int NodeWrapper::SetAsyncReads(int startingLoc)
+{
+	int argAmount = 2;
+
+	if (specsLength < startingLoc + argAmount)
+	{
+		std::cout << "Invalid argument amount" << std::endl;
+
+		return argAmount;
+	}
+
+	cm->SetAsyncReads(std::stoi(pseudoSpecs[startingLoc]), std::stoul(pseudoSpecs[startingLoc + 1]));
+
+	return argAmount;
+}
+
+int NodeWrapper::AsyncReadStats(int startingLoc)
+{
+	cm->PrintAsyncReadStats();
+
+	return 0;
+}
+
+int NodeWrapper::SetColorDecodeScale(int startingLoc)
+{
+	int argAmount = 1;
+
+	if (specsLength < startingLoc + argAmount)
+	{
+		std::cout << "Invalid argument amount" << std::endl;
+
+		return argAmount;
+	}
+
+	cm->SetColorDecodeScale(std::stoi(pseudoSpecs[startingLoc]));
+
+	return argAmount;
+}
+
+int NodeWrapper::ChooseColorDecodeRegions(int startingLoc)
+{
+	int argAmount = 6;
+
+	if (specsLength < startingLoc + argAmount)
+	{
+		std::cout << "Invalid argument amount" << std::endl;
+
+		return argAmount;
+	}
+
+	Eigen::Vector3d box_min(std::stod(pseudoSpecs[startingLoc]), std::stod(pseudoSpecs[startingLoc + 1]), std::stod(pseudoSpecs[startingLoc + 2]));
+	Eigen::Vector3d box_max(std::stod(pseudoSpecs[startingLoc + 3]), std::stod(pseudoSpecs[startingLoc + 4]), std::stod(pseudoSpecs[startingLoc + 5]));
+
+	cm->ChooseColorDecodeRegions(vgd, box_min, box_max);
+
+	return argAmount;
+}
+
+int NodeWrapper::FrameCopyStats(int startingLoc)
+{
+	MKV_Rendering::FramePool::PrintCopyStats();
+
+	return 0;
+}
+
+int NodeWrapper::BenchmarkColorDecode(int startingLoc)
+{
+	int argAmount = 1;
+
+	if (specsLength < startingLoc + argAmount)
+	{
+		std::cout << "Invalid argument amount" << std::endl;
+
+		return argAmount;
+	}
+
+	cm->BenchmarkColorDecode(std::stoi(pseudoSpecs[startingLoc]));
+
+	return argAmount;
+}
+
+int NodeWrapper::BenchmarkDepthCodec(int startingLoc)
+{
+	int argAmount = 1;
+
+	if (specsLength < startingLoc + argAmount)
+	{
+		std::cout << "Invalid argument amount" << std::endl;
+
+		return argAmount;
+	}
+
+	cm->BenchmarkDepthCodec(std::stoi(pseudoSpecs[startingLoc]));
+
+	return argAmount;
+}
+
+int NodeWrapper::SetDepthTransform(int startingLoc)
+{
+	int argAmount = 2;
+
+	if (specsLength < startingLoc + argAmount)
+	{
+		std::cout << "Invalid argument amount" << std::endl;
+
+		return argAmount;
+	}
+
+	DepthTransformMode mode;
+
+	if (!Abstract_Data::ParseDepthTransformMode(pseudoSpecs[startingLoc + 1], mode))
+	{
+		std::cout << "Unknown depth transform: " << pseudoSpecs[startingLoc + 1] << std::endl;
+
+		return argAmount;
+	}
+
+	cm->SetDepthTransformMode(std::stoi(pseudoSpecs[startingLoc]), mode);
+
+	return argAmount;
+}
+
+int NodeWrapper::SetFrameCache(int startingLoc)
+{
+	int argAmount = 1;
+
+	if (specsLength < startingLoc + argAmount)
+	{
+		std::cout << "Invalid argument amount" << std::endl;
+
+		return argAmount;
+	}
+
+	cm->SetFrameCacheBudget(std::stoull(pseudoSpecs[startingLoc]));
+
+	return argAmount;
+}
+
+int NodeWrapper::SetFrameIndex(int startingLoc)
+{
+	int argAmount = 1;
+
+	if (specsLength < startingLoc + argAmount)
+	{
+		std::cout << "Invalid argument amount" << std::endl;
+
+		return argAmount;
+	}
+
+	cm->SetFrameIndexEnabled(std::stoi(pseudoSpecs[startingLoc]) != 0);
+
+	return argAmount;
+}
+
+int NodeWrapper::MakeSyntheticRig(int startingLoc)
+{
+	int argAmount = 5;
+
+	if (specsLength < startingLoc + argAmount)
+	{
+		std::cout << "Invalid argument amount" << std::endl;
+
+		return argAmount;
+	}
+
+	cm->MakeSyntheticRig(
+		pseudoSpecs[startingLoc],
+		pseudoSpecs[startingLoc + 1],
+		std::stoi(pseudoSpecs[startingLoc + 2]),
+		std::stoi(pseudoSpecs[startingLoc + 3]),
+		std::stod(pseudoSpecs[startingLoc + 4])
+	);
+
+	return argAmount;
+}
+
+int NodeWrapper::SyncTimeline(int startingLoc)
+{
+	int argAmount = 1;
+
+	if (specsLength < startingLoc + argAmount)
+	{
+		std::cout << "Invalid argument amount" << std::endl;
+
+		return argAmount;
+	}
+
+	long long tolerance = std::stoll(pseudoSpecs[startingLoc]);
+
+	if (tolerance < 0)
+	{
+		cm->ClearTimeline();
+	}
+	else
+	{
+		cm->BuildTimeline(tolerance);
+	}
+
+	return argAmount;
+}
+
+int NodeWrapper::PackCameras(int startingLoc)
+{
+	int argAmount = 2;
+
+	if (specsLength < startingLoc + argAmount)
+	{
+		std::cout << "Invalid argument amount" << std::endl;
+
+		return argAmount;
+	}
+
+	cm->PackCameras(pseudoSpecs[startingLoc], pseudoSpecs[startingLoc + 1]);
+
+	return argAmount;
+}
@@ -47,4 +47,46 @@ protected:
 	int EnableCamera(int startingLoc, bool enable);
 
 	int CleanupMeshPoisson(int startingLoc);
+
+	int SetPrefetch(int startingLoc);
+
+	int PrefetchStats(int startingLoc);
+
+	int SetAsyncReads(int startingLoc);
+
+	int AsyncReadStats(int startingLoc);
+
+	int FrameCopyStats(int startingLoc);
+
+	int SetColorDecodeScale(int startingLoc);
+
+	int ChooseColorDecodeRegions(int startingLoc);
+
+	int MakeOBJSequence(int startingLoc);
+
+	int BenchmarkColorDecode(int startingLoc);
+
+	int BenchmarkDepthCodec(int startingLoc);
+
+	int SetDepthTransform(int startingLoc);
+
+	int SetFrameCache(int startingLoc);
+
+	int SetFrameIndex(int startingLoc);
+
+	int SyncTimeline(int startingLoc);
+
+	int MakeSyntheticRig(int startingLoc);
+
+	int PackCameras(int startingLoc);
+
+	int MakeOBJMeshingGrid(int startingLoc);
+
+	int SetMeshingGridStorage(int startingLoc);
+
+	int SetMeshingGridIntegration(int startingLoc);
+
+	int SetMeshingGridKeepLargest(int startingLoc);
+
+	int BenchmarkMeshingLayout(int startingLoc);
 };
\ No newline at end of file
@@ -0,0 +1,273 @@
+#include "PackedContainer.h"
+#include "ErrorLogger.h"
+
+#include <cstring>
+#include <algorithm>
+
+MKV_Rendering::PackedContainerWriter::PackedContainerWriter()
+{
+}
+
+void MKV_Rendering::PackedContainerWriter::PadToChunk()
+{
+	static const char zeros[CHUNK_SIZE] = {};
+
+	uint64_t position = (uint64_t)file.tellp();
+	uint64_t padding = (CHUNK_SIZE - position % CHUNK_SIZE) % CHUNK_SIZE;
+
+	file.write(zeros, padding);
+}
+
+bool MKV_Rendering::PackedContainerWriter::AppendPayload(std::string payload_path, uint64_t& offset, uint32_t& size)
+{
+	std::ifstream payload(payload_path, std::ios::binary | std::ios::ate);
+
+	if (!payload.is_open())
+	{
+		ErrorLogger::LOG_ERROR("Could not open " + payload_path + "!");
+		return false;
+	}
+
+	size_t payload_size = (size_t)payload.tellg();
+	payload.seekg(0, std::ios::beg);
+
+	read_buffer.resize(payload_size);
+	payload.read(read_buffer.data(), payload_size);
+
+	offset = (uint64_t)file.tellp();
+	size = (uint32_t)payload_size;
+
+	file.write(read_buffer.data(), payload_size);
+
+	return payload.good() && file.good();
+}
+
+bool MKV_Rendering::PackedContainerWriter::Begin(std::string container_path, const k4a_calibration_t& calibration, const Eigen::Matrix4d& extrinsic, bool depth_in_color_space)
+{
+	path = container_path;
+	file.open(path, std::ios::binary | std::ios::trunc);
+
+	if (!file.is_open())
+	{
+		ErrorLogger::LOG_ERROR("Could not create " + path + "!");
+		return false;
+	}
+
+	header = PackedContainerHeader();
+	header.calibration = calibration;
+	header.depth_in_color_space = depth_in_color_space ? 1 : 0;
+
+	for (int i = 0; i < 16; ++i)
+	{
+		header.extrinsic[i] = extrinsic(i / 4, i % 4);
+	}
+
+	frames.clear();
+
+	for (auto& previous : previous_paths)
+	{
+		previous = "";
+	}
+
+	//Written properly once the tables are known
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	PadToChunk();
+
+	return file.good();
+}
+
+bool MKV_Rendering::PackedContainerWriter::AddFrame(uint64_t timestamp, std::string color_path, std::string depth_path, std::string matte_path)
+{
+	if (!frames.empty() && timestamp < frames.back().timestamp)
+	{
+		ErrorLogger::LOG_ERROR("Frame at " + std::to_string(timestamp) + " is before the previous frame!");
+		return false;
+	}
+
+	std::string paths[(int)PackedStream::COUNT] = { color_path, depth_path, matte_path };
+
+	PackedFrameRecord record;
+	record.timestamp = timestamp;
+
+	PadToChunk();
+
+	for (int s = 0; s < (int)PackedStream::COUNT; ++s)
+	{
+		if (paths[s] == "")
+		{
+			previous_paths[s] = "";
+			continue;
+		}
+
+		if (!frames.empty() && paths[s] == previous_paths[s])
+		{
+			record.offsets[s] = frames.back().offsets[s];
+			record.sizes[s] = frames.back().sizes[s];
+			continue;
+		}
+
+		if (!AppendPayload(paths[s], record.offsets[s], record.sizes[s]))
+		{
+			return false;
+		}
+
+		previous_paths[s] = paths[s];
+	}
+
+	frames.push_back(record);
+
+	return true;
+}
+
+bool MKV_Rendering::PackedContainerWriter::Finish()
+{
+	header.frame_count = frames.size();
+
+	PadToChunk();
+	header.frame_table_offset = (uint64_t)file.tellp();
+	file.write(reinterpret_cast<const char*>(frames.data()), frames.size() * sizeof(PackedFrameRecord));
+
+	//Buckets as wide as the average frame interval hold about one frame each
+	std::vector<uint64_t> time_buckets;
+
+	if (!frames.empty())
+	{
+		header.first_timestamp = frames.front().timestamp;
+
+		uint64_t duration = frames.back().timestamp - frames.front().timestamp;
+
+		header.time_bucket_width = std::max<uint64_t>(1, (frames.size() > 1) ? duration / (frames.size() - 1) : 1);
+		header.time_bucket_count = duration / header.time_bucket_width + 1;
+
+		time_buckets.resize(header.time_bucket_count);
+
+		size_t frame = 0;
+
+		for (uint64_t b = 0; b < header.time_bucket_count; ++b)
+		{
+			uint64_t bucket_start = header.first_timestamp + b * header.time_bucket_width;
+
+			while (frame < frames.size() && frames[frame].timestamp < bucket_start)
+			{
+				++frame;
+			}
+
+			time_buckets[b] = frame;
+		}
+	}
+
+	header.time_table_offset = (uint64_t)file.tellp();
+	file.write(reinterpret_cast<const char*>(time_buckets.data()), time_buckets.size() * sizeof(uint64_t));
+
+	file.seekp(0);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	bool success = file.good();
+
+	file.close();
+
+	if (!success)
+	{
+		ErrorLogger::LOG_ERROR("Failed to write " + path + "!");
+	}
+
+	return success;
+}
+
+MKV_Rendering::PackedContainer::PackedContainer()
+{
+}
+
+bool MKV_Rendering::PackedContainer::Open(std::string container_path)
+{
+	header = nullptr;
+	frames = nullptr;
+	time_buckets = nullptr;
+
+	if (!mapping.Open(container_path))
+	{
+		ErrorLogger::LOG_ERROR("Could not map " + container_path + "!");
+		return false;
+	}
+
+	auto data = mapping.GetData();
+	auto size = mapping.GetSize();
+
+	PackedContainerHeader expected;
+	auto candidate = reinterpret_cast<const PackedContainerHeader*>(data);
+
+	if (size < sizeof(PackedContainerHeader) ||
+		std::memcmp(candidate->magic, expected.magic, sizeof(expected.magic)) != 0 ||
+		candidate->version != expected.version)
+	{
+		ErrorLogger::LOG_ERROR(container_path + " is not a packed container!");
+		mapping.Close();
+		return false;
+	}
+
+	if (candidate->frame_table_offset + candidate->frame_count * sizeof(PackedFrameRecord) > size ||
+		candidate->time_table_offset + candidate->time_bucket_count * sizeof(uint64_t) > size ||
+		candidate->time_bucket_width == 0)
+	{
+		ErrorLogger::LOG_ERROR(container_path + " is truncated!");
+		mapping.Close();
+		return false;
+	}
+
+	header = candidate;
+	frames = reinterpret_cast<const PackedFrameRecord*>(data + header->frame_table_offset);
+	time_buckets = reinterpret_cast<const uint64_t*>(data + header->time_table_offset);
+
+	return true;
+}
+
+Eigen::Matrix4d MKV_Rendering::PackedContainer::GetExtrinsic()
+{
+	Eigen::Matrix4d extrinsic;
+
+	for (int i = 0; i < 16; ++i)
+	{
+		extrinsic(i / 4, i % 4) = header->extrinsic[i];
+	}
+
+	return extrinsic;
+}
+
+bool MKV_Rendering::PackedContainer::GetPayload(size_t frame, PackedStream stream, const uint8_t*& data, size_t& size)
+{
+	auto& record = frames[frame];
+
+	size = record.sizes[(int)stream];
+
+	if (size == 0 || record.offsets[(int)stream] + size > mapping.GetSize())
+	{
+		data = nullptr;
+		return false;
+	}
+
+	data = mapping.GetData() + record.offsets[(int)stream];
+
+	return true;
+}
+
+size_t MKV_Rendering::PackedContainer::FindFrame(uint64_t time)
+{
+	size_t frame_count = GetFrameCount();
+
+	if (frame_count == 0 || time <= header->first_timestamp)
+	{
+		return 0;
+	}
+
+	uint64_t bucket = std::min((time - header->first_timestamp) / header->time_bucket_width, header->time_bucket_count - 1);
+
+	size_t frame = (size_t)time_buckets[bucket];
+
+	//At most a frame or two past the bucket's start unless the timing is very uneven
+	while (frame < frame_count && frames[frame].timestamp < time)
+	{
+		++frame;
+	}
+
+	return frame;
+}
@@ -0,0 +1,200 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <Eigen/Dense>
+#include <k4a/k4a.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+
+namespace MKV_Rendering {
+
+	/// <summary>
+	/// The payloads stored for every frame of a packed container
+	/// </summary>
+	enum class PackedStream
+	{
+		COLOR = 0,
+		DEPTH = 1,
+		MATTE = 2,
+		COUNT = 3
+	};
+
+	/// <summary>
+	/// Start of every packed container, followed by the payload chunks, the frame table and the time table
+	/// </summary>
+	struct PackedContainerHeader
+	{
+		char magic[4] = { 'V', 'P', 'A', 'K' };
+		uint32_t version = 2;
+
+		uint64_t frame_count = 0;
+
+		uint64_t frame_table_offset = 0;
+
+		/// <summary>
+		/// Time table - bucket i holds the first frame at or after first_timestamp + i * time_bucket_width
+		/// </summary>
+		uint64_t time_table_offset = 0;
+		uint64_t time_bucket_count = 0;
+		uint64_t time_bucket_width = 1;
+		uint64_t first_timestamp = 0;
+
+		/// <summary>
+		/// The camera's extrinsic matrix as used for integration, row major
+		/// </summary>
+		double extrinsic[16] = {};
+
+		/// <summary>
+		/// Set when the depth payloads are already in the color camera's space, as image folders keep them, so they are
+		/// not transformed again
+		/// </summary>
+		uint32_t depth_in_color_space = 0;
+		uint32_t padding = 0;
+
+		/// <summary>
+		/// The camera's calibration, as loaded from its intrinsics
+		/// </summary>
+		k4a_calibration_t calibration;
+	};
+
+	/// <summary>
+	/// Where one frame's payloads are in a packed container
+	/// </summary>
+	struct PackedFrameRecord
+	{
+		uint64_t timestamp = 0;
+
+		uint64_t offsets[(int)PackedStream::COUNT] = {};
+
+		/// <summary>
+		/// Size of each payload in bytes, 0 if the frame does not have it
+		/// </summary>
+		uint32_t sizes[(int)PackedStream::COUNT] = {};
+
+		uint32_t padding = 0;
+	};
+
+	/// <summary>
+	/// Writes a camera's frames into a packed container, copying the compressed files as they are
+	/// </summary>
+	class PackedContainerWriter
+	{
+		std::ofstream file;
+
+		std::string path;
+
+		PackedContainerHeader header;
+
+		std::vector<PackedFrameRecord> frames;
+
+		/// <summary>
+		/// Files of the previous frame, so a file shown for several frames is only stored once
+		/// </summary>
+		std::string previous_paths[(int)PackedStream::COUNT];
+
+		std::vector<char> read_buffer;
+
+		/// <summary>
+		/// Pads the file to the next chunk boundary
+		/// </summary>
+		void PadToChunk();
+
+		/// <summary>
+		/// Appends a file's contents to the container
+		/// </summary>
+		/// <returns>Successfully(?) read and written</returns>
+		bool AppendPayload(std::string payload_path, uint64_t& offset, uint32_t& size);
+
+	public:
+		/// <summary>
+		/// Every frame's payloads start on a chunk boundary, so a frame can be read without touching its neighbours
+		/// </summary>
+		static const uint64_t CHUNK_SIZE = 4096;
+
+		/// <summary>
+		/// Constructor. Say hi! :D
+		/// </summary>
+		PackedContainerWriter();
+
+		/// <summary>
+		/// Creates the container and reserves room for its header
+		/// </summary>
+		/// <param name="container_path">: the file to write</param>
+		/// <param name="calibration">: the camera's calibration</param>
+		/// <param name="extrinsic">: the camera's extrinsic matrix as used for integration</param>
+		/// <param name="depth_in_color_space">: the depth files are already in the color camera's space</param>
+		/// <returns>Successfully(?) created</returns>
+		bool Begin(std::string container_path, const k4a_calibration_t& calibration, const Eigen::Matrix4d& extrinsic, bool depth_in_color_space = false);
+
+		/// <summary>
+		/// Appends a frame, timestamps must not go backwards
+		/// </summary>
+		/// <param name="timestamp">: time of the frame</param>
+		/// <param name="color_path">: compressed color image</param>
+		/// <param name="depth_path">: compressed depth image</param>
+		/// <param name="matte_path">: compressed matte image, "" if there is none</param>
+		/// <returns>Successfully(?) appended</returns>
+		bool AddFrame(uint64_t timestamp, std::string color_path, std::string depth_path, std::string matte_path);
+
+		/// <summary>
+		/// Writes the frame and time tables and the header, and closes the file
+		/// </summary>
+		/// <returns>Successfully(?) finished</returns>
+		bool Finish();
+	};
+
+	/// <summary>
+	/// A packed container mapped into memory, payloads are handed out without being copied
+	/// </summary>
+	class PackedContainer
+	{
+		MappedFile mapping;
+
+		const PackedContainerHeader* header = nullptr;
+		const PackedFrameRecord* frames = nullptr;
+		const uint64_t* time_buckets = nullptr;
+
+	public:
+		/// <summary>
+		/// Constructor. Say hi! :D
+		/// </summary>
+		PackedContainer();
+
+		/// <summary>
+		/// Maps a container and checks that its tables fit in it
+		/// </summary>
+		/// <param name="container_path">: the file to open</param>
+		/// <returns>Successfully(?) opened</returns>
+		bool Open(std::string container_path);
+
+		size_t GetFrameCount() { return (header != nullptr) ? (size_t)header->frame_count : 0; }
+
+		const k4a_calibration_t& GetCalibration() { return header->calibration; }
+
+		Eigen::Matrix4d GetExtrinsic();
+
+		bool IsDepthInColorSpace() { return header->depth_in_color_space != 0; }
+
+		uint64_t GetTimestamp(size_t frame) { return frames[frame].timestamp; }
+
+		/// <summary>
+		/// Gets a frame's compressed payload straight from the mapping
+		/// </summary>
+		/// <param name="frame">: the frame</param>
+		/// <param name="stream">: which payload</param>
+		/// <param name="data">: where the payload starts</param>
+		/// <param name="size">: size of the payload in bytes</param>
+		/// <returns>False if the frame has no such payload</returns>
+		bool GetPayload(size_t frame, PackedStream stream, const uint8_t*& data, size_t& size);
+
+		/// <summary>
+		/// Finds the first frame at or after a time using the time table, without searching
+		/// </summary>
+		/// <param name="time">: the time to find</param>
+		/// <returns>The frame, or the frame count if time is after the last frame</returns>
+		size_t FindFrame(uint64_t time);
+	};
+}
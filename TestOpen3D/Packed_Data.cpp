@@ -0,0 +1,339 @@
+#include "Packed_Data.h"
+
+void MKV_Rendering::Packed_Data::UpdateTimestamp()
+{
+	_timestamp = container.GetTimestamp(current_frame);
+}
+
+void MKV_Rendering::Packed_Data::GetIntrinsicTensor()
+{
+	auto params = calibration.color_camera_calibration.intrinsics.parameters;
+
+	intrinsic_mat = Eigen::Matrix3d::Identity();
+	intrinsic_mat(0, 0) = params.param.fx;
+	intrinsic_mat(1, 1) = params.param.fy;
+	intrinsic_mat(0, 2) = params.param.cx;
+	intrinsic_mat(1, 2) = params.param.cy;
+
+	intrinsic_t = open3d::core::Tensor::Init<double>({
+			{params.param.fx, 0, params.param.cx},
+			{0, params.param.fy, params.param.cy},
+			{0, 0, 1}
+		});
+}
+
+void MKV_Rendering::Packed_Data::GetExtrinsicTensor()
+{
+	//Stored exactly as it was used for integration, already inverted
+	extrinsic_mat = container.GetExtrinsic();
+
+	extrinsic_t = open3d::core::eigen_converter::EigenMatrixToTensor(extrinsic_mat);
+}
+
+std::shared_ptr<MKV_Rendering::MatteMask> MKV_Rendering::Packed_Data::LoadMatte()
+{
+	const uint8_t* payload;
+	size_t payload_size;
+
+	if (!container.GetPayload(current_frame, PackedStream::MATTE, payload, payload_size))
+	{
+		return nullptr;
+	}
+
+	std::shared_ptr<MatteMask> matte = nullptr;
+
+	if (frame_cache != nullptr)
+	{
+		matte = frame_cache->GetMatte(index, current_frame);
+
+		if (matte != nullptr)
+		{
+			return matte;
+		}
+	}
+
+	if (!decoder.Decode(payload, payload_size, matte_buffer))
+	{
+		ErrorLogger::LOG_ERROR("Could not decode matte of frame " + std::to_string(current_frame) + "!");
+		return nullptr;
+	}
+
+	matte = std::make_shared<MatteMask>();
+	matte->FromImage(matte_buffer);
+
+	if (frame_cache != nullptr)
+	{
+		frame_cache->PutMatte(index, current_frame, matte);
+	}
+
+	return matte;
+}
+
+bool MKV_Rendering::Packed_Data::TransformDepth(open3d::geometry::Image* old_depth, open3d::geometry::RGBDImage* frame)
+{
+	std::shared_ptr<MatteMask> matte = LoadMatte();
+
+	//Reuses the frame's memory when the size matches
+	return TransformFrame(&calibration, transform, reinterpret_cast<uint16_t*>(old_depth->data_.data()), old_depth->width_, old_depth->height_, frame, matte.get());
+}
+
+MKV_Rendering::Packed_Data::Packed_Data(std::string root_folder, std::string container_file, int index) : Abstract_Data(root_folder, index)
+{
+	std::string container_path = root_folder + "/" + container_file;
+
+	if (!container.Open(container_path) || container.GetFrameCount() == 0)
+	{
+		ErrorLogger::LOG_ERROR("No frames in " + container_path + "!", true);
+		return;
+	}
+
+	calibration = container.GetCalibration();
+	MarkStartupStep("Open Container");
+
+	ErrorLogger::EXECUTE("Create Intrinsic Tensor", this, &Packed_Data::GetIntrinsicTensor);
+	ErrorLogger::EXECUTE("Create Extrinsic Tensor", this, &Packed_Data::GetExtrinsicTensor);
+	MarkStartupStep("Tensors");
+
+	imageWidth = calibration.color_camera_calibration.resolution_width;
+	imageHeight = calibration.color_camera_calibration.resolution_height;
+
+	current_frame = 0;
+	UpdateTimestamp();
+
+	std::cout << container.GetFrameCount() << " frames packed in " << container_path << std::endl;
+
+	transform = k4a_transformation_create(&calibration);
+	MarkStartupStep("Transformation");
+}
+
+MKV_Rendering::Packed_Data::~Packed_Data()
+{
+	if (transform != NULL)
+	{
+		k4a_transformation_destroy(transform);
+	}
+}
+
+bool MKV_Rendering::Packed_Data::GetCompressedPayload(PackedStream stream, const uint8_t*& data, size_t& size)
+{
+	return container.GetPayload(current_frame, stream, data, size);
+}
+
+uint64_t MKV_Rendering::Packed_Data::GetCaptureTimestamp()
+{
+	return _timestamp;
+}
+
+bool MKV_Rendering::Packed_Data::CycleCaptureForwards()
+{
+	if (current_frame + 1 >= container.GetFrameCount())
+	{
+		ErrorLogger::LOG_ERROR("Reached end of container!");
+		return false;
+	}
+
+	++current_frame;
+	UpdateTimestamp();
+
+	return true;
+}
+
+bool MKV_Rendering::Packed_Data::CycleCaptureBackwards()
+{
+	if (current_frame == 0)
+	{
+		ErrorLogger::LOG_ERROR("Reached beginning of container!");
+		return false;
+	}
+
+	--current_frame;
+	UpdateTimestamp();
+
+	return true;
+}
+
+bool MKV_Rendering::Packed_Data::SeekToTime(uint64_t time)
+{
+	size_t frame = container.FindFrame(time);
+
+	if (frame >= container.GetFrameCount())
+	{
+		current_frame = container.GetFrameCount() - 1;
+		UpdateTimestamp();
+		ErrorLogger::LOG_ERROR("Reached end of container!");
+		return false;
+	}
+
+	current_frame = frame;
+	UpdateTimestamp();
+
+	return true;
+}
+
+bool MKV_Rendering::Packed_Data::GetCaptureTimeline(std::vector<uint64_t>& timeline)
+{
+	timeline.resize(container.GetFrameCount());
+
+	for (size_t i = 0; i < timeline.size(); ++i)
+	{
+		timeline[i] = container.GetTimestamp(i);
+	}
+
+	return true;
+}
+
+bool MKV_Rendering::Packed_Data::SeekToCaptureIndex(size_t capture)
+{
+	if (capture >= container.GetFrameCount())
+	{
+		ErrorLogger::LOG_ERROR("Capture " + std::to_string(capture) + " is past the end of the container!");
+		return false;
+	}
+
+	current_frame = capture;
+	UpdateTimestamp();
+
+	return true;
+}
+
+std::shared_ptr<open3d::geometry::RGBDImage> MKV_Rendering::Packed_Data::GetFrameRGBD()
+{
+	return GetFrameStreams(FRAME_STREAM_ALL);
+}
+
+std::shared_ptr<open3d::geometry::RGBDImage> MKV_Rendering::Packed_Data::GetFrameStreams(int streams)
+{
+	if (frame_cache != nullptr)
+	{
+		auto cached = frame_cache->GetFrame(index, current_frame, FrameStream::RGBD);
+
+		if (cached != nullptr)
+		{
+			return cached;
+		}
+	}
+
+	const uint8_t* color_payload;
+	const uint8_t* depth_payload;
+	size_t color_size;
+	size_t depth_size;
+
+	if (!container.GetPayload(current_frame, PackedStream::COLOR, color_payload, color_size) ||
+		!container.GetPayload(current_frame, PackedStream::DEPTH, depth_payload, depth_size))
+	{
+		ErrorLogger::LOG_ERROR("Frame " + std::to_string(current_frame) + " is missing color or depth!");
+		return nullptr;
+	}
+
+	//Decoding into a pooled frame reuses its memory instead of allocating new images
+	auto rgbd = frame_pool.Lease();
+
+	//The color payload stays in the container, so it is only decoded once it is asked for
+	bool defer_color = (streams & FRAME_STREAM_COLOR) == 0 && !integrate_in_depth_space;
+
+	if (!defer_color && !decoder.Decode(color_payload, color_size, rgbd->color_))
+	{
+		return nullptr;
+	}
+
+	//Depth packed from an image folder is already in the color camera's space, and goes straight into the frame
+	if (container.IsDepthInColorSpace())
+	{
+		if (!decoder.Decode(depth_payload, depth_size, rgbd->depth_))
+		{
+			return nullptr;
+		}
+	}
+	else
+	{
+		if (!decoder.Decode(depth_payload, depth_size, raw_depth_buffer))
+		{
+			return nullptr;
+		}
+
+		//A frame whose depth could not be transformed is neither returned nor cached
+		if (!ErrorLogger::EXECUTE("Transforming Depth", this, &Packed_Data::TransformDepth, &raw_depth_buffer, &(*rgbd)))
+		{
+			ErrorLogger::LOG_ERROR("Could not transform depth of frame " + std::to_string(current_frame) + "!");
+			return nullptr;
+		}
+	}
+
+	if (defer_color)
+	{
+		DeferColor(rgbd, nullptr, 0);
+	}
+	else if (frame_cache != nullptr)
+	{
+		frame_cache->PutFrame(index, current_frame, FrameStream::RGBD, rgbd);
+	}
+
+	return rgbd;
+}
+
+bool MKV_Rendering::Packed_Data::DecodeDeferredColor(open3d::geometry::RGBDImage& frame)
+{
+	const uint8_t* color_payload;
+	size_t color_size;
+
+	if (!container.GetPayload(current_frame, PackedStream::COLOR, color_payload, color_size) ||
+		!decoder.Decode(color_payload, color_size, frame.color_))
+	{
+		ErrorLogger::LOG_ERROR("Could not decode the deferred color of frame " + std::to_string(current_frame) + "!");
+		return false;
+	}
+
+	//Complete now, so it can be shared like any other frame
+	if (frame_cache != nullptr)
+	{
+		frame_cache->PutFrame(index, current_frame, FrameStream::RGBD, deferred_color_frame);
+	}
+
+	return true;
+}
+
+open3d::camera::PinholeCameraParameters MKV_Rendering::Packed_Data::GetParameters()
+{
+	open3d::camera::PinholeCameraParameters to_return;
+
+	to_return.extrinsic_ = extrinsic_mat;
+
+	to_return.intrinsic_ = open3d::camera::PinholeCameraIntrinsic(
+		calibration.color_camera_calibration.resolution_width,
+		calibration.color_camera_calibration.resolution_height,
+		calibration.color_camera_calibration.intrinsics.parameters.param.fx,
+		calibration.color_camera_calibration.intrinsics.parameters.param.fy,
+		calibration.color_camera_calibration.intrinsics.parameters.param.cx,
+		calibration.color_camera_calibration.intrinsics.parameters.param.cy
+	);
+
+	return to_return;
+}
+
+void MKV_Rendering::Packed_Data::PackIntoVoxelGrid(open3d::t::geometry::TSDFVoxelGrid* grid, VoxelGridData* data)
+{
+	open3d::t::geometry::Image color;
+	open3d::t::geometry::Image depth;
+
+	AcquireFrameTensors(color, depth, grid->GetDevice());
+
+	grid->Integrate(depth, color,
+		GetFrameIntrinsic(), GetFrameExtrinsic(),
+		data->depth_scale, data->depth_max);
+}
+
+void MKV_Rendering::Packed_Data::PackIntoOldVoxelGrid(open3d::geometry::VoxelGrid* grid)
+{
+	auto rgbd = AcquireFrame(FRAME_STREAM_DEPTH);
+
+	auto params = GetFrameParameters();
+
+	grid->CarveSilhouette(rgbd->depth_, params, true);
+}
+
+void MKV_Rendering::Packed_Data::PackIntoNewVoxelGrid(MeshingVoxelGrid* grid)
+{
+	auto rgbd = AcquireFrame(grid->IsGeometryOnly() ? FRAME_STREAM_DEPTH : FRAME_STREAM_ALL);
+
+	grid->AddImage(rgbd->color_, rgbd->depth_, GetFrameExtrinsicMat(), GetFrameIntrinsicMat());
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "open3d/Open3D.h"
+#include "VoxelGridData.h"
+#include "Abstract_Data.h"
+#include "PackedContainer.h"
+#include "ImageDecoder.h"
+
+#include <k4a/k4a.h>
+#include <string>
+#include <vector>
+
+namespace MKV_Rendering {
+
+	/// <summary>
+	/// A camera packed into a single container by WritePackedContainer, read through a memory mapping
+	/// </summary>
+	class Packed_Data : public Abstract_Data
+	{
+		/// <summary>
+		/// The mapped container
+		/// </summary>
+		PackedContainer container;
+
+		/// <summary>
+		/// The camera calibration, as embedded in the container
+		/// </summary>
+		k4a_calibration_t calibration;
+
+		/// <summary>
+		/// The camera transform handle
+		/// </summary>
+		k4a_transformation_t transform = NULL;
+
+		/// <summary>
+		/// Decodes the payloads straight from the mapping
+		/// </summary>
+		ImageDecoder decoder;
+
+		/// <summary>
+		/// Current frame
+		/// </summary>
+		size_t current_frame = 0;
+
+		/// <summary>
+		/// Depth as decoded, before being moved into the color camera's space
+		/// </summary>
+		open3d::geometry::Image raw_depth_buffer;
+
+		/// <summary>
+		/// The current frame's matte as decoded, before being packed
+		/// </summary>
+		open3d::geometry::Image matte_buffer;
+
+		/// <summary>
+		/// Caches the current playback time
+		/// </summary>
+		void UpdateTimestamp();
+
+		void GetIntrinsicTensor();
+		void GetExtrinsicTensor();
+
+		/// <summary>
+		/// Gets the current frame's packed matte, from the frame cache if it was decoded before
+		/// </summary>
+		/// <returns>The matte, or nullptr if the frame has none</returns>
+		std::shared_ptr<MatteMask> LoadMatte();
+
+		bool TransformDepth(open3d::geometry::Image* old_depth, open3d::geometry::RGBDImage* frame);
+
+		bool DecodeDeferredColor(open3d::geometry::RGBDImage& frame);
+	public:
+		/// <summary>
+		/// Constructor. Say hi! :D
+		/// </summary>
+		/// <param name="root_folder">: the folder containing the container</param>
+		/// <param name="container_file">: the container's file name</param>
+		/// <param name="index">: the camera's index in the manager</param>
+		Packed_Data(std::string root_folder, std::string container_file, int index);
+
+		//Destructor. Say goodbye! :(
+		~Packed_Data();
+
+		/// <summary>
+		/// Gets a payload of the current frame, still compressed, without copying it
+		/// </summary>
+		/// <param name="stream">: which payload</param>
+		/// <param name="data">: where the payload starts</param>
+		/// <param name="size">: size of the payload in bytes</param>
+		/// <returns>False if the frame has no such payload</returns>
+		bool GetCompressedPayload(PackedStream stream, const uint8_t*& data, size_t& size);
+
+		//See Abstract_Data for below
+
+		uint64_t GetCaptureTimestamp();
+		bool CycleCaptureForwards();
+		bool CycleCaptureBackwards();
+		bool SeekToTime(uint64_t time);
+		bool GetCaptureTimeline(std::vector<uint64_t>& timeline);
+		bool SeekToCaptureIndex(size_t capture);
+
+		std::shared_ptr<open3d::geometry::RGBDImage> GetFrameRGBD();
+		std::shared_ptr<open3d::geometry::RGBDImage> GetFrameStreams(int streams);
+
+		open3d::camera::PinholeCameraParameters GetParameters();
+
+		void PackIntoVoxelGrid(open3d::t::geometry::TSDFVoxelGrid* grid, VoxelGridData* data);
+
+		void PackIntoOldVoxelGrid(open3d::geometry::VoxelGrid* grid);
+
+		void PackIntoNewVoxelGrid(MeshingVoxelGrid* grid);
+	};
+}
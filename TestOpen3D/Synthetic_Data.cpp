@@ -0,0 +1,423 @@
+#include "Synthetic_Data.h"
+
+#include <cmath>
+#include <algorithm>
+#include <type_traits>
+
+static const double SYNTHETIC_PI = 3.14159265358979323846;
+
+/// <summary>
+/// One sphere of the figure at some point in time
+/// </summary>
+struct SyntheticSphere
+{
+	Eigen::Vector3d center;
+	double radius;
+	Eigen::Vector3d color;
+};
+
+static const int SYNTHETIC_SPHERE_COUNT = 6;
+
+/// <summary>
+/// Poses the figure: hips, torso and head stacked up, with both hands swinging in opposite directions
+/// </summary>
+static void PoseFigure(double seconds, double motion_speed, SyntheticSphere* spheres)
+{
+	double swing = 0.8 * std::sin(2.0 * SYNTHETIC_PI * motion_speed * seconds);
+	double bob = 0.02 * std::sin(4.0 * SYNTHETIC_PI * motion_speed * seconds);
+
+	double arm_length = 0.45;
+
+	spheres[0] = { Eigen::Vector3d(0.0, 0.75 + bob, 0.0), 0.25, Eigen::Vector3d(0.20, 0.25, 0.60) };
+	spheres[1] = { Eigen::Vector3d(0.0, 1.10 + bob, 0.0), 0.30, Eigen::Vector3d(0.80, 0.30, 0.25) };
+	spheres[2] = { Eigen::Vector3d(0.0, 1.58 + bob, 0.0), 0.14, Eigen::Vector3d(0.90, 0.75, 0.60) };
+	spheres[3] = { Eigen::Vector3d(0.42, 1.35 - arm_length * std::cos(swing) + bob, arm_length * std::sin(swing)), 0.09, Eigen::Vector3d(0.90, 0.75, 0.60) };
+	spheres[4] = { Eigen::Vector3d(-0.42, 1.35 - arm_length * std::cos(-swing) + bob, arm_length * std::sin(-swing)), 0.09, Eigen::Vector3d(0.90, 0.75, 0.60) };
+	//A mound the figure stands on, mostly below the floor
+	spheres[5] = { Eigen::Vector3d(0.0, -0.37, 0.0), 0.55, Eigen::Vector3d(0.35, 0.55, 0.30) };
+}
+
+/// <summary>
+/// Mixes a number into a well spread 64 bit hash
+/// </summary>
+static inline uint64_t SplitMix(uint64_t x)
+{
+	x += 0x9E3779B97F4A7C15ull;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+	return x ^ (x >> 31);
+}
+
+/// <summary>
+/// Normally distributed noise that only depends on its inputs
+/// </summary>
+static inline double HashedNoise(uint64_t seed, uint64_t pixel)
+{
+	uint64_t hash = SplitMix(seed ^ SplitMix(pixel));
+
+	double u1 = ((hash >> 11) + 1.0) / 9007199254740993.0;
+	double u2 = (SplitMix(hash) >> 11) / 9007199254740992.0;
+
+	return std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * SYNTHETIC_PI * u2);
+}
+
+MKV_Rendering::SyntheticSceneSettings MKV_Rendering::SyntheticSceneSettings::FromStructure(std::map<std::string, std::string>& structure)
+{
+	SyntheticSceneSettings settings;
+
+	auto read = [&structure](std::string key, auto& value) {
+		auto found = structure.find(key);
+
+		if (found == structure.end() || found->second == "")
+		{
+			return;
+		}
+
+		try
+		{
+			value = (std::remove_reference_t<decltype(value)>)std::stod(found->second);
+		}
+		catch (const std::exception&)
+		{
+			ErrorLogger::LOG_ERROR("Could not read " + key + " '" + found->second + "', using the default!");
+		}
+	};
+
+	read("Ring_Size", settings.ring_size);
+	read("Ring_Index", settings.ring_index);
+	read("Width", settings.width);
+	read("Height", settings.height);
+	read("FOV", settings.fov);
+	read("Frames", settings.frame_count);
+	read("FPS", settings.FPS);
+	read("Ring_Radius", settings.ring_radius);
+	read("Ring_Height", settings.ring_height);
+	read("Motion_Speed", settings.motion_speed);
+	read("Depth_Noise", settings.depth_noise);
+	read("Seed", settings.seed);
+	read("Time_Offset", settings.time_offset);
+
+	return settings;
+}
+
+void MKV_Rendering::SyntheticSceneSettings::WriteStructure(std::ostream& structure_file)
+{
+	structure_file << "Type synthetic" << std::endl;
+	structure_file << "Ring_Size " << ring_size << std::endl;
+	structure_file << "Ring_Index " << ring_index << std::endl;
+	structure_file << "Width " << width << std::endl;
+	structure_file << "Height " << height << std::endl;
+	structure_file << "FOV " << fov << std::endl;
+	structure_file << "Frames " << frame_count << std::endl;
+	structure_file << "FPS " << FPS << std::endl;
+	structure_file << "Ring_Radius " << ring_radius << std::endl;
+	structure_file << "Ring_Height " << ring_height << std::endl;
+	structure_file << "Motion_Speed " << motion_speed << std::endl;
+	structure_file << "Depth_Noise " << depth_noise << std::endl;
+	structure_file << "Seed " << seed << std::endl;
+	structure_file << "Time_Offset " << time_offset << std::endl;
+}
+
+void MKV_Rendering::Synthetic_Data::UpdateTimestamp()
+{
+	_timestamp = (uint64_t)((double)current_frame / settings.FPS * 1000000.0) + settings.time_offset;
+}
+
+void MKV_Rendering::Synthetic_Data::GetIntrinsicTensor()
+{
+	double focal = settings.width / (2.0 * std::tan(settings.fov * SYNTHETIC_PI / 360.0));
+
+	intrinsic_mat = Eigen::Matrix3d::Identity();
+	intrinsic_mat(0, 0) = focal;
+	intrinsic_mat(1, 1) = focal;
+	intrinsic_mat(0, 2) = settings.width / 2.0;
+	intrinsic_mat(1, 2) = settings.height / 2.0;
+
+	intrinsic_t = open3d::core::Tensor::Init<double>({
+			{focal, 0, settings.width / 2.0},
+			{0, focal, settings.height / 2.0},
+			{0, 0, 1}
+		});
+}
+
+void MKV_Rendering::Synthetic_Data::GetExtrinsicTensor()
+{
+	double angle = 2.0 * SYNTHETIC_PI * settings.ring_index / std::max(settings.ring_size, 1);
+
+	camera_position = Eigen::Vector3d(settings.ring_radius * std::cos(angle), settings.ring_height, settings.ring_radius * std::sin(angle));
+
+	//Looks at the middle of the figure, x right, y down and z forwards like the Kinect
+	Eigen::Vector3d forward = (Eigen::Vector3d(0.0, 1.0, 0.0) - camera_position).normalized();
+	Eigen::Vector3d right = forward.cross(Eigen::Vector3d::UnitY()).normalized();
+	Eigen::Vector3d down = forward.cross(right);
+
+	camera_rotation.col(0) = right;
+	camera_rotation.col(1) = down;
+	camera_rotation.col(2) = forward;
+
+	extrinsic_mat = Eigen::Matrix4d::Identity();
+	extrinsic_mat.block<3, 3>(0, 0) = camera_rotation.transpose();
+	extrinsic_mat.block<3, 1>(0, 3) = -camera_rotation.transpose() * camera_position;
+
+	extrinsic_t = open3d::core::eigen_converter::EigenMatrixToTensor(extrinsic_mat);
+}
+
+void MKV_Rendering::Synthetic_Data::RenderFrame(size_t frame, open3d::geometry::RGBDImage& rgbd)
+{
+	rgbd.color_.Prepare(settings.width, settings.height, 3, sizeof(uint8_t));
+	rgbd.depth_.Prepare(settings.width, settings.height, 1, sizeof(uint16_t));
+
+	SyntheticSphere spheres[SYNTHETIC_SPHERE_COUNT];
+	PoseFigure(frame / settings.FPS, settings.motion_speed, spheres);
+
+	Eigen::Vector3d light = Eigen::Vector3d(0.3, 0.8, 0.5).normalized();
+
+	double fx = intrinsic_mat(0, 0);
+	double fy = intrinsic_mat(1, 1);
+	double cx = intrinsic_mat(0, 2);
+	double cy = intrinsic_mat(1, 2);
+
+	uint64_t noise_seed = SplitMix(((uint64_t)settings.seed << 32) ^ ((uint64_t)settings.ring_index << 24) ^ frame);
+
+	auto color = rgbd.color_.data_.data();
+	auto depth = reinterpret_cast<uint16_t*>(rgbd.depth_.data_.data());
+
+#pragma omp parallel for schedule(static)
+	for (int v = 0; v < settings.height; ++v)
+	{
+		for (int u = 0; u < settings.width; ++u)
+		{
+			size_t pixel = (size_t)v * settings.width + u;
+
+			//Unnormalized so that the distance along the ray is the camera space depth. Pixel centers are on whole numbers, as in integration
+			Eigen::Vector3d direction = camera_rotation * Eigen::Vector3d((u - cx) / fx, (v - cy) / fy, 1.0);
+
+			double a = direction.squaredNorm();
+			double nearest = INFINITY;
+			int hit = -1;
+
+			for (int s = 0; s < SYNTHETIC_SPHERE_COUNT; ++s)
+			{
+				Eigen::Vector3d offset = camera_position - spheres[s].center;
+
+				double b = offset.dot(direction);
+				double c = offset.squaredNorm() - spheres[s].radius * spheres[s].radius;
+				double discriminant = b * b - a * c;
+
+				if (discriminant < 0)
+				{
+					continue;
+				}
+
+				double t = (-b - std::sqrt(discriminant)) / a;
+
+				if (t > 0 && t < nearest)
+				{
+					nearest = t;
+					hit = s;
+				}
+			}
+
+			if (hit < 0)
+			{
+				depth[pixel] = 0;
+				color[pixel * 3] = color[pixel * 3 + 1] = color[pixel * 3 + 2] = 0;
+				continue;
+			}
+
+			Eigen::Vector3d normal = (camera_position + nearest * direction - spheres[hit].center) / spheres[hit].radius;
+
+			//Checkered in latitude and longitude, so surfaces have texture to match
+			int checker = ((int)std::floor(std::atan2(normal.z(), normal.x()) * 4.0 / SYNTHETIC_PI) +
+				(int)std::floor(std::asin(std::clamp(normal.y(), -1.0, 1.0)) * 4.0 / SYNTHETIC_PI)) & 1;
+
+			double shade = (0.35 + 0.65 * std::max(normal.dot(light), 0.0)) * (checker ? 1.0 : 0.7);
+
+			for (int ch = 0; ch < 3; ++ch)
+			{
+				color[pixel * 3 + ch] = (uint8_t)std::min(255.0, spheres[hit].color[ch] * shade * 255.0);
+			}
+
+			double millimeters = nearest * 1000.0;
+
+			if (settings.depth_noise > 0)
+			{
+				millimeters += settings.depth_noise * HashedNoise(noise_seed, pixel);
+			}
+
+			depth[pixel] = (uint16_t)std::clamp(millimeters + 0.5, 1.0, 65535.0);
+		}
+	}
+}
+
+MKV_Rendering::Synthetic_Data::Synthetic_Data(std::string root_folder, SyntheticSceneSettings settings, int index) : Abstract_Data(root_folder, index), settings(settings)
+{
+	if (this->settings.frame_count <= 0 || this->settings.FPS <= 0 || this->settings.width <= 0 || this->settings.height <= 0)
+	{
+		ErrorLogger::LOG_ERROR("Synthetic camera in " + root_folder + " needs a positive size, frame count and FPS!", true);
+	}
+
+	ErrorLogger::EXECUTE("Create Intrinsic Tensor", this, &Synthetic_Data::GetIntrinsicTensor);
+	ErrorLogger::EXECUTE("Create Extrinsic Tensor", this, &Synthetic_Data::GetExtrinsicTensor);
+	MarkStartupStep("Tensors");
+
+	imageWidth = this->settings.width;
+	imageHeight = this->settings.height;
+
+	current_frame = 0;
+	UpdateTimestamp();
+
+	std::cout << "Synthetic camera " << this->settings.ring_index << " of " << this->settings.ring_size << ", " << this->settings.frame_count << " frames" << std::endl;
+}
+
+MKV_Rendering::Synthetic_Data::~Synthetic_Data()
+{
+}
+
+uint64_t MKV_Rendering::Synthetic_Data::GetCaptureTimestamp()
+{
+	return _timestamp;
+}
+
+bool MKV_Rendering::Synthetic_Data::CycleCaptureForwards()
+{
+	if (current_frame + 1 >= (size_t)settings.frame_count)
+	{
+		ErrorLogger::LOG_ERROR("Reached end of synthetic recording!");
+		return false;
+	}
+
+	++current_frame;
+	UpdateTimestamp();
+
+	return true;
+}
+
+bool MKV_Rendering::Synthetic_Data::CycleCaptureBackwards()
+{
+	if (current_frame == 0)
+	{
+		ErrorLogger::LOG_ERROR("Reached beginning of synthetic recording!");
+		return false;
+	}
+
+	--current_frame;
+	UpdateTimestamp();
+
+	return true;
+}
+
+bool MKV_Rendering::Synthetic_Data::SeekToTime(uint64_t time)
+{
+	std::vector<uint64_t> timeline;
+	GetCaptureTimeline(timeline);
+
+	size_t frame = std::lower_bound(timeline.begin(), timeline.end(), time) - timeline.begin();
+
+	if (frame >= timeline.size())
+	{
+		current_frame = timeline.size() - 1;
+		UpdateTimestamp();
+		ErrorLogger::LOG_ERROR("Reached end of synthetic recording!");
+		return false;
+	}
+
+	current_frame = frame;
+	UpdateTimestamp();
+
+	return true;
+}
+
+bool MKV_Rendering::Synthetic_Data::GetCaptureTimeline(std::vector<uint64_t>& timeline)
+{
+	timeline.resize(settings.frame_count);
+
+	//Same conversion as UpdateTimestamp
+	for (size_t i = 0; i < timeline.size(); ++i)
+	{
+		timeline[i] = (uint64_t)((double)i / settings.FPS * 1000000.0) + settings.time_offset;
+	}
+
+	return true;
+}
+
+bool MKV_Rendering::Synthetic_Data::SeekToCaptureIndex(size_t capture)
+{
+	if (capture >= (size_t)settings.frame_count)
+	{
+		ErrorLogger::LOG_ERROR("Capture " + std::to_string(capture) + " is past the end of the synthetic recording!");
+		return false;
+	}
+
+	current_frame = capture;
+	UpdateTimestamp();
+
+	return true;
+}
+
+std::shared_ptr<open3d::geometry::RGBDImage> MKV_Rendering::Synthetic_Data::GetFrameRGBD()
+{
+	if (frame_cache != nullptr)
+	{
+		auto cached = frame_cache->GetFrame(index, current_frame, FrameStream::RGBD);
+
+		if (cached != nullptr)
+		{
+			return cached;
+		}
+	}
+
+	auto rgbd = frame_pool.Lease();
+
+	RenderFrame(current_frame, *rgbd);
+
+	if (frame_cache != nullptr)
+	{
+		frame_cache->PutFrame(index, current_frame, FrameStream::RGBD, rgbd);
+	}
+
+	return rgbd;
+}
+
+open3d::camera::PinholeCameraParameters MKV_Rendering::Synthetic_Data::GetParameters()
+{
+	open3d::camera::PinholeCameraParameters to_return;
+
+	to_return.extrinsic_ = extrinsic_mat;
+
+	to_return.intrinsic_ = open3d::camera::PinholeCameraIntrinsic(
+		settings.width, settings.height,
+		intrinsic_mat(0, 0), intrinsic_mat(1, 1),
+		intrinsic_mat(0, 2), intrinsic_mat(1, 2)
+	);
+
+	return to_return;
+}
+
+void MKV_Rendering::Synthetic_Data::PackIntoVoxelGrid(open3d::t::geometry::TSDFVoxelGrid* grid, VoxelGridData* data)
+{
+	open3d::t::geometry::Image color;
+	open3d::t::geometry::Image depth;
+
+	AcquireFrameTensors(color, depth, grid->GetDevice());
+
+	grid->Integrate(depth, color,
+		GetFrameIntrinsic(), extrinsic_t,
+		data->depth_scale, data->depth_max);
+}
+
+void MKV_Rendering::Synthetic_Data::PackIntoOldVoxelGrid(open3d::geometry::VoxelGrid* grid)
+{
+	auto rgbd = AcquireFrame(FRAME_STREAM_DEPTH);
+
+	auto params = GetFrameParameters();
+
+	grid->CarveSilhouette(rgbd->depth_, params, true);
+}
+
+void MKV_Rendering::Synthetic_Data::PackIntoNewVoxelGrid(MeshingVoxelGrid* grid)
+{
+	auto rgbd = AcquireFrame(grid->IsGeometryOnly() ? FRAME_STREAM_DEPTH : FRAME_STREAM_ALL);
+
+	grid->AddImage(rgbd->color_, rgbd->depth_, extrinsic_mat, intrinsic_mat);
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "open3d/Open3D.h"
+#include "VoxelGridData.h"
+#include "Abstract_Data.h"
+
+#include <string>
+#include <vector>
+#include <map>
+
+namespace MKV_Rendering {
+
+	/// <summary>
+	/// Everything that decides what a synthetic camera sees. All lengths are in meters
+	/// </summary>
+	struct SyntheticSceneSettings
+	{
+		/// <summary>
+		/// How many cameras stand in the ring, and which of them this is
+		/// </summary>
+		int ring_size = 8;
+		int ring_index = 0;
+
+		int width = 640;
+		int height = 576;
+
+		/// <summary>
+		/// Horizontal field of view in degrees
+		/// </summary>
+		double fov = 75.0;
+
+		int frame_count = 300;
+		double FPS = 30.0;
+
+		/// <summary>
+		/// Distance of the cameras from the middle of the scene, and their height
+		/// </summary>
+		double ring_radius = 2.0;
+		double ring_height = 1.2;
+
+		/// <summary>
+		/// How fast the figure moves, 1 is one arm swing a second
+		/// </summary>
+		double motion_speed = 1.0;
+
+		/// <summary>
+		/// Standard deviation of the depth noise in millimeters, 0 for none
+		/// </summary>
+		double depth_noise = 0.0;
+
+		/// <summary>
+		/// Seeds the depth noise, the same seed always gives the same frames
+		/// </summary>
+		uint32_t seed = 0;
+
+		/// <summary>
+		/// Added to every timestamp of this camera in microseconds, to imitate cameras that did not start together
+		/// </summary>
+		uint64_t time_offset = 0;
+
+		/// <summary>
+		/// Reads the settings from a .structure file's keys, keeping the defaults for missing keys
+		/// </summary>
+		/// <param name="structure">: the keys and values of the .structure file</param>
+		/// <returns>The settings</returns>
+		static SyntheticSceneSettings FromStructure(std::map<std::string, std::string>& structure);
+
+		/// <summary>
+		/// Writes the settings as .structure file lines
+		/// </summary>
+		/// <param name="structure_file">: where to write</param>
+		void WriteStructure(std::ostream& structure_file);
+	};
+
+	/// <summary>
+	/// A camera with no recording behind it, which renders an animated figure from its place in a ring of cameras. Frames are
+	/// ray cast on the fly and are the same on every run, so benchmarks do not need real captures
+	/// </summary>
+	class Synthetic_Data : public Abstract_Data
+	{
+		SyntheticSceneSettings settings;
+
+		/// <summary>
+		/// Current frame
+		/// </summary>
+		size_t current_frame = 0;
+
+		/// <summary>
+		/// Camera to world rotation and the camera's position, the inverse of the extrinsic
+		/// </summary>
+		Eigen::Matrix3d camera_rotation;
+		Eigen::Vector3d camera_position;
+
+		/// <summary>
+		/// Caches the current playback time
+		/// </summary>
+		void UpdateTimestamp();
+
+		void GetIntrinsicTensor();
+		void GetExtrinsicTensor();
+
+		/// <summary>
+		/// Ray casts a frame of the scene
+		/// </summary>
+		/// <param name="frame">: which frame to render</param>
+		/// <param name="rgbd">: destination, prepared to fit</param>
+		void RenderFrame(size_t frame, open3d::geometry::RGBDImage& rgbd);
+
+	public:
+		/// <summary>
+		/// Constructor. Say hi! :D
+		/// </summary>
+		/// <param name="root_folder">: the camera's folder, only used to name it</param>
+		/// <param name="settings">: the scene and this camera's place in the ring</param>
+		/// <param name="index">: the camera's index in the manager</param>
+		Synthetic_Data(std::string root_folder, SyntheticSceneSettings settings, int index);
+
+		//Destructor. Say goodbye! :(
+		~Synthetic_Data();
+
+		//See Abstract_Data for below
+
+		uint64_t GetCaptureTimestamp();
+		bool CycleCaptureForwards();
+		bool CycleCaptureBackwards();
+		bool SeekToTime(uint64_t time);
+		bool GetCaptureTimeline(std::vector<uint64_t>& timeline);
+		bool SeekToCaptureIndex(size_t capture);
+
+		std::shared_ptr<open3d::geometry::RGBDImage> GetFrameRGBD();
+
+		open3d::camera::PinholeCameraParameters GetParameters();
+
+		void PackIntoVoxelGrid(open3d::t::geometry::TSDFVoxelGrid* grid, VoxelGridData* data);
+
+		void PackIntoOldVoxelGrid(open3d::geometry::VoxelGrid* grid);
+
+		void PackIntoNewVoxelGrid(MeshingVoxelGrid* grid);
+	};
+}
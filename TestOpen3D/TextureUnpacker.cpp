@@ -71,7 +71,7 @@ bool TextureUnpacker::PackUV(geometry::Image& im, geometry::TriangleMesh& mesh,
 /// <param name="outputImage">Output texture. Resize this to the desired height/width/channels/etc before sending it to this function.</param>
 /// <param name="debug_info">Whether or not to debug additional information - highly inefficient, only use to debug</param>
 /// <returns></returns>
-bool TextureUnpacker::PerformTextureUnpack(std::vector<open3d::geometry::Image>* color_array, geometry::TriangleMesh* mesh, geometry::Image* outputImage, bool debug_info)
+bool TextureUnpacker::PerformTextureUnpack(std::vector<const open3d::geometry::Image*>* color_array, geometry::TriangleMesh* mesh, geometry::Image* outputImage, bool debug_info)
 {
     UvpOperationInputT uvpInput;
 
@@ -188,8 +188,8 @@ bool TextureUnpacker::PerformTextureUnpack(std::vector<open3d::geometry::Image>*
     int intW = outputImage->width_;
     int intH = outputImage->height_;
 
-    double w2 = (double)color_array->at(0).width_;
-    double h2 = (double)color_array->at(0).height_;
+    double w2 = (double)color_array->at(0)->width_;
+    double h2 = (double)color_array->at(0)->height_;
 
     double step = 1.0 / sqrt(2.0);
 
@@ -277,27 +277,27 @@ bool TextureUnpacker::PerformTextureUnpack(std::vector<open3d::geometry::Image>*
                     v1 = h - v1 - 1;
                     v2 = h2 - v2 - 1;
 
-                    (*outputImage->PointerAt<uint8_t>(u0, v0, 0)) = (*color_array->at(source_image).PointerAt<uint8_t>(u2, v2, 0));
-                    (*outputImage->PointerAt<uint8_t>(u0, v0, 1)) = (*color_array->at(source_image).PointerAt<uint8_t>(u2, v2, 1));
-                    (*outputImage->PointerAt<uint8_t>(u0, v0, 2)) = (*color_array->at(source_image).PointerAt<uint8_t>(u2, v2, 2));
+                    (*outputImage->PointerAt<uint8_t>(u0, v0, 0)) = (*color_array->at(source_image)->PointerAt<uint8_t>(u2, v2, 0));
+                    (*outputImage->PointerAt<uint8_t>(u0, v0, 1)) = (*color_array->at(source_image)->PointerAt<uint8_t>(u2, v2, 1));
+                    (*outputImage->PointerAt<uint8_t>(u0, v0, 2)) = (*color_array->at(source_image)->PointerAt<uint8_t>(u2, v2, 2));
 
                     //One day the code below will work
                     
-                    //(*outputImage->PointerAt<uint8_t>(u0, v0, 0)) = image_weights[v0 * (int)w + u0] * (*outputImage->PointerAt<uint8_t>(u0, v0, 0)) + deltaX * deltaY * (*color_array->at(source_image).PointerAt<uint8_t>(u2, v2, 0));
-                    //(*outputImage->PointerAt<uint8_t>(u0, v0, 1)) = image_weights[v0 * (int)w + u0] * (*outputImage->PointerAt<uint8_t>(u0, v0, 1)) + deltaX * deltaY * (*color_array->at(source_image).PointerAt<uint8_t>(u2, v2, 1));
-                    //(*outputImage->PointerAt<uint8_t>(u0, v0, 2)) = image_weights[v0 * (int)w + u0] * (*outputImage->PointerAt<uint8_t>(u0, v0, 2)) + deltaX * deltaY * (*color_array->at(source_image).PointerAt<uint8_t>(u2, v2, 2));
+                    //(*outputImage->PointerAt<uint8_t>(u0, v0, 0)) = image_weights[v0 * (int)w + u0] * (*outputImage->PointerAt<uint8_t>(u0, v0, 0)) + deltaX * deltaY * (*color_array->at(source_image)->PointerAt<uint8_t>(u2, v2, 0));
+                    //(*outputImage->PointerAt<uint8_t>(u0, v0, 1)) = image_weights[v0 * (int)w + u0] * (*outputImage->PointerAt<uint8_t>(u0, v0, 1)) + deltaX * deltaY * (*color_array->at(source_image)->PointerAt<uint8_t>(u2, v2, 1));
+                    //(*outputImage->PointerAt<uint8_t>(u0, v0, 2)) = image_weights[v0 * (int)w + u0] * (*outputImage->PointerAt<uint8_t>(u0, v0, 2)) + deltaX * deltaY * (*color_array->at(source_image)->PointerAt<uint8_t>(u2, v2, 2));
                     //
-                    //(*outputImage->PointerAt<uint8_t>(u0, v1, 0)) = image_weights[v1 * (int)w + u0] * (*outputImage->PointerAt<uint8_t>(u0, v1, 0)) + deltaX * (1.0 - deltaY) * (*color_array->at(source_image).PointerAt<uint8_t>(u2, v2, 0));
-                    //(*outputImage->PointerAt<uint8_t>(u0, v1, 1)) = image_weights[v1 * (int)w + u0] * (*outputImage->PointerAt<uint8_t>(u0, v1, 1)) + deltaX * (1.0 - deltaY) * (*color_array->at(source_image).PointerAt<uint8_t>(u2, v2, 1));
-                    //(*outputImage->PointerAt<uint8_t>(u0, v1, 2)) = image_weights[v1 * (int)w + u0] * (*outputImage->PointerAt<uint8_t>(u0, v1, 2)) + deltaX * (1.0 - deltaY) * (*color_array->at(source_image).PointerAt<uint8_t>(u2, v2, 2));
+                    //(*outputImage->PointerAt<uint8_t>(u0, v1, 0)) = image_weights[v1 * (int)w + u0] * (*outputImage->PointerAt<uint8_t>(u0, v1, 0)) + deltaX * (1.0 - deltaY) * (*color_array->at(source_image)->PointerAt<uint8_t>(u2, v2, 0));
+                    //(*outputImage->PointerAt<uint8_t>(u0, v1, 1)) = image_weights[v1 * (int)w + u0] * (*outputImage->PointerAt<uint8_t>(u0, v1, 1)) + deltaX * (1.0 - deltaY) * (*color_array->at(source_image)->PointerAt<uint8_t>(u2, v2, 1));
+                    //(*outputImage->PointerAt<uint8_t>(u0, v1, 2)) = image_weights[v1 * (int)w + u0] * (*outputImage->PointerAt<uint8_t>(u0, v1, 2)) + deltaX * (1.0 - deltaY) * (*color_array->at(source_image)->PointerAt<uint8_t>(u2, v2, 2));
                     //
-                    //(*outputImage->PointerAt<uint8_t>(u1, v0, 0)) = image_weights[v0 * (int)w + u1] * (*outputImage->PointerAt<uint8_t>(u1, v0, 0)) + (1.0 - deltaX) * deltaY * (*color_array->at(source_image).PointerAt<uint8_t>(u2, v2, 0));
-                    //(*outputImage->PointerAt<uint8_t>(u1, v0, 1)) = image_weights[v0 * (int)w + u1] * (*outputImage->PointerAt<uint8_t>(u1, v0, 1)) + (1.0 - deltaX) * deltaY * (*color_array->at(source_image).PointerAt<uint8_t>(u2, v2, 1));
-                    //(*outputImage->PointerAt<uint8_t>(u1, v0, 2)) = image_weights[v0 * (int)w + u1] * (*outputImage->PointerAt<uint8_t>(u1, v0, 2)) + (1.0 - deltaX) * deltaY * (*color_array->at(source_image).PointerAt<uint8_t>(u2, v2, 2));
+                    //(*outputImage->PointerAt<uint8_t>(u1, v0, 0)) = image_weights[v0 * (int)w + u1] * (*outputImage->PointerAt<uint8_t>(u1, v0, 0)) + (1.0 - deltaX) * deltaY * (*color_array->at(source_image)->PointerAt<uint8_t>(u2, v2, 0));
+                    //(*outputImage->PointerAt<uint8_t>(u1, v0, 1)) = image_weights[v0 * (int)w + u1] * (*outputImage->PointerAt<uint8_t>(u1, v0, 1)) + (1.0 - deltaX) * deltaY * (*color_array->at(source_image)->PointerAt<uint8_t>(u2, v2, 1));
+                    //(*outputImage->PointerAt<uint8_t>(u1, v0, 2)) = image_weights[v0 * (int)w + u1] * (*outputImage->PointerAt<uint8_t>(u1, v0, 2)) + (1.0 - deltaX) * deltaY * (*color_array->at(source_image)->PointerAt<uint8_t>(u2, v2, 2));
                     //
-                    //(*outputImage->PointerAt<uint8_t>(u1, v1, 0)) = image_weights[v1 * (int)w + u1] * (*outputImage->PointerAt<uint8_t>(u1, v1, 0)) + (1.0 - deltaX) * (1.0 - deltaY) * (*color_array->at(source_image).PointerAt<uint8_t>(u2, v2, 0));
-                    //(*outputImage->PointerAt<uint8_t>(u1, v1, 1)) = image_weights[v1 * (int)w + u1] * (*outputImage->PointerAt<uint8_t>(u1, v1, 1)) + (1.0 - deltaX) * (1.0 - deltaY) * (*color_array->at(source_image).PointerAt<uint8_t>(u2, v2, 1));
-                    //(*outputImage->PointerAt<uint8_t>(u1, v1, 2)) = image_weights[v1 * (int)w + u1] * (*outputImage->PointerAt<uint8_t>(u1, v1, 2)) + (1.0 - deltaX) * (1.0 - deltaY) * (*color_array->at(source_image).PointerAt<uint8_t>(u2, v2, 2));
+                    //(*outputImage->PointerAt<uint8_t>(u1, v1, 0)) = image_weights[v1 * (int)w + u1] * (*outputImage->PointerAt<uint8_t>(u1, v1, 0)) + (1.0 - deltaX) * (1.0 - deltaY) * (*color_array->at(source_image)->PointerAt<uint8_t>(u2, v2, 0));
+                    //(*outputImage->PointerAt<uint8_t>(u1, v1, 1)) = image_weights[v1 * (int)w + u1] * (*outputImage->PointerAt<uint8_t>(u1, v1, 1)) + (1.0 - deltaX) * (1.0 - deltaY) * (*color_array->at(source_image)->PointerAt<uint8_t>(u2, v2, 1));
+                    //(*outputImage->PointerAt<uint8_t>(u1, v1, 2)) = image_weights[v1 * (int)w + u1] * (*outputImage->PointerAt<uint8_t>(u1, v1, 2)) + (1.0 - deltaX) * (1.0 - deltaY) * (*color_array->at(source_image)->PointerAt<uint8_t>(u2, v2, 2));
                     //
                     //image_weights[v0 * (int)w + u0] += deltaX * deltaY;
                     //image_weights[v1 * (int)w + u0] += deltaX * (1.0 - deltaY);
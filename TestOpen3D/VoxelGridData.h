@@ -10,6 +10,7 @@ namespace MKV_Rendering {
         float depth_scale = 1000.f; //May need to change
         float depth_max = 3.f; //May need to change
         float signed_distance_field_truncation = 0.04f; //May need to change
+        bool integrate_in_depth_space = false; //Integrates at the depth camera's resolution with color mapped onto it, far fewer pixels per camera
 
         std::string device_code = "CPU:0"; //May need to change, but probably not
     };